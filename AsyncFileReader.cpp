@@ -0,0 +1,657 @@
+#include "AsyncFileReader.h"
+#include "DDSCompression.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace {
+
+// The whole range, or less at the end of the file
+int readRange(const std::string& path, uint64_t offset, size_t size, std::vector<uint8_t>& data) {
+#ifdef _WIN32
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return ENOENT;
+	data.resize(size);
+	file.seekg(std::streamoff(offset), std::ios::beg);
+	file.read(reinterpret_cast<char*>(data.data()), std::streamsize(size));
+	data.resize(size_t(file.gcount()));
+	return file.bad() ? EIO : 0;
+#else
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return errno;
+
+	int error = 0;
+	size_t done = 0;
+	data.resize(size);
+	while (done < size) {
+		const ssize_t bytes = pread(fd, data.data() + done, size - done, off_t(offset + done));
+		if (bytes < 0) {
+			if (errno == EINTR) continue;
+			error = errno;
+			break;
+		}
+		if (bytes == 0) break;    // The end of the file
+		done += size_t(bytes);
+	}
+	close(fd);
+	data.resize(error ? 0 : done);
+	return error;
+#endif
+}
+
+// A blocking pread per task, the tasks spread over the pool
+class ThreadPoolFileReader final : public AsyncFileReader {
+public:
+	explicit ThreadPoolFileReader(unsigned threads) : pool(threads) {}
+
+	void submit(const std::string& path, uint64_t offset, size_t size, Callback done) override {
+		pool.submit([path, offset, size, done = std::move(done)] {
+			std::vector<uint8_t> data;
+			int error;
+			try {
+				error = readRange(path, offset, size, data);
+			} catch (const std::bad_alloc&) {
+				data = {};
+				error = ENOMEM;
+			}
+			done(error, std::move(data));
+		});
+	}
+
+	Backend getBackend() const override { return Backend::ThreadPool; }
+
+protected:
+	void process(std::function<void()> task) override {
+		pool.submit(std::move(task));
+	}
+
+private:
+	WorkStealingPool pool;
+};
+
+#ifdef __linux__
+
+// The ring, the registered buffers and the requests all belong to one thread, which submits and
+// reaps. The other threads only queue the requests and poke it through an eventfd, whose read is
+// always pending on the ring, so a single io_uring_enter waits for both the new requests and the
+// completions. The files are opened on the ring thread too: that blocks on the metadata sometimes,
+// but never the caller.
+//
+// The reads that fit a registered buffer once rounded to the block size go through it, with
+// O_DIRECT if the file system takes it, and are copied out. The larger ones go straight to the
+// result through the page cache.
+class IoUringFileReader final : public AsyncFileReader {
+public:
+	static std::unique_ptr<IoUringFileReader> create(unsigned threads) {
+		std::unique_ptr<IoUringFileReader> reader(new IoUringFileReader(threads));
+		if (!reader->setup()) return nullptr;
+		reader->thread = std::thread(&IoUringFileReader::ringLoop, reader.get());
+		return reader;
+	}
+
+	~IoUringFileReader() override {
+		if (thread.joinable()) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				stopping = true;
+			}
+			wake();
+			thread.join();
+		}
+
+		if (sqes) munmap(sqes, sqesSize);
+		if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+		if (sqRing) munmap(sqRing, sqRingSize);
+		if (ringFd >= 0) close(ringFd);
+		if (wakeFd >= 0) close(wakeFd);
+		std::free(fixedBuffers);
+	}
+
+	void submit(const std::string& path, uint64_t offset, size_t size, Callback done) override {
+		auto request = std::make_unique<Request>();
+		request->path = path;
+		request->offset = offset;
+		request->size = size;
+		request->done = std::move(done);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			incoming.push_back(std::move(request));
+		}
+		wake();
+	}
+
+	Backend getBackend() const override { return Backend::IoUring; }
+
+protected:
+	// The task may queue more reads, so the ring thread keeps going until it is done
+	void process(std::function<void()> task) override {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			processing++;
+		}
+		pool.submit([this, task = std::move(task)] {
+			task();
+			// Woken under the lock: once the ring thread sees the count at zero it may exit, and the
+			// destructor close the eventfd under a write still on its way
+			std::lock_guard<std::mutex> lock(mutex);
+			processing--;
+			if (stopping) wake();
+		});
+	}
+
+private:
+	static constexpr unsigned QUEUE_DEPTH = 64;
+	static constexpr unsigned MAX_ACTIVE = QUEUE_DEPTH - 1;    // One entry is the eventfd read
+	static constexpr size_t FIXED_BUFFER_COUNT = 8;
+	static constexpr size_t FIXED_BUFFER_SIZE = 1 << 20;
+	static constexpr size_t DIRECT_ALIGNMENT = 4096;           // The logical block size of about every disk
+	static constexpr uint32_t MAX_READ = 1u << 30;             // The length of an entry is 32-bit
+	static constexpr uint64_t WAKE_TAG = 0;                    // The requests are tagged with their address
+
+	struct Request {
+		std::string path;
+		uint64_t offset = 0;
+		size_t size = 0;
+		Callback done;
+
+		int fd = -1;
+		bool direct = false;
+		int buffer = -1;              // The registered buffer, or -1 to read into data
+		uint64_t alignedOffset = 0;   // The range read into the registered buffer
+		size_t alignedSize = 0;
+		size_t completed = 0;         // Of the range being read
+		std::vector<uint8_t> data;
+	};
+
+	int ringFd = -1;
+	int wakeFd = -1;
+	uint64_t wakeValue = 0;
+
+	void* sqRing = nullptr;
+	void* cqRing = nullptr;
+	size_t sqRingSize = 0, cqRingSize = 0;
+	io_uring_sqe* sqes = nullptr;
+	size_t sqesSize = 0;
+	unsigned* sqTail = nullptr;
+	unsigned* sqMask = nullptr;
+	unsigned* sqArray = nullptr;
+	unsigned* cqHead = nullptr;
+	unsigned* cqTail = nullptr;
+	unsigned* cqMask = nullptr;
+	io_uring_cqe* cqes = nullptr;
+
+	uint8_t* fixedBuffers = nullptr;
+	std::vector<int> freeBuffers;    // Empty when the kernel didn't take the registration
+
+	// The ring thread only
+	unsigned active = 0;
+	unsigned toSubmit = 0;
+
+	std::mutex mutex;
+	std::deque<std::unique_ptr<Request>> incoming;    // Under mutex
+	size_t processing = 0;                            // Under mutex, the tasks on the pool
+	bool stopping = false;                            // Under mutex
+	WorkStealingPool pool;
+	std::thread thread;
+
+	explicit IoUringFileReader(unsigned threads) : pool(threads) {}
+
+	bool setup() {
+		io_uring_params params = {};
+		ringFd = int(syscall(__NR_io_uring_setup, QUEUE_DEPTH, &params));
+		if (ringFd < 0) return false;
+
+		sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		if (params.features & IORING_FEAT_SINGLE_MMAP) sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+		sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+		if (sqRing == MAP_FAILED) {
+			sqRing = nullptr;
+			return false;
+		}
+		if (params.features & IORING_FEAT_SINGLE_MMAP) {
+			cqRing = sqRing;
+		} else {
+			cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+			if (cqRing == MAP_FAILED) {
+				cqRing = nullptr;
+				return false;
+			}
+		}
+		sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* entries = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+		if (entries == MAP_FAILED) return false;
+		sqes = static_cast<io_uring_sqe*>(entries);
+
+		auto* sq = static_cast<uint8_t*>(sqRing);
+		auto* cq = static_cast<uint8_t*>(cqRing);
+		sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		wakeFd = eventfd(0, EFD_CLOEXEC);
+		if (wakeFd < 0) return false;
+
+		// The registered buffers are pinned, older kernels count them against RLIMIT_MEMLOCK.
+		// Without them every read goes through the page cache, which is still asynchronous
+		fixedBuffers = static_cast<uint8_t*>(std::aligned_alloc(DIRECT_ALIGNMENT, FIXED_BUFFER_COUNT * FIXED_BUFFER_SIZE));
+		if (fixedBuffers) {
+			iovec buffers[FIXED_BUFFER_COUNT];
+			for (size_t i = 0; i < FIXED_BUFFER_COUNT; i++) {
+				buffers[i].iov_base = fixedBuffers + i * FIXED_BUFFER_SIZE;
+				buffers[i].iov_len = FIXED_BUFFER_SIZE;
+			}
+			if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, buffers, FIXED_BUFFER_COUNT) == 0) {
+				for (size_t i = FIXED_BUFFER_COUNT; i > 0; i--) freeBuffers.push_back(int(i - 1));
+			} else {
+				std::free(fixedBuffers);
+				fixedBuffers = nullptr;
+			}
+		}
+		return true;
+	}
+
+	void wake() {
+		const uint64_t one = 1;
+		[[maybe_unused]] ssize_t written = write(wakeFd, &one, sizeof(one));
+	}
+
+	io_uring_sqe& nextEntry() {
+		const unsigned tail = *sqTail;    // Only this thread moves the tail
+		const unsigned index = tail & *sqMask;
+		io_uring_sqe& entry = sqes[index];
+		std::memset(&entry, 0, sizeof(entry));
+		sqArray[index] = index;
+		std::atomic_ref<unsigned>(*sqTail).store(tail + 1, std::memory_order_release);
+		toSubmit++;
+		return entry;
+	}
+
+	void armWake() {
+		io_uring_sqe& entry = nextEntry();
+		entry.opcode = IORING_OP_READ;
+		entry.fd = wakeFd;
+		entry.addr = reinterpret_cast<uint64_t>(&wakeValue);
+		entry.len = sizeof(wakeValue);
+		entry.user_data = WAKE_TAG;
+	}
+
+	void queueRead(Request* request) {
+		io_uring_sqe& entry = nextEntry();
+		entry.fd = request->fd;
+		entry.user_data = reinterpret_cast<uint64_t>(request);
+		if (request->buffer >= 0) {
+			entry.opcode = IORING_OP_READ_FIXED;
+			entry.addr = reinterpret_cast<uint64_t>(fixedBuffers + size_t(request->buffer) * FIXED_BUFFER_SIZE + request->completed);
+			entry.len = uint32_t(request->alignedSize - request->completed);
+			entry.off = request->alignedOffset + request->completed;
+			entry.buf_index = uint16_t(request->buffer);
+		} else {
+			entry.opcode = IORING_OP_READ;
+			entry.addr = reinterpret_cast<uint64_t>(request->data.data() + request->completed);
+			entry.len = uint32_t(std::min<size_t>(request->size - request->completed, MAX_READ));
+			entry.off = request->offset + request->completed;
+		}
+	}
+
+	void start(std::unique_ptr<Request> owned) {
+		Request* request = owned.release();    // Back in a unique_ptr in finish
+		active++;
+
+		const uint64_t end = request->offset + request->size;
+		request->alignedOffset = request->offset & ~uint64_t(DIRECT_ALIGNMENT - 1);
+		request->alignedSize = size_t((end + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT - request->alignedOffset);
+
+		if (request->alignedSize <= FIXED_BUFFER_SIZE && !freeBuffers.empty()) {
+			request->buffer = freeBuffers.back();
+			freeBuffers.pop_back();
+			request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+			request->direct = request->fd >= 0;
+		} else {
+			try {
+				request->data.resize(request->size);
+			} catch (const std::bad_alloc&) {
+				finish(request, ENOMEM);
+				return;
+			}
+		}
+		if (request->fd < 0) request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (request->fd < 0) {
+			finish(request, errno);
+			return;
+		}
+
+		if (request->size == 0) {
+			finish(request, 0);
+			return;
+		}
+		queueRead(request);
+	}
+
+	void complete(Request* request, int result) {
+		if (result == -EINTR || result == -EAGAIN) {
+			queueRead(request);
+			return;
+		}
+		// The file system took O_DIRECT at open, but not this range. The page cache then
+		if (result == -EINVAL && request->direct) {
+			close(request->fd);
+			request->direct = false;
+			request->fd = open(request->path.c_str(), O_RDONLY | O_CLOEXEC);
+			if (request->fd < 0) {
+				finish(request, errno);
+				return;
+			}
+			queueRead(request);
+			return;
+		}
+		if (result < 0) {
+			finish(request, -result);
+			return;
+		}
+
+		request->completed += size_t(result);
+		const size_t wanted = request->buffer >= 0 ? request->alignedSize : request->size;
+		if (result == 0 || request->completed >= wanted) {
+			finish(request, 0);
+		} else {
+			queueRead(request);
+		}
+	}
+
+	void finish(Request* raw, int error) {
+		std::unique_ptr<Request> request(raw);
+		if (request->fd >= 0) close(request->fd);
+
+		if (request->buffer >= 0) {
+			// The requested part of the aligned range, or what the file had of it
+			if (!error) {
+				const size_t skip = size_t(request->offset - request->alignedOffset);
+				const size_t bytes = request->completed > skip ? std::min(request->size, request->completed - skip) : 0;
+				const uint8_t* source = fixedBuffers + size_t(request->buffer) * FIXED_BUFFER_SIZE + skip;
+				try {
+					request->data.assign(source, source + bytes);
+				} catch (const std::bad_alloc&) {
+					error = ENOMEM;
+				}
+			}
+			freeBuffers.push_back(request->buffer);
+		} else if (!error) {
+			request->data.resize(std::min(request->size, request->completed));
+		}
+		if (error) request->data = {};
+
+		active--;
+		request->done(error, std::move(request->data));
+	}
+
+	void ringLoop() {
+		armWake();
+		std::vector<std::unique_ptr<Request>> starting;
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (stopping && incoming.empty() && active == 0 && processing == 0) break;
+				while (!incoming.empty() && active + starting.size() < MAX_ACTIVE) {
+					starting.push_back(std::move(incoming.front()));
+					incoming.pop_front();
+				}
+			}
+			// Outside the lock, the callbacks of the failed ones may queue more
+			for (auto& request : starting) start(std::move(request));
+			starting.clear();
+
+			// Submits everything and sleeps until something completes, a read or the eventfd one
+			const long submitted = syscall(__NR_io_uring_enter, ringFd, toSubmit, 1u, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if (submitted > 0) toSubmit -= unsigned(submitted);
+
+			unsigned head = *cqHead;
+			const unsigned tail = std::atomic_ref<unsigned>(*cqTail).load(std::memory_order_acquire);
+			for (; head != tail; head++) {
+				const io_uring_cqe& completion = cqes[head & *cqMask];
+				const uint64_t tag = completion.user_data;
+				const int result = completion.res;
+				std::atomic_ref<unsigned>(*cqHead).store(head + 1, std::memory_order_release);
+
+				if (tag == WAKE_TAG) {
+					armWake();
+				} else {
+					complete(reinterpret_cast<Request*>(tag), result);
+				}
+			}
+		}
+	}
+};
+
+#endif
+
+}
+
+std::future<std::vector<uint8_t>> AsyncFileReader::read(const std::string& path, uint64_t offset, size_t size) {
+	auto promise = std::make_shared<std::promise<std::vector<uint8_t>>>();
+	auto result = promise->get_future();
+	submit(path, offset, size, [promise, path](int error, std::vector<uint8_t> data) {
+		if (error) {
+			promise->set_exception(std::make_exception_ptr(std::system_error(error, std::generic_category(), path)));
+		} else {
+			promise->set_value(std::move(data));
+		}
+	});
+	return result;
+}
+
+void AsyncFileReader::readRanges(const std::string& path, std::vector<DDSByteRange> ranges, Callback done) {
+	// A single range is read in place
+	if (ranges.size() == 1) {
+		const DDSByteRange range = ranges[0];
+		submit(path, range.offset, range.size, [range, done = std::move(done)](int error, std::vector<uint8_t> data) {
+			if (!error && data.size() < range.size) error = ENODATA;
+			done(error, error ? std::vector<uint8_t>() : std::move(data));
+		});
+		return;
+	}
+
+	struct PackedRead {
+		std::vector<uint8_t> data;
+		Callback done;
+		std::atomic<size_t> remaining;
+		std::atomic<int> error = 0;
+	};
+	auto state = std::make_shared<PackedRead>();
+	try {
+		state->data.resize(DDSParser::getRangesSize(ranges));
+	} catch (const std::bad_alloc&) {
+		done(ENOMEM, {});
+		return;
+	}
+	if (ranges.empty()) {
+		done(0, {});
+		return;
+	}
+	state->done = std::move(done);
+	state->remaining = ranges.size();
+
+	size_t packed = 0;
+	for (const DDSByteRange& range : ranges) {
+		submit(path, range.offset, range.size, [state, range, packed](int error, std::vector<uint8_t> data) {
+			if (!error && data.size() < range.size) error = ENODATA;
+			if (error) {
+				int none = 0;
+				state->error.compare_exchange_strong(none, error);
+			} else {
+				std::memcpy(state->data.data() + packed, data.data(), range.size);
+			}
+
+			if (state->remaining.fetch_sub(1) != 1) return;
+			const int first = state->error;
+			state->done(first, first ? std::vector<uint8_t>() : std::move(state->data));
+		});
+		packed += range.size;
+	}
+}
+
+void AsyncFileReader::readDDS(const std::string& path, size_t maxsize, std::function<void(DDSBatchItem)> done) {
+	submit(path, 0, DDSParser::MAX_HEADER_SIZE, [this, path, maxsize, done = std::move(done)](int error, std::vector<uint8_t> header) {
+		if (error) {
+			DDSBatchItem item;
+			item.path = path;
+			done(std::move(item));
+			return;
+		}
+		process([this, path, maxsize, done, header = std::move(header)]() mutable {
+			parseDDS(path, std::move(header), maxsize, std::move(done));
+		});
+	});
+}
+
+void AsyncFileReader::parseDDS(const std::string& path, std::vector<uint8_t> header, size_t maxsize,
+                               std::function<void(DDSBatchItem)> done) {
+	DDSBatchItem item;
+	item.path = path;
+	DDSStatus status = DDSParser::parseHeader(header.data(), header.size(), item.layout);
+	if (status == DDSStatus::OK && item.layout.supercompressed) {
+		readCompressedDDS(std::move(header), std::move(item), maxsize, std::move(done));
+		return;
+	}
+	if (status == DDSStatus::OK) status = DDSParser::computeSubresources(item.layout, maxsize);
+	const uint64_t fileSize = uint64_t(item.layout.headerSize) + item.layout.dataSize;
+	if (status == DDSStatus::OK && fileSize > UINT32_MAX) status = DDSStatus::Overflow;
+	if (status != DDSStatus::OK) {
+		item.status = status;
+		done(std::move(item));
+		return;
+	}
+
+	// The headers again with the pixels, they are in the cache now. Without skipped mips it is
+	// a single range, the whole file; with them, the tail of the chain of every item
+	const std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(item.layout);
+	DDSParser::packSubresources(item.layout, ranges);
+	readRanges(path, ranges, [item = std::move(item), done](int error, std::vector<uint8_t> data) mutable {
+		if (!error) {
+			item.status = DDSStatus::OK;
+			item.data = std::move(data);
+		} else if (error == ENODATA) {
+			item.status = DDSStatus::Truncated;
+		}
+		done(std::move(item));
+	});
+}
+
+void AsyncFileReader::readCompressedDDS(std::vector<uint8_t> header, DDSBatchItem item, size_t maxsize,
+                                        std::function<void(DDSBatchItem)> done) {
+	const DDSStatus status = DDSParser::computeSubresources(item.layout, maxsize);
+	if (status != DDSStatus::OK) {
+		item.status = status;
+		done(std::move(item));
+		return;
+	}
+
+	// The index, then the frames of the loaded subresources. The file size isn't known, a frame past
+	// the end fails its read
+	const size_t indexSize = DDSCompression::getIndexSize(item.layout);
+	const std::string path = item.path;
+	submit(path, item.layout.headerSize, indexSize, [this, header = std::move(header), item = std::move(item),
+	                                                 indexSize, done = std::move(done)](int error, std::vector<uint8_t> index) mutable {
+		if (error) {
+			done(std::move(item));
+			return;
+		}
+		process([this, header = std::move(header), item = std::move(item), indexSize, done = std::move(done),
+		         index = std::move(index)]() mutable {
+			readFrames(std::move(header), std::move(item), std::move(index), indexSize, std::move(done));
+		});
+	});
+}
+
+void AsyncFileReader::readFrames(std::vector<uint8_t> header, DDSBatchItem item, std::vector<uint8_t> index,
+                                 size_t indexSize, std::function<void(DDSBatchItem)> done) {
+	auto codec = DDSCodec::Stored;
+	std::vector<DDSFrame> frames;
+	DDSStatus status = index.size() < indexSize ? DDSStatus::Truncated :
+	                   DDSCompression::parseIndex(index.data(), index.size(), item.layout, 0, codec, frames);
+	if (status != DDSStatus::OK) {
+		item.status = status;
+		done(std::move(item));
+		return;
+	}
+
+	frames = DDSCompression::selectFrames(item.layout, frames);
+	std::vector<DDSByteRange> frameRanges = DDSCompression::packFrames(frames);
+	const std::string path = item.path;
+	readRanges(path, std::move(frameRanges), [this, header = std::move(header), item = std::move(item), codec,
+	                                          frames = std::move(frames), done](int error, std::vector<uint8_t> data) mutable {
+		if (error) {
+			if (error == ENODATA) item.status = DDSStatus::Truncated;
+			done(std::move(item));
+			return;
+		}
+
+		// A file per task, the other files are read and decompressed meanwhile
+		process([header = std::move(header), item = std::move(item), codec, frames = std::move(frames),
+		         data = std::move(data), done = std::move(done)]() mutable {
+			try {
+				const std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(item.layout);
+				DDSParser::packSubresources(item.layout, ranges);
+				item.data.resize(DDSParser::getRangesSize(ranges));
+				DDSCompression::writeHeaders(header.data(), item.layout, item.data.data());
+				item.status = DDSCompression::decompress(data.data(), codec, frames, item.layout, item.data.data(), 1);
+			} catch (const std::bad_alloc&) {
+				item.status = DDSStatus::ReadFailed;
+			}
+			if (item.status != DDSStatus::OK) item.data.clear();
+			done(std::move(item));
+		});
+	});
+}
+
+std::future<DDSBatchItem> AsyncFileReader::readDDS(const std::string& path, size_t maxsize) {
+	auto promise = std::make_shared<std::promise<DDSBatchItem>>();
+	auto result = promise->get_future();
+	readDDS(path, maxsize, [promise](DDSBatchItem item) { promise->set_value(std::move(item)); });
+	return result;
+}
+
+std::unique_ptr<AsyncFileReader> AsyncFileReader::create(Backend preferred, unsigned threads) {
+#ifdef __linux__
+	// Seccomp filters in the containers often say no to io_uring_setup
+	if (preferred == Backend::IoUring) {
+		if (auto reader = IoUringFileReader::create(threads)) return reader;
+	}
+#endif
+	return std::make_unique<ThreadPoolFileReader>(threads);
+}
+
+const char* AsyncFileReader::toString(Backend backend) {
+	switch (backend) {
+		case Backend::ThreadPool: return "thread pool";
+		case Backend::IoUring: return "io_uring";
+	}
+	return "unknown";
+}
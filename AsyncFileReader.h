@@ -0,0 +1,68 @@
+#pragma once
+
+#include "DDSBatchLoader.h"
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Reads byte ranges of files without blocking the caller, for the texture streaming. Two backends:
+// io_uring on Linux (registered buffers, O_DIRECT when the file system takes it) and pread on a
+// WorkStealingPool everywhere else, or when the kernel doesn't let us set a ring up.
+//
+// The completions run on the reader's own threads, so the callbacks should only hand the data over
+// (set a promise, submit a task, queue the next read) and must not throw. The parsing and the
+// decompression of readDDS run on a WorkStealingPool of the reader, never on the io_uring thread.
+// The destructor waits for all the reads, including the ones queued from the callbacks.
+class AsyncFileReader {
+public:
+	enum class Backend {
+		ThreadPool,
+		IoUring,
+	};
+
+	// error is an errno value, 0 on success. A range past the end of the file comes back short
+	using Callback = std::function<void(int error, std::vector<uint8_t> data)>;
+
+	virtual ~AsyncFileReader() = default;
+
+	virtual void submit(const std::string& path, uint64_t offset, size_t size, Callback done) = 0;
+	virtual Backend getBackend() const = 0;
+
+	// The future throws std::system_error when the read fails
+	std::future<std::vector<uint8_t>> read(const std::string& path, uint64_t offset, size_t size);
+
+	// Several ranges of one file, packed back to back into one buffer in their order. A short range
+	// (past the end of the file) fails the whole read with ENODATA
+	void readRanges(const std::string& path, std::vector<DDSByteRange> ranges, Callback done);
+
+	// The header first, then the payload the header asks for (only the mips that survive maxsize).
+	// A supercompressed file comes back expanded, its frames decompressed on the pool.
+	// The failures are in the status of the item
+	void readDDS(const std::string& path, size_t maxsize, std::function<void(DDSBatchItem)> done);
+	std::future<DDSBatchItem> readDDS(const std::string& path, size_t maxsize = 0);
+
+	// The preferred backend if this system has it, the thread pool otherwise. The threads are the
+	// pool's: the reads and the parsing for the thread pool, the parsing only for io_uring.
+	// 0 means "as many as the hardware has"
+	static std::unique_ptr<AsyncFileReader> create(Backend preferred = Backend::IoUring, unsigned threads = 0);
+
+	static const char* toString(Backend backend);
+
+protected:
+	// Runs the CPU work of readDDS on the pool. The task must not throw
+	virtual void process(std::function<void()> task) = 0;
+
+private:
+	// The steps of readDDS on the pool, each after a read: the header, the index of a supercompressed
+	// file, then the frames it lists
+	void parseDDS(const std::string& path, std::vector<uint8_t> header, size_t maxsize,
+	              std::function<void(DDSBatchItem)> done);
+	void readCompressedDDS(std::vector<uint8_t> header, DDSBatchItem item, size_t maxsize,
+	                       std::function<void(DDSBatchItem)> done);
+	void readFrames(std::vector<uint8_t> header, DDSBatchItem item, std::vector<uint8_t> index, size_t indexSize,
+	                std::function<void(DDSBatchItem)> done);
+};
@@ -0,0 +1,983 @@
+#include "BCDecoder.h"
+#include "Half.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every thread decodes at least this many rows of blocks, smaller images aren't worth a thread
+const size_t MIN_BLOCK_ROWS_PER_THREAD = 16;
+
+// The blocks are little-endian bit streams
+class BlockBits {
+	uint64_t low, high;
+	unsigned position = 0;
+
+public:
+	explicit BlockBits(const uint8_t* block) {
+		std::memcpy(&low, block, 8);
+		std::memcpy(&high, block + 8, 8);
+	}
+
+	uint32_t read(unsigned count) {
+		if (count == 0) return 0;
+		uint64_t value;
+		if (position >= 64) value = high >> (position - 64);
+		else if (position + count <= 64) value = low >> position;
+		else value = (low >> position) | (high << (64 - position));
+		position += count;
+		return uint32_t(value & ((uint64_t(1) << count) - 1));
+	}
+};
+
+uint32_t readLE16(const uint8_t* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8); }
+uint32_t readLE32(const uint8_t* p) { return readLE16(p) | (readLE16(p + 2) << 16); }
+
+// The parts of the decoding with SIMD versions, a set per SIMDLevel
+struct Kernels {
+	SIMDLevel level;
+	// The 16 pixels of a color block from the palette of 4 RGBA colors and the 2-bit indices
+	void (*lookupColors)(const uint8_t palette[16], uint32_t indices, uint8_t rgba[64]);
+	// A channel of the 16 pixels from the palette of 8 values and the 3-bit indices
+	void (*lookupChannel)(const uint8_t palette[8], uint64_t indices, uint8_t rgba[64], unsigned channel);
+	// The BC7 pixels. The first and the second endpoints of the subsets are 4 bytes (RGBA) each
+	void (*interpolateBC7)(const uint8_t first[16], const uint8_t second[16], const uint8_t subsets[16],
+	                       const uint8_t colorWeights[16], const uint8_t alphaWeights[16], uint8_t rgba[64]);
+	// The BC6H pixels from the unquantized endpoints (RGB, the two of the first subset, then the second one)
+	void (*interpolateBC6H)(const int endpoints[12], const uint8_t subsets[16], const uint8_t weights[16],
+	                        bool isSigned, uint16_t rgbaHalf[64]);
+	// The conversions between the outputs, of a whole block
+	void (*unormToHalf)(const uint8_t rgba[64], uint16_t rgbaHalf[64]);
+	void (*floatToHalf)(const float rgba[64], uint16_t rgbaHalf[64]);
+	void (*halfToUnorm)(const uint16_t rgbaHalf[64], uint8_t rgba[64]);
+};
+
+//--------------------------------------------------------------------------------------
+// BC1 - BC5
+//--------------------------------------------------------------------------------------
+
+void expand565(uint32_t c, uint8_t rgb[3]) {
+	uint32_t r = (c >> 11) & 0x1F, g = (c >> 5) & 0x3F, b = c & 0x1F;
+	rgb[0] = uint8_t((r << 3) | (r >> 2));
+	rgb[1] = uint8_t((g << 2) | (g >> 4));
+	rgb[2] = uint8_t((b << 3) | (b >> 2));
+}
+
+// The BC1 color block. BC2 and BC3 always use the four-color mode
+void decodeColorBlock(const Kernels& k, const uint8_t* block, uint8_t rgba[64], bool allowTransparent) {
+	uint32_t c0 = readLE16(block), c1 = readLE16(block + 2);
+	uint32_t indices = readLE32(block + 4);
+
+	alignas(16) uint8_t palette[4][4];
+	expand565(c0, palette[0]);
+	expand565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	if (c0 > c1 || !allowTransparent) {
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = uint8_t((2 * palette[0][c] + palette[1][c] + 1) / 3);
+			palette[3][c] = uint8_t((palette[0][c] + 2 * palette[1][c] + 1) / 3);
+		}
+	} else {
+		for (int c = 0; c < 3; c++) {
+			palette[2][c] = uint8_t((palette[0][c] + palette[1][c] + 1) / 2);
+			palette[3][c] = 0;
+		}
+		palette[3][3] = 0;
+	}
+
+	k.lookupColors(palette[0], indices, rgba);
+}
+
+// The BC4 block (also the BC3 alpha and the BC5 channels), into a channel of the pixels
+void decodeUnormChannel(const Kernels& k, const uint8_t* block, uint8_t rgba[64], unsigned channel) {
+	uint32_t a0 = block[0], a1 = block[1];
+	alignas(8) uint8_t palette[8] = { uint8_t(a0), uint8_t(a1) };
+	if (a0 > a1) {
+		for (uint32_t i = 1; i <= 6; i++) palette[i + 1] = uint8_t(((7 - i) * a0 + i * a1 + 3) / 7);
+	} else {
+		for (uint32_t i = 1; i <= 4; i++) palette[i + 1] = uint8_t(((5 - i) * a0 + i * a1 + 2) / 5);
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	k.lookupChannel(palette, uint64_t(readLE16(block + 2)) | (uint64_t(readLE32(block + 4)) << 16), rgba, channel);
+}
+
+// The signed BC4 block, into every 4th float
+void decodeSnormChannel(const uint8_t* block, float* out) {
+	// -128 is the same as -127
+	int a0 = std::max(int(int8_t(block[0])), -127), a1 = std::max(int(int8_t(block[1])), -127);
+	float palette[8] = { float(a0) / 127.f, float(a1) / 127.f };
+	if (a0 > a1) {
+		for (int i = 1; i <= 6; i++) palette[i + 1] = float((7 - i) * a0 + i * a1) / (7.f * 127.f);
+	} else {
+		for (int i = 1; i <= 4; i++) palette[i + 1] = float((5 - i) * a0 + i * a1) / (5.f * 127.f);
+		palette[6] = -1.f;
+		palette[7] = 1.f;
+	}
+
+	uint64_t indices = uint64_t(readLE16(block + 2)) | (uint64_t(readLE32(block + 4)) << 16);
+	for (int i = 0; i < 16; i++) {
+		out[4 * i] = palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+void decodeExplicitAlpha(const uint8_t* block, uint8_t rgba[64]) {
+	for (int i = 0; i < 16; i++) {
+		uint32_t a = (block[i / 2] >> (4 * (i % 2))) & 0xF;
+		rgba[4 * i + 3] = uint8_t(a | (a << 4));
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// The partitions shared by BC6H and BC7
+//--------------------------------------------------------------------------------------
+
+// The 2-subset partitions, a bit per pixel
+const uint16_t PARTITIONS2[64] = {
+	0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+	0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+	0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+	0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+	0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+	0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+	0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+	0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22,
+};
+
+// The 3-subset partitions, two bits per pixel
+const uint32_t PARTITIONS3[64] = {
+	0xAA685050, 0x6A5A5040, 0x5A5A4200, 0x5450A0A8, 0xA5A50000, 0xA0A05050, 0x5555A0A0, 0x5A5A5050,
+	0xAA550000, 0xAA555500, 0xAAAA5500, 0x90909090, 0x94949494, 0xA4A4A4A4, 0xA9A59450, 0x2A0A4250,
+	0xA5945040, 0x0A425054, 0xA5A5A500, 0x55A0A0A0, 0xA8A85454, 0x6A6A4040, 0xA4A45000, 0x1A1A0500,
+	0x0050A4A4, 0xAAA59090, 0x14696914, 0x69691400, 0xA08585A0, 0xAA821414, 0x50A4A450, 0x6A5A0200,
+	0xA9A58000, 0x5090A0A8, 0xA8A09050, 0x24242424, 0x00AA5500, 0x24924924, 0x24499224, 0x50A50A50,
+	0x500AA550, 0xAAAA4444, 0x66660000, 0xA5A0A5A0, 0x50A050A0, 0x69286928, 0x44AAAA44, 0x66666600,
+	0xAA444444, 0x54A854A8, 0x95809580, 0x96969600, 0xA85454A8, 0x80959580, 0xAA141414, 0x96960000,
+	0xAAAA1414, 0xA05050A0, 0xA0A5A5A0, 0x96000000, 0x40804080, 0xA9A8A9A8, 0xAAAAAA44, 0x2A4A5254,
+};
+
+// The anchor pixels (their indices have one bit less). The pixel 0 is always the anchor of the subset 0
+const uint8_t ANCHORS2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+const uint8_t ANCHORS3_SECOND[64] = {
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+const uint8_t ANCHORS3_THIRD[64] = {
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+const uint8_t WEIGHTS2[4] = { 0, 21, 43, 64 };
+const uint8_t WEIGHTS3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+const uint8_t WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+const uint8_t* weightsFor(unsigned indexBits) {
+	return indexBits == 2 ? WEIGHTS2 : indexBits == 3 ? WEIGHTS3 : WEIGHTS4;
+}
+
+unsigned subsetOf(unsigned subsets, unsigned partition, unsigned pixel) {
+	if (subsets == 2) return (PARTITIONS2[partition] >> pixel) & 1;
+	if (subsets == 3) return (PARTITIONS3[partition] >> (2 * pixel)) & 3;
+	return 0;
+}
+
+bool isAnchor(unsigned subsets, unsigned partition, unsigned pixel) {
+	if (pixel == 0) return true;
+	if (subsets == 2) return pixel == ANCHORS2[partition];
+	if (subsets == 3) return pixel == ANCHORS3_SECOND[partition] || pixel == ANCHORS3_THIRD[partition];
+	return false;
+}
+
+//--------------------------------------------------------------------------------------
+// BC7
+//--------------------------------------------------------------------------------------
+
+struct BC7Mode {
+	uint8_t subsets, partitionBits, rotationBits, indexSelectionBits;
+	uint8_t colorBits, alphaBits;
+	uint8_t endpointPBits, sharedPBits;
+	uint8_t indexBits, secondaryIndexBits;
+};
+
+const BC7Mode BC7_MODES[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+void decodeBC7(const Kernels& k, const uint8_t* block, uint8_t rgba[64]) {
+	unsigned mode = 0;
+	while (mode < 8 && !(block[0] & (1u << mode))) mode++;
+	if (mode == 8) {
+		// The reserved mode decodes to transparent black
+		std::memset(rgba, 0, 64);
+		return;
+	}
+
+	const BC7Mode& m = BC7_MODES[mode];
+	BlockBits bits(block);
+	bits.read(mode + 1);
+	unsigned partition = bits.read(m.partitionBits);
+	unsigned rotation = bits.read(m.rotationBits);
+	unsigned indexSelection = bits.read(m.indexSelectionBits);
+
+	const unsigned endpointCount = 2u * m.subsets;
+	uint32_t endpoints[6][4] = {};
+	for (unsigned c = 0; c < 3; c++) {
+		for (unsigned e = 0; e < endpointCount; e++) endpoints[e][c] = bits.read(m.colorBits);
+	}
+	for (unsigned e = 0; e < endpointCount && m.alphaBits; e++) endpoints[e][3] = bits.read(m.alphaBits);
+
+	unsigned colorBits = m.colorBits, alphaBits = m.alphaBits;
+	if (m.endpointPBits || m.sharedPBits) {
+		uint32_t pBits[6];
+		for (unsigned e = 0; e < endpointCount; e++) {
+			pBits[e] = (m.endpointPBits || e % 2 == 0) ? bits.read(1) : pBits[e - 1];
+		}
+		for (unsigned e = 0; e < endpointCount; e++) {
+			for (unsigned c = 0; c < 4; c++) endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+		}
+		colorBits++;
+		if (alphaBits) alphaBits++;
+	}
+
+	alignas(16) uint8_t first[16] = {}, second[16] = {};
+	for (unsigned e = 0; e < endpointCount; e++) {
+		uint8_t* expanded = (e % 2 ? second : first) + 4 * (e / 2);
+		for (unsigned c = 0; c < 3; c++) {
+			uint32_t v = endpoints[e][c] << (8 - colorBits);
+			expanded[c] = uint8_t(v | (v >> colorBits));
+		}
+		if (alphaBits) {
+			uint32_t v = endpoints[e][3] << (8 - alphaBits);
+			expanded[3] = uint8_t(v | (v >> alphaBits));
+		} else {
+			expanded[3] = 255;
+		}
+	}
+
+	uint8_t indices[16], secondaryIndices[16] = {};
+	for (unsigned i = 0; i < 16; i++) {
+		indices[i] = uint8_t(bits.read(m.indexBits - (isAnchor(m.subsets, partition, i) ? 1 : 0)));
+	}
+	if (m.secondaryIndexBits) {
+		for (unsigned i = 0; i < 16; i++) secondaryIndices[i] = uint8_t(bits.read(m.secondaryIndexBits - (i == 0 ? 1 : 0)));
+	}
+
+	// With two index sets, the colors use the first one and the alpha uses the second one
+	// (or the other way around when the index selection bit is set)
+	const uint8_t* colorIndices = indices;
+	const uint8_t* alphaIndices = m.secondaryIndexBits ? secondaryIndices : indices;
+	unsigned colorIndexBits = m.indexBits;
+	unsigned alphaIndexBits = m.secondaryIndexBits ? m.secondaryIndexBits : m.indexBits;
+	if (indexSelection) {
+		std::swap(colorIndices, alphaIndices);
+		std::swap(colorIndexBits, alphaIndexBits);
+	}
+	const uint8_t* colorWeights = weightsFor(colorIndexBits);
+	const uint8_t* alphaWeights = weightsFor(alphaIndexBits);
+
+	alignas(16) uint8_t subsets[16], pixelColorWeights[16], pixelAlphaWeights[16];
+	for (unsigned i = 0; i < 16; i++) {
+		subsets[i] = uint8_t(subsetOf(m.subsets, partition, i));
+		pixelColorWeights[i] = colorWeights[colorIndices[i]];
+		pixelAlphaWeights[i] = alphaWeights[alphaIndices[i]];
+	}
+	k.interpolateBC7(first, second, subsets, pixelColorWeights, pixelAlphaWeights, rgba);
+	if (rotation) {
+		for (unsigned i = 0; i < 16; i++) std::swap(rgba[4 * i + 3], rgba[4 * i + rotation - 1]);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// BC6H
+//--------------------------------------------------------------------------------------
+
+enum BC6HField : uint8_t { R0, G0, B0, R1, G1, B1, R2, G2, B2, R3, G3, B3 };
+
+// A run of endpoint bits in the block: the bits of the field from "first" to "last", in the stored order
+struct BC6HSegment {
+	uint8_t field, first, last;
+};
+
+struct BC6HMode {
+	uint8_t code;            // The mode bits (2 or 5 of them)
+	uint8_t subsets;
+	bool transformed;        // The endpoints other than the first one are deltas
+	uint8_t precision;       // The bits of the first endpoint
+	uint8_t deltaBits[3];    // The bits of the other endpoints
+	uint8_t segmentCount;
+	BC6HSegment segments[23];
+};
+
+// The endpoint layouts of the 14 modes, as the BC6H specification lists them
+const BC6HMode BC6H_MODES[14] = {
+	// Mode 1
+	{ 0, 2, true, 10, { 5, 5, 5 }, 19, {
+		{ G2, 4, 4 }, { B2, 4, 4 }, { B3, 4, 4 }, { R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 },
+		{ R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 },
+		{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 },
+		{ B3, 3, 3 }
+	} },
+	// Mode 2
+	{ 1, 2, true, 7, { 6, 6, 6 }, 23, {
+		{ G2, 5, 5 }, { G3, 4, 4 }, { G3, 5, 5 }, { R0, 0, 6 }, { B3, 0, 0 }, { B3, 1, 1 },
+		{ B2, 4, 4 }, { G0, 0, 6 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 6 },
+		{ B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 },
+		{ G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 }
+	} },
+	// Mode 3
+	{ 2, 2, true, 11, { 5, 4, 4 }, 18, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 4 }, { R0, 10, 10 }, { G2, 0, 3 },
+		{ G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 },
+		{ B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }
+	} },
+	// Mode 4
+	{ 6, 2, true, 11, { 4, 5, 4 }, 20, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { G3, 4, 4 },
+		{ G2, 0, 3 }, { G1, 0, 4 }, { G0, 10, 10 }, { G3, 0, 3 }, { B1, 0, 3 }, { B0, 10, 10 },
+		{ B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 0, 0 }, { B3, 2, 2 }, { R3, 0, 3 },
+		{ G2, 4, 4 }, { B3, 3, 3 }
+	} },
+	// Mode 5
+	{ 10, 2, true, 11, { 4, 4, 5 }, 20, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 10, 10 }, { B2, 4, 4 },
+		{ G2, 0, 3 }, { G1, 0, 3 }, { G0, 10, 10 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 },
+		{ B0, 10, 10 }, { B2, 0, 3 }, { R2, 0, 3 }, { B3, 1, 1 }, { B3, 2, 2 }, { R3, 0, 3 },
+		{ B3, 4, 4 }, { B3, 3, 3 }
+	} },
+	// Mode 6
+	{ 14, 2, true, 9, { 5, 5, 5 }, 19, {
+		{ R0, 0, 8 }, { B2, 4, 4 }, { G0, 0, 8 }, { G2, 4, 4 }, { B0, 0, 8 }, { B3, 4, 4 },
+		{ R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 }, { G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 },
+		{ B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 }, { B3, 2, 2 }, { R3, 0, 4 },
+		{ B3, 3, 3 }
+	} },
+	// Mode 7
+	{ 18, 2, true, 8, { 6, 5, 5 }, 19, {
+		{ R0, 0, 7 }, { G3, 4, 4 }, { B2, 4, 4 }, { G0, 0, 7 }, { B3, 2, 2 }, { G2, 4, 4 },
+		{ B0, 0, 7 }, { B3, 3, 3 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 4 },
+		{ B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 5 },
+		{ R3, 0, 5 }
+	} },
+	// Mode 8
+	{ 22, 2, true, 8, { 5, 6, 5 }, 21, {
+		{ R0, 0, 7 }, { B3, 0, 0 }, { B2, 4, 4 }, { G0, 0, 7 }, { G2, 5, 5 }, { G2, 4, 4 },
+		{ B0, 0, 7 }, { G3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 },
+		{ G1, 0, 5 }, { G3, 0, 3 }, { B1, 0, 4 }, { B3, 1, 1 }, { B2, 0, 3 }, { R2, 0, 4 },
+		{ B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }
+	} },
+	// Mode 9
+	{ 26, 2, true, 8, { 5, 5, 6 }, 21, {
+		{ R0, 0, 7 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 7 }, { B2, 5, 5 }, { G2, 4, 4 },
+		{ B0, 0, 7 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 4 }, { G3, 4, 4 }, { G2, 0, 3 },
+		{ G1, 0, 4 }, { B3, 0, 0 }, { G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 4 },
+		{ B3, 2, 2 }, { R3, 0, 4 }, { B3, 3, 3 }
+	} },
+	// Mode 10
+	{ 30, 2, false, 6, { 6, 6, 6 }, 23, {
+		{ R0, 0, 5 }, { G3, 4, 4 }, { B3, 0, 0 }, { B3, 1, 1 }, { B2, 4, 4 }, { G0, 0, 5 },
+		{ G2, 5, 5 }, { B2, 5, 5 }, { B3, 2, 2 }, { G2, 4, 4 }, { B0, 0, 5 }, { G3, 5, 5 },
+		{ B3, 3, 3 }, { B3, 5, 5 }, { B3, 4, 4 }, { R1, 0, 5 }, { G2, 0, 3 }, { G1, 0, 5 },
+		{ G3, 0, 3 }, { B1, 0, 5 }, { B2, 0, 3 }, { R2, 0, 5 }, { R3, 0, 5 }
+	} },
+	// Mode 11
+	{ 3, 1, false, 10, { 10, 10, 10 }, 6, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 9 }, { G1, 0, 9 }, { B1, 0, 9 }
+	} },
+	// Mode 12
+	{ 7, 1, true, 11, { 9, 9, 9 }, 9, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 8 }, { R0, 10, 10 }, { G1, 0, 8 },
+		{ G0, 10, 10 }, { B1, 0, 8 }, { B0, 10, 10 }
+	} },
+	// Mode 13
+	{ 11, 1, true, 12, { 8, 8, 8 }, 9, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 7 }, { R0, 11, 10 }, { G1, 0, 7 },
+		{ G0, 11, 10 }, { B1, 0, 7 }, { B0, 11, 10 }
+	} },
+	// Mode 14
+	{ 15, 1, true, 16, { 4, 4, 4 }, 9, {
+		{ R0, 0, 9 }, { G0, 0, 9 }, { B0, 0, 9 }, { R1, 0, 3 }, { R0, 15, 10 }, { G1, 0, 3 },
+		{ G0, 15, 10 }, { B1, 0, 3 }, { B0, 15, 10 }
+	} },
+};
+
+int signExtend(int value, unsigned bits) {
+	int shift = 32 - int(bits);
+	return int(uint32_t(value) << shift) >> shift;
+}
+
+int unquantize(int value, unsigned precision, bool isSigned) {
+	if (!isSigned) {
+		if (precision >= 15) return value;
+		if (value == 0) return 0;
+		if (value == (1 << precision) - 1) return 0xFFFF;
+		return ((value << 16) + 0x8000) >> precision;
+	}
+	if (precision >= 16) return value;
+	bool negative = value < 0;
+	int magnitude = negative ? -value : value;
+	int result;
+	if (magnitude == 0) result = 0;
+	else if (magnitude >= (1 << (precision - 1)) - 1) result = 0x7FFF;
+	else result = ((magnitude << 15) + 0x4000) >> (precision - 1);
+	return negative ? -result : result;
+}
+
+uint16_t finishUnquantize(int value, bool isSigned) {
+	if (!isSigned) return uint16_t((value * 31) >> 6);
+	int scaled = value < 0 ? -(((-value) * 31) >> 5) : (value * 31) >> 5;
+	return scaled < 0 ? uint16_t(0x8000 | -scaled) : uint16_t(scaled);
+}
+
+void decodeBC6H(const Kernels& k, const uint8_t* block, uint16_t rgbaHalf[64], bool isSigned) {
+	unsigned code = block[0] & 0x3;
+	if (code >= 2) code = block[0] & 0x1F;
+
+	const BC6HMode* mode = nullptr;
+	for (const auto& candidate : BC6H_MODES) {
+		if (candidate.code == code) { mode = &candidate; break; }
+	}
+	if (!mode) {
+		// The reserved modes decode to black
+		for (int i = 0; i < 16; i++) {
+			rgbaHalf[4 * i] = rgbaHalf[4 * i + 1] = rgbaHalf[4 * i + 2] = 0;
+			rgbaHalf[4 * i + 3] = 0x3C00;
+		}
+		return;
+	}
+
+	BlockBits bits(block);
+	bits.read(code < 2 ? 2 : 5);
+
+	int endpoints[12] = {};    // R0, G0, B0, R1 ... B3
+	for (unsigned s = 0; s < mode->segmentCount; s++) {
+		const BC6HSegment& segment = mode->segments[s];
+		int step = segment.first <= segment.last ? 1 : -1;
+		for (int bit = segment.first;; bit += step) {
+			endpoints[segment.field] |= int(bits.read(1)) << bit;
+			if (bit == segment.last) break;
+		}
+	}
+
+	unsigned partition = mode->subsets == 2 ? bits.read(5) : 0;
+	const unsigned endpointCount = 2u * mode->subsets;
+	const unsigned precision = mode->precision;
+
+	if (isSigned) {
+		for (unsigned c = 0; c < 3; c++) endpoints[c] = signExtend(endpoints[c], precision);
+	}
+	for (unsigned e = 1; e < endpointCount; e++) {
+		for (unsigned c = 0; c < 3; c++) {
+			int& v = endpoints[3 * e + c];
+			if (mode->transformed) {
+				v = (endpoints[c] + signExtend(v, mode->deltaBits[c])) & ((1 << precision) - 1);
+				if (isSigned) v = signExtend(v, precision);
+			} else if (isSigned) {
+				v = signExtend(v, precision);
+			}
+		}
+	}
+	for (unsigned e = 0; e < 3 * endpointCount; e++) endpoints[e] = unquantize(endpoints[e], precision, isSigned);
+
+	const unsigned indexBits = mode->subsets == 2 ? 3 : 4;
+	const uint8_t* weights = weightsFor(indexBits);
+	alignas(16) uint8_t subsets[16], pixelWeights[16];
+	for (unsigned i = 0; i < 16; i++) {
+		pixelWeights[i] = weights[bits.read(indexBits - (isAnchor(mode->subsets, partition, i) ? 1 : 0))];
+		subsets[i] = uint8_t(subsetOf(mode->subsets, partition, i));
+	}
+	k.interpolateBC6H(endpoints, subsets, pixelWeights, isSigned, rgbaHalf);
+}
+
+//--------------------------------------------------------------------------------------
+// Conversions between the outputs
+//--------------------------------------------------------------------------------------
+
+const std::array<uint16_t, 256>& unormToHalfTable() {
+	static const std::array<uint16_t, 256> table = [] {
+		std::array<uint16_t, 256> t = {};
+		for (int i = 0; i < 256; i++) t[i] = floatToHalf(float(i) / 255.f);
+		return t;
+	}();
+	return table;
+}
+
+uint8_t floatToUnorm(float value) {
+	return uint8_t(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+}
+
+bool isNativelyHalf(BCFormat format) {
+	return format == BCFormat::BC4Signed || format == BCFormat::BC5Signed ||
+	       format == BCFormat::BC6H || format == BCFormat::BC6HSigned;
+}
+
+//--------------------------------------------------------------------------------------
+// The scalar kernels
+//--------------------------------------------------------------------------------------
+
+void lookupColorsScalar(const uint8_t palette[16], uint32_t indices, uint8_t rgba[64]) {
+	for (int i = 0; i < 16; i++) std::memcpy(rgba + 4 * i, palette + 4 * ((indices >> (2 * i)) & 3), 4);
+}
+
+void lookupChannelScalar(const uint8_t palette[8], uint64_t indices, uint8_t rgba[64], unsigned channel) {
+	for (int i = 0; i < 16; i++) rgba[4 * i + channel] = palette[(indices >> (3 * i)) & 7];
+}
+
+void interpolateBC7Scalar(const uint8_t first[16], const uint8_t second[16], const uint8_t subsets[16],
+                          const uint8_t colorWeights[16], const uint8_t alphaWeights[16], uint8_t rgba[64]) {
+	for (unsigned i = 0; i < 16; i++) {
+		const uint8_t* e0 = first + 4 * subsets[i];
+		const uint8_t* e1 = second + 4 * subsets[i];
+		uint8_t* pixel = rgba + 4 * i;
+		for (unsigned c = 0; c < 4; c++) {
+			uint32_t w = c < 3 ? colorWeights[i] : alphaWeights[i];
+			pixel[c] = uint8_t(((64 - w) * e0[c] + w * e1[c] + 32) >> 6);
+		}
+	}
+}
+
+void interpolateBC6HScalar(const int endpoints[12], const uint8_t subsets[16], const uint8_t weights[16],
+                           bool isSigned, uint16_t rgbaHalf[64]) {
+	for (unsigned i = 0; i < 16; i++) {
+		const int* e0 = endpoints + 6 * subsets[i];
+		const int* e1 = e0 + 3;
+		int w = weights[i];
+		for (unsigned c = 0; c < 3; c++) {
+			rgbaHalf[4 * i + c] = finishUnquantize(((64 - w) * e0[c] + w * e1[c] + 32) >> 6, isSigned);
+		}
+		rgbaHalf[4 * i + 3] = 0x3C00;    // 1.0
+	}
+}
+
+void unormToHalfScalar(const uint8_t rgba[64], uint16_t rgbaHalf[64]) {
+	const auto& table = unormToHalfTable();
+	for (int i = 0; i < 64; i++) rgbaHalf[i] = table[rgba[i]];
+}
+
+void floatToHalfScalar(const float rgba[64], uint16_t rgbaHalf[64]) {
+	for (int i = 0; i < 64; i++) rgbaHalf[i] = floatToHalf(rgba[i]);
+}
+
+void halfToUnormScalar(const uint16_t rgbaHalf[64], uint8_t rgba[64]) {
+	for (int i = 0; i < 64; i++) rgba[i] = floatToUnorm(halfToFloat(rgbaHalf[i]));
+}
+
+const Kernels SCALAR_KERNELS = {
+	SIMDLevel::Scalar, lookupColorsScalar, lookupChannelScalar, interpolateBC7Scalar, interpolateBC6HScalar,
+	unormToHalfScalar, floatToHalfScalar, halfToUnormScalar,
+};
+
+#if defined(SIMD_X86)
+
+//--------------------------------------------------------------------------------------
+// The SSE4.1 kernels. The palettes and the endpoints fit a register, so the lookups are byte shuffles
+//--------------------------------------------------------------------------------------
+
+// The shuffles of the index bytes of the color blocks (4 pixels each): the 4 bytes of the palette entry of every pixel
+struct ColorShuffles {
+	alignas(16) uint8_t masks[256][16];
+};
+
+constexpr ColorShuffles makeColorShuffles() {
+	ColorShuffles shuffles = {};
+	for (unsigned indices = 0; indices < 256; indices++) {
+		for (unsigned i = 0; i < 16; i++) shuffles.masks[indices][i] = uint8_t(4 * ((indices >> (2 * (i / 4))) & 3) + i % 4);
+	}
+	return shuffles;
+}
+
+constexpr ColorShuffles COLOR_SHUFFLES = makeColorShuffles();
+
+SIMD_TARGET_SSE41 void lookupColorsSSE41(const uint8_t palette[16], uint32_t indices, uint8_t rgba[64]) {
+	const __m128i colors = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette));
+	for (unsigned r = 0; r < 4; r++) {
+		const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(COLOR_SHUFFLES.masks[(indices >> (8 * r)) & 0xFF]));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 16 * r), _mm_shuffle_epi8(colors, mask));
+	}
+}
+
+// The values of the 16 pixels into a channel of their RGBA bytes, the other channels kept
+SIMD_TARGET_SSE41 inline void storeChannel(__m128i values, uint8_t rgba[64], unsigned channel) {
+	const __m128i shift = _mm_cvtsi32_si128(int(8 * channel));
+	const __m128i channelMask = _mm_sll_epi32(_mm_set1_epi32(0xFF), shift);
+	for (int r = 0; r < 4; r++) {
+		// The pixel 4r + k into the byte 4k, the others zeroed, then moved to the channel
+		const __m128i spread = _mm_or_si128(_mm_setr_epi32(4 * r, 4 * r + 1, 4 * r + 2, 4 * r + 3), _mm_set1_epi32(int(0xFFFFFF00u)));
+		const __m128i moved = _mm_sll_epi32(_mm_shuffle_epi8(values, spread), shift);
+		__m128i* pixels = reinterpret_cast<__m128i*>(rgba + 16 * r);
+		_mm_storeu_si128(pixels, _mm_blendv_epi8(_mm_loadu_si128(pixels), moved, channelMask));
+	}
+}
+
+SIMD_TARGET_SSE41 void lookupChannelSSE41(const uint8_t palette[8], uint64_t indices, uint8_t rgba[64], unsigned channel) {
+	alignas(16) uint8_t bytes[16];
+	for (int i = 0; i < 16; i++) bytes[i] = uint8_t((indices >> (3 * i)) & 7);
+	const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette));
+	storeChannel(_mm_shuffle_epi8(values, _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes))), rgba, channel);
+}
+
+// ((64 - w) * a + w * b + 32) >> 6 for the 16 bytes, the pairs of a and b times the pairs of weights
+SIMD_TARGET_SSE41 inline __m128i interpolateBytes(__m128i a, __m128i b, __m128i w) {
+	const __m128i weights = _mm_sub_epi8(_mm_set1_epi8(64), w);
+	const __m128i round = _mm_set1_epi16(32);
+	__m128i low = _mm_maddubs_epi16(_mm_unpacklo_epi8(a, b), _mm_unpacklo_epi8(weights, w));
+	__m128i high = _mm_maddubs_epi16(_mm_unpackhi_epi8(a, b), _mm_unpackhi_epi8(weights, w));
+	low = _mm_srli_epi16(_mm_add_epi16(low, round), 6);
+	high = _mm_srli_epi16(_mm_add_epi16(high, round), 6);
+	return _mm_packus_epi16(low, high);
+}
+
+SIMD_TARGET_SSE41 void interpolateBC7SSE41(const uint8_t first[16], const uint8_t second[16], const uint8_t subsets[16],
+                                           const uint8_t colorWeights[16], const uint8_t alphaWeights[16], uint8_t rgba[64]) {
+	const __m128i e0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+	const __m128i e1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(second));
+	const __m128i subset = _mm_loadu_si128(reinterpret_cast<const __m128i*>(subsets));
+	const __m128i colorWeight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colorWeights));
+	const __m128i alphaWeight = _mm_loadu_si128(reinterpret_cast<const __m128i*>(alphaWeights));
+	const __m128i alpha = _mm_set1_epi32(int(0xFF000000u));
+	const __m128i channels = _mm_set1_epi32(0x03020100);
+	for (int r = 0; r < 4; r++) {
+		// The subset and the weights of the pixel 4r + k into its 4 bytes
+		const __m128i spread = _mm_add_epi8(_mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3), _mm_set1_epi8(char(4 * r)));
+		const __m128i endpoint = _mm_add_epi8(_mm_slli_epi16(_mm_shuffle_epi8(subset, spread), 2), channels);
+		const __m128i w = _mm_blendv_epi8(_mm_shuffle_epi8(colorWeight, spread), _mm_shuffle_epi8(alphaWeight, spread), alpha);
+		const __m128i pixels = interpolateBytes(_mm_shuffle_epi8(e0, endpoint), _mm_shuffle_epi8(e1, endpoint), w);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 16 * r), pixels);
+	}
+}
+
+const Kernels SSE41_KERNELS = {
+	SIMDLevel::SSE41, lookupColorsSSE41, lookupChannelSSE41, interpolateBC7SSE41, interpolateBC6HScalar,
+	unormToHalfScalar, floatToHalfScalar, halfToUnormScalar,
+};
+
+//--------------------------------------------------------------------------------------
+// The AVX2 kernels. F16C converts the halves, BMI2 spreads the 3-bit indices
+//--------------------------------------------------------------------------------------
+
+SIMD_TARGET_AVX2 void lookupChannelAVX2(const uint8_t palette[8], uint64_t indices, uint8_t rgba[64], unsigned channel) {
+	const uint64_t bytes = 0x0707070707070707ull;
+	const __m128i index = _mm_set_epi64x(int64_t(_pdep_u64(indices >> 24, bytes)), int64_t(_pdep_u64(indices, bytes)));
+	const __m128i values = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(palette));
+	storeChannel(_mm_shuffle_epi8(values, index), rgba, channel);
+}
+
+SIMD_TARGET_AVX2 inline __m256i broadcast16(const uint8_t bytes[16]) {
+	return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes)));
+}
+
+// interpolateBC7SSE41 on both halves, 8 pixels at a time
+SIMD_TARGET_AVX2 void interpolateBC7AVX2(const uint8_t first[16], const uint8_t second[16], const uint8_t subsets[16],
+                                         const uint8_t colorWeights[16], const uint8_t alphaWeights[16], uint8_t rgba[64]) {
+	const __m256i e0 = broadcast16(first), e1 = broadcast16(second), subset = broadcast16(subsets);
+	const __m256i colorWeight = broadcast16(colorWeights), alphaWeight = broadcast16(alphaWeights);
+	const __m256i alpha = _mm256_set1_epi32(int(0xFF000000u));
+	const __m256i channels = _mm256_set1_epi32(0x03020100);
+	const __m256i weights = _mm256_set1_epi8(64), round = _mm256_set1_epi16(32);
+	for (int r = 0; r < 2; r++) {
+		const __m256i spread = _mm256_add_epi8(_mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+		                                                        4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7),
+		                                       _mm256_set1_epi8(char(8 * r)));
+		const __m256i endpoint = _mm256_add_epi8(_mm256_slli_epi16(_mm256_shuffle_epi8(subset, spread), 2), channels);
+		const __m256i w = _mm256_blendv_epi8(_mm256_shuffle_epi8(colorWeight, spread), _mm256_shuffle_epi8(alphaWeight, spread), alpha);
+		const __m256i a = _mm256_shuffle_epi8(e0, endpoint), b = _mm256_shuffle_epi8(e1, endpoint);
+		const __m256i complement = _mm256_sub_epi8(weights, w);
+		__m256i low = _mm256_maddubs_epi16(_mm256_unpacklo_epi8(a, b), _mm256_unpacklo_epi8(complement, w));
+		__m256i high = _mm256_maddubs_epi16(_mm256_unpackhi_epi8(a, b), _mm256_unpackhi_epi8(complement, w));
+		low = _mm256_srli_epi16(_mm256_add_epi16(low, round), 6);
+		high = _mm256_srli_epi16(_mm256_add_epi16(high, round), 6);
+		// The unpacks and the pack stay within the 128-bit lanes, so the order comes back
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + 32 * r), _mm256_packus_epi16(low, high));
+	}
+}
+
+// The 8 pixels of a channel: the weighted endpoints of their subsets, then finishUnquantize
+SIMD_TARGET_AVX2 inline __m256i interpolateBC6HChannel(const int endpoints[12], unsigned channel, __m256i inSecond,
+                                                       __m256i w, bool isSigned) {
+	const __m256i e0 = _mm256_blendv_epi8(_mm256_set1_epi32(endpoints[channel]), _mm256_set1_epi32(endpoints[6 + channel]), inSecond);
+	const __m256i e1 = _mm256_blendv_epi8(_mm256_set1_epi32(endpoints[3 + channel]), _mm256_set1_epi32(endpoints[9 + channel]), inSecond);
+	const __m256i complement = _mm256_sub_epi32(_mm256_set1_epi32(64), w);
+	__m256i value = _mm256_add_epi32(_mm256_mullo_epi32(complement, e0), _mm256_mullo_epi32(w, e1));
+	value = _mm256_srai_epi32(_mm256_add_epi32(value, _mm256_set1_epi32(32)), 6);
+
+	const __m256i thirtyOne = _mm256_set1_epi32(31);
+	if (!isSigned) return _mm256_srai_epi32(_mm256_mullo_epi32(value, thirtyOne), 6);
+	// The magnitude scaled, and the sign bit of the half unless it rounded to zero
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i scaled = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_abs_epi32(value), thirtyOne), 5);
+	const __m256i negative = _mm256_and_si256(_mm256_cmpgt_epi32(zero, value), _mm256_cmpgt_epi32(scaled, zero));
+	return _mm256_or_si256(scaled, _mm256_and_si256(negative, _mm256_set1_epi32(0x8000)));
+}
+
+SIMD_TARGET_AVX2 void interpolateBC6HAVX2(const int endpoints[12], const uint8_t subsets[16], const uint8_t weights[16],
+                                          bool isSigned, uint16_t rgbaHalf[64]) {
+	const __m128i one = _mm_set1_epi16(0x3C00);
+	for (int h = 0; h < 2; h++) {
+		const __m128i subset = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(subsets + 8 * h));
+		const __m128i weight = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(weights + 8 * h));
+		const __m256i inSecond = _mm256_cmpgt_epi32(_mm256_cvtepu8_epi32(subset), _mm256_setzero_si256());
+		const __m256i w = _mm256_cvtepu8_epi32(weight);
+
+		// The channels of the 8 pixels as 16-bit values, then interleaved
+		__m128i channel[3];
+		for (unsigned c = 0; c < 3; c++) {
+			const __m256i value = interpolateBC6HChannel(endpoints, c, inSecond, w, isSigned);
+			channel[c] = _mm_packus_epi32(_mm256_castsi256_si128(value), _mm256_extracti128_si256(value, 1));
+		}
+		const __m128i rgLow = _mm_unpacklo_epi16(channel[0], channel[1]), rgHigh = _mm_unpackhi_epi16(channel[0], channel[1]);
+		const __m128i baLow = _mm_unpacklo_epi16(channel[2], one), baHigh = _mm_unpackhi_epi16(channel[2], one);
+		__m128i* pixels = reinterpret_cast<__m128i*>(rgbaHalf + 32 * h);
+		_mm_storeu_si128(pixels, _mm_unpacklo_epi32(rgLow, baLow));
+		_mm_storeu_si128(pixels + 1, _mm_unpackhi_epi32(rgLow, baLow));
+		_mm_storeu_si128(pixels + 2, _mm_unpacklo_epi32(rgHigh, baHigh));
+		_mm_storeu_si128(pixels + 3, _mm_unpackhi_epi32(rgHigh, baHigh));
+	}
+}
+
+// Divided rather than multiplied by the reciprocal, to round like unormToHalfTable
+SIMD_TARGET_AVX2 void unormToHalfAVX2(const uint8_t rgba[64], uint16_t rgbaHalf[64]) {
+	const __m256 scale = _mm256_set1_ps(255.f);
+	for (int i = 0; i < 64; i += 8) {
+		const __m256i unorm = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(rgba + i)));
+		const __m256 value = _mm256_div_ps(_mm256_cvtepi32_ps(unorm), scale);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgbaHalf + i), _mm256_cvtps_ph(value, _MM_FROUND_TO_NEAREST_INT));
+	}
+}
+
+SIMD_TARGET_AVX2 void floatToHalfAVX2(const float rgba[64], uint16_t rgbaHalf[64]) {
+	for (int i = 0; i < 64; i += 8) {
+		const __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(rgba + i), _MM_FROUND_TO_NEAREST_INT);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgbaHalf + i), half);
+	}
+}
+
+// floatToUnorm on 8 halves
+SIMD_TARGET_AVX2 inline __m256i halfToUnorm8(const uint16_t* rgbaHalf) {
+	__m256 value = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgbaHalf)));
+	value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+	value = _mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.f)), _mm256_set1_ps(0.5f));
+	return _mm256_cvttps_epi32(value);
+}
+
+SIMD_TARGET_AVX2 void halfToUnormAVX2(const uint16_t rgbaHalf[64], uint8_t rgba[64]) {
+	for (int i = 0; i < 64; i += 16) {
+		// The 16-bit pack interleaves the 128-bit lanes, the permutation puts them back in order
+		__m256i words = _mm256_packus_epi32(halfToUnorm8(rgbaHalf + i), halfToUnorm8(rgbaHalf + i + 8));
+		words = _mm256_permute4x64_epi64(words, 0xD8);
+		const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + i), bytes);
+	}
+}
+
+const Kernels AVX2_KERNELS = {
+	SIMDLevel::AVX2, lookupColorsSSE41, lookupChannelAVX2, interpolateBC7AVX2, interpolateBC6HAVX2,
+	unormToHalfAVX2, floatToHalfAVX2, halfToUnormAVX2,
+};
+
+#endif
+
+const Kernels& kernelsFor(SIMDLevel level) {
+#if defined(SIMD_X86)
+	if (level == SIMDLevel::AVX2) return AVX2_KERNELS;
+	if (level == SIMDLevel::SSE41) return SSE41_KERNELS;
+#endif
+	return SCALAR_KERNELS;
+}
+
+std::atomic<const Kernels*>& selectedKernels() {
+	static std::atomic<const Kernels*> kernels = &kernelsFor(detectSIMDLevel());
+	return kernels;
+}
+
+const Kernels& currentKernels() {
+	return *selectedKernels().load(std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------------------------------
+// The blocks
+//--------------------------------------------------------------------------------------
+
+void decodeBlockRGBA16F(const Kernels& k, BCFormat format, const uint8_t* block, uint16_t rgbaHalf[64]);
+
+void decodeBlockRGBA8(const Kernels& k, BCFormat format, const uint8_t* block, uint8_t rgba[64]) {
+	switch (format) {
+		case BCFormat::BC1:
+			decodeColorBlock(k, block, rgba, true);
+			break;
+		case BCFormat::BC2:
+			decodeColorBlock(k, block + 8, rgba, false);
+			decodeExplicitAlpha(block, rgba);
+			break;
+		case BCFormat::BC3:
+			decodeColorBlock(k, block + 8, rgba, false);
+			decodeUnormChannel(k, block, rgba, 3);
+			break;
+		case BCFormat::BC4:
+			decodeUnormChannel(k, block, rgba, 0);
+			for (int i = 0; i < 16; i++) {
+				rgba[4 * i + 1] = rgba[4 * i + 2] = 0;
+				rgba[4 * i + 3] = 255;
+			}
+			break;
+		case BCFormat::BC5:
+			decodeUnormChannel(k, block, rgba, 0);
+			decodeUnormChannel(k, block + 8, rgba, 1);
+			for (int i = 0; i < 16; i++) {
+				rgba[4 * i + 2] = 0;
+				rgba[4 * i + 3] = 255;
+			}
+			break;
+		case BCFormat::BC7:
+			decodeBC7(k, block, rgba);
+			break;
+		default: {
+			// The negative and the HDR values are clamped
+			alignas(16) uint16_t half[64];
+			decodeBlockRGBA16F(k, format, block, half);
+			k.halfToUnorm(half, rgba);
+			break;
+		}
+	}
+}
+
+void decodeBlockRGBA16F(const Kernels& k, BCFormat format, const uint8_t* block, uint16_t rgbaHalf[64]) {
+	switch (format) {
+		case BCFormat::BC6H:
+		case BCFormat::BC6HSigned:
+			decodeBC6H(k, block, rgbaHalf, format == BCFormat::BC6HSigned);
+			break;
+		case BCFormat::BC4Signed:
+		case BCFormat::BC5Signed: {
+			alignas(32) float rgba[64] = {};
+			decodeSnormChannel(block, rgba);
+			if (format == BCFormat::BC5Signed) decodeSnormChannel(block + 8, rgba + 1);
+			for (int i = 0; i < 16; i++) rgba[4 * i + 3] = 1.f;
+			k.floatToHalf(rgba, rgbaHalf);
+			break;
+		}
+		default: {
+			alignas(16) uint8_t rgba[64];
+			decodeBlockRGBA8(k, format, block, rgba);
+			k.unormToHalf(rgba, rgbaHalf);
+			break;
+		}
+	}
+}
+
+}
+
+bool BCDecoder::fromDXGIFormat(uint32_t dxgiFormat, BCFormat& format) {
+	switch (dxgiFormat) {
+		case 70: case 71: case 72: format = BCFormat::BC1; return true;          // DXGI_FORMAT_BC1_*
+		case 73: case 74: case 75: format = BCFormat::BC2; return true;          // DXGI_FORMAT_BC2_*
+		case 76: case 77: case 78: format = BCFormat::BC3; return true;          // DXGI_FORMAT_BC3_*
+		case 79: case 80: format = BCFormat::BC4; return true;                   // DXGI_FORMAT_BC4_TYPELESS, _UNORM
+		case 81: format = BCFormat::BC4Signed; return true;                      // DXGI_FORMAT_BC4_SNORM
+		case 82: case 83: format = BCFormat::BC5; return true;                   // DXGI_FORMAT_BC5_TYPELESS, _UNORM
+		case 84: format = BCFormat::BC5Signed; return true;                      // DXGI_FORMAT_BC5_SNORM
+		case 94: case 95: format = BCFormat::BC6H; return true;                  // DXGI_FORMAT_BC6H_TYPELESS, _UF16
+		case 96: format = BCFormat::BC6HSigned; return true;                     // DXGI_FORMAT_BC6H_SF16
+		case 97: case 98: case 99: format = BCFormat::BC7; return true;          // DXGI_FORMAT_BC7_*
+		default: return false;
+	}
+}
+
+size_t BCDecoder::blockBytes(BCFormat format) {
+	return (format == BCFormat::BC1 || format == BCFormat::BC4 || format == BCFormat::BC4Signed) ? 8 : 16;
+}
+
+BCOutput BCDecoder::preferredOutput(BCFormat format) {
+	return isNativelyHalf(format) ? BCOutput::RGBA16F : BCOutput::RGBA8;
+}
+
+void BCDecoder::decodeBlock(BCFormat format, const uint8_t* block, uint8_t rgba[16 * 4]) {
+	decodeBlockRGBA8(currentKernels(), format, block, rgba);
+}
+
+void BCDecoder::decodeBlock(BCFormat format, const uint8_t* block, uint16_t rgbaHalf[16 * 4]) {
+	decodeBlockRGBA16F(currentKernels(), format, block, rgbaHalf);
+}
+
+void BCDecoder::decode(BCFormat format, const uint8_t* src, size_t srcRowPitch,
+                       size_t width, size_t height,
+                       BCOutput output, uint8_t* dst, size_t dstRowPitch,
+                       unsigned threads) {
+	const size_t blocksX = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const size_t blocksY = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	const size_t bytes = blockBytes(format);
+	const size_t pixelSize = pixelBytes(output);
+	const Kernels& k = currentKernels();
+
+	auto decodeRows = [&](size_t firstRow, size_t endRow) {
+		alignas(16) uint8_t rgba[64];
+		alignas(16) uint16_t rgbaHalf[64];
+		const uint8_t* pixels = output == BCOutput::RGBA8 ? rgba : reinterpret_cast<const uint8_t*>(rgbaHalf);
+
+		for (size_t by = firstRow; by < endRow; by++) {
+			const uint8_t* blockRow = src + by * srcRowPitch;
+			const size_t rows = std::min(BLOCK_SIZE, height - by * BLOCK_SIZE);
+			for (size_t bx = 0; bx < blocksX; bx++) {
+				if (output == BCOutput::RGBA8) decodeBlockRGBA8(k, format, blockRow + bx * bytes, rgba);
+				else decodeBlockRGBA16F(k, format, blockRow + bx * bytes, rgbaHalf);
+
+				const size_t columns = std::min(BLOCK_SIZE, width - bx * BLOCK_SIZE);
+				for (size_t y = 0; y < rows; y++) {
+					std::memcpy(dst + (by * BLOCK_SIZE + y) * dstRowPitch + bx * BLOCK_SIZE * pixelSize,
+					            pixels + y * BLOCK_SIZE * pixelSize, columns * pixelSize);
+				}
+			}
+		}
+	};
+
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t workers = std::min<size_t>(threads, std::max<size_t>(1, blocksY / MIN_BLOCK_ROWS_PER_THREAD));
+	if (workers <= 1) {
+		decodeRows(0, blocksY);
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	size_t rowsPerWorker = (blocksY + workers - 1) / workers;
+	for (size_t w = 1; w < workers; w++) {
+		size_t first = std::min(blocksY, w * rowsPerWorker), end = std::min(blocksY, first + rowsPerWorker);
+		pool.emplace_back(decodeRows, first, end);
+	}
+	decodeRows(0, std::min(blocksY, rowsPerWorker));
+	for (auto& thread : pool) thread.join();
+}
+
+SIMDLevel BCDecoder::getSIMDLevel() {
+	return currentKernels().level;
+}
+
+bool BCDecoder::setSIMDLevel(SIMDLevel level) {
+	if (level > detectSIMDLevel()) return false;
+	selectedKernels().store(&kernelsFor(level), std::memory_order_relaxed);
+	return true;
+}
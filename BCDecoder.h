@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// The block-compressed formats BCDecoder understands
+enum class BCFormat { BC1, BC2, BC3, BC4, BC4Signed, BC5, BC5Signed, BC6H, BC6HSigned, BC7 };
+
+// The decoded pixels. RGBA8 is R8G8B8A8_UNORM, RGBA16F is R16G16B16A16_FLOAT
+enum class BCOutput { RGBA8, RGBA16F };
+
+// The CPU decompressor for BC1 - BC7, for when the GPU can't sample a compressed format
+// (and for the software rasterizer and the tools that need plain pixels).
+//
+// The blocks are decoded independently, so the images are split between threads by block rows.
+// The bit fields are read by scalar code. The palette lookups, the BC6H and BC7 interpolation
+// and the conversions between the outputs have SSE4.1 and AVX2 (with F16C) kernels, picked at
+// run time (see CpuFeatures.h); the scalar ones are the fallback. Every level gives the same pixels.
+//
+// The class is pure logic, it doesn't touch Direct3D. The DXGI formats are passed as numbers.
+class BCDecoder {
+public:
+	static constexpr size_t BLOCK_SIZE = 4;    // The blocks are 4x4 pixels
+
+	// Maps a DXGI_FORMAT (the _UNORM, _SNORM, _SRGB and _TYPELESS variants of BC1 - BC7)
+	static bool fromDXGIFormat(uint32_t dxgiFormat, BCFormat& format);
+	static size_t blockBytes(BCFormat format);
+	// BC6H and the signed formats don't fit RGBA8
+	static BCOutput preferredOutput(BCFormat format);
+	static size_t pixelBytes(BCOutput output) { return output == BCOutput::RGBA8 ? 4 : 8; }
+
+	// One block into 16 pixels, row by row
+	static void decodeBlock(BCFormat format, const uint8_t* block, uint8_t rgba[16 * 4]);
+	static void decodeBlock(BCFormat format, const uint8_t* block, uint16_t rgbaHalf[16 * 4]);
+
+	// A whole surface. srcRowPitch is the size of one row of blocks. The pixels past width and height
+	// in the last blocks are dropped. 0 threads means "as many as the hardware has"
+	static void decode(BCFormat format, const uint8_t* src, size_t srcRowPitch,
+	                   size_t width, size_t height,
+	                   BCOutput output, uint8_t* dst, size_t dstRowPitch,
+	                   unsigned threads = 0);
+
+	// The kernels decodeBlock and decode use, the best ones of the CPU unless set otherwise (for the
+	// tests and the benchmarks). A level the CPU doesn't have isn't set
+	static SIMDLevel getSIMDLevel();
+	static bool setSIMDLevel(SIMDLevel level);
+};
@@ -0,0 +1,67 @@
+#include "CpuFeatures.h"
+
+#if defined(SIMD_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <windows.h>
+#elif defined(SIMD_X86)
+#include <cpuid.h>
+#endif
+
+namespace {
+
+#if defined(SIMD_X86)
+
+// CPUID.1:ECX and CPUID.7.0:EBX, the bits the OS support checks don't cover
+const unsigned CPUID1_ECX_F16C = 1u << 29;
+const unsigned CPUID7_EBX_BMI2 = 1u << 8;
+
+#if defined(_MSC_VER)
+
+SIMDLevel detect() {
+	int info1[4], info7[4];
+	__cpuid(info1, 1);
+	__cpuidex(info7, 7, 0);
+	const bool f16c = (unsigned(info1[2]) & CPUID1_ECX_F16C) != 0;
+	const bool bmi2 = (unsigned(info7[1]) & CPUID7_EBX_BMI2) != 0;
+	// These ones also check that the OS saves the YMM registers
+	if (IsProcessorFeaturePresent(PF_AVX2_INSTRUCTIONS_AVAILABLE) && f16c && bmi2) return SIMDLevel::AVX2;
+	if (IsProcessorFeaturePresent(PF_SSE4_1_INSTRUCTIONS_AVAILABLE) &&
+	    IsProcessorFeaturePresent(PF_SSSE3_INSTRUCTIONS_AVAILABLE)) return SIMDLevel::SSE41;
+	return SIMDLevel::Scalar;
+}
+
+#else
+
+SIMDLevel detect() {
+	unsigned eax, ebx, ecx, edx, ecx1 = 0, ebx7 = 0;
+	if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) ecx1 = ecx;
+	if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) ebx7 = ebx;
+	__builtin_cpu_init();
+	// __builtin_cpu_supports also checks that the OS saves the YMM registers
+	if (__builtin_cpu_supports("avx2") && (ecx1 & CPUID1_ECX_F16C) && (ebx7 & CPUID7_EBX_BMI2)) return SIMDLevel::AVX2;
+	if (__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("ssse3")) return SIMDLevel::SSE41;
+	return SIMDLevel::Scalar;
+}
+
+#endif
+
+#else
+
+SIMDLevel detect() { return SIMDLevel::Scalar; }
+
+#endif
+
+}
+
+SIMDLevel detectSIMDLevel() {
+	static const SIMDLevel level = detect();
+	return level;
+}
+
+const char* simdLevelName(SIMDLevel level) {
+	switch (level) {
+		case SIMDLevel::SSE41: return "SSE4.1";
+		case SIMDLevel::AVX2: return "AVX2";
+		default: return "scalar";
+	}
+}
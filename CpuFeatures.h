@@ -0,0 +1,29 @@
+#pragma once
+
+// The instruction sets the SIMD kernels of BCDecoder, MipGenerator and SoftwareRasterizer are written for.
+//
+// The binaries must run on any x86-64 CPU, so the kernels are compiled per function (SIMD_TARGET
+// on GCC and Clang, MSVC needs nothing) and picked at run time, once, from what the CPU and the OS
+// support. Every module keeps its scalar code as the fallback, and every level gives
+// the same results as the scalar one. The SIMD kernels are x86-64 only.
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIMD_X86 1
+#endif
+
+#if defined(SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(features) __attribute__((target(features)))
+#else
+#define SIMD_TARGET(features)
+#endif
+
+// The target strings of the levels
+#define SIMD_TARGET_SSE41 SIMD_TARGET("sse4.1")
+#define SIMD_TARGET_AVX2 SIMD_TARGET("avx2,f16c,bmi2")
+
+// From the slowest. SSE41 includes SSSE3; AVX2 includes F16C and BMI2, which every AVX2 CPU has
+enum class SIMDLevel { Scalar, SSE41, AVX2 };
+
+// The best level this machine runs, detected at the first call
+SIMDLevel detectSIMDLevel();
+const char* simdLevelName(SIMDLevel level);
@@ -2,19 +2,66 @@
 
 #include "Base.h"
 #include "GraphicContents.h"
+#include "ShaderCache.h"
+#include "TextureCache.h"
+#include "ResizePolicy.h"
+#include "DisplayTopology.h"
+#include "TraceRecorder.h"
+#include "Platform.h"
 
 #if defined(USE_DX11)
 #include <d3d11.h>
-#include <dxgi1_2.h>
+#include <dxgi1_3.h>
+#include "RingBufferAllocator.h"
 #elif defined(USE_DX12)
 #include <directx/d3d12.h>
 #include <dxgi1_4.h>
+#include "PipelineCache.h"
+#include "FrameUploadAllocator.h"
+#include "FenceTimeline.h"
 #else
 #error "You should set either USE_DX11 or USE_DX12"
 #endif
 
 #include <vector>
 #include <memory>
+#include <string>
+
+// The real HLSL compiler (D3DCompile2) behind the ShaderCache interface
+struct D3DShaderCompiler : public ShaderCompiler, public Base {
+	std::vector<uint8_t> compile(const std::string& source, const std::string& entryPoint,
+	                             const std::string& target, uint32_t flags) override;
+};
+
+// Loads the TextureCache entries with the DDS loader of the DirectX version. The textures are
+// ID3D11ShaderResourceView* with DX11 and ID3D12Resource* (in PIXEL_SHADER_RESOURCE) with DX12
+struct D3DTextureResidency : public TextureResidency {
+#if defined(USE_DX11)
+	ID3D11Device* device = nullptr;
+#elif defined(USE_DX12)
+	ID3D12Device* device = nullptr;
+	ID3D12CommandQueue* commandQueue = nullptr;    // The uploads wait for it
+#else
+#error "You should set either USE_DX11 or USE_DX12"
+#endif
+
+	// flags are DDS_LOADER_FLAGS
+	bool load(const std::string& path, uint32_t flags, CachedTexture& texture) override;
+	void evict(const CachedTexture& texture) override;
+};
+
+#if defined(USE_DX12)
+// The FenceTimeline side of a Direct3D 12 queue. The objects belong to the context
+struct D3D12FenceQueue : public FenceQueue {
+	ID3D12CommandQueue* commandQueue = nullptr;
+	ID3D12Fence* fence = nullptr;
+	HANDLE event = nullptr;
+
+	void signal(uint64_t value) override;
+	uint64_t getCompletedValue() override;
+	void wait(uint64_t value) override;
+};
+#endif
 
 // The base class for the Direct3D contexts.
 // Contains common (mostly DXGI) logic between the DirectX versions
@@ -28,11 +75,28 @@ struct D3DContextBase : public Base {
 #endif
 	std::shared_ptr<GraphicContents> contents;
 
-	IDXGIAdapter* intelAdapter = nullptr;
+	static const UINT INTEL_VENDOR_ID = 0x8086;
+
+	IDXGIAdapter* intelAdapter = nullptr;       // Points into adapters
 	IDXGIFactory2* dxgiFactory = nullptr;
 
-	IDXGIOutput* intelAdapterFirstOutput = nullptr;
+	IDXGIOutput* intelOutput = nullptr;         // Points into outputs
 	std::vector<IDXGIAdapter*> adapters;
+	std::vector<IDXGIOutput*> outputs;          // Parallel to topology.getOutputs()
+
+	// Enumerating the adapters and outputs is slow, so it is done once
+	// and repeated only if the displays change
+	DisplayTopology topology;
+	bool topologyValid = false;
+
+	D3DShaderCompiler shaderCompiler;
+	ShaderCache shaderCache;
+
+	// Set up by the derived contexts once the device exists, cleared before it goes
+	D3DTextureResidency textureResidency;
+	TextureCache textureCache;
+
+	ResizePolicy resizePolicy;
 
 	void checkDeviceRemoved(HRESULT hr) const;
 	static bool checkRECTsIntersect(const RECT& r1, const RECT& r2);
@@ -48,18 +112,40 @@ struct D3DContextBase : public Base {
 	// This one should be called between the drawing function and the swapChain->Present() call
 	void syncIntelOutput() const;
 
-	RECT getFullDisplayRECT() const;
+	void refreshDisplayTopology();
+	void releaseDisplayTopology();
+	// Refreshes the topology if it has been invalidated or the DXGI factory is stale
+	const DisplayTopology& getDisplayTopology();
+	// Call this on WM_DISPLAYCHANGE
+	void invalidateDisplayTopology() { topologyValid = false; }
+
+	RECT getFullDisplayRECT();
 
 	virtual ~D3DContextBase();
 };
 
 
 // The Direct3D-specific context. Depends on the DirectX version flags
-struct D3DContext : public D3DContextBase {
+struct D3DContext : public D3DContextBase, public RenderSurface {
 #if defined(USE_DX11)
     ID3D11DeviceContext *deviceContext;
     IDXGISwapChain1 *swapChain;
-	ID3D11ShaderResourceView* imageTextureView = nullptr;
+    IDXGISwapChain2 *swapChain2 = nullptr;     // For SetSourceSize()
+	TextureCache::Reference imageTexture;                  // An ID3D11ShaderResourceView
+	ID3D11Buffer* vertexRingBuffer = nullptr;
+	RingBufferAllocator vertexRing;
+
+	// Long-lived device objects, so that the resize hot path only records the drawing commands
+	ID3D11RenderTargetView* renderTargetView = nullptr;     // Recreated only after ResizeBuffers
+	ID3D11VertexShader* vertexShader = nullptr;
+	ID3D11PixelShader* pixelShader = nullptr;
+	ID3D11InputLayout* inputLayout = nullptr;
+	std::string shaderCode;                                 // The source the shader objects were created from
+
+	void CreateRenderTarget();
+	void CleanupRenderTarget();
+	void CreateShaders(const std::string& shader_code);
+	void CleanupShaders();
     void DrawTriangle(int width, int height,
                       ID3D11Device* device,
                       ID3D11DeviceContext* device_context,
@@ -70,11 +156,14 @@ struct D3DContext : public D3DContextBase {
     struct FrameContext
     {
         ID3D12CommandAllocator* CommandAllocator;
-        UINT64                  FenceValue;
     };
 
     static int const NUM_BACK_BUFFERS = 3;
     static int const NUM_FRAMES_IN_FLIGHT = 3;
+    // The frames queued for presentation before WaitForNextFrameResources blocks. 1 gives the lowest
+    // input-to-photon latency, more lets the CPU run ahead for the throughput
+    static UINT const DEFAULT_MAX_FRAME_LATENCY = 1;
+    static UINT const SWAP_CHAIN_FLAGS = DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
 
     FrameContext                 g_frameContext[NUM_FRAMES_IN_FLIGHT] = {};
     UINT                         g_frameIndex = 0;
@@ -86,9 +175,15 @@ struct D3DContext : public D3DContextBase {
     ID3D12GraphicsCommandList*   g_pd3dCommandList = nullptr;
     ID3D12Fence*                 g_fence = nullptr;
     HANDLE                       g_fenceEvent = nullptr;
-    UINT64                       g_fenceLastSignaledValue = 0;
+    // Which frame slot the GPU may still use and when the back buffers are free, see FenceTimeline
+    D3D12FenceQueue              fenceQueue;
+    FenceTimeline                fenceTimeline { fenceQueue, NUM_FRAMES_IN_FLIGHT };
     IDXGISwapChain3*             swapChain = nullptr;
-    HANDLE                       g_hSwapChainWaitableObject = nullptr;
+    HANDLE                       g_hSwapChainWaitableObject = nullptr;     // Taken once, see SWAP_CHAIN_FLAGS
+    UINT                         maxFrameLatency = DEFAULT_MAX_FRAME_LATENCY;
+    // The frame-latency waits that timed out or failed, and the counts of the waitable they didn't take
+    size_t                       frameLatencyTimeouts = 0;
+    UINT                         frameLatencyDebt = 0;
     ID3D12Resource*              g_mainRenderTargetResource[NUM_BACK_BUFFERS] = {};
     D3D12_CPU_DESCRIPTOR_HANDLE  g_mainRenderTargetDescriptor[NUM_BACK_BUFFERS] = {};
 	ID3D12Resource*              imageTextureView = nullptr;
@@ -97,38 +192,68 @@ struct D3DContext : public D3DContextBase {
 
 private:
 	struct DrawingCache {
-		ID3D12Resource* vertex_buffer = nullptr;
-		ID3D12PipelineState *pipeline = nullptr;
-        ~DrawingCache() {
-            if (vertex_buffer != nullptr) { vertex_buffer->Release(); }
-            if (pipeline != nullptr) { pipeline->Release(); }
-        }
+		// The per-frame vertices come from a persistently mapped upload buffer, a region per frame in flight
+		ID3D12Resource* upload_buffer = nullptr;
+		uint8_t* upload_data = nullptr;
+		FrameUploadAllocator upload_allocator { NUM_FRAMES_IN_FLIGHT };
+		UINT64 frame_fence_value = 0;       // The fence value the current frame signals
+		// The outgrown upload buffers, released once the fence passes the value of the last frame that used them
+		std::vector<std::pair<ID3D12Resource*, UINT64>> retired_upload_buffers;
+		std::unique_ptr<PipelineCache> pipelines;   // Created together with the device
+
+		// Empties the region of the frame, the GPU is done with it
+		void beginFrame(UINT frame_index, UINT64 fence_value, UINT64 completed_fence_value);
+		// Grows the buffer if the frame outgrows its region
+		uint8_t* allocateUpload(ID3D12Device* device, size_t size, size_t alignment, D3D12_GPU_VIRTUAL_ADDRESS& gpu_address);
+		void releaseUploadBuffers();
+        ~DrawingCache() { releaseUploadBuffers(); }
 	};
 	DrawingCache drawingCache;
 
+	// What a frame needs that doesn't depend on the back buffers, so it is ready before a resize waits
+	struct PreparedFrame {
+		D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {};
+		UINT vertex_count = 0;
+		ID3D12RootSignature* root_signature = nullptr;
+		ID3D12PipelineState* pipeline = nullptr;
+	};
+
 	bool CreateDeviceD3D();
     void CleanupDeviceD3D();
     void CreateRenderTarget();
     void CleanupRenderTarget();
-    void WaitForLastSubmittedFrame();
-    void FlushGPU();
     FrameContext* WaitForNextFrameResources();
+    // Everything from the frame-latency wait to the Present, the resizing included
+    void DrawFrame(const RECT& position, UINT syncInterval, UINT presentFlags);
+    static PreparedFrame PrepareFrame(ID3D12Device* device,
+                                      DrawingCache* drawing_cache,
+                                      ShaderCache& shader_cache,
+                                      std::shared_ptr<GraphicContents> contents);
     static void DrawTriangle(int width, int height,
-                             ID3D12Device* device,
                              ID3D12GraphicsCommandList* graphics_command_list,
                              ID3D12CommandQueue* command_queue,
-                             IDXGISwapChain3* swap_chain,
                              ID3D12Resource* mainRenderTargetResource,
 							 D3D12_CPU_DESCRIPTOR_HANDLE& mainRenderTargetDescriptor,
-							 FrameContext* frameCtx, DrawingCache* vertex_buffer,
-                             std::shared_ptr<GraphicContents> contents);
+							 FrameContext* frameCtx, const PreparedFrame& frame);
 
 public:
+    // Can change between the frames, 1 to NUM_FRAMES_IN_FLIGHT. The waits it causes are traced
+    // as "WaitForFrameLatency", the fence waits as "WaitForFence"
+    void setMaximumFrameLatency(UINT latency);
+    UINT getMaximumFrameLatency() const { return maxFrameLatency; }
+    // Also traced as "FrameLatencyTimeout"
+    size_t getFrameLatencyTimeouts() const { return frameLatencyTimeouts; }
 #else
 #error "You should set either USE_DX11 or USE_DX12"
 #endif
 
+    RECT lastPosition = {};     // Where the animation frames are drawn
+
     explicit D3DContext(std::shared_ptr<GraphicContents> contents);
     void reposition(const RECT& position);
+    void reposition(const DisplayRect& position) override {
+        reposition(RECT { position.left, position.top, position.right, position.bottom });
+    }
+    void presentFrame() override;
     ~D3DContext() override;
 };
\ No newline at end of file
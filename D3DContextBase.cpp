@@ -1,8 +1,36 @@
 #include "D3DContext.h"
 
+#include <d3dcompiler.h>
+
 #include <iostream>
+#include <stdexcept>
 #include <utility>
 
+std::vector<uint8_t> D3DShaderCompiler::compile(const std::string& source, const std::string& entryPoint,
+                                                const std::string& target, uint32_t flags) {
+	ID3DBlob *code = nullptr, *error = nullptr;
+	HRESULT hr = D3DCompile2(source.c_str(), source.length(),
+	                         nullptr,
+	                         nullptr, nullptr, entryPoint.c_str(), target.c_str(), flags, 0,
+	                         0, nullptr, 0,
+	                         &code, &error);
+	if (FAILED(hr)) {
+		std::string err = "Shader compilation error (" + entryPoint + ", " + target + "): ";
+		if (error != nullptr) {
+			err += reinterpret_cast<const char*>(error->GetBufferPointer());
+			error->Release();
+		}
+		if (code != nullptr) code->Release();
+		throw std::runtime_error(err);
+	}
+	if (error != nullptr) error->Release();
+
+	auto begin = static_cast<const uint8_t*>(code->GetBufferPointer());
+	std::vector<uint8_t> bytecode(begin, begin + code->GetBufferSize());
+	code->Release();
+	return bytecode;
+}
+
 bool D3DContextBase::checkRECTsIntersect(const RECT& r1, const RECT& r2) {
 	return r1.left < r2.right && r2.left < r1.right &&
 		   r1.top < r2.bottom && r2.top < r1.bottom;
@@ -33,43 +61,77 @@ void D3DContextBase::checkDeviceRemoved(HRESULT hr) const {
     }
 }
 
-D3DContextBase::D3DContextBase(std::shared_ptr<GraphicContents> contents) : contents(std::move(contents)), device(nullptr) {
+D3DContextBase::D3DContextBase(std::shared_ptr<GraphicContents> contents) : contents(std::move(contents)), device(nullptr),
+		shaderCache(shaderCompiler, "shader_cache"), textureCache(textureResidency) {
 	// Create the DXGI factory.
 	hr_check(CreateDXGIFactory1(IID_PPV_ARGS(&dxgiFactory)));
 
-	// Look for the adapters (and specifically an Intel GPU) in the system
-	const UINT INTEL_VENDOR_ID = 0x8086;
+	// Look for the adapters (and specifically an Intel GPU) and their outputs in the system
+	refreshDisplayTopology();
+}
+
+void D3DContextBase::releaseDisplayTopology() {
+	intelOutput = nullptr;
+	intelAdapter = nullptr;
+	for (IDXGIOutput* o : outputs) { o->Release(); }
+	outputs.clear();
+	for (IDXGIAdapter* a : adapters) { a->Release(); }
+	adapters.clear();
+	topologyValid = false;
+}
+
+void D3DContextBase::refreshDisplayTopology() {
+	releaseDisplayTopology();
+
+	if (!dxgiFactory->IsCurrent()) {
+		// Adapters or outputs were added or removed. Only a new factory enumerates them correctly
+		dxgiFactory->Release();
+		dxgiFactory = nullptr;
+		hr_check(CreateDXGIFactory1(IID_PPV_ARGS(&dxgiFactory)));
+	}
+
+	std::vector<DisplayOutput> descs;
 	IDXGIAdapter* adapter;
-	for (UINT i = 0; dxgiFactory->EnumAdapters(i, &adapter) != DXGI_ERROR_NOT_FOUND; i++) {
+	for (UINT a = 0; dxgiFactory->EnumAdapters(a, &adapter) != DXGI_ERROR_NOT_FOUND; a++) {
 		DXGI_ADAPTER_DESC desc;
 		adapters.push_back(adapter);
 		hr_check(adapter->GetDesc(&desc));
-		if (desc.VendorId == INTEL_VENDOR_ID) {
-			this->intelAdapter = adapter;
-			return;
+		if (desc.VendorId == INTEL_VENDOR_ID && intelAdapter == nullptr) {
+			intelAdapter = adapter;
 		}
-	}
 
-	dxgiFactory->Release();
-}
-
-RECT D3DContextBase::getFullDisplayRECT() const {
-	// Calculating the whole virtual desktop size
-	IDXGIOutput* output;
-	LONG leftmost = 0, topmost = 0, rightmost = 0, bottommost = 0;
-	for (IDXGIAdapter* a : adapters) {
-		for (UINT i = 0; a->EnumOutputs(i, &output) != DXGI_ERROR_NOT_FOUND; i++) {
+		IDXGIOutput* output;
+		for (UINT o = 0; adapter->EnumOutputs(o, &output) != DXGI_ERROR_NOT_FOUND; o++) {
 			DXGI_OUTPUT_DESC outputDesc;
+			outputs.push_back(output);
 			hr_check(output->GetDesc(&outputDesc));
-			if (outputDesc.DesktopCoordinates.left < leftmost) leftmost = outputDesc.DesktopCoordinates.left;
-			if (outputDesc.DesktopCoordinates.top < topmost) topmost = outputDesc.DesktopCoordinates.top;
-			if (outputDesc.DesktopCoordinates.right > rightmost) rightmost = outputDesc.DesktopCoordinates.right;
-			if (outputDesc.DesktopCoordinates.bottom > bottommost) bottommost = outputDesc.DesktopCoordinates.bottom;
-			output->Release();
+
+			const RECT& r = outputDesc.DesktopCoordinates;
+			descs.push_back({
+				.desktop = { r.left, r.top, r.right, r.bottom },
+				.vendorId = desc.VendorId,
+				.adapterIndex = a,
+				.outputIndex = o,
+				.attached = outputDesc.AttachedToDesktop && outputDesc.Monitor != nullptr,
+			});
 		}
 	}
 
-	return { leftmost, topmost, rightmost, bottommost };
+	topology = DisplayTopology(std::move(descs));
+	topologyValid = true;
+}
+
+const DisplayTopology& D3DContextBase::getDisplayTopology() {
+	if (!topologyValid || !dxgiFactory->IsCurrent()) {
+		refreshDisplayTopology();
+	}
+	return topology;
+}
+
+RECT D3DContextBase::getFullDisplayRECT() {
+	// The whole virtual desktop size
+	DisplayRect bounds = getDisplayTopology().getBounds();
+	return { bounds.left, bounds.top, bounds.right, bounds.bottom };
 }
 
 // If there is an Intel adapter in the system, we have to synchronize with it manually,
@@ -78,40 +140,34 @@ RECT D3DContextBase::getFullDisplayRECT() const {
 //
 // This one should be called between the drawing function and the swapChain->Present() call
 void D3DContextBase::lookForIntelOutput(const RECT& position) {
-	if (intelAdapterFirstOutput != nullptr) {
-		intelAdapterFirstOutput->Release();
-		intelAdapterFirstOutput = nullptr;
+	const DisplayTopology& t = getDisplayTopology();
+	intelOutput = nullptr;
+	if (intelAdapter == nullptr) return;
+
+	// Preferring the Intel output the window is on. If the window is on another adapter's
+	// output, we are still syncing with the first Intel output that has a monitor
+	int i = t.findOutputContaining({ position.left, position.top, position.right, position.bottom });
+	if (i >= 0 && t.getOutputs()[i].vendorId == INTEL_VENDOR_ID) {
+		intelOutput = outputs[i];
+		return;
 	}
-	if (intelAdapter != nullptr) {
-		IDXGIOutput* output;
-		for (UINT i = 0; intelAdapter->EnumOutputs(i, &output) != DXGI_ERROR_NOT_FOUND; i++) {
-			DXGI_OUTPUT_DESC outputDesc;
-			hr_check(output->GetDesc(&outputDesc));
-			if (outputDesc.Monitor != nullptr /*&&
-				outputDesc.DesktopCoordinates.left <= position.right &&
-				outputDesc.DesktopCoordinates.top <= position.bottom &&
-				outputDesc.DesktopCoordinates.right >= position.right &&
-				outputDesc.DesktopCoordinates.bottom >= position.bottom*/) {
-
-				intelAdapterFirstOutput = output;
-				//std::cout << i << std::endl;
-				break;
-			} else {
-				output->Release();
-			}
+
+	for (size_t k = 0; k < outputs.size(); k++) {
+		if (t.getOutputs()[k].vendorId == INTEL_VENDOR_ID && t.getOutputs()[k].attached) {
+			intelOutput = outputs[k];
+			return;
 		}
 	}
 }
 
 void D3DContextBase::syncIntelOutput() const {
-	if (intelAdapterFirstOutput != nullptr) {
-		hr_check(intelAdapterFirstOutput->WaitForVBlank());
+	if (intelOutput != nullptr) {
+		ScopedTimer timer("syncIntelOutput");
+		hr_check(intelOutput->WaitForVBlank());
 	}
 }
 
 D3DContextBase::~D3DContextBase() {
+	releaseDisplayTopology();
 	if (dxgiFactory != nullptr) dxgiFactory->Release();
-    if (intelAdapterFirstOutput != nullptr) { intelAdapterFirstOutput->Release(); }
-	for (IDXGIAdapter* a : adapters) { a->Release(); }
 }
-
@@ -1,8 +1,11 @@
 #include "D3DContext.h"
 #include "DDSTextureLoader.h"
+#include "DDSParser.h"
 
 #include "d3dcompiler.h"
 
+#include <algorithm>
+#include <filesystem>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -10,135 +13,208 @@
 
 using namespace DirectX;
 
+namespace {
+
+// What the texture takes in the video memory: all the mips of all the array items
+size_t getTextureBytes(ID3D11Resource* resource) {
+	D3D11_RESOURCE_DIMENSION dimension;
+	resource->GetType(&dimension);
+
+	DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;
+	size_t width = 1, height = 1, depth = 1, mipCount = 1, arraySize = 1;
+	if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE1D) {
+		ID3D11Texture1D* texture = nullptr;
+		if (FAILED(resource->QueryInterface(IID_PPV_ARGS(&texture)))) return 0;
+		D3D11_TEXTURE1D_DESC desc;
+		texture->GetDesc(&desc);
+		texture->Release();
+		format = desc.Format; width = desc.Width; mipCount = desc.MipLevels; arraySize = desc.ArraySize;
+	} else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D) {
+		ID3D11Texture2D* texture = nullptr;
+		if (FAILED(resource->QueryInterface(IID_PPV_ARGS(&texture)))) return 0;
+		D3D11_TEXTURE2D_DESC desc;
+		texture->GetDesc(&desc);
+		texture->Release();
+		format = desc.Format; width = desc.Width; height = desc.Height; mipCount = desc.MipLevels; arraySize = desc.ArraySize;
+	} else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE3D) {
+		ID3D11Texture3D* texture = nullptr;
+		if (FAILED(resource->QueryInterface(IID_PPV_ARGS(&texture)))) return 0;
+		D3D11_TEXTURE3D_DESC desc;
+		texture->GetDesc(&desc);
+		texture->Release();
+		format = desc.Format; width = desc.Width; height = desc.Height; depth = desc.Depth; mipCount = desc.MipLevels;
+	} else {
+		return 0;
+	}
+
+	size_t total = 0;
+	size_t w = width, h = height, d = depth;
+	for (size_t mip = 0; mip < mipCount; mip++) {
+		size_t numBytes = 0, rowBytes = 0, numRows = 0;
+		if (DDSParser::surfaceInfo(static_cast<DXGIFormat>(format), w, h, numBytes, rowBytes, numRows) == DDSStatus::OK) {
+			total += numBytes * d * arraySize;
+		}
+		w = std::max<size_t>(w >> 1, 1);
+		h = std::max<size_t>(h >> 1, 1);
+		d = std::max<size_t>(d >> 1, 1);
+	}
+	return total;
+}
+
+}
+
+bool D3DTextureResidency::load(const std::string& path, uint32_t flags, CachedTexture& texture) {
+	ID3D11Resource* resource = nullptr;
+	ID3D11ShaderResourceView* view = nullptr;
+	HRESULT hr = CreateDDSTextureFromFileEx(device, std::filesystem::path(path).c_str(), 0,
+	                                        D3D11_USAGE_DEFAULT, D3D11_BIND_SHADER_RESOURCE, 0, 0,
+	                                        static_cast<DDS_LOADER_FLAGS>(flags), &resource, &view);
+	if (FAILED(hr)) return false;
+
+	// The view holds the resource
+	texture.texture = view;
+	texture.gpuBytes = getTextureBytes(resource);
+	texture.cpuBytes = 0;    // The file data is gone once the texture is created
+	resource->Release();
+	return true;
+}
+
+void D3DTextureResidency::evict(const CachedTexture& texture) {
+	static_cast<ID3D11ShaderResourceView*>(texture.texture)->Release();
+}
+
 void D3DContext::DrawTriangle(int width, int height,
                    ID3D11Device* device,
                    ID3D11DeviceContext* device_context,
                    IDXGISwapChain1* swap_chain,
                    std::shared_ptr<GraphicContents> contents) {
 
-    auto vertices = contents->getVertices();
+    const size_t vertex_count = contents->getVertexCount();
+    const size_t vertices_size = vertex_count * sizeof(TextureVertex);
+
+    // The vertex buffer is persistent and only recreated when the contents outgrow it
+    if (vertexRingBuffer == nullptr || vertices_size > vertexRing.getCapacity()) {
+        if (vertexRingBuffer != nullptr) { vertexRingBuffer->Release(); vertexRingBuffer = nullptr; }
+        vertexRing.reset(RingBufferAllocator::grownCapacity(vertexRing.getCapacity(), vertices_size));
+
+        D3D11_BUFFER_DESC vb_desc;
+        ZeroMemory(&vb_desc, sizeof(vb_desc));
+        vb_desc.ByteWidth = (UINT)vertexRing.getCapacity();
+        vb_desc.Usage = D3D11_USAGE_DYNAMIC;
+        vb_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        vb_desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        vb_desc.MiscFlags = 0;
+        vb_desc.StructureByteStride = sizeof(TextureVertex);
 
-    D3D11_BUFFER_DESC vb_desc;
-    ZeroMemory(&vb_desc, sizeof(vb_desc));
-    vb_desc.ByteWidth = (UINT)(vertices.size() * sizeof(TextureVertex));
-    vb_desc.Usage = D3D11_USAGE_DEFAULT;
-    vb_desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    vb_desc.CPUAccessFlags = 0;
-    vb_desc.MiscFlags = 0;
-    vb_desc.StructureByteStride = sizeof(TextureVertex);
+        hr_check(device->CreateBuffer(&vb_desc, nullptr, &vertexRingBuffer));
+    }
 
-    D3D11_SUBRESOURCE_DATA vb_data;
-    ZeroMemory(&vb_data, sizeof(vb_data));
-    vb_data.pSysMem = &vertices[0];
+    RingBufferAllocator::Allocation allocation = {};
+    if (!vertexRing.allocate(vertices_size, sizeof(TextureVertex), allocation)) {
+        throw std::runtime_error("The vertex ring buffer is smaller than a single frame");
+    }
 
     {
-        ID3D11Buffer *vertex_buffer;
+        D3D11_MAPPED_SUBRESOURCE mapped;
+        hr_check(device_context->Map(vertexRingBuffer, 0,
+                                     allocation.discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+                                     0, &mapped));
+        // The contents write their vertices directly into the mapped buffer
+        auto dst = reinterpret_cast<TextureVertex*>(static_cast<uint8_t*>(mapped.pData) + allocation.offset);
+        contents->writeVertices(std::span<TextureVertex>(dst, vertex_count));
+        device_context->Unmap(vertexRingBuffer, 0);
+    }
+
+    // The shader objects live as long as the contents keep returning the same shader
+    std::string shader_code = contents->getShader();
+    if (vertexShader == nullptr || shader_code != shaderCode) {
+        CleanupShaders();
+        CreateShaders(shader_code);
+    }
+
+    // After this point and before swapChain->Present(), we should only record the drawing commands
+    {
         const UINT stride = sizeof(TextureVertex);
-        const UINT offset = 0;
-        device->CreateBuffer(&vb_desc, &vb_data, &vertex_buffer);
-        device_context->IASetVertexBuffers(0, 1, &vertex_buffer, &stride, &offset);
+        const UINT offset = (UINT)allocation.offset;
+        device_context->IASetVertexBuffers(0, 1, &vertexRingBuffer, &stride, &offset);
+        device_context->IASetInputLayout(inputLayout);
+        device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);//D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        device_context->VSSetShader(vertexShader, nullptr, 0);
+        device_context->PSSetShader(pixelShader, nullptr, 0);
+        ID3D11ShaderResourceView* imageTextureView = imageTexture.as<ID3D11ShaderResourceView>();
+        device_context->PSSetShaderResources( 0, 1, &imageTextureView );
+
+        {
+            D3D11_VIEWPORT viewport;
+            viewport.MinDepth = 0;
+            viewport.MaxDepth = 1;
+            viewport.TopLeftX = 0;
+            viewport.TopLeftY = 0;
+            viewport.Width = (float) width;
+            viewport.Height = (float) height;
+            device_context->RSSetViewports(1u, &viewport);
+        }
 
+        FLOAT color[] = {0.0f, 0.2f, 0.4f, 1.0f};
+        // Render to the target
         {
-            ID3D11InputLayout *input_layout;
-            ID3D11VertexShader *vertex_shader;
-            ID3D11PixelShader *pixel_shader;
-            {
-                ID3DBlob *vs, *vs_error;
-                ID3DBlob *ps, *ps_error;
-
-                std::string shader_code = contents->getShader();
-
-                auto hresult = D3DCompile2(shader_code.c_str(), shader_code.length(),
-                                     nullptr,
-                                     nullptr, nullptr, "PSMain", "ps_4_0", D3DCOMPILE_DEBUG, 0,
-                                     0, nullptr, 0,
-                                     &ps, &ps_error);
-
-                if (ps_error != nullptr) {
-					std::string err = "Pixel shader compilation error: ";
-					err += reinterpret_cast<const char*>( ps_error->GetBufferPointer());
-					throw std::runtime_error(err);
-                }
-
-                hr_check(device->CreatePixelShader(ps->GetBufferPointer(), ps->GetBufferSize(), nullptr, &pixel_shader));
-                device_context->PSSetShader(pixel_shader, nullptr, 0);
-
-                hr_check(D3DCompile2(shader_code.c_str(), shader_code.length(),
-                                     nullptr,
-                                     nullptr, nullptr, "VSMain", "vs_4_0", D3DCOMPILE_DEBUG, 0,
-                                     0, nullptr, 0,
-                                     &vs, &vs_error));
-
-                if (vs_error != nullptr) {
-                    throw std::runtime_error("Vertex shader compilation error");
-                }
-
-                hr_check(device->CreateVertexShader(vs->GetBufferPointer(), vs->GetBufferSize(), nullptr, &vertex_shader));
-                device_context->VSSetShader(vertex_shader, nullptr, 0);
-				device_context->PSSetShaderResources( 0, 1, &imageTextureView );
-
-                D3D11_INPUT_ELEMENT_DESC element_desc[] =
-                {
-                        { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-						{ "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
-                        //{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
-                };
-
-                hr_check(device->CreateInputLayout(element_desc, sizeof(element_desc) / sizeof(D3D11_INPUT_ELEMENT_DESC), vs->GetBufferPointer(), vs->GetBufferSize(), &input_layout));
-
-                device_context->IASetInputLayout(input_layout);
-
-                vs->Release();
-                ps->Release();
-                if (vs_error != nullptr) vs_error->Release();
-                if (ps_error != nullptr) ps_error->Release();
-            }
-
-            device_context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);//D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
-            {
-                D3D11_VIEWPORT viewport;
-                viewport.MinDepth = 0;
-                viewport.MaxDepth = 1;
-                viewport.TopLeftX = 0;
-                viewport.TopLeftY = 0;
-                viewport.Width = (float) width;
-                viewport.Height = (float) height;
-                device_context->RSSetViewports(1u, &viewport);
-            }
-
-            FLOAT color[] = {0.0f, 0.2f, 0.4f, 1.0f};
-            // Render to the target
-            {
-                ID3D11RenderTargetView *rtv;
-                ID3D11Resource *buffer;
-
-                hr_check(swap_chain->GetBuffer(0, IID_PPV_ARGS(&buffer)));
-                hr_check(device->CreateRenderTargetView(buffer, nullptr, &rtv));
-
-                // After this point and before swapChin->Present(), we should render as fast as possible
-                device_context->ClearRenderTargetView(rtv, color);
-
-                device_context->OMSetRenderTargets(1, &rtv, nullptr);
-                device_context->Draw((UINT)vertices.size(), 0);
-
-				syncIntelOutput();
-
-				// Discard outstanding queued presents and queue a frame with the new size ASAP.
-				checkDeviceRemoved(swapChain->Present(0, DXGI_PRESENT_RESTART));
-
-				buffer->Release();
-                rtv->Release();
-            }
-
-            vertex_shader->Release();
-            pixel_shader->Release();
-            input_layout->Release();
+            device_context->ClearRenderTargetView(renderTargetView, color);
+
+            device_context->OMSetRenderTargets(1, &renderTargetView, nullptr);
+            device_context->Draw((UINT)vertex_count, 0);
+
+            syncIntelOutput();
+
+            // Discard outstanding queued presents and queue a frame with the new size ASAP.
+            ScopedTimer timer("Present");
+            checkDeviceRemoved(swap_chain->Present(0, DXGI_PRESENT_RESTART));
         }
-        vertex_buffer->Release();
     }
 }
 
+void D3DContext::CreateShaders(const std::string& shader_code) {
+    // Compiling is the slowest part of the frame, so the bytecode comes from the cache
+    const auto& ps = shaderCache.get(shader_code, "PSMain", "ps_4_0", D3DCOMPILE_DEBUG);
+    hr_check(device->CreatePixelShader(ps.data(), ps.size(), nullptr, &pixelShader));
+
+    const auto& vs = shaderCache.get(shader_code, "VSMain", "vs_4_0", D3DCOMPILE_DEBUG);
+    hr_check(device->CreateVertexShader(vs.data(), vs.size(), nullptr, &vertexShader));
+
+    D3D11_INPUT_ELEMENT_DESC element_desc[] =
+    {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            //{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 }
+    };
+
+    hr_check(device->CreateInputLayout(element_desc, sizeof(element_desc) / sizeof(D3D11_INPUT_ELEMENT_DESC), vs.data(), vs.size(), &inputLayout));
+
+    shaderCode = shader_code;
+}
+
+void D3DContext::CleanupShaders() {
+    if (inputLayout) { inputLayout->Release(); inputLayout = nullptr; }
+    if (vertexShader) { vertexShader->Release(); vertexShader = nullptr; }
+    if (pixelShader) { pixelShader->Release(); pixelShader = nullptr; }
+    shaderCode.clear();
+}
+
+void D3DContext::CreateRenderTarget() {
+    // With the flip model D3D11 always renders to the buffer 0,
+    // so a single view stays valid until the buffers are resized
+    ID3D11Resource *buffer;
+    hr_check(swapChain->GetBuffer(0, IID_PPV_ARGS(&buffer)));
+    hr_check(device->CreateRenderTargetView(buffer, nullptr, &renderTargetView));
+    buffer->Release();
+}
+
+void D3DContext::CleanupRenderTarget() {
+    // ResizeBuffers fails while anything still references the buffers, including the bound render target
+    if (deviceContext) { deviceContext->OMSetRenderTargets(0, nullptr, nullptr); }
+    if (renderTargetView) { renderTargetView->Release(); renderTargetView = nullptr; }
+}
+
 
 D3DContext::D3DContext(std::shared_ptr<GraphicContents> contents): D3DContextBase(std::move(contents)), deviceContext(nullptr), swapChain(nullptr) {
     // Create the D3D device.
@@ -159,23 +235,38 @@ D3DContext::D3DContext(std::shared_ptr<GraphicContents> contents): D3DContextBas
     scd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
     scd.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
     hr_check(dxgiFactory->CreateSwapChainForComposition(device, &scd, nullptr, &swapChain));
+    hr_check(swapChain->QueryInterface(IID_PPV_ARGS(&swapChain2)));
 
-	hr_check(CreateDDSTextureFromFile( this->device, L"grass.dds", nullptr, &imageTextureView ));
+	textureResidency.device = device;
+	imageTexture = textureCache.acquire("grass.dds");
+	if (!imageTexture) hr_check(E_FAIL);
 
 	this->reposition(getFullDisplayRECT());
 }
 
 void D3DContext::reposition(const RECT& position) {
+	ScopedTimer timer("reposition");
+	lastPosition = position;
 	int width = position.right - position.left;
 	int height = position.bottom - position.top;
 
 	lookForIntelOutput(position);
 
-	// A real app might want to compare these dimensions with the current swap chain
-    // dimensions and skip all this if they're unchanged.
-    checkDeviceRemoved(swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE));
+	// The buffers are reallocated only when the policy says so. Otherwise we draw
+	// into their top-left part and present just that part
+	if (resizePolicy.update({ width, height })) {
+		ScopedTimer timer("ResizeBuffers");
+		BufferSize allocated = resizePolicy.getAllocated();
+		CleanupRenderTarget();
+		checkDeviceRemoved(swapChain->ResizeBuffers(0, allocated.width, allocated.height, DXGI_FORMAT_UNKNOWN, DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE));
+		CreateRenderTarget();
+	}
+	checkDeviceRemoved(swapChain2->SetSourceSize(width, height));
 
-    DrawTriangle(width, height, device, deviceContext, swapChain, contents);
+    {
+        ScopedTimer timer("DrawTriangle");
+        DrawTriangle(width, height, device, deviceContext, swapChain, contents);
+    }
 
     //Sleep(500);
     // Wait for a vblank to really make sure our frame with the new size is ready before
@@ -183,11 +274,37 @@ void D3DContext::reposition(const RECT& position) {
     // TODO: Determine why this is necessary at all. Why isn't one Present() enough?
     // TODO: Determine if there's a way to wait for vblank without calling Present().
     // TODO: Determine if DO_NOT_SEQUENCE is safe to use with SWAP_EFFECT_FLIP_DISCARD.
-    checkDeviceRemoved(swapChain->Present(1, DXGI_PRESENT_DO_NOT_SEQUENCE));
+    {
+        ScopedTimer timer("Present (vblank)");
+        checkDeviceRemoved(swapChain->Present(1, DXGI_PRESENT_DO_NOT_SEQUENCE));
+    }
+}
+
+void D3DContext::presentFrame() {
+	ScopedTimer timer("presentFrame");
+	int width = lastPosition.right - lastPosition.left;
+	int height = lastPosition.bottom - lastPosition.top;
+
+    {
+        ScopedTimer timer("DrawTriangle");
+        DrawTriangle(width, height, device, deviceContext, swapChain, contents);
+    }
+
+    // There is no frame-latency waitable here, so the frames are paced by the same vblank wait
+    // that ends a resize
+    {
+        ScopedTimer timer("Present (vblank)");
+        checkDeviceRemoved(swapChain->Present(1, DXGI_PRESENT_DO_NOT_SEQUENCE));
+    }
 }
 
 D3DContext::~D3DContext() {
-	if (imageTextureView) { imageTextureView->Release(); imageTextureView = nullptr; }
+    CleanupRenderTarget();
+    CleanupShaders();
+	imageTexture.reset();
+	textureCache.clear();
+	if (vertexRingBuffer) { vertexRingBuffer->Release(); vertexRingBuffer = nullptr; }
+    if (swapChain2) { swapChain2->Release(); swapChain2 = nullptr; }
     if (swapChain) { swapChain->SetFullscreenState(false, nullptr); swapChain->Release(); swapChain = nullptr; }
     if (deviceContext) { deviceContext->Release(); deviceContext = nullptr; }
     if (device) { device->Release(); device = nullptr; }
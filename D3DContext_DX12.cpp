@@ -1,11 +1,13 @@
 #include "D3DContext.h"
-//#include "DDSTextureLoader12.h"
+#include "DDSTextureLoader12.h"
 
 #include <d3dcompiler.h>
 
 #include <vector>
 #include <string>
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 
 //using namespace DirectX;
 
@@ -20,97 +22,35 @@
 #endif
 
 
-void D3DContext::DrawTriangle(int width, int height,
-                   ID3D12Device* device,
-                   ID3D12GraphicsCommandList* graphics_command_list,
-                   ID3D12CommandQueue* command_queue,
-                   IDXGISwapChain3* swap_chain,
-                   ID3D12Resource* mainRenderTargetResource,
-                   D3D12_CPU_DESCRIPTOR_HANDLE& mainRenderTargetDescriptor,
-				   FrameContext* frameCtx,
-                   D3DContext::DrawingCache* drawing_cache,
-                   std::shared_ptr<GraphicContents> contents) {
-    auto vertices = contents->getVertices();
-
-    D3D12_RESOURCE_DESC vb_desc = {
-            .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
-            .Alignment = 0,
-            .Width = sizeof(RGBAVertex) * vertices.size(),
-            .Height = 1,
-            .DepthOrArraySize = 1,
-            .MipLevels = 1,
-            .Format = DXGI_FORMAT_UNKNOWN,
-            .SampleDesc = { .Count = 1, .Quality = 0 },
-            .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
-            .Flags = D3D12_RESOURCE_FLAG_NONE,
-    };
-
-    if (drawing_cache->vertex_buffer == nullptr) {
-        D3D12_HEAP_PROPERTIES heap_props = {
-                .Type = D3D12_HEAP_TYPE_UPLOAD
-        };
-
-        hr_check(device->CreateCommittedResource(
-                &heap_props,
-                D3D12_HEAP_FLAG_NONE,
-                &vb_desc,
-                D3D12_RESOURCE_STATE_GENERIC_READ,
-                nullptr,
-                IID_PPV_ARGS(&drawing_cache->vertex_buffer)));
-    }
+D3DContext::PreparedFrame D3DContext::PrepareFrame(ID3D12Device* device,
+                                                   D3DContext::DrawingCache* drawing_cache,
+                                                   ShaderCache& shader_cache,
+                                                   std::shared_ptr<GraphicContents> contents) {
+    PreparedFrame frame;
+    const size_t vertex_count = contents->getVertexCount();
+    const size_t vertices_size = sizeof(RGBAVertex) * vertex_count;
 
+    // The vertices go to the region of this frame, the GPU may still read the other frames' ones
+    D3D12_GPU_VIRTUAL_ADDRESS vertices_address = 0;
     {
-        void *gpu_data = nullptr;
-        D3D12_RANGE read_range = {0, 0}; // CPU isn't going to read this data, only write
-        hr_check(drawing_cache->vertex_buffer->Map(0, &read_range, &gpu_data));
-        memcpy(gpu_data, &vertices[0], vb_desc.Width);
-		drawing_cache->vertex_buffer->Unmap(0, nullptr);
+        uint8_t* vertices = drawing_cache->allocateUpload(device, vertices_size, sizeof(RGBAVertex), vertices_address);
+        // The contents write their vertices directly into the upload heap
+        contents->writeVertices(std::span<RGBAVertex>(reinterpret_cast<RGBAVertex*>(vertices), vertex_count));
     }
 
-    D3D12_VERTEX_BUFFER_VIEW vertex_buffer_view = {
-            .BufferLocation = drawing_cache->vertex_buffer->GetGPUVirtualAddress(),
-            .SizeInBytes = static_cast<UINT>(sizeof(RGBAVertex) * vertices.size()),
+    frame.vertex_count = static_cast<UINT>(vertex_count);
+    frame.vertex_buffer_view = {
+            .BufferLocation = vertices_address,
+            .SizeInBytes = static_cast<UINT>(vertices_size),
             .StrideInBytes = sizeof(RGBAVertex)
     };
 
-    ID3D12RootSignature *rootSignature;
-
     {
-        ID3DBlob *vs, *vs_error;
-        ID3DBlob *ps, *ps_error;
-
         std::string shader_code = contents->getShader();
 
-        HRESULT hr;
-        hr = D3DCompile2(shader_code.c_str(), shader_code.length(),
-                             nullptr,
-                             nullptr, nullptr, "PSMain", "ps_4_0", D3DCOMPILE_DEBUG, 0,
-                             0, nullptr, 0,
-                             &ps, &ps_error);
-        if ( FAILED(hr) )
-        {
-            if ( ps_error )
-            {
-                std::cerr << "Pixel Shader Compilation Failed: " << (char*)ps_error->GetBufferPointer() << std::endl;
-                ps_error->Release();
-            }
-            hr_check(hr);
-        }
-
-        hr = D3DCompile2(shader_code.c_str(), shader_code.length(),
-                             nullptr,
-                             nullptr, nullptr, "VSMain", "vs_4_0", D3DCOMPILE_DEBUG, 0,
-                             0, nullptr, 0,
-                             &vs, &vs_error);
-        if ( FAILED(hr) )
-        {
-            if ( ps_error )
-            {
-                std::cerr << "Vertex Shader Compilation Failed: " << (char*)ps_error->GetBufferPointer() << std::endl;
-                ps_error->Release();
-            }
-            hr_check(hr);
-        }
+        // Compiling is the slowest part of the frame, so the bytecode comes from the cache
+        const auto& ps = shader_cache.get(shader_code, "PSMain", "ps_4_0", D3DCOMPILE_DEBUG);
+        const auto& vs = shader_cache.get(shader_code, "VSMain", "vs_4_0", D3DCOMPILE_DEBUG);
 
         D3D12_INPUT_ELEMENT_DESC vertexFormat[] =
         {
@@ -142,27 +82,18 @@ void D3DContext::DrawTriangle(int width, int height,
                 },
         };
 
-        {
-            ID3DBlob* serializedDesc = nullptr;
-            hr_check(D3D12SerializeVersionedRootSignature(&desc, &serializedDesc, nullptr));
-
-            hr_check(device->CreateRootSignature(0,
-                                                 serializedDesc->GetBufferPointer(),
-                                                 serializedDesc->GetBufferSize(),
-                                                 IID_PPV_ARGS(&rootSignature)));
-
-            serializedDesc->Release();
-        }
+        // Both are looked up by the hash of their descriptions, so only the first frame creates them
+        frame.root_signature = drawing_cache->pipelines->getRootSignature(desc);
 
         D3D12_GRAPHICS_PIPELINE_STATE_DESC pipelineStateDesc = {
-                .pRootSignature = rootSignature,
+                .pRootSignature = frame.root_signature,
                 .VS = {
-                        .pShaderBytecode = vs->GetBufferPointer(),
-                        .BytecodeLength = vs->GetBufferSize(),
+                        .pShaderBytecode = vs.data(),
+                        .BytecodeLength = vs.size(),
                 },
                 .PS = {
-                        .pShaderBytecode = ps->GetBufferPointer(),
-                        .BytecodeLength = ps->GetBufferSize(),
+                        .pShaderBytecode = ps.data(),
+                        .BytecodeLength = ps.size(),
                 },
                 .StreamOutput = {0},
                 .BlendState = {
@@ -202,19 +133,22 @@ void D3DContext::DrawTriangle(int width, int height,
                 },
         };
 
-		if (drawing_cache->pipeline == nullptr) {
-			hr_check(device->CreateGraphicsPipelineState(
-					&pipelineStateDesc, IID_PPV_ARGS(&drawing_cache->pipeline)));
-		}
-
-        vs->Release();
-        ps->Release();
+        frame.pipeline = drawing_cache->pipelines->getGraphicsPipeline(pipelineStateDesc);
     }
+    return frame;
+}
 
+void D3DContext::DrawTriangle(int width, int height,
+                   ID3D12GraphicsCommandList* graphics_command_list,
+                   ID3D12CommandQueue* command_queue,
+                   ID3D12Resource* mainRenderTargetResource,
+                   D3D12_CPU_DESCRIPTOR_HANDLE& mainRenderTargetDescriptor,
+				   FrameContext* frameCtx,
+                   const D3DContext::PreparedFrame& frame) {
     // Render to the target
     {
         hr_check(frameCtx->CommandAllocator->Reset());
-        hr_check(graphics_command_list->Reset(frameCtx->CommandAllocator, drawing_cache->pipeline));
+        hr_check(graphics_command_list->Reset(frameCtx->CommandAllocator, frame.pipeline));
 
         D3D12_VIEWPORT viewport;
         viewport.MinDepth = 0;
@@ -231,7 +165,7 @@ void D3DContext::DrawTriangle(int width, int height,
                 .bottom = height,
         };
 
-        graphics_command_list->SetGraphicsRootSignature(rootSignature);
+        graphics_command_list->SetGraphicsRootSignature(frame.root_signature);
         graphics_command_list->RSSetViewports(1, &viewport);
         graphics_command_list->RSSetScissorRects(1, &scissorRect);
 
@@ -252,10 +186,10 @@ void D3DContext::DrawTriangle(int width, int height,
                                                      color /*clear_color_with_alpha*/, 0, nullptr);
 		graphics_command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
         //graphics_command_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);//D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-        graphics_command_list->IASetVertexBuffers(0, 1, &vertex_buffer_view);
+        graphics_command_list->IASetVertexBuffers(0, 1, &frame.vertex_buffer_view);
 
         // Finally drawing the bloody triangle!
-		graphics_command_list->DrawInstanced((UINT)vertices.size(), 1, 0, 0);
+		graphics_command_list->DrawInstanced(frame.vertex_count, 1, 0, 0);
 
         barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_RENDER_TARGET;
         barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PRESENT;
@@ -264,8 +198,79 @@ void D3DContext::DrawTriangle(int width, int height,
 
         command_queue->ExecuteCommandLists(1, (ID3D12CommandList *const *) &graphics_command_list);
     }
+}
+
 
-	rootSignature->Release();
+void D3DContext::DrawingCache::beginFrame(UINT frame_index, UINT64 fence_value, UINT64 completed_fence_value) {
+    upload_allocator.beginFrame(frame_index);
+    frame_fence_value = fence_value;
+
+    auto completed = [&](const std::pair<ID3D12Resource*, UINT64>& retired) {
+        if (retired.second > completed_fence_value) return false;
+        retired.first->Release();
+        return true;
+    };
+    retired_upload_buffers.erase(std::remove_if(retired_upload_buffers.begin(), retired_upload_buffers.end(), completed),
+                                 retired_upload_buffers.end());
+}
+
+uint8_t* D3DContext::DrawingCache::allocateUpload(ID3D12Device* device, size_t size, size_t alignment,
+                                                  D3D12_GPU_VIRTUAL_ADDRESS& gpu_address) {
+    FrameUploadAllocator::Allocation allocation = {};
+    if (upload_buffer == nullptr || !upload_allocator.allocate(size, alignment, allocation)) {
+        // The frames in flight, this one included, still read the old buffer
+        if (upload_buffer != nullptr) retired_upload_buffers.emplace_back(upload_buffer, frame_fence_value);
+        upload_buffer = nullptr;
+        upload_data = nullptr;
+
+        const size_t region_size = FrameUploadAllocator::grownRegionSize(upload_allocator.getRegionSize(),
+                                                                         upload_allocator.getRequiredRegionSize(size, alignment));
+        upload_allocator.reset(region_size);
+
+        D3D12_HEAP_PROPERTIES heap_props = {
+                .Type = D3D12_HEAP_TYPE_UPLOAD
+        };
+        D3D12_RESOURCE_DESC desc = {
+                .Dimension = D3D12_RESOURCE_DIMENSION_BUFFER,
+                .Alignment = 0,
+                .Width = upload_allocator.getCapacity(),
+                .Height = 1,
+                .DepthOrArraySize = 1,
+                .MipLevels = 1,
+                .Format = DXGI_FORMAT_UNKNOWN,
+                .SampleDesc = { .Count = 1, .Quality = 0 },
+                .Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR,
+                .Flags = D3D12_RESOURCE_FLAG_NONE,
+        };
+        hr_check(device->CreateCommittedResource(
+                &heap_props,
+                D3D12_HEAP_FLAG_NONE,
+                &desc,
+                D3D12_RESOURCE_STATE_GENERIC_READ,
+                nullptr,
+                IID_PPV_ARGS(&upload_buffer)));
+
+        // Upload heaps may stay mapped for their whole life
+        void* data = nullptr;
+        D3D12_RANGE read_range = {0, 0}; // CPU isn't going to read this data, only write
+        hr_check(upload_buffer->Map(0, &read_range, &data));
+        upload_data = static_cast<uint8_t*>(data);
+
+        if (!upload_allocator.allocate(size, alignment, allocation)) {
+            throw std::runtime_error("The upload buffer is smaller than a single frame");
+        }
+    }
+
+    gpu_address = upload_buffer->GetGPUVirtualAddress() + allocation.offset;
+    return upload_data + allocation.offset;
+}
+
+void D3DContext::DrawingCache::releaseUploadBuffers() {
+    for (auto& retired : retired_upload_buffers) retired.first->Release();
+    retired_upload_buffers.clear();
+    if (upload_buffer != nullptr) { upload_buffer->Release(); upload_buffer = nullptr; }
+    upload_data = nullptr;
+    upload_allocator.reset(0);
 }
 
 
@@ -275,6 +280,31 @@ static void bool_check(bool res)
     while (true) __debugbreak();
 }
 
+bool D3DTextureResidency::load(const std::string& path, uint32_t flags, CachedTexture& texture) {
+	std::vector<DDSBatchItem> items(1);
+	items[0].path = path;
+	DDSBatchLoader::loadItem(items[0]);
+	if (items[0].status != DDSStatus::OK) return false;
+
+	// Waits for the copy, so the file data can go right away
+	std::vector<ID3D12Resource*> textures;
+	if (FAILED(DirectX::UploadDDSTextureBatch(device, commandQueue, items, D3D12_RESOURCE_FLAG_NONE,
+	                                          static_cast<DirectX::DDS_LOADER_FLAGS>(flags), textures)) || !textures[0]) {
+		return false;
+	}
+
+	const D3D12_RESOURCE_DESC desc = textures[0]->GetDesc();
+	texture.texture = textures[0];
+	texture.gpuBytes = size_t(device->GetResourceAllocationInfo(0, 1, &desc).SizeInBytes);
+	texture.cpuBytes = 0;
+	return true;
+}
+
+void D3DTextureResidency::evict(const CachedTexture& texture) {
+	// The users keep their references until the frames that sample the texture are done
+	static_cast<ID3D12Resource*>(texture.texture)->Release();
+}
+
 
 bool D3DContext::CreateDeviceD3D(/*HWND hWnd*/)
 {
@@ -291,6 +321,7 @@ bool D3DContext::CreateDeviceD3D(/*HWND hWnd*/)
     // TODO: Determine if PRESENT_DO_NOT_SEQUENCE is safe to use with SWAP_EFFECT_FLIP_DISCARD.
     scd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
     scd.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+    scd.Flags = SWAP_CHAIN_FLAGS;
 
     // [DEBUG] Enable debug interface
 #ifdef DX12_ENABLE_DEBUG_LAYER
@@ -372,6 +403,10 @@ bool D3DContext::CreateDeviceD3D(/*HWND hWnd*/)
     if (g_fenceEvent == nullptr)
         return false;
 
+    fenceQueue.commandQueue = g_pd3dCommandQueue;
+    fenceQueue.fence = g_fence;
+    fenceQueue.event = g_fenceEvent;
+
     {
         IDXGIFactory4* dxgiFactory = nullptr;
         IDXGISwapChain1* swapChain1 = nullptr;
@@ -383,21 +418,33 @@ bool D3DContext::CreateDeviceD3D(/*HWND hWnd*/)
             return false;
         swapChain1->Release();
         dxgiFactory->Release();
-        swapChain->SetMaximumFrameLatency(NUM_BACK_BUFFERS);
-        //g_hSwapChainWaitableObject = swapChain->GetFrameLatencyWaitableObject();
-        //g_hSwapChainWaitableObject = swapChain->GetFrameLatencyWaitableObject();
+        // With the waitable object the latency is the swap chain's, not the device's. The handle is
+        // taken once and closed with the swap chain
+        if (swapChain->SetMaximumFrameLatency(maxFrameLatency) != S_OK)
+            return false;
+        g_hSwapChainWaitableObject = swapChain->GetFrameLatencyWaitableObject();
+        if (g_hSwapChainWaitableObject == nullptr)
+            return false;
     }
 
+    drawingCache.pipelines = std::make_unique<PipelineCache>(device, "pipeline_cache.bin");
+
+    textureResidency.device = device;
+    textureResidency.commandQueue = g_pd3dCommandQueue;
+
     CreateRenderTarget();
     return true;
 }
 
 void D3DContext::CleanupDeviceD3D()
 {
+    // Nothing may be in flight when the objects go
+    if (fenceQueue.fence) fenceTimeline.waitForIdle();
     CleanupRenderTarget();
 	if (imageTextureView) { imageTextureView->Release(); imageTextureView = nullptr; }
+	textureCache.clear();
 	if (swapChain != nullptr) { swapChain->SetFullscreenState(false, nullptr); swapChain->Release(); swapChain = nullptr; }
-    if (g_hSwapChainWaitableObject != nullptr) { CloseHandle(g_hSwapChainWaitableObject); }
+    if (g_hSwapChainWaitableObject != nullptr) { CloseHandle(g_hSwapChainWaitableObject); g_hSwapChainWaitableObject = nullptr; }
     for (auto & i : g_frameContext) {
         if (i.CommandAllocator) {
             i.CommandAllocator->Release();
@@ -410,6 +457,8 @@ void D3DContext::CleanupDeviceD3D()
     if (g_pd3dSrvDescHeap) { g_pd3dSrvDescHeap->Release(); g_pd3dSrvDescHeap = nullptr; }
     if (g_fence) { g_fence->Release(); g_fence = nullptr; }
     if (g_fenceEvent) { CloseHandle(g_fenceEvent); g_fenceEvent = nullptr; }
+    drawingCache.releaseUploadBuffers();
+    drawingCache.pipelines.reset();     // Saves the pipeline library to disk
     if (device) { device->Release(); device = nullptr; }
 
 #ifdef DX12_ENABLE_DEBUG_LAYER
@@ -435,63 +484,61 @@ void D3DContext::CreateRenderTarget()
 
 void D3DContext::CleanupRenderTarget()
 {
-    FlushGPU();
-
+    // The callers wait for the work that references the buffers, see FenceTimeline::waitForBackBuffers
     for (auto & i : g_mainRenderTargetResource)
         if (i) { i->Release(); i = nullptr; }
 }
 
-void D3DContext::FlushGPU() {
-    FrameContext* frameCtx = &g_frameContext[g_frameIndex % NUM_FRAMES_IN_FLIGHT];
-    for (int i = 0; i < NUM_BACK_BUFFERS; i++) {
-
-        UINT64 fenceValue = g_fenceLastSignaledValue + 1;
-        g_pd3dCommandQueue->Signal(g_fence, fenceValue);
-        g_fenceLastSignaledValue = fenceValue;
-        frameCtx->FenceValue = fenceValue;
-
-        WaitForLastSubmittedFrame();
-    }
-}
-
-void D3DContext::WaitForLastSubmittedFrame()
-{
-    FrameContext* frameCtx = &g_frameContext[g_frameIndex % NUM_FRAMES_IN_FLIGHT];
-
-    UINT64 fenceValue = frameCtx->FenceValue;
-    if (fenceValue == 0)
-        return; // No fence was signaled
-
-    frameCtx->FenceValue = 0;
-    if (g_fence->GetCompletedValue() >= fenceValue)
-        return;
-
-    g_fence->SetEventOnCompletion(fenceValue, g_fenceEvent);
-    WaitForSingleObject(g_fenceEvent, INFINITE);
-}
-
 D3DContext::FrameContext* D3DContext::WaitForNextFrameResources()
 {
     UINT nextFrameIndex = g_frameIndex + 1;
     g_frameIndex = nextFrameIndex;
 
-    g_hSwapChainWaitableObject = swapChain->GetFrameLatencyWaitableObject();
-    HANDLE waitableObjects[] = { g_hSwapChainWaitableObject, nullptr };
-    DWORD numWaitableObjects = 1;
+    // Blocks while maxFrameLatency frames are queued for presentation, so the frame starts as late
+    // as it can and shows the newest input. The timeout keeps a lost present from hanging the window
+    {
+        ScopedTimer timer("WaitForFrameLatency");
+        const int64_t start = TraceRecorder::now();
+        DWORD result;
+        do
+            result = WaitForSingleObjectEx(g_hSwapChainWaitableObject, 1000, TRUE);
+        while (result == WAIT_IO_COMPLETION);    // An APC ran, not a present
+
+        if (result == WAIT_OBJECT_0) {
+            // The counts the timed-out waits didn't take, as far as they are signaled already, so the
+            // queue goes back to maxFrameLatency frames instead of staying deeper for good
+            while (frameLatencyDebt > 0 && WaitForSingleObjectEx(g_hSwapChainWaitableObject, 0, FALSE) == WAIT_OBJECT_0)
+                frameLatencyDebt--;
+        } else {
+            // A present that doesn't retire, a hung compositor or a removed device. The frame goes on
+            // (a removed device surfaces in Present) without the count it didn't take from the waitable,
+            // the next successful waits take it back. The waitable itself isn't recreated
+            frameLatencyTimeouts++;
+            frameLatencyDebt = std::min(frameLatencyDebt + 1, maxFrameLatency);
+            if (TraceRecorder::instance().isEnabled())
+                TraceRecorder::instance().record("FrameLatencyTimeout", start, TraceRecorder::now() - start);
+        }
+    }
 
-    FrameContext* frameCtx = &g_frameContext[nextFrameIndex % NUM_FRAMES_IN_FLIGHT];
-    UINT64 fenceValue = frameCtx->FenceValue;
-    if (fenceValue != 0) // means no fence was signaled
+    // The allocator and the upload region of the slot are free once its last frame completes
     {
-        frameCtx->FenceValue = 0;
-        g_fence->SetEventOnCompletion(fenceValue, g_fenceEvent);
-        waitableObjects[1] = g_fenceEvent;
-        numWaitableObjects = 2;
+        ScopedTimer timer("WaitForFence");
+        fenceTimeline.waitForFrame(nextFrameIndex);
     }
+    return &g_frameContext[nextFrameIndex % NUM_FRAMES_IN_FLIGHT];
+}
 
-    WaitForMultipleObjects(numWaitableObjects, waitableObjects, TRUE, INFINITE);
+void D3D12FenceQueue::signal(uint64_t value) {
+    hr_check(commandQueue->Signal(fence, value));
+}
 
-    return frameCtx;
+uint64_t D3D12FenceQueue::getCompletedValue() {
+    return fence->GetCompletedValue();
+}
+
+void D3D12FenceQueue::wait(uint64_t value) {
+    hr_check(fence->SetEventOnCompletion(value, event));
+    WaitForSingleObject(event, INFINITE);
 }
 
 D3DContext::D3DContext(std::shared_ptr<GraphicContents> contents): D3DContextBase(contents), swapChain(nullptr), descriptorHeap(nullptr) {
@@ -512,38 +559,84 @@ D3DContext::D3DContext(std::shared_ptr<GraphicContents> contents): D3DContextBas
 }
 
 void D3DContext::reposition(const RECT& position) {
+	ScopedTimer timer("reposition");
+
+	// Discard outstanding queued presents and queue a frame with the new size ASAP.
+	DrawFrame(position, 0, DXGI_PRESENT_RESTART);
+
+	// Wait for a vblank to really make sure our frame with the new size is ready before
+    // the window finishes resizing.
+    // TODO: Determine why this is necessary at all. Why isn't one Present() enough?
+    // TODO: Determine if there's a way to wait for vblank without calling Present().
+    // TODO: Determine if DO_NOT_SEQUENCE is safe to use with SWAP_EFFECT_FLIP_DISCARD.
+    {
+        ScopedTimer timer("Present (vblank)");
+        checkDeviceRemoved(swapChain->Present(1, DXGI_PRESENT_DO_NOT_SEQUENCE));
+    }
+}
+
+void D3DContext::presentFrame() {
+	ScopedTimer timer("presentFrame");
+	// Queued for the next vblank. The frame-latency waitable at the start of the next frame
+	// blocks until it is shown, which paces the loop to the refresh rate
+	DrawFrame(lastPosition, 1, 0);
+}
+
+void D3DContext::DrawFrame(const RECT& position, UINT syncInterval, UINT presentFlags) {
+	lastPosition = position;
 	int width = position.right - position.left;
 	int height = position.bottom - position.top;
 
 	lookForIntelOutput(position);
-	CleanupRenderTarget();
-	checkDeviceRemoved(swapChain->ResizeBuffers(0, width, height, DXGI_FORMAT_UNKNOWN, DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE));//0/*DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT*/));
-    CreateRenderTarget();
 
     FrameContext* frameCtx = WaitForNextFrameResources();
+    drawingCache.beginFrame(g_frameIndex, fenceTimeline.getNextValue(), fenceTimeline.getCompletedValue());
+
+	// The vertices and the pipeline don't depend on the back buffers, so they are ready
+	// while the GPU finishes the frames that still use the old ones
+	PreparedFrame frame;
+	{
+		ScopedTimer timer("PrepareFrame");
+		frame = PrepareFrame(device, &this->drawingCache, shaderCache, contents);
+	}
+
+	// The buffers are reallocated only when the policy says so. Otherwise we draw
+	// into their top-left part and present just that part
+	if (resizePolicy.update({ width, height })) {
+		ScopedTimer timer("ResizeBuffers");
+		BufferSize allocated = resizePolicy.getAllocated();
+		// The last frame rendered to the old buffers, without a signal of its own unlike waitForIdle
+		fenceTimeline.waitForBackBuffers();
+		CleanupRenderTarget();
+		// The waitable flag can't change after the creation, ResizeBuffers has to repeat it
+		checkDeviceRemoved(swapChain->ResizeBuffers(0, allocated.width, allocated.height, DXGI_FORMAT_UNKNOWN, DXGI_SWAP_CHAIN_FLAG_GDI_COMPATIBLE | SWAP_CHAIN_FLAGS));
+		CreateRenderTarget();
+	}
+	checkDeviceRemoved(swapChain->SetSourceSize(width, height));
 
 	UINT backBufferIdx = swapChain->GetCurrentBackBufferIndex();
-	DrawTriangle(width, height, device, this->g_pd3dCommandList, this->g_pd3dCommandQueue, swapChain,
-								 g_mainRenderTargetResource[backBufferIdx],
-								 g_mainRenderTargetDescriptor[backBufferIdx],
-								 frameCtx, &this->drawingCache, contents);
+	{
+		ScopedTimer timer("DrawTriangle");
+		DrawTriangle(width, height, this->g_pd3dCommandList, this->g_pd3dCommandQueue,
+									 g_mainRenderTargetResource[backBufferIdx],
+									 g_mainRenderTargetDescriptor[backBufferIdx],
+									 frameCtx, frame);
+	}
 
 	syncIntelOutput();
 
-	// Discard outstanding queued presents and queue a frame with the new size ASAP.
-    checkDeviceRemoved(swapChain->Present(0, DXGI_PRESENT_RESTART));
+	{
+		ScopedTimer timer("Present");
+		checkDeviceRemoved(swapChain->Present(syncInterval, presentFlags));
+	}
 
-	UINT64 fenceValue = g_fenceLastSignaledValue + 1;
-    g_pd3dCommandQueue->Signal(g_fence, fenceValue);
-    g_fenceLastSignaledValue = fenceValue;
-    frameCtx->FenceValue = fenceValue;
+	fenceTimeline.endFrame(g_frameIndex);
+}
 
-	// Wait for a vblank to really make sure our frame with the new size is ready before
-    // the window finishes resizing.
-    // TODO: Determine why this is necessary at all. Why isn't one Present() enough?
-    // TODO: Determine if there's a way to wait for vblank without calling Present().
-    // TODO: Determine if DO_NOT_SEQUENCE is safe to use with SWAP_EFFECT_FLIP_DISCARD.
-    checkDeviceRemoved(swapChain->Present(1, DXGI_PRESENT_DO_NOT_SEQUENCE));
+void D3DContext::setMaximumFrameLatency(UINT latency) {
+	// Deeper than the frames in flight, the CPU would wait for the fences instead
+	maxFrameLatency = std::clamp<UINT>(latency, 1, NUM_FRAMES_IN_FLIGHT);
+	if (swapChain != nullptr) checkDeviceRemoved(swapChain->SetMaximumFrameLatency(maxFrameLatency));
 }
 
 D3DContext::~D3DContext() {
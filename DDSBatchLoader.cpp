@@ -0,0 +1,170 @@
+#include "DDSBatchLoader.h"
+
+#include "AsyncFileReader.h"
+#include "DDSCompression.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+
+namespace {
+
+struct BatchState {
+	std::vector<DDSBatchItem> items;
+	std::atomic<size_t> remaining;
+	std::promise<std::vector<DDSBatchItem>> done;
+	size_t maxsize;
+};
+
+bool readRange(std::ifstream& file, size_t offset, size_t size, uint8_t* dst) {
+	file.seekg(std::streamoff(offset), std::ios::beg);
+	return bool(file.read(reinterpret_cast<char*>(dst), std::streamsize(size)));
+}
+
+// The index, then the frames of the loaded subresources, expanded to what a raw file would have read.
+// The pool runs a file per thread, the frames are decompressed on this one
+DDSStatus readCompressed(std::ifstream& file, size_t size, const uint8_t* header, DDSBatchItem& item, size_t maxsize) {
+	DDSLayout& layout = item.layout;
+	DDSStatus status = DDSParser::computeSubresources(layout, maxsize);
+	if (status != DDSStatus::OK) return status;
+
+	std::vector<uint8_t> buffer(DDSCompression::getIndexSize(layout));
+	if (layout.headerSize + buffer.size() > size) return DDSStatus::Truncated;
+	if (!readRange(file, layout.headerSize, buffer.size(), buffer.data())) return DDSStatus::ReadFailed;
+
+	DDSCodec codec;
+	std::vector<DDSFrame> frames;
+	status = DDSCompression::parseIndex(buffer.data(), buffer.size(), layout, size, codec, frames);
+	if (status != DDSStatus::OK) return status;
+
+	frames = DDSCompression::selectFrames(layout, frames);
+	const std::vector<DDSByteRange> frameRanges = DDSCompression::packFrames(frames);
+	buffer.resize(DDSParser::getRangesSize(frameRanges));
+	uint8_t* dst = buffer.data();
+	for (const auto& range : frameRanges) {
+		if (!readRange(file, range.offset, range.size, dst)) return DDSStatus::ReadFailed;
+		dst += range.size;
+	}
+
+	const std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(layout);
+	DDSParser::packSubresources(layout, ranges);
+	item.data.resize(DDSParser::getRangesSize(ranges));
+	DDSCompression::writeHeaders(header, layout, item.data.data());
+	return DDSCompression::decompress(buffer.data(), codec, frames, layout, item.data.data(), 1);
+}
+
+}
+
+void DDSBatchLoader::loadItem(DDSBatchItem& item, size_t maxsize) {
+	item.data.clear();
+	item.status = DDSStatus::ReadFailed;
+
+	std::ifstream file(item.path, std::ios::binary | std::ios::ate);
+	if (!file) return;
+	const std::streamoff size = file.tellg();
+	if (size < 0) return;
+	// The parser takes offsets as size_t and the loaders limit the files to 32 bits
+	if (uint64_t(size) > UINT32_MAX) {
+		item.status = DDSStatus::Overflow;
+		return;
+	}
+
+	// The headers decide what to read: the skipped mips never leave the disk, and the supercompressed files
+	// are read frame by frame. Without maxsize a raw file is read whole, with the headers
+	uint8_t header[DDSParser::MAX_HEADER_SIZE];
+	const size_t headerSize = std::min(size_t(size), sizeof(header));
+	if (!readRange(file, 0, headerSize, header)) return;
+	if (DDSCompression::isCompressed(header, headerSize)) {
+		item.status = DDSParser::parseHeader(header, headerSize, item.layout);
+		if (item.status == DDSStatus::OK) item.status = readCompressed(file, size_t(size), header, item, maxsize);
+		if (item.status != DDSStatus::OK) item.data.clear();
+		return;
+	}
+
+	if (maxsize) {
+		item.status = DDSParser::parseHeader(header, headerSize, item.layout);
+		if (item.status == DDSStatus::OK) item.status = DDSParser::computeSubresources(item.layout, maxsize);
+		if (item.status == DDSStatus::OK && item.layout.headerSize + item.layout.dataSize > size_t(size)) {
+			item.status = DDSStatus::Truncated;
+		}
+		if (item.status != DDSStatus::OK) return;
+
+		if (item.layout.skipMip > 0) {
+			const std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(item.layout);
+			item.data.resize(DDSParser::getRangesSize(ranges));
+			uint8_t* dst = item.data.data();
+			for (const auto& range : ranges) {
+				if (!readRange(file, range.offset, range.size, dst)) {
+					item.data.clear();
+					item.status = DDSStatus::ReadFailed;
+					return;
+				}
+				dst += range.size;
+			}
+			DDSParser::packSubresources(item.layout, ranges);
+			return;
+		}
+	}
+
+	item.data.resize(size_t(size));
+	if (!readRange(file, 0, size_t(size), item.data.data())) {
+		item.data.clear();
+		return;
+	}
+
+	item.status = DDSParser::parse(item.data.data(), item.data.size(), item.layout, maxsize);
+	if (item.status != DDSStatus::OK) item.data.clear();
+}
+
+std::future<std::vector<DDSBatchItem>> DDSBatchLoader::load(WorkStealingPool& pool, std::vector<std::string> paths,
+                                                            size_t maxsize) {
+	auto state = std::make_shared<BatchState>();
+	state->items.resize(paths.size());
+	state->remaining = paths.size();
+	state->maxsize = maxsize;
+	for (size_t i = 0; i < paths.size(); i++) state->items[i].path = std::move(paths[i]);
+
+	auto result = state->done.get_future();
+	if (state->items.empty()) {
+		state->done.set_value({});
+		return result;
+	}
+
+	for (size_t i = 0; i < state->items.size(); i++) {
+		pool.submit([state, i] {
+			try {
+				loadItem(state->items[i], state->maxsize);
+			} catch (...) {
+				// Out of memory for this file
+				state->items[i].data = {};
+				state->items[i].status = DDSStatus::ReadFailed;
+			}
+			// The last one hands the whole batch over
+			if (state->remaining.fetch_sub(1) == 1) state->done.set_value(std::move(state->items));
+		});
+	}
+	return result;
+}
+
+std::future<std::vector<DDSBatchItem>> DDSBatchLoader::load(AsyncFileReader& reader, std::vector<std::string> paths,
+                                                            size_t maxsize) {
+	auto state = std::make_shared<BatchState>();
+	state->items.resize(paths.size());
+	state->remaining = paths.size();
+	state->maxsize = maxsize;
+
+	auto result = state->done.get_future();
+	if (state->items.empty()) {
+		state->done.set_value({});
+		return result;
+	}
+
+	for (size_t i = 0; i < paths.size(); i++) {
+		reader.readDDS(paths[i], maxsize, [state, i](DDSBatchItem item) {
+			state->items[i] = std::move(item);
+			if (state->remaining.fetch_sub(1) == 1) state->done.set_value(std::move(state->items));
+		});
+	}
+	return result;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "DDSParser.h"
+#include "WorkStealingPool.h"
+
+#include <future>
+#include <string>
+#include <vector>
+
+class AsyncFileReader;
+
+// One file of a batch. The subresources of the layout point into data
+struct DDSBatchItem {
+	std::string path;
+	DDSStatus status = DDSStatus::ReadFailed;
+	std::vector<uint8_t> data;     // The whole file, or only the ranges the loaded mips need when maxsize skips some
+	DDSLayout layout;
+
+	const uint8_t* getPixels(const DDSSubresource& subresource) const { return data.data() + subresource.offset; }
+};
+
+// Reads, parses and validates many DDS files at once, every file is a task on the pool.
+// The items come back in the order of the paths, the failed ones with their status set,
+// so one broken file doesn't fail the batch. The uploads are the backend's business,
+// see UploadDDSTextureBatch in DDSTextureLoader12.h
+//
+// With an AsyncFileReader no thread waits on the disk: the header and the payload of every file
+// are separate reads in flight together, and the parsing runs on the reader's completion threads.
+class DDSBatchLoader {
+public:
+	// The future is ready when all the files are
+	static std::future<std::vector<DDSBatchItem>> load(WorkStealingPool& pool, std::vector<std::string> paths,
+	                                                   size_t maxsize = 0);
+
+	static std::future<std::vector<DDSBatchItem>> load(AsyncFileReader& reader, std::vector<std::string> paths,
+	                                                   size_t maxsize = 0);
+
+	// The read and the parse stages of a single file, on the calling thread. With maxsize set the headers
+	// are read first and the skipped mips not at all
+	static void loadItem(DDSBatchItem& item, size_t maxsize = 0);
+};
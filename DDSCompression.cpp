@@ -0,0 +1,252 @@
+#include "DDSCompression.h"
+#include "LZ4.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+// Every thread gets at least this many bytes of subresources, the small textures aren't worth a thread
+const size_t MIN_BYTES_PER_THREAD = size_t(1) << 20;
+
+const size_t INDEX_HEADER_SIZE = 12;
+const size_t INDEX_ENTRY_SIZE = 8;
+
+uint16_t read16(const uint8_t* p) {
+	uint16_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint32_t read32(const uint8_t* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+void write16(uint8_t* p, uint16_t value) {
+	std::memcpy(p, &value, sizeof(value));
+}
+
+void write32(uint8_t* p, uint32_t value) {
+	std::memcpy(p, &value, sizeof(value));
+}
+
+size_t getRawSize(const DDSSubresource& subresource) {
+	return subresource.slicePitch * subresource.depth;
+}
+
+size_t getFrameCount(const DDSLayout& layout) {
+	return size_t(layout.arraySize) * layout.mipCount;
+}
+
+// Runs work(i) for every i below count. The items are taken one at a time, they differ in size a lot
+template<class Work>
+void forEachParallel(size_t count, size_t totalBytes, unsigned threads, const Work& work) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t workers = std::min<size_t>({ threads, count, std::max<size_t>(1, totalBytes / MIN_BYTES_PER_THREAD) });
+
+	std::atomic<size_t> next(0);
+	auto run = [&] {
+		for (size_t i; (i = next.fetch_add(1)) < count;) work(i);
+	};
+	if (workers <= 1) {
+		run();
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	for (size_t w = 1; w < workers; w++) pool.emplace_back(run);
+	run();
+	for (auto& thread : pool) thread.join();
+}
+
+}
+
+const char* toString(DDSCodec codec) {
+	switch (codec) {
+		case DDSCodec::Stored: return "stored";
+		case DDSCodec::LZ4: return "lz4";
+		case DDSCodec::Zstd: return "zstd";
+	}
+	return "unknown";
+}
+
+bool DDSCompression::isCompressed(const uint8_t* data, size_t size) {
+	DDSLayout layout;
+	return DDSParser::parseHeader(data, size, layout) == DDSStatus::OK && layout.supercompressed;
+}
+
+size_t DDSCompression::getIndexSize(const DDSLayout& layout) {
+	return INDEX_HEADER_SIZE + getFrameCount(layout) * INDEX_ENTRY_SIZE;
+}
+
+DDSStatus DDSCompression::parseIndex(const uint8_t* index, size_t size, const DDSLayout& layout, size_t fileSize,
+                                     DDSCodec& codec, std::vector<DDSFrame>& frames) {
+	frames.clear();
+	if (!layout.supercompressed) return DDSStatus::InvalidData;
+	const size_t indexSize = getIndexSize(layout);
+	if (size < indexSize) return DDSStatus::Truncated;
+
+	if (read32(index) != DDSParser::SUPERCOMPRESSED_MAGIC || read32(index + 8) != getFrameCount(layout)) {
+		return DDSStatus::InvalidData;
+	}
+	if (read16(index + 4) != VERSION) return DDSStatus::NotSupported;
+	codec = DDSCodec(read16(index + 6));
+	switch (codec) {
+		case DDSCodec::Stored: case DDSCodec::LZ4: break;
+		case DDSCodec::Zstd: return DDSStatus::NotSupported;
+		default: return DDSStatus::InvalidData;
+	}
+
+	// The frames lie after the index, within the file. Their sizes are checked against the subresources
+	// when they are decompressed
+	const size_t dataStart = layout.headerSize + indexSize;
+	frames.resize(getFrameCount(layout));
+	for (size_t i = 0; i < frames.size(); i++) {
+		const uint8_t* entry = index + INDEX_HEADER_SIZE + i * INDEX_ENTRY_SIZE;
+		frames[i].offset = read32(entry);
+		frames[i].size = read32(entry + 4);
+		if (frames[i].offset < dataStart) return DDSStatus::InvalidData;
+		if (fileSize && uint64_t(frames[i].offset) + frames[i].size > fileSize) return DDSStatus::Truncated;
+	}
+	return DDSStatus::OK;
+}
+
+std::vector<DDSFrame> DDSCompression::selectFrames(const DDSLayout& layout, const std::vector<DDSFrame>& frames) {
+	// The loaded subresources are the last getLoadedMips of every item
+	const uint32_t loaded = layout.getLoadedMips();
+	std::vector<DDSFrame> selected(layout.subresources.size());
+	for (size_t k = 0; k < selected.size(); k++) {
+		selected[k] = frames[(k / loaded) * layout.mipCount + layout.skipMip + k % loaded];
+	}
+	return selected;
+}
+
+std::vector<DDSByteRange> DDSCompression::packFrames(std::vector<DDSFrame>& frames) {
+	std::vector<DDSByteRange> ranges;
+	size_t packed = 0;
+	for (DDSFrame& frame : frames) {
+		if (!ranges.empty() && ranges.back().offset + ranges.back().size == frame.offset) {
+			ranges.back().size += frame.size;
+		} else {
+			ranges.push_back({ frame.offset, frame.size });
+		}
+		frame.offset = packed;
+		packed += frame.size;
+	}
+	return ranges;
+}
+
+DDSStatus DDSCompression::decompress(const uint8_t* src, DDSCodec codec, const std::vector<DDSFrame>& frames,
+                                     const DDSLayout& layout, uint8_t* dst, unsigned threads) {
+	if (frames.size() != layout.subresources.size()) return DDSStatus::InvalidData;
+
+	size_t totalBytes = 0;
+	for (const DDSSubresource& subresource : layout.subresources) totalBytes += getRawSize(subresource);
+
+	std::atomic<bool> failed(false);
+	forEachParallel(frames.size(), totalBytes, threads, [&](size_t i) {
+		if (failed.load(std::memory_order_relaxed)) return;
+		const DDSFrame& frame = frames[i];
+		const size_t rawSize = getRawSize(layout.subresources[i]);
+		uint8_t* out = dst + layout.subresources[i].offset;
+
+		bool succeeded;
+		if (frame.size == rawSize) {
+			std::memcpy(out, src + frame.offset, rawSize);
+			succeeded = true;
+		} else {
+			succeeded = codec == DDSCodec::LZ4 && frame.size < rawSize &&
+			            LZ4::decompress(src + frame.offset, frame.size, out, rawSize);
+		}
+		if (!succeeded) failed = true;
+	});
+	return failed ? DDSStatus::InvalidData : DDSStatus::OK;
+}
+
+void DDSCompression::writeHeaders(const uint8_t* headers, const DDSLayout& layout, uint8_t* dst) {
+	std::memcpy(dst, headers, layout.headerSize);
+	write32(dst + DDSParser::SUPERCOMPRESSED_MARKER_OFFSET, 0);
+}
+
+DDSStatus DDSCompression::getExpandedSize(const uint8_t* data, size_t size, size_t& expandedSize) {
+	expandedSize = 0;
+	DDSLayout layout;
+	DDSStatus status = DDSParser::parseHeader(data, size, layout);
+	if (status == DDSStatus::OK && !layout.supercompressed) status = DDSStatus::InvalidData;
+	if (status == DDSStatus::OK) status = DDSParser::computeSubresources(layout);
+	if (status != DDSStatus::OK) return status;
+
+	// The loaders keep the files within 32 bits
+	if (uint64_t(layout.headerSize) + layout.dataSize > UINT32_MAX) return DDSStatus::Overflow;
+	expandedSize = layout.headerSize + layout.dataSize;
+	return DDSStatus::OK;
+}
+
+DDSStatus DDSCompression::expand(const uint8_t* data, size_t size, uint8_t* dst, size_t maxsize, unsigned threads) {
+	DDSLayout layout;
+	DDSStatus status = DDSParser::parseHeader(data, size, layout);
+	if (status == DDSStatus::OK && !layout.supercompressed) status = DDSStatus::InvalidData;
+	if (status == DDSStatus::OK) status = DDSParser::computeSubresources(layout, maxsize);
+	if (status != DDSStatus::OK) return status;
+
+	DDSCodec codec;
+	std::vector<DDSFrame> frames;
+	status = parseIndex(data + layout.headerSize, size - layout.headerSize, layout, size, codec, frames);
+	if (status != DDSStatus::OK) return status;
+
+	writeHeaders(data, layout, dst);
+	return decompress(data, codec, selectFrames(layout, frames), layout, dst, threads);
+}
+
+DDSStatus DDSCompression::compress(const uint8_t* data, size_t size, DDSCodec codec, std::vector<uint8_t>& out,
+                                   unsigned threads) {
+	out.clear();
+	if (codec != DDSCodec::Stored && codec != DDSCodec::LZ4) return DDSStatus::NotSupported;
+
+	DDSLayout layout;
+	DDSStatus status = DDSParser::parse(data, size, layout);
+	if (status != DDSStatus::OK) return status;
+
+	// Every subresource on its own, then back to back
+	std::vector<std::vector<uint8_t>> packed(layout.subresources.size());
+	forEachParallel(packed.size(), layout.dataSize, threads, [&](size_t i) {
+		const DDSSubresource& subresource = layout.subresources[i];
+		const size_t rawSize = getRawSize(subresource);
+		if (codec == DDSCodec::LZ4) {
+			packed[i].resize(LZ4::compressBound(rawSize));
+			packed[i].resize(LZ4::compress(data + subresource.offset, rawSize, packed[i].data()));
+		}
+		if (codec == DDSCodec::Stored || packed[i].size() >= rawSize) {
+			packed[i].assign(data + subresource.offset, data + subresource.offset + rawSize);
+		}
+	});
+
+	layout.supercompressed = true;
+	const size_t indexSize = getIndexSize(layout);
+	size_t outSize = layout.headerSize + indexSize;
+	for (const auto& frame : packed) outSize += frame.size();
+	if (outSize > UINT32_MAX) return DDSStatus::Overflow;
+
+	out.resize(outSize);
+	uint8_t* index = out.data() + layout.headerSize;
+	std::memcpy(out.data(), data, layout.headerSize);
+	write32(out.data() + DDSParser::SUPERCOMPRESSED_MARKER_OFFSET, DDSParser::SUPERCOMPRESSED_MAGIC);
+	write32(index, DDSParser::SUPERCOMPRESSED_MAGIC);
+	write16(index + 4, VERSION);
+	write16(index + 6, uint16_t(codec));
+	write32(index + 8, uint32_t(packed.size()));
+
+	size_t offset = layout.headerSize + indexSize;
+	for (size_t i = 0; i < packed.size(); i++) {
+		uint8_t* entry = index + INDEX_HEADER_SIZE + i * INDEX_ENTRY_SIZE;
+		write32(entry, uint32_t(offset));
+		write32(entry + 4, uint32_t(packed[i].size()));
+		if (!packed[i].empty()) std::memcpy(out.data() + offset, packed[i].data(), packed[i].size());
+		offset += packed[i].size();
+	}
+	return DDSStatus::OK;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "DDSParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How the frames of a supercompressed DDS are packed. Zstd has its id reserved, but there is no decoder
+// for it here: such files are NotSupported
+enum class DDSCodec : uint16_t { Stored = 0, LZ4 = 1, Zstd = 2 };
+const char* toString(DDSCodec codec);
+
+// A compressed subresource in the file
+struct DDSFrame {
+	size_t offset = 0;    // From the start of the file, or of the packed frames
+	size_t size = 0;
+};
+
+// The supercompressed DDS container: a regular DDS whose subresources are compressed one by one, so the
+// loaders read a fraction of the bytes and decompress every subresource on its own thread, straight
+// to where the raw file would have it.
+//
+// The headers are those of the raw file with DDSParser::SUPERCOMPRESSED_MAGIC in reserved1[9]. After
+// them comes the index:
+//
+//     uint32_t magic ('DDSZ'); uint16_t version (1); uint16_t codec; uint32_t frameCount;
+//     frameCount times { uint32_t offset; uint32_t size; }
+//
+// and then the frames, one per subresource of the whole chain, item by item, mip by mip. A frame
+// as large as its subresource is stored as is, whatever the codec: the noise doesn't get any larger.
+//
+// The class is pure logic, it doesn't touch Direct3D.
+class DDSCompression {
+public:
+	static constexpr uint16_t VERSION = 1;
+
+	// The headers say so. Needs DDSParser::MAX_HEADER_SIZE bytes, or the whole file if it is shorter
+	static bool isCompressed(const uint8_t* data, size_t size);
+
+	// The layout is parsed from the headers of the compressed file
+	static size_t getIndexSize(const DDSLayout& layout);
+	// Validates the index at layout.headerSize and fills the frames of all the subresources. fileSize
+	// bounds the frames, 0 if unknown (the reads of the frames fail then)
+	static DDSStatus parseIndex(const uint8_t* index, size_t size, const DDSLayout& layout, size_t fileSize,
+	                            DDSCodec& codec, std::vector<DDSFrame>& frames);
+	// The frames of the subresources the layout loads, after computeSubresources with maxsize
+	static std::vector<DDSFrame> selectFrames(const DDSLayout& layout, const std::vector<DDSFrame>& frames);
+
+	// What to read of the file for the frames, merged where they touch. The frame offsets move from
+	// the file to the ranges read back to back, the way DDSParser::packSubresources does it
+	static std::vector<DDSByteRange> packFrames(std::vector<DDSFrame>& frames);
+
+	// The frames, found in src, into the subresources of the layout, found in dst: one frame per
+	// subresource. The frames are spread over the threads, 0 means "as many as the hardware has"
+	static DDSStatus decompress(const uint8_t* src, DDSCodec codec, const std::vector<DDSFrame>& frames,
+	                            const DDSLayout& layout, uint8_t* dst, unsigned threads = 0);
+
+	// The raw headers, without the marker: layout.headerSize bytes
+	static void writeHeaders(const uint8_t* headers, const DDSLayout& layout, uint8_t* dst);
+
+	// A whole compressed file to the raw one, the size of which is getExpandedSize. With maxsize the
+	// skipped mips aren't decompressed and their bytes are left uninitialized, the way the loaders
+	// leave the ones they don't read
+	static DDSStatus getExpandedSize(const uint8_t* data, size_t size, size_t& expandedSize);
+	static DDSStatus expand(const uint8_t* data, size_t size, uint8_t* dst, size_t maxsize = 0, unsigned threads = 0);
+
+	// A raw DDS file to a compressed one
+	static DDSStatus compress(const uint8_t* data, size_t size, DDSCodec codec, std::vector<uint8_t>& out,
+	                          unsigned threads = 0);
+};
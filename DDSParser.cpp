@@ -0,0 +1,383 @@
+#include "DDSParser.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+namespace {
+
+// See DDS.h in the 'Texconv' sample and the 'DirectXTex' library, and DDSTextureLoader12.cpp
+struct Header {
+	uint32_t size, flags, height, width, pitchOrLinearSize, depth, mipMapCount;
+	uint32_t reserved1[11];
+	DDSPixelFormat ddspf;
+	uint32_t caps, caps2, caps3, caps4, reserved2;
+};
+
+struct HeaderDX10 {
+	uint32_t dxgiFormat, resourceDimension, miscFlag, arraySize, miscFlags2;
+};
+
+static_assert(sizeof(Header) == 124 && sizeof(HeaderDX10) == 20, "The DDS headers are packed");
+static_assert(offsetof(Header, reserved1[9]) + 4 == DDSParser::SUPERCOMPRESSED_MARKER_OFFSET, "The marker is in reserved1[9]");
+
+constexpr uint32_t makeFourCC(char a, char b, char c, char d) {
+	return uint32_t(uint8_t(a)) | (uint32_t(uint8_t(b)) << 8) | (uint32_t(uint8_t(c)) << 16) | (uint32_t(uint8_t(d)) << 24);
+}
+
+const uint32_t DDS_MAGIC = makeFourCC('D', 'D', 'S', ' ');
+
+const uint32_t DDS_FOURCC = 0x00000004;          // DDPF_FOURCC
+const uint32_t DDS_RGB = 0x00000040;             // DDPF_RGB
+const uint32_t DDS_LUMINANCE = 0x00020000;       // DDPF_LUMINANCE
+const uint32_t DDS_ALPHA = 0x00000002;           // DDPF_ALPHA
+const uint32_t DDS_BUMPDUDV = 0x00080000;        // DDPF_BUMPDUDV
+const uint32_t DDS_HEADER_FLAGS_VOLUME = 0x00800000;    // DDSD_DEPTH
+const uint32_t DDS_HEIGHT = 0x00000002;          // DDSD_HEIGHT
+const uint32_t DDS_CUBEMAP = 0x00000200;         // DDSCAPS2_CUBEMAP
+const uint32_t DDS_CUBEMAP_ALLFACES = 0x0000FE00;       // DDSCAPS2_CUBEMAP and all the six faces
+const uint32_t DDS_MISC_TEXTURECUBE = 0x4;       // RESOURCE_MISC_TEXTURECUBE
+const uint32_t DDS_MISC_FLAGS2_ALPHA_MODE_MASK = 0x7;
+const uint32_t DDS_ALPHA_MODE_PREMULTIPLIED = 2;
+
+// The Direct3D 12 hardware limits. We don't trust the DDS metadata beyond them
+const uint32_t REQ_MIP_LEVELS = 15;
+const uint32_t REQ_TEXTURE1D_U_DIMENSION = 16384;
+const uint32_t REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION = 2048;
+const uint32_t REQ_TEXTURE2D_U_OR_V_DIMENSION = 16384;
+const uint32_t REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION = 2048;
+const uint32_t REQ_TEXTURECUBE_DIMENSION = 16384;
+const uint32_t REQ_TEXTURE3D_U_V_OR_W_DIMENSION = 2048;
+const size_t REQ_SUBRESOURCES = 30720;
+
+// The video formats, they need the device for the plane layout. The depth and stencil formats have two
+// planes too, but they are laid out as one
+bool isPlanar(DXGIFormat format) {
+	const DXGIFormatTraits& traits = DXGIFormatTraits::get(format);
+	return traits.planes > 1 && !traits.depthStencil;
+}
+
+}
+
+const char* toString(DDSStatus status) {
+	switch (status) {
+		case DDSStatus::OK: return "OK";
+		case DDSStatus::ReadFailed: return "the file can't be read";
+		case DDSStatus::InvalidData: return "not a valid DDS file";
+		case DDSStatus::Truncated: return "the file is truncated";
+		case DDSStatus::NotSupported: return "the format or the dimensions aren't supported";
+		case DDSStatus::Overflow: return "the sizes overflow";
+	}
+	return "unknown";
+}
+
+DXGIFormat DDSParser::legacyFormat(const DDSPixelFormat& ddpf) {
+	auto isBitMask = [&](uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+		return ddpf.rBitMask == r && ddpf.gBitMask == g && ddpf.bBitMask == b && ddpf.aBitMask == a;
+	};
+
+	if (ddpf.flags & DDS_RGB) {
+		// The sRGB formats are written with the "DX10" header
+		switch (ddpf.rgbBitCount) {
+			case 32:
+				if (isBitMask(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGIFormat::R8G8B8A8_UNORM;
+				if (isBitMask(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000)) return DXGIFormat::B8G8R8A8_UNORM;
+				if (isBitMask(0x00ff0000, 0x0000ff00, 0x000000ff, 0)) return DXGIFormat::B8G8R8X8_UNORM;
+				// D3DX writes 10:10:10:2 with the red and blue masks swapped, see DDSTextureLoader12.cpp
+				if (isBitMask(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000)) return DXGIFormat::R10G10B10A2_UNORM;
+				if (isBitMask(0x0000ffff, 0xffff0000, 0, 0)) return DXGIFormat::R16G16_UNORM;
+				if (isBitMask(0xffffffff, 0, 0, 0)) return DXGIFormat::R32_FLOAT;
+				break;
+
+			case 16:
+				if (isBitMask(0x7c00, 0x03e0, 0x001f, 0x8000)) return DXGIFormat::B5G5R5A1_UNORM;
+				if (isBitMask(0xf800, 0x07e0, 0x001f, 0)) return DXGIFormat::B5G6R5_UNORM;
+				if (isBitMask(0x0f00, 0x00f0, 0x000f, 0xf000)) return DXGIFormat::B4G4R4A4_UNORM;
+				// NVTT versions 1.x wrote these as RGB instead of LUMINANCE
+				if (isBitMask(0x00ff, 0, 0, 0xff00)) return DXGIFormat::R8G8_UNORM;
+				if (isBitMask(0xffff, 0, 0, 0)) return DXGIFormat::R16_UNORM;
+				break;
+
+			case 8:
+				if (isBitMask(0xff, 0, 0, 0)) return DXGIFormat::R8_UNORM;
+				break;
+
+			default:
+				break;
+		}
+	} else if (ddpf.flags & DDS_LUMINANCE) {
+		switch (ddpf.rgbBitCount) {
+			case 16:
+				if (isBitMask(0xffff, 0, 0, 0)) return DXGIFormat::R16_UNORM;
+				if (isBitMask(0x00ff, 0, 0, 0xff00)) return DXGIFormat::R8G8_UNORM;
+				break;
+
+			case 8:
+				if (isBitMask(0xff, 0, 0, 0)) return DXGIFormat::R8_UNORM;
+				// Some DDS writers assume the bit count should be 8 instead of 16
+				if (isBitMask(0x00ff, 0, 0, 0xff00)) return DXGIFormat::R8G8_UNORM;
+				break;
+
+			default:
+				break;
+		}
+	} else if (ddpf.flags & DDS_ALPHA) {
+		if (ddpf.rgbBitCount == 8) return DXGIFormat::A8_UNORM;
+	} else if (ddpf.flags & DDS_BUMPDUDV) {
+		switch (ddpf.rgbBitCount) {
+			case 32:
+				if (isBitMask(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000)) return DXGIFormat::R8G8B8A8_SNORM;
+				if (isBitMask(0x0000ffff, 0xffff0000, 0, 0)) return DXGIFormat::R16G16_SNORM;
+				break;
+
+			case 16:
+				if (isBitMask(0x00ff, 0xff00, 0, 0)) return DXGIFormat::R8G8_SNORM;
+				break;
+
+			default:
+				break;
+		}
+	} else if (ddpf.flags & DDS_FOURCC) {
+		switch (ddpf.fourCC) {
+			// The premultiplied DXT2 and DXT4 are the same blocks as DXT3 and DXT5
+			case makeFourCC('D', 'X', 'T', '1'): return DXGIFormat::BC1_UNORM;
+			case makeFourCC('D', 'X', 'T', '2'): case makeFourCC('D', 'X', 'T', '3'): return DXGIFormat::BC2_UNORM;
+			case makeFourCC('D', 'X', 'T', '4'): case makeFourCC('D', 'X', 'T', '5'): return DXGIFormat::BC3_UNORM;
+			case makeFourCC('A', 'T', 'I', '1'): case makeFourCC('B', 'C', '4', 'U'): return DXGIFormat::BC4_UNORM;
+			case makeFourCC('B', 'C', '4', 'S'): return DXGIFormat::BC4_SNORM;
+			case makeFourCC('A', 'T', 'I', '2'): case makeFourCC('B', 'C', '5', 'U'): return DXGIFormat::BC5_UNORM;
+			case makeFourCC('B', 'C', '5', 'S'): return DXGIFormat::BC5_SNORM;
+			case makeFourCC('R', 'G', 'B', 'G'): return DXGIFormat::R8G8_B8G8_UNORM;
+			case makeFourCC('G', 'R', 'G', 'B'): return DXGIFormat::G8R8_G8B8_UNORM;
+			case makeFourCC('Y', 'U', 'Y', '2'): return DXGIFormat::YUY2;
+
+			// The D3DFORMAT numbers
+			case 36: return DXGIFormat::R16G16B16A16_UNORM;     // D3DFMT_A16B16G16R16
+			case 110: return DXGIFormat::R16G16B16A16_SNORM;    // D3DFMT_Q16W16V16U16
+			case 111: return DXGIFormat::R16_FLOAT;             // D3DFMT_R16F
+			case 112: return DXGIFormat::R16G16_FLOAT;          // D3DFMT_G16R16F
+			case 113: return DXGIFormat::R16G16B16A16_FLOAT;    // D3DFMT_A16B16G16R16F
+			case 114: return DXGIFormat::R32_FLOAT;             // D3DFMT_R32F
+			case 115: return DXGIFormat::R32G32_FLOAT;          // D3DFMT_G32R32F
+			case 116: return DXGIFormat::R32G32B32A32_FLOAT;    // D3DFMT_A32B32G32R32F
+			default: break;
+		}
+	}
+
+	return DXGIFormat::UNKNOWN;
+}
+
+DDSStatus DDSParser::surfaceInfo(DXGIFormat format, size_t width, size_t height,
+                                 size_t& numBytes, size_t& rowBytes, size_t& numRows) {
+	uint64_t bytes = 0, row = 0, rows = 0;
+	if (!DXGIFormatTraits::getSurfaceInfo(format, width, height, bytes, row, rows)) return DDSStatus::NotSupported;
+
+	if (bytes > UINT32_MAX || row > UINT32_MAX || rows > UINT32_MAX) return DDSStatus::Overflow;
+	numBytes = size_t(bytes);
+	rowBytes = size_t(row);
+	numRows = size_t(rows);
+	return DDSStatus::OK;
+}
+
+DDSStatus DDSParser::parseHeader(const uint8_t* data, size_t size, DDSLayout& layout) {
+	layout = DDSLayout();
+	if (size < sizeof(uint32_t) + sizeof(Header)) return DDSStatus::Truncated;
+
+	uint32_t magic;
+	Header header;
+	std::memcpy(&magic, data, sizeof(magic));
+	std::memcpy(&header, data + sizeof(magic), sizeof(header));
+	if (magic != DDS_MAGIC || header.size != sizeof(Header) || header.ddspf.size != sizeof(DDSPixelFormat)) {
+		return DDSStatus::InvalidData;
+	}
+
+	layout.width = header.width;
+	layout.height = header.height;
+	layout.depth = header.depth;
+	layout.mipCount = std::max(header.mipMapCount, 1u);
+	layout.arraySize = 1;
+	layout.headerSize = sizeof(uint32_t) + sizeof(Header);
+	layout.supercompressed = header.reserved1[9] == SUPERCOMPRESSED_MAGIC;
+
+	if ((header.ddspf.flags & DDS_FOURCC) && header.ddspf.fourCC == makeFourCC('D', 'X', '1', '0')) {
+		if (size < layout.headerSize + sizeof(HeaderDX10)) return DDSStatus::Truncated;
+		HeaderDX10 dx10;
+		std::memcpy(&dx10, data + layout.headerSize, sizeof(dx10));
+		layout.headerSize += sizeof(HeaderDX10);
+
+		layout.arraySize = dx10.arraySize;
+		if (layout.arraySize == 0) return DDSStatus::InvalidData;
+
+		const DXGIFormat format = DXGIFormat(dx10.dxgiFormat);
+		switch (format) {
+			case DXGIFormat::YUY2: case DXGIFormat::Y210: case DXGIFormat::Y216:
+				if (layout.width % 2 != 0) return DDSStatus::NotSupported;
+				break;
+
+			case DXGIFormat::AI44: case DXGIFormat::IA44: case DXGIFormat::P8: case DXGIFormat::A8P8:
+				return DDSStatus::NotSupported;
+
+			default:
+				if (isPlanar(format) || bitsPerPixel(format) == 0) return DDSStatus::NotSupported;
+				break;
+		}
+		layout.format = format;
+
+		switch (DDSDimension(dx10.resourceDimension)) {
+			case DDSDimension::Texture1D:
+				// D3DX writes 1D textures with a fixed height of 1
+				if ((header.flags & DDS_HEIGHT) && layout.height != 1) return DDSStatus::InvalidData;
+				layout.height = layout.depth = 1;
+				break;
+
+			case DDSDimension::Texture2D:
+				if (dx10.miscFlag & DDS_MISC_TEXTURECUBE) {
+					layout.arraySize *= 6;
+					layout.cubeMap = true;
+				}
+				layout.depth = 1;
+				break;
+
+			case DDSDimension::Texture3D:
+				if (!(header.flags & DDS_HEADER_FLAGS_VOLUME)) return DDSStatus::InvalidData;
+				if (layout.arraySize > 1) return DDSStatus::NotSupported;
+				break;
+
+			default:
+				return DDSStatus::NotSupported;
+		}
+		layout.dimension = DDSDimension(dx10.resourceDimension);
+
+		const uint32_t alphaMode = dx10.miscFlags2 & DDS_MISC_FLAGS2_ALPHA_MODE_MASK;
+		layout.alphaMode = alphaMode <= 4 ? alphaMode : 0;
+	} else {
+		layout.format = legacyFormat(header.ddspf);
+		if (layout.format == DXGIFormat::UNKNOWN || isPlanar(layout.format)) return DDSStatus::NotSupported;
+
+		if (header.flags & DDS_HEADER_FLAGS_VOLUME) {
+			layout.dimension = DDSDimension::Texture3D;
+		} else {
+			if (header.caps2 & DDS_CUBEMAP) {
+				// All the six faces are required
+				if ((header.caps2 & DDS_CUBEMAP_ALLFACES) != DDS_CUBEMAP_ALLFACES) return DDSStatus::NotSupported;
+				layout.arraySize = 6;
+				layout.cubeMap = true;
+			}
+			// There's no way for a legacy Direct3D 9 DDS to express a 1D texture
+			layout.depth = 1;
+			layout.dimension = DDSDimension::Texture2D;
+		}
+
+		if ((header.ddspf.flags & DDS_FOURCC) &&
+		    (header.ddspf.fourCC == makeFourCC('D', 'X', 'T', '2') || header.ddspf.fourCC == makeFourCC('D', 'X', 'T', '4'))) {
+			layout.alphaMode = DDS_ALPHA_MODE_PREMULTIPLIED;
+		}
+	}
+
+	// Bound the sizes, for security purposes we don't trust the metadata larger than the hardware requirements
+	if (layout.mipCount > REQ_MIP_LEVELS) return DDSStatus::NotSupported;
+	switch (layout.dimension) {
+		case DDSDimension::Texture1D:
+			if (layout.arraySize > REQ_TEXTURE1D_ARRAY_AXIS_DIMENSION || layout.width > REQ_TEXTURE1D_U_DIMENSION) {
+				return DDSStatus::NotSupported;
+			}
+			break;
+
+		case DDSDimension::Texture2D: {
+			// arraySize already counts the cube faces
+			const uint32_t limit = layout.cubeMap ? REQ_TEXTURECUBE_DIMENSION : REQ_TEXTURE2D_U_OR_V_DIMENSION;
+			if (layout.arraySize > REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION || layout.width > limit || layout.height > limit) {
+				return DDSStatus::NotSupported;
+			}
+			break;
+		}
+
+		case DDSDimension::Texture3D:
+			if (layout.width > REQ_TEXTURE3D_U_V_OR_W_DIMENSION || layout.height > REQ_TEXTURE3D_U_V_OR_W_DIMENSION ||
+			    layout.depth > REQ_TEXTURE3D_U_V_OR_W_DIMENSION) {
+				return DDSStatus::NotSupported;
+			}
+			break;
+	}
+
+	if (layout.width == 0 || layout.height == 0 || layout.depth == 0) return DDSStatus::InvalidData;
+
+	const size_t items = layout.dimension == DDSDimension::Texture3D ? 1 : layout.arraySize;
+	if (items * layout.mipCount > REQ_SUBRESOURCES) return DDSStatus::NotSupported;
+	return DDSStatus::OK;
+}
+
+DDSStatus DDSParser::computeSubresources(DDSLayout& layout, size_t maxsize) {
+	layout.subresources.clear();
+	layout.skipMip = 0;
+
+	size_t offset = layout.headerSize;
+	for (uint32_t item = 0; item < layout.arraySize; item++) {
+		size_t w = layout.width, h = layout.height, d = layout.depth;
+		for (uint32_t mip = 0; mip < layout.mipCount; mip++) {
+			size_t numBytes, rowBytes, numRows;
+			DDSStatus status = surfaceInfo(layout.format, w, h, numBytes, rowBytes, numRows);
+			if (status != DDSStatus::OK) return status;
+
+			if (layout.mipCount <= 1 || !maxsize || (w <= maxsize && h <= maxsize && d <= maxsize)) {
+				DDSSubresource sub;
+				sub.offset = offset;
+				sub.rowPitch = rowBytes;
+				sub.slicePitch = numBytes;
+				sub.width = uint32_t(w);
+				sub.height = uint32_t(h);
+				sub.depth = uint32_t(d);
+				layout.subresources.push_back(sub);
+			} else if (item == 0) {
+				// The skipped mips, counted on the first item only
+				layout.skipMip++;
+			}
+
+			offset += numBytes * d;
+			w = std::max<size_t>(w >> 1, 1);
+			h = std::max<size_t>(h >> 1, 1);
+			d = std::max<size_t>(d >> 1, 1);
+		}
+	}
+
+	layout.dataSize = offset - layout.headerSize;
+	return layout.subresources.empty() ? DDSStatus::InvalidData : DDSStatus::OK;
+}
+
+std::vector<DDSByteRange> DDSParser::getReadRanges(const DDSLayout& layout) {
+	std::vector<DDSByteRange> ranges;
+	ranges.push_back({ 0, layout.headerSize });
+	for (const auto& sub : layout.subresources) {
+		const size_t size = sub.slicePitch * sub.depth;
+		DDSByteRange& last = ranges.back();
+		if (last.offset + last.size == sub.offset) {
+			last.size += size;
+		} else {
+			ranges.push_back({ sub.offset, size });
+		}
+	}
+	return ranges;
+}
+
+void DDSParser::packSubresources(DDSLayout& layout, const std::vector<DDSByteRange>& ranges) {
+	// Both are in the file order
+	size_t range = 0, packed = 0;
+	for (auto& sub : layout.subresources) {
+		while (sub.offset >= ranges[range].offset + ranges[range].size) packed += ranges[range++].size;
+		sub.offset = packed + (sub.offset - ranges[range].offset);
+	}
+}
+
+size_t DDSParser::getRangesSize(const std::vector<DDSByteRange>& ranges) {
+	size_t size = 0;
+	for (const auto& range : ranges) size += range.size;
+	return size;
+}
+
+DDSStatus DDSParser::parse(const uint8_t* data, size_t size, DDSLayout& layout, size_t maxsize) {
+	DDSStatus status = parseHeader(data, size, layout);
+	if (status == DDSStatus::OK && layout.supercompressed) status = DDSStatus::NotSupported;
+	if (status == DDSStatus::OK) status = computeSubresources(layout, maxsize);
+	if (status == DDSStatus::OK && layout.headerSize + layout.dataSize > size) status = DDSStatus::Truncated;
+	return status;
+}
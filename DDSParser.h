@@ -0,0 +1,92 @@
+#pragma once
+
+#include "DXGIFormat.h"
+#include "DXGIFormatTraits.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Why a DDS file was rejected. The loaders map these to their HRESULTs
+enum class DDSStatus { OK, ReadFailed, InvalidData, Truncated, NotSupported, Overflow };
+const char* toString(DDSStatus status);
+
+// The D3D11_RESOURCE_DIMENSION and D3D12_RESOURCE_DIMENSION values, they are the same
+enum class DDSDimension : uint32_t { Texture1D = 2, Texture2D = 3, Texture3D = 4 };
+
+// Where a subresource lies in the file
+struct DDSSubresource {
+	size_t offset = 0;    // From the start of the file, or of the packed ranges after packSubresources
+	size_t rowPitch = 0, slicePitch = 0;
+	uint32_t width = 0, height = 0, depth = 0;
+};
+
+struct DDSLayout {
+	DXGIFormat format = DXGIFormat::UNKNOWN;
+	DDSDimension dimension = DDSDimension::Texture2D;
+	uint32_t width = 0, height = 0, depth = 0;
+	uint32_t mipCount = 0;
+	uint32_t arraySize = 0;       // The cube maps count 6 per cube
+	bool cubeMap = false;
+	uint32_t alphaMode = 0;       // DDS_ALPHA_MODE
+	size_t headerSize = 0;        // The magic number and the headers, the pixels start right after
+	bool supercompressed = false; // The file holds DDSCompression frames, the index starts right after the headers.
+	                              // The loaders expand them, their subresources point to the raw pixels
+
+	// Filled by computeSubresources. The mips larger than maxsize are skipped,
+	// the rest go item by item, mip by mip, the way the Direct3D subresource indices do
+	uint32_t skipMip = 0;
+	size_t dataSize = 0;          // The pixels of all the mips, the skipped ones included
+	std::vector<DDSSubresource> subresources;
+
+	uint32_t getLoadedMips() const { return mipCount - skipMip; }
+};
+
+// The DDS_PIXELFORMAT of the header
+struct DDSPixelFormat {
+	uint32_t size, flags, fourCC, rgbBitCount;
+	uint32_t rBitMask, gBitMask, bBitMask, aBitMask;
+};
+
+// A part of the file to read
+struct DDSByteRange {
+	size_t offset = 0;
+	size_t size = 0;
+};
+
+// The DDS header validation and the subresource layout, the same rules the Direct3D 12 loader
+// applies (and its size limits), but without Direct3D. So the parsing runs and is measured anywhere.
+//
+// The planar video formats (NV12 and friends) are rejected, they need the device for the plane layout
+class DDSParser {
+public:
+	// Enough bytes for parseHeader, whatever the file is
+	static constexpr size_t MAX_HEADER_SIZE = 4 + 124 + 20;
+	// The supercompressed files (see DDSCompression) carry this FourCC in reserved1[9] of the header
+	static constexpr uint32_t SUPERCOMPRESSED_MAGIC = 'D' | 'D' << 8 | 'S' << 16 | uint32_t('Z') << 24;
+	static constexpr size_t SUPERCOMPRESSED_MARKER_OFFSET = 4 + 7 * 4 + 9 * 4;
+
+	// Validates the headers and fills everything but the subresources
+	static DDSStatus parseHeader(const uint8_t* data, size_t size, DDSLayout& layout);
+	// The offsets and the pitches of the subresources, skipping the mips larger than maxsize (0 keeps all)
+	static DDSStatus computeSubresources(DDSLayout& layout, size_t maxsize = 0);
+	// Both of the above, checking that the file holds all the pixels. A supercompressed file is NotSupported,
+	// DDSCompression expands it first
+	static DDSStatus parse(const uint8_t* data, size_t size, DDSLayout& layout, size_t maxsize = 0);
+
+	// What the headers and the subresources of the layout need of the file, merged and in the file order.
+	// With the large mips skipped it is the headers and the tail of the chain of every item
+	static std::vector<DDSByteRange> getReadRanges(const DDSLayout& layout);
+	// The ranges read back to back: the subresource offsets move from the file to that buffer
+	static void packSubresources(DDSLayout& layout, const std::vector<DDSByteRange>& ranges);
+	static size_t getRangesSize(const std::vector<DDSByteRange>& ranges);
+
+	// The format of the headers without the "DX10" extension, UNKNOWN if no DXGI format maps to it.
+	// The loaders share it
+	static DXGIFormat legacyFormat(const DDSPixelFormat& ddpf);
+
+	// See DXGIFormatTraits. The sizes overflow past 32 bits, the limit of the Direct3D 12 loader
+	static size_t bitsPerPixel(DXGIFormat format) { return DXGIFormatTraits::get(format).bitsPerPixel; }
+	static DDSStatus surfaceInfo(DXGIFormat format, size_t width, size_t height,
+	                             size_t& numBytes, size_t& rowBytes, size_t& numRows);
+};
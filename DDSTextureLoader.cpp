@@ -15,10 +15,16 @@
 //--------------------------------------------------------------------------------------
 
 #include "DDSTextureLoader.h"
+#include "BCDecoder.h"
+#include "DDSCompression.h"
+#include "DDSParser.h"
+#include "DXGIFormatTraits.h"
+#include "MipGenerator.h"
 
 #include <algorithm>
 #include <cassert>
 #include <memory>
+#include <new>
 
 #ifdef __clang__
 #pragma clang diagnostic ignored "-Wcovered-switch-default"
@@ -136,6 +142,21 @@ namespace
 	}
 #endif
 
+	//--------------------------------------------------------------------------------------
+	HRESULT HResultFromStatus(DDSStatus status) noexcept
+	{
+		switch (status)
+		{
+			case DDSStatus::OK:           return S_OK;
+			case DDSStatus::InvalidData:  return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+			case DDSStatus::Truncated:    return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+			case DDSStatus::NotSupported: return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+			case DDSStatus::Overflow:     return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+			default:                      return E_FAIL;
+		}
+	}
+
+
 	//--------------------------------------------------------------------------------------
 	HRESULT LoadTextureDataFromMemory(
 			_In_reads_(ddsDataSize) const uint8_t* ddsData,
@@ -177,6 +198,12 @@ namespace
 			return E_FAIL;
 		}
 
+		// The supercompressed files need a buffer of their own to expand into, only the file loader has one
+		if (hdr->reserved1[9] == DDSParser::SUPERCOMPRESSED_MAGIC)
+		{
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+		}
+
 		// Check for DX10 extension
 		bool bDXT10Header = false;
 		if ((hdr->ddspf.flags & DDS_FOURCC) &&
@@ -203,13 +230,115 @@ namespace
 	}
 
 
+	//--------------------------------------------------------------------------------------
+	// Reads size bytes at offset, all of them or it fails
+	HRESULT ReadFileRange(
+			HANDLE hFile,
+			size_t offset,
+			size_t size,
+			_Out_writes_bytes_(size) uint8_t* dst) noexcept
+	{
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		DWORD bytesRead = 0;
+		if (!ReadFile(hFile, dst, static_cast<DWORD>(size), &bytesRead, &overlapped))
+		{
+			return HRESULT_FROM_WIN32(GetLastError());
+		}
+		return (bytesRead < size) ? E_FAIL : S_OK;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// What to read of the file after its first headerSize bytes. All of it, unless maxsize drops some
+	// of the large mips: FillInitData never looks at those, so they stay on the disk. The supercompressed
+	// files are read whole
+	HRESULT GetRangesToRead(
+			_In_reads_bytes_(headerSize) const uint8_t* ddsData,
+			size_t headerSize,
+			size_t fileSize,
+			size_t maxsize,
+			std::vector<DDSByteRange>& ranges) noexcept
+	{
+		try
+		{
+			DDSLayout layout;
+			if (maxsize
+				&& DDSParser::parseHeader(ddsData, headerSize, layout) == DDSStatus::OK
+				&& DDSParser::computeSubresources(layout, maxsize) == DDSStatus::OK
+				&& !layout.supercompressed
+				&& layout.skipMip > 0
+				&& layout.headerSize + layout.dataSize <= fileSize)
+			{
+				ranges = DDSParser::getReadRanges(layout);
+				ranges.erase(ranges.begin());    // The headers, read already
+			}
+			else
+			{
+				ranges.assign(1, DDSByteRange{ headerSize, fileSize - headerSize });
+			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			return E_OUTOFMEMORY;
+		}
+		return S_OK;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// A supercompressed file, read whole, to the raw one FillInitData expects. Only the subresources
+	// that survive maxsize are decompressed, in parallel, straight to their place in the layout
+	HRESULT ExpandTextureData(
+			std::unique_ptr<uint8_t[]>& ddsData,
+			size_t& fileSize,
+			size_t maxsize) noexcept
+	{
+		size_t expandedSize = 0;
+		DDSStatus status = DDSCompression::getExpandedSize(ddsData.get(), fileSize, expandedSize);
+		if (status != DDSStatus::OK)
+		{
+			return HResultFromStatus(status);
+		}
+
+		std::unique_ptr<uint8_t[]> expanded(new (std::nothrow) uint8_t[expandedSize]);
+		if (!expanded)
+		{
+			return E_OUTOFMEMORY;
+		}
+
+		try
+		{
+			status = DDSCompression::expand(ddsData.get(), fileSize, expanded.get(), maxsize);
+		}
+		catch (const std::bad_alloc&)
+		{
+			return E_OUTOFMEMORY;
+		}
+		catch (...)
+		{
+			// The decompression threads couldn't start
+			return E_FAIL;
+		}
+		if (status != DDSStatus::OK)
+		{
+			return HResultFromStatus(status);
+		}
+
+		ddsData = std::move(expanded);
+		fileSize = expandedSize;
+		return S_OK;
+	}
+
+
 	//--------------------------------------------------------------------------------------
 	HRESULT LoadTextureDataFromFile(
 			_In_z_ const wchar_t* fileName,
 			std::unique_ptr<uint8_t[]>& ddsData,
 			const DDS_HEADER** header,
 			const uint8_t** bitData,
-			size_t* bitSize) noexcept
+			size_t* bitSize,
+			size_t maxsize) noexcept
 	{
 		if (!header || !bitData || !bitSize)
 		{
@@ -264,23 +393,34 @@ namespace
 			return E_OUTOFMEMORY;
 		}
 
-		// read the data in
-		DWORD bytesRead = 0;
-		if (!ReadFile(hFile.get(),
-					  ddsData.get(),
-					  fileInfo.EndOfFile.LowPart,
-					  &bytesRead,
-					  nullptr
-		))
+		// read the headers in, then what the subresources need of the rest
+		size_t fileSize = fileInfo.EndOfFile.LowPart;
+		const size_t headerSize = std::min(fileSize, DDSParser::MAX_HEADER_SIZE);
+		std::vector<DDSByteRange> ranges;
+		HRESULT hr = ReadFileRange(hFile.get(), 0, headerSize, ddsData.get());
+		if (SUCCEEDED(hr))
+		{
+			hr = GetRangesToRead(ddsData.get(), headerSize, fileSize, maxsize, ranges);
+		}
+		for (size_t i = 0; SUCCEEDED(hr) && i < ranges.size(); ++i)
+		{
+			hr = ReadFileRange(hFile.get(), ranges[i].offset, ranges[i].size, ddsData.get() + ranges[i].offset);
+		}
+		if (FAILED(hr))
 		{
 			ddsData.reset();
-			return HRESULT_FROM_WIN32(GetLastError());
+			return hr;
 		}
 
-		if (bytesRead < fileInfo.EndOfFile.LowPart)
+		// A supercompressed file goes on as the raw one would have
+		if (DDSCompression::isCompressed(ddsData.get(), fileSize))
 		{
-			ddsData.reset();
-			return E_FAIL;
+			hr = ExpandTextureData(ddsData, fileSize, maxsize);
+			if (FAILED(hr))
+			{
+				ddsData.reset();
+				return hr;
+			}
 		}
 
 		// DDS files always start with the same magic number ("DDS ")
@@ -307,7 +447,7 @@ namespace
 			(MAKEFOURCC('D', 'X', '1', '0') == hdr->ddspf.fourCC))
 		{
 			// Must be long enough for both headers and magic value
-			if (fileInfo.EndOfFile.LowPart < (sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)))
+			if (fileSize < (sizeof(uint32_t) + sizeof(DDS_HEADER) + sizeof(DDS_HEADER_DXT10)))
 			{
 				ddsData.reset();
 				return E_FAIL;
@@ -321,7 +461,7 @@ namespace
 		auto offset = sizeof(uint32_t) + sizeof(DDS_HEADER)
 					  + (bDXT10Header ? sizeof(DDS_HEADER_DXT10) : 0u);
 		*bitData = ddsData.get() + offset;
-		*bitSize = fileInfo.EndOfFile.LowPart - offset;
+		*bitSize = fileSize - offset;
 
 		return S_OK;
 	}
@@ -332,146 +472,7 @@ namespace
 	//--------------------------------------------------------------------------------------
 	size_t BitsPerPixel(_In_ DXGI_FORMAT fmt) noexcept
 	{
-		switch (fmt)
-		{
-			case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-			case DXGI_FORMAT_R32G32B32A32_FLOAT:
-			case DXGI_FORMAT_R32G32B32A32_UINT:
-			case DXGI_FORMAT_R32G32B32A32_SINT:
-				return 128;
-
-			case DXGI_FORMAT_R32G32B32_TYPELESS:
-			case DXGI_FORMAT_R32G32B32_FLOAT:
-			case DXGI_FORMAT_R32G32B32_UINT:
-			case DXGI_FORMAT_R32G32B32_SINT:
-				return 96;
-
-			case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-			case DXGI_FORMAT_R16G16B16A16_FLOAT:
-			case DXGI_FORMAT_R16G16B16A16_UNORM:
-			case DXGI_FORMAT_R16G16B16A16_UINT:
-			case DXGI_FORMAT_R16G16B16A16_SNORM:
-			case DXGI_FORMAT_R16G16B16A16_SINT:
-			case DXGI_FORMAT_R32G32_TYPELESS:
-			case DXGI_FORMAT_R32G32_FLOAT:
-			case DXGI_FORMAT_R32G32_UINT:
-			case DXGI_FORMAT_R32G32_SINT:
-			case DXGI_FORMAT_R32G8X24_TYPELESS:
-			case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-			case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-			case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-			case DXGI_FORMAT_Y416:
-			case DXGI_FORMAT_Y210:
-			case DXGI_FORMAT_Y216:
-				return 64;
-
-			case DXGI_FORMAT_R10G10B10A2_TYPELESS:
-			case DXGI_FORMAT_R10G10B10A2_UNORM:
-			case DXGI_FORMAT_R10G10B10A2_UINT:
-			case DXGI_FORMAT_R11G11B10_FLOAT:
-			case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-			case DXGI_FORMAT_R8G8B8A8_UNORM:
-			case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-			case DXGI_FORMAT_R8G8B8A8_UINT:
-			case DXGI_FORMAT_R8G8B8A8_SNORM:
-			case DXGI_FORMAT_R8G8B8A8_SINT:
-			case DXGI_FORMAT_R16G16_TYPELESS:
-			case DXGI_FORMAT_R16G16_FLOAT:
-			case DXGI_FORMAT_R16G16_UNORM:
-			case DXGI_FORMAT_R16G16_UINT:
-			case DXGI_FORMAT_R16G16_SNORM:
-			case DXGI_FORMAT_R16G16_SINT:
-			case DXGI_FORMAT_R32_TYPELESS:
-			case DXGI_FORMAT_D32_FLOAT:
-			case DXGI_FORMAT_R32_FLOAT:
-			case DXGI_FORMAT_R32_UINT:
-			case DXGI_FORMAT_R32_SINT:
-			case DXGI_FORMAT_R24G8_TYPELESS:
-			case DXGI_FORMAT_D24_UNORM_S8_UINT:
-			case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-			case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-			case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-			case DXGI_FORMAT_R8G8_B8G8_UNORM:
-			case DXGI_FORMAT_G8R8_G8B8_UNORM:
-			case DXGI_FORMAT_B8G8R8A8_UNORM:
-			case DXGI_FORMAT_B8G8R8X8_UNORM:
-			case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
-			case DXGI_FORMAT_B8G8R8A8_TYPELESS:
-			case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-			case DXGI_FORMAT_B8G8R8X8_TYPELESS:
-			case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-			case DXGI_FORMAT_AYUV:
-			case DXGI_FORMAT_Y410:
-			case DXGI_FORMAT_YUY2:
-				return 32;
-
-			case DXGI_FORMAT_P010:
-			case DXGI_FORMAT_P016:
-				return 24;
-
-			case DXGI_FORMAT_R8G8_TYPELESS:
-			case DXGI_FORMAT_R8G8_UNORM:
-			case DXGI_FORMAT_R8G8_UINT:
-			case DXGI_FORMAT_R8G8_SNORM:
-			case DXGI_FORMAT_R8G8_SINT:
-			case DXGI_FORMAT_R16_TYPELESS:
-			case DXGI_FORMAT_R16_FLOAT:
-			case DXGI_FORMAT_D16_UNORM:
-			case DXGI_FORMAT_R16_UNORM:
-			case DXGI_FORMAT_R16_UINT:
-			case DXGI_FORMAT_R16_SNORM:
-			case DXGI_FORMAT_R16_SINT:
-			case DXGI_FORMAT_B5G6R5_UNORM:
-			case DXGI_FORMAT_B5G5R5A1_UNORM:
-			case DXGI_FORMAT_A8P8:
-			case DXGI_FORMAT_B4G4R4A4_UNORM:
-				return 16;
-
-			case DXGI_FORMAT_NV12:
-			case DXGI_FORMAT_420_OPAQUE:
-			case DXGI_FORMAT_NV11:
-				return 12;
-
-			case DXGI_FORMAT_R8_TYPELESS:
-			case DXGI_FORMAT_R8_UNORM:
-			case DXGI_FORMAT_R8_UINT:
-			case DXGI_FORMAT_R8_SNORM:
-			case DXGI_FORMAT_R8_SINT:
-			case DXGI_FORMAT_A8_UNORM:
-			case DXGI_FORMAT_BC2_TYPELESS:
-			case DXGI_FORMAT_BC2_UNORM:
-			case DXGI_FORMAT_BC2_UNORM_SRGB:
-			case DXGI_FORMAT_BC3_TYPELESS:
-			case DXGI_FORMAT_BC3_UNORM:
-			case DXGI_FORMAT_BC3_UNORM_SRGB:
-			case DXGI_FORMAT_BC5_TYPELESS:
-			case DXGI_FORMAT_BC5_UNORM:
-			case DXGI_FORMAT_BC5_SNORM:
-			case DXGI_FORMAT_BC6H_TYPELESS:
-			case DXGI_FORMAT_BC6H_UF16:
-			case DXGI_FORMAT_BC6H_SF16:
-			case DXGI_FORMAT_BC7_TYPELESS:
-			case DXGI_FORMAT_BC7_UNORM:
-			case DXGI_FORMAT_BC7_UNORM_SRGB:
-			case DXGI_FORMAT_AI44:
-			case DXGI_FORMAT_IA44:
-			case DXGI_FORMAT_P8:
-				return 8;
-
-			case DXGI_FORMAT_R1_UNORM:
-				return 1;
-
-			case DXGI_FORMAT_BC1_TYPELESS:
-			case DXGI_FORMAT_BC1_UNORM:
-			case DXGI_FORMAT_BC1_UNORM_SRGB:
-			case DXGI_FORMAT_BC4_TYPELESS:
-			case DXGI_FORMAT_BC4_UNORM:
-			case DXGI_FORMAT_BC4_SNORM:
-				return 4;
-
-			default:
-				return 0;
-		}
+		return DXGIFormatTraits::get(static_cast<DXGIFormat>(fmt)).bitsPerPixel;
 	}
 
 
@@ -490,123 +491,10 @@ namespace
 		uint64_t rowBytes = 0;
 		uint64_t numRows = 0;
 
-		bool bc = false;
-		bool packed = false;
-		bool planar = false;
-		size_t bpe = 0;
-		switch (fmt)
-		{
-			case DXGI_FORMAT_BC1_TYPELESS:
-			case DXGI_FORMAT_BC1_UNORM:
-			case DXGI_FORMAT_BC1_UNORM_SRGB:
-			case DXGI_FORMAT_BC4_TYPELESS:
-			case DXGI_FORMAT_BC4_UNORM:
-			case DXGI_FORMAT_BC4_SNORM:
-				bc = true;
-				bpe = 8;
-				break;
-
-			case DXGI_FORMAT_BC2_TYPELESS:
-			case DXGI_FORMAT_BC2_UNORM:
-			case DXGI_FORMAT_BC2_UNORM_SRGB:
-			case DXGI_FORMAT_BC3_TYPELESS:
-			case DXGI_FORMAT_BC3_UNORM:
-			case DXGI_FORMAT_BC3_UNORM_SRGB:
-			case DXGI_FORMAT_BC5_TYPELESS:
-			case DXGI_FORMAT_BC5_UNORM:
-			case DXGI_FORMAT_BC5_SNORM:
-			case DXGI_FORMAT_BC6H_TYPELESS:
-			case DXGI_FORMAT_BC6H_UF16:
-			case DXGI_FORMAT_BC6H_SF16:
-			case DXGI_FORMAT_BC7_TYPELESS:
-			case DXGI_FORMAT_BC7_UNORM:
-			case DXGI_FORMAT_BC7_UNORM_SRGB:
-				bc = true;
-				bpe = 16;
-				break;
-
-			case DXGI_FORMAT_R8G8_B8G8_UNORM:
-			case DXGI_FORMAT_G8R8_G8B8_UNORM:
-			case DXGI_FORMAT_YUY2:
-				packed = true;
-				bpe = 4;
-				break;
-
-			case DXGI_FORMAT_Y210:
-			case DXGI_FORMAT_Y216:
-				packed = true;
-				bpe = 8;
-				break;
-
-			case DXGI_FORMAT_NV12:
-			case DXGI_FORMAT_420_OPAQUE:
-				if ((height % 2) != 0)
-				{
-					// Requires a height alignment of 2.
-					return E_INVALIDARG;
-				}
-				planar = true;
-				bpe = 2;
-				break;
-
-			case DXGI_FORMAT_P010:
-			case DXGI_FORMAT_P016:
-				if ((height % 2) != 0)
-				{
-					// Requires a height alignment of 2.
-					return E_INVALIDARG;
-				}
-				planar = true;
-				bpe = 4;
-				break;
-
-			default:
-				break;
-		}
-
-		if (bc)
-		{
-			uint64_t numBlocksWide = 0;
-			if (width > 0)
-			{
-				numBlocksWide = std::max<uint64_t>(1u, (uint64_t(width) + 3u) / 4u);
-			}
-			uint64_t numBlocksHigh = 0;
-			if (height > 0)
-			{
-				numBlocksHigh = std::max<uint64_t>(1u, (uint64_t(height) + 3u) / 4u);
-			}
-			rowBytes = numBlocksWide * bpe;
-			numRows = numBlocksHigh;
-			numBytes = rowBytes * numBlocksHigh;
-		}
-		else if (packed)
-		{
-			rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-			numRows = uint64_t(height);
-			numBytes = rowBytes * height;
-		}
-		else if (fmt == DXGI_FORMAT_NV11)
-		{
-			rowBytes = ((uint64_t(width) + 3u) >> 2) * 4u;
-			numRows = uint64_t(height) * 2u; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
-			numBytes = rowBytes * numRows;
-		}
-		else if (planar)
-		{
-			rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-			numBytes = (rowBytes * uint64_t(height)) + ((rowBytes * uint64_t(height) + 1u) >> 1);
-			numRows = height + ((uint64_t(height) + 1u) >> 1);
-		}
-		else
+		if (!DXGIFormatTraits::getSurfaceInfo(static_cast<DXGIFormat>(fmt), width, height, numBytes, rowBytes, numRows))
 		{
-			const size_t bpp = BitsPerPixel(fmt);
-			if (!bpp)
-				return E_INVALIDARG;
-
-			rowBytes = (uint64_t(width) * bpp + 7u) / 8u; // round up to nearest byte
-			numRows = uint64_t(height);
-			numBytes = rowBytes * height;
+			// Unknown format, or a 4:2:0 format of an odd height
+			return E_INVALIDARG;
 		}
 
 #if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
@@ -635,337 +523,24 @@ namespace
 
 
 	//--------------------------------------------------------------------------------------
-#define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
-
 	DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf) noexcept
 	{
-		if (ddpf.flags & DDS_RGB)
-		{
-			// Note that sRGB formats are written using the "DX10" extended header
-
-			switch (ddpf.RGBBitCount)
-			{
-				case 32:
-					if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
-					{
-						return DXGI_FORMAT_R8G8B8A8_UNORM;
-					}
-
-					if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
-					{
-						return DXGI_FORMAT_B8G8R8A8_UNORM;
-					}
-
-					if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0))
-					{
-						return DXGI_FORMAT_B8G8R8X8_UNORM;
-					}
-
-					// No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0) aka D3DFMT_X8B8G8R8
-
-					// Note that many common DDS reader/writers (including D3DX) swap the
-					// the RED/BLUE masks for 10:10:10:2 formats. We assume
-					// below that the 'backwards' header mask is being used since it is most
-					// likely written by D3DX. The more robust solution is to use the 'DX10'
-					// header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
-
-					// For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
-					if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
-					{
-						return DXGI_FORMAT_R10G10B10A2_UNORM;
-					}
-
-					// No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
-
-					if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
-					{
-						return DXGI_FORMAT_R16G16_UNORM;
-					}
-
-					if (ISBITMASK(0xffffffff, 0, 0, 0))
-					{
-						// Only 32-bit color channel format in D3D9 was R32F
-						return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
-					}
-					break;
-
-				case 24:
-					// No 24bpp DXGI formats aka D3DFMT_R8G8B8
-					break;
-
-				case 16:
-					if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000))
-					{
-						return DXGI_FORMAT_B5G5R5A1_UNORM;
-					}
-					if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0))
-					{
-						return DXGI_FORMAT_B5G6R5_UNORM;
-					}
-
-					// No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0) aka D3DFMT_X1R5G5B5
-
-					if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000))
-					{
-						return DXGI_FORMAT_B4G4R4A4_UNORM;
-					}
-
-					// NVTT versions 1.x wrote this as RGB instead of LUMINANCE
-					if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-					{
-						return DXGI_FORMAT_R8G8_UNORM;
-					}
-					if (ISBITMASK(0xffff, 0, 0, 0))
-					{
-						return DXGI_FORMAT_R16_UNORM;
-					}
-
-					// No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0) aka D3DFMT_X4R4G4B4
-
-					// No 3:3:2:8 or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_A8P8, etc.
-					break;
-
-				case 8:
-					// NVTT versions 1.x wrote this as RGB instead of LUMINANCE
-					if (ISBITMASK(0xff, 0, 0, 0))
-					{
-						return DXGI_FORMAT_R8_UNORM;
-					}
-
-					// No 3:3:2 or paletted DXGI formats aka D3DFMT_R3G3B2, D3DFMT_P8
-					break;
-			}
-		}
-		else if (ddpf.flags & DDS_LUMINANCE)
-		{
-			switch (ddpf.RGBBitCount)
-			{
-				case 16:
-					if (ISBITMASK(0xffff, 0, 0, 0))
-					{
-						return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-					if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-					{
-						return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-					break;
-
-				case 8:
-					if (ISBITMASK(0xff, 0, 0, 0))
-					{
-						return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-
-					// No DXGI format maps to ISBITMASK(0x0f,0,0,0xf0) aka D3DFMT_A4L4
-
-					if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-					{
-						return DXGI_FORMAT_R8G8_UNORM; // Some DDS writers assume the bitcount should be 8 instead of 16
-					}
-					break;
-			}
-		}
-		else if (ddpf.flags & DDS_ALPHA)
-		{
-			if (8 == ddpf.RGBBitCount)
-			{
-				return DXGI_FORMAT_A8_UNORM;
-			}
-		}
-		else if (ddpf.flags & DDS_BUMPDUDV)
-		{
-			switch (ddpf.RGBBitCount)
-			{
-				case 32:
-					if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
-					{
-						return DXGI_FORMAT_R8G8B8A8_SNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-					if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
-					{
-						return DXGI_FORMAT_R16G16_SNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-
-					// No DXGI format maps to ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000) aka D3DFMT_A2W10V10U10
-					break;
-
-				case 16:
-					if (ISBITMASK(0x00ff, 0xff00, 0, 0))
-					{
-						return DXGI_FORMAT_R8G8_SNORM; // D3DX10/11 writes this out as DX10 extension
-					}
-					break;
-			}
-
-			// No DXGI format maps to DDPF_BUMPLUMINANCE aka D3DFMT_L6V5U5, D3DFMT_X8L8V8U8
-		}
-		else if (ddpf.flags & DDS_FOURCC)
-		{
-			if (MAKEFOURCC('D', 'X', 'T', '1') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC1_UNORM;
-			}
-			if (MAKEFOURCC('D', 'X', 'T', '3') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC2_UNORM;
-			}
-			if (MAKEFOURCC('D', 'X', 'T', '5') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC3_UNORM;
-			}
-
-			// While pre-multiplied alpha isn't directly supported by the DXGI formats,
-			// they are basically the same as these BC formats so they can be mapped
-			if (MAKEFOURCC('D', 'X', 'T', '2') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC2_UNORM;
-			}
-			if (MAKEFOURCC('D', 'X', 'T', '4') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC3_UNORM;
-			}
-
-			if (MAKEFOURCC('A', 'T', 'I', '1') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC4_UNORM;
-			}
-			if (MAKEFOURCC('B', 'C', '4', 'U') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC4_UNORM;
-			}
-			if (MAKEFOURCC('B', 'C', '4', 'S') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC4_SNORM;
-			}
-
-			if (MAKEFOURCC('A', 'T', 'I', '2') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC5_UNORM;
-			}
-			if (MAKEFOURCC('B', 'C', '5', 'U') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC5_UNORM;
-			}
-			if (MAKEFOURCC('B', 'C', '5', 'S') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_BC5_SNORM;
-			}
-
-			// BC6H and BC7 are written using the "DX10" extended header
-
-			if (MAKEFOURCC('R', 'G', 'B', 'G') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_R8G8_B8G8_UNORM;
-			}
-			if (MAKEFOURCC('G', 'R', 'G', 'B') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_G8R8_G8B8_UNORM;
-			}
-
-			if (MAKEFOURCC('Y', 'U', 'Y', '2') == ddpf.fourCC)
-			{
-				return DXGI_FORMAT_YUY2;
-			}
-
-			// Check for D3DFORMAT enums being set here
-			switch (ddpf.fourCC)
-			{
-				case 36: // D3DFMT_A16B16G16R16
-					return DXGI_FORMAT_R16G16B16A16_UNORM;
-
-				case 110: // D3DFMT_Q16W16V16U16
-					return DXGI_FORMAT_R16G16B16A16_SNORM;
-
-				case 111: // D3DFMT_R16F
-					return DXGI_FORMAT_R16_FLOAT;
-
-				case 112: // D3DFMT_G16R16F
-					return DXGI_FORMAT_R16G16_FLOAT;
-
-				case 113: // D3DFMT_A16B16G16R16F
-					return DXGI_FORMAT_R16G16B16A16_FLOAT;
-
-				case 114: // D3DFMT_R32F
-					return DXGI_FORMAT_R32_FLOAT;
-
-				case 115: // D3DFMT_G32R32F
-					return DXGI_FORMAT_R32G32_FLOAT;
-
-				case 116: // D3DFMT_A32B32G32R32F
-					return DXGI_FORMAT_R32G32B32A32_FLOAT;
-
-					// No DXGI format maps to D3DFMT_CxV8U8
-			}
-		}
-
-		return DXGI_FORMAT_UNKNOWN;
+		return static_cast<DXGI_FORMAT>(DDSParser::legacyFormat({ ddpf.size, ddpf.flags, ddpf.fourCC, ddpf.RGBBitCount,
+				ddpf.RBitMask, ddpf.GBitMask, ddpf.BBitMask, ddpf.ABitMask }));
 	}
 
-#undef ISBITMASK
-
 
 	//--------------------------------------------------------------------------------------
 	DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format) noexcept
 	{
-		switch (format)
-		{
-			case DXGI_FORMAT_R8G8B8A8_UNORM:
-				return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-
-			case DXGI_FORMAT_BC1_UNORM:
-				return DXGI_FORMAT_BC1_UNORM_SRGB;
-
-			case DXGI_FORMAT_BC2_UNORM:
-				return DXGI_FORMAT_BC2_UNORM_SRGB;
-
-			case DXGI_FORMAT_BC3_UNORM:
-				return DXGI_FORMAT_BC3_UNORM_SRGB;
-
-			case DXGI_FORMAT_B8G8R8A8_UNORM:
-				return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
-
-			case DXGI_FORMAT_B8G8R8X8_UNORM:
-				return DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
-
-			case DXGI_FORMAT_BC7_UNORM:
-				return DXGI_FORMAT_BC7_UNORM_SRGB;
-
-			default:
-				return format;
-		}
+		return static_cast<DXGI_FORMAT>(DXGIFormatTraits::get(static_cast<DXGIFormat>(format)).srgb);
 	}
 
 
 	//--------------------------------------------------------------------------------------
 	inline DXGI_FORMAT MakeLinear(_In_ DXGI_FORMAT format) noexcept
 	{
-		switch (format)
-		{
-			case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-				return DXGI_FORMAT_R8G8B8A8_UNORM;
-
-			case DXGI_FORMAT_BC1_UNORM_SRGB:
-				return DXGI_FORMAT_BC1_UNORM;
-
-			case DXGI_FORMAT_BC2_UNORM_SRGB:
-				return DXGI_FORMAT_BC2_UNORM;
-
-			case DXGI_FORMAT_BC3_UNORM_SRGB:
-				return DXGI_FORMAT_BC3_UNORM;
-
-			case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-				return DXGI_FORMAT_B8G8R8A8_UNORM;
-
-			case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-				return DXGI_FORMAT_B8G8R8X8_UNORM;
-
-			case DXGI_FORMAT_BC7_UNORM_SRGB:
-				return DXGI_FORMAT_BC7_UNORM;
-
-			default:
-				return format;
-		}
+		return static_cast<DXGI_FORMAT>(DXGIFormatTraits::get(static_cast<DXGIFormat>(format)).linear);
 	}
 
 
@@ -1067,6 +642,181 @@ namespace
 	}
 
 
+	//--------------------------------------------------------------------------------------
+	// The block-compressed formats the device can't sample are decoded on the CPU
+	bool NeedsDecoding(
+			_In_ ID3D11Device* d3dDevice,
+			_In_ DXGI_FORMAT format,
+			_In_ uint32_t resDim) noexcept
+	{
+		BCFormat bcFormat;
+		if (!BCDecoder::fromDXGIFormat(static_cast<uint32_t>(format), bcFormat))
+			return false;
+
+		const UINT required = (resDim == D3D11_RESOURCE_DIMENSION_TEXTURE3D)
+							  ? D3D11_FORMAT_SUPPORT_TEXTURE3D
+							  : D3D11_FORMAT_SUPPORT_TEXTURE2D;
+		UINT fmtSupport = 0;
+		return FAILED(d3dDevice->CheckFormatSupport(format, &fmtSupport)) || !(fmtSupport & required);
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Replaces the block-compressed subresources filled by FillInitData with the decoded ones.
+	// The decoded pixels live in decodedData, which has to outlive the resource creation
+	HRESULT DecodeInitData(
+			_In_ DXGI_FORMAT format,
+			_In_ size_t width,
+			_In_ size_t height,
+			_In_ size_t depth,
+			_In_ size_t mipCount,
+			_In_ size_t arraySize,
+			_Inout_updates_(mipCount*arraySize) D3D11_SUBRESOURCE_DATA* initData,
+			_Out_ std::unique_ptr<uint8_t[]>& decodedData,
+			_Out_ DXGI_FORMAT& decodedFormat) noexcept
+	{
+		BCFormat bcFormat;
+		if (!BCDecoder::fromDXGIFormat(static_cast<uint32_t>(format), bcFormat))
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+		const BCOutput output = BCDecoder::preferredOutput(bcFormat);
+		const size_t pixelBytes = BCDecoder::pixelBytes(output);
+
+		// All the decoded subresources share one allocation
+		size_t totalBytes = 0;
+		for (size_t j = 0; j < arraySize; j++)
+		{
+			size_t w = width, h = height, d = depth;
+			for (size_t i = 0; i < mipCount; i++)
+			{
+				totalBytes += w * h * d * pixelBytes;
+				w = std::max<size_t>(w >> 1, 1);
+				h = std::max<size_t>(h >> 1, 1);
+				d = std::max<size_t>(d >> 1, 1);
+			}
+		}
+
+		if (totalBytes > UINT32_MAX)
+			return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+		decodedData.reset(new (std::nothrow) uint8_t[totalBytes]);
+		if (!decodedData)
+			return E_OUTOFMEMORY;
+
+		try
+		{
+			uint8_t* pDstBits = decodedData.get();
+			for (size_t j = 0; j < arraySize; j++)
+			{
+				size_t w = width, h = height, d = depth;
+				for (size_t i = 0; i < mipCount; i++)
+				{
+					D3D11_SUBRESOURCE_DATA& res = initData[j * mipCount + i];
+					const size_t rowBytes = w * pixelBytes;
+					const size_t numBytes = rowBytes * h;
+					for (size_t slice = 0; slice < d; slice++)
+					{
+						BCDecoder::decode(bcFormat,
+										  static_cast<const uint8_t*>(res.pSysMem) + slice * res.SysMemSlicePitch, res.SysMemPitch,
+										  w, h,
+										  output, pDstBits + slice * numBytes, rowBytes);
+					}
+
+					res.pSysMem = pDstBits;
+					res.SysMemPitch = static_cast<UINT>(rowBytes);
+					res.SysMemSlicePitch = static_cast<UINT>(numBytes);
+					pDstBits += numBytes * d;
+
+					w = std::max<size_t>(w >> 1, 1);
+					h = std::max<size_t>(h >> 1, 1);
+					d = std::max<size_t>(d >> 1, 1);
+				}
+			}
+		}
+		catch (...)
+		{
+			// The decoder threads couldn't start
+			decodedData.reset();
+			return E_FAIL;
+		}
+
+		if (output == BCOutput::RGBA16F)
+			decodedFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+		else
+			decodedFormat = (MakeLinear(format) != format) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		return S_OK;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Builds the missing mips of a 2D texture on the CPU (MipGenerator). initData holds the level 0
+	// of every array item and is replaced with the full chains. The pixels live in mipData,
+	// which has to outlive the resource creation
+	HRESULT GenerateMipInitData(
+			_In_ DXGI_FORMAT format,
+			_In_ size_t width,
+			_In_ size_t height,
+			_In_ size_t arraySize,
+			_In_ DDS_LOADER_FLAGS loadFlags,
+			_Inout_ std::unique_ptr<D3D11_SUBRESOURCE_DATA[]>& initData,
+			_Out_ std::unique_ptr<uint8_t[]>& mipData,
+			_Out_ size_t& mipCount) noexcept
+	{
+		MipFormat mipFormat;
+		MipGenerator::Settings settings;
+		if (!MipGenerator::fromDXGIFormat(static_cast<uint32_t>(format), mipFormat, settings.srgb))
+			return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
+
+		// The filtering follows the format the views will have
+		if (loadFlags & DDS_LOADER_FORCE_SRGB)
+			settings.srgb = true;
+		else if (loadFlags & DDS_LOADER_IGNORE_SRGB)
+			settings.srgb = false;
+		if (loadFlags & DDS_LOADER_MIP_FILTER_KAISER)
+			settings.filter = MipFilter::Kaiser;
+
+		const size_t chainMips = std::min<size_t>(D3D11_REQ_MIP_LEVELS, MipGenerator::countMips(width, height));
+		MipLevel levels[D3D11_REQ_MIP_LEVELS];
+		const size_t chainBytes = MipGenerator::layoutChain(mipFormat, width, height, chainMips, levels);
+		if (chainBytes * arraySize > UINT32_MAX)
+			return HRESULT_FROM_WIN32(ERROR_ARITHMETIC_OVERFLOW);
+
+		std::unique_ptr<D3D11_SUBRESOURCE_DATA[]> chainData(new (std::nothrow) D3D11_SUBRESOURCE_DATA[chainMips * arraySize]);
+		std::unique_ptr<uint8_t[]> chains(new (std::nothrow) uint8_t[chainBytes * arraySize]);
+		if (!chainData || !chains)
+			return E_OUTOFMEMORY;
+
+		try
+		{
+			for (size_t j = 0; j < arraySize; j++)
+			{
+				uint8_t* chain = chains.get() + j * chainBytes;
+				MipGenerator::generate(mipFormat, settings,
+									   static_cast<const uint8_t*>(initData[j].pSysMem), initData[j].SysMemPitch,
+									   chainMips, levels, chain);
+
+				for (size_t i = 0; i < chainMips; i++)
+				{
+					D3D11_SUBRESOURCE_DATA& res = chainData[j * chainMips + i];
+					res.pSysMem = chain + levels[i].offset;
+					res.SysMemPitch = static_cast<UINT>(levels[i].rowPitch);
+					res.SysMemSlicePitch = static_cast<UINT>(levels[i].slicePitch);
+				}
+			}
+		}
+		catch (...)
+		{
+			// The filter threads couldn't start
+			return E_FAIL;
+		}
+
+		initData = std::move(chainData);
+		mipData = std::move(chains);
+		mipCount = chainMips;
+		return S_OK;
+	}
+
+
 	//--------------------------------------------------------------------------------------
 	HRESULT CreateD3DResources(
 			_In_ ID3D11Device* d3dDevice,
@@ -1517,8 +1267,9 @@ namespace
 				return HRESULT_FROM_WIN32(ERROR_NOT_SUPPORTED);
 		}
 
+		// DDS_LOADER_GENERATE_MIPS asks for the CPU mips even when the GPU could make them
 		bool autogen = false;
-		if (mipCount == 1 && d3dContext && textureView) // Must have context and shader-view to auto generate mipmaps
+		if (mipCount == 1 && d3dContext && textureView && !(loadFlags & DDS_LOADER_GENERATE_MIPS)) // Must have context and shader-view to auto generate mipmaps
 		{
 			// See if format is supported for auto-gen mipmaps (varies by feature level)
 			UINT fmtSupport = 0;
@@ -1634,6 +1385,18 @@ namespace
 				return E_OUTOFMEMORY;
 			}
 
+			// Without the hardware support for a block-compressed format, it is decoded on the CPU
+			const bool decode = NeedsDecoding(d3dDevice, format, resDim);
+			std::unique_ptr<uint8_t[]> decodedData;
+			DXGI_FORMAT resourceFormat = format;
+
+			// The mips the GPU can't generate are built on the CPU: when asked to, or when the caller
+			// passed a context for the autogen but the format doesn't support it
+			const bool generateMips = mipCount == 1 && resDim == D3D11_RESOURCE_DIMENSION_TEXTURE2D
+									  && ((loadFlags & DDS_LOADER_GENERATE_MIPS) || (d3dContext && textureView));
+			std::unique_ptr<uint8_t[]> mipData;
+			size_t resourceMips = mipCount;
+
 			size_t skipMip = 0;
 			size_t twidth = 0;
 			size_t theight = 0;
@@ -1641,12 +1404,24 @@ namespace
 			hr = FillInitData(width, height, depth, mipCount, arraySize,
 							  format, maxsize, bitSize, bitData,
 							  twidth, theight, tdepth, skipMip, initData.get());
+			if (SUCCEEDED(hr) && decode)
+			{
+				hr = DecodeInitData(format, twidth, theight, tdepth, mipCount - skipMip, arraySize,
+									initData.get(), decodedData, resourceFormat);
+			}
+			MipFormat mipFormat;
+			bool srgb;
+			if (SUCCEEDED(hr) && generateMips && MipGenerator::fromDXGIFormat(static_cast<uint32_t>(resourceFormat), mipFormat, srgb))
+			{
+				hr = GenerateMipInitData(resourceFormat, twidth, theight, arraySize, loadFlags,
+										 initData, mipData, resourceMips);
+			}
 
 			if (SUCCEEDED(hr))
 			{
 				hr = CreateD3DResources(d3dDevice,
-										resDim, twidth, theight, tdepth, mipCount - skipMip, arraySize,
-										format,
+										resDim, twidth, theight, tdepth, resourceMips - skipMip, arraySize,
+										resourceFormat,
 										usage, bindFlags, cpuAccessFlags, miscFlags,
 										loadFlags,
 										isCubeMap,
@@ -1687,11 +1462,16 @@ namespace
 
 					hr = FillInitData(width, height, depth, mipCount, arraySize, format, maxsize, bitSize, bitData,
 									  twidth, theight, tdepth, skipMip, initData.get());
+					if (SUCCEEDED(hr) && decode)
+					{
+						hr = DecodeInitData(format, twidth, theight, tdepth, mipCount - skipMip, arraySize,
+											initData.get(), decodedData, resourceFormat);
+					}
 					if (SUCCEEDED(hr))
 					{
 						hr = CreateD3DResources(d3dDevice,
 												resDim, twidth, theight, tdepth, mipCount - skipMip, arraySize,
-												format,
+												resourceFormat,
 												usage, bindFlags, cpuAccessFlags, miscFlags,
 												loadFlags,
 												isCubeMap,
@@ -2038,7 +1818,8 @@ HRESULT DirectX::CreateDDSTextureFromFileEx(
 										 ddsData,
 										 &header,
 										 &bitData,
-										 &bitSize
+										 &bitSize,
+										 maxsize
 	);
 	if (FAILED(hr))
 	{
@@ -43,6 +43,8 @@ namespace DirectX
 		DDS_LOADER_DEFAULT = 0,
 		DDS_LOADER_FORCE_SRGB = 0x1,
 		DDS_LOADER_IGNORE_SRGB = 0x2,
+		DDS_LOADER_GENERATE_MIPS = 0x10,
+		DDS_LOADER_MIP_FILTER_KAISER = 0x20,
 	};
 
 #ifdef __clang__
@@ -57,6 +59,19 @@ namespace DirectX
 #endif
 #endif
 
+	// When the device can't sample a block-compressed format, it is decoded on the CPU (BCDecoder)
+	// and the texture is created as R8G8B8A8 or R16G16B16A16_FLOAT instead
+	//
+	// A 2D texture without mips gets them generated on the CPU (MipGenerator) when DDS_LOADER_GENERATE_MIPS
+	// is set, or when a context is passed but the format doesn't support MIP_AUTOGEN. Only R8G8B8A8,
+	// B8G8R8A8/X8 and R16G16B16A16_FLOAT (the decoded block-compressed formats included) are filtered;
+	// the sRGB ones are filtered in the linear space. DDS_LOADER_MIP_FILTER_KAISER picks the sharper filter
+	//
+	// With maxsize set, the file versions read the headers first and then only the mips that survive maxsize
+	//
+	// The supercompressed files (DDSCompression) are read whole by the file versions and expanded, the
+	// subresources that survive maxsize decompressed in parallel. The memory versions fail on them
+
 	// Standard version
 	HRESULT CreateDDSTextureFromMemory(
 			_In_ ID3D11Device* d3dDevice,
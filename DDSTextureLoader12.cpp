@@ -15,15 +15,25 @@
 //--------------------------------------------------------------------------------------
 
 #include "DDSTextureLoader12.h"
+#include "BCDecoder.h"
+#include "MipGenerator.h"
+#include "AsyncFileReader.h"
+#include "DDSCompression.h"
+#include "DDSParser.h"
+#include "DXGIFormatTraits.h"
 
 #include <algorithm>
 #include <cassert>
+#include <filesystem>
 #include <memory>
 #include <new>
 
 #ifndef _WIN32
 #include <fstream>
-#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #endif
 
 #ifdef _MSC_VER
@@ -76,6 +86,9 @@ using namespace DirectX;
 // HRESULT_FROM_WIN32(ERROR_INVALID_DATA)
 #define HRESULT_E_INVALID_DATA static_cast<HRESULT>(0x8007000DL)
 
+// E_PENDING, which the WSL headers don't have
+#define HRESULT_E_PENDING static_cast<HRESULT>(0x8000000AL)
+
 //--------------------------------------------------------------------------------------
 // DDS file structure definitions
 //
@@ -165,6 +178,11 @@ namespace
     inline HANDLE safe_handle(HANDLE h) noexcept { return (h == INVALID_HANDLE_VALUE) ? nullptr : h; }
 #endif
 
+    struct com_releaser { void operator()(IUnknown* p) noexcept { if (p) p->Release(); } };
+
+    template<class T>
+    using ScopedCom = std::unique_ptr<T, com_releaser>;
+
     #if !defined(NO_D3D12_DEBUG_NAME) && ( defined(_DEBUG) || defined(PROFILE) )
     template<UINT TNameLength>
     inline void SetDebugObjectName(_In_ ID3D12DeviceChild* resource, _In_z_ const wchar_t(&name)[TNameLength]) noexcept
@@ -194,6 +212,21 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------------------------
+    HRESULT HResultFromStatus(DDSStatus status) noexcept
+    {
+        switch (status)
+        {
+        case DDSStatus::OK:           return S_OK;
+        case DDSStatus::InvalidData:  return HRESULT_E_INVALID_DATA;
+        case DDSStatus::Truncated:    return HRESULT_E_HANDLE_EOF;
+        case DDSStatus::NotSupported: return HRESULT_E_NOT_SUPPORTED;
+        case DDSStatus::Overflow:     return HRESULT_E_ARITHMETIC_OVERFLOW;
+        default:                      return E_FAIL;
+        }
+    }
+
+
     //--------------------------------------------------------------------------------------
     HRESULT LoadTextureDataFromMemory(
         _In_reads_(ddsDataSize) const uint8_t* ddsData,
@@ -235,6 +268,12 @@ namespace
             return E_FAIL;
         }
 
+        // The supercompressed files need a buffer of their own to expand into, only the file loaders have one
+        if (hdr->reserved1[9] == DDSParser::SUPERCOMPRESSED_MAGIC)
+        {
+            return HRESULT_E_NOT_SUPPORTED;
+        }
+
         // Check for DX10 extension
         bool bDXT10Header = false;
         if ((hdr->ddspf.flags & DDS_FOURCC) &&
@@ -261,13 +300,122 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------------------------
+    // Reads size bytes at offset, all of them or it fails
+#ifdef _WIN32
+    HRESULT ReadFileRange(
+        HANDLE hFile,
+        size_t offset,
+        size_t size,
+        _Out_writes_bytes_(size) uint8_t* dst) noexcept
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        DWORD bytesRead = 0;
+        if (!ReadFile(hFile, dst, static_cast<DWORD>(size), &bytesRead, &overlapped))
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+        return (bytesRead < size) ? E_FAIL : S_OK;
+    }
+#else
+    HRESULT ReadFileRange(
+        std::ifstream& inFile,
+        size_t offset,
+        size_t size,
+        _Out_writes_bytes_(size) uint8_t* dst) noexcept
+    {
+        inFile.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        inFile.read(reinterpret_cast<char*>(dst), static_cast<std::streamsize>(size));
+        return inFile ? S_OK : E_FAIL;
+    }
+#endif
+
+
+    //--------------------------------------------------------------------------------------
+    // What to read of the file after its first headerSize bytes. All of it, unless maxsize drops some
+    // of the large mips: FillInitData never looks at those, so they stay on the disk and their part
+    // of ddsData is left uninitialized. The supercompressed files are read whole
+    HRESULT GetRangesToRead(
+        _In_reads_bytes_(headerSize) const uint8_t* ddsData,
+        size_t headerSize,
+        size_t fileSize,
+        size_t maxsize,
+        std::vector<DDSByteRange>& ranges) noexcept
+    {
+        try
+        {
+            DDSLayout layout;
+            if (maxsize
+                && DDSParser::parseHeader(ddsData, headerSize, layout) == DDSStatus::OK
+                && DDSParser::computeSubresources(layout, maxsize) == DDSStatus::OK
+                && !layout.supercompressed
+                && layout.skipMip > 0
+                && layout.headerSize + layout.dataSize <= fileSize)
+            {
+                ranges = DDSParser::getReadRanges(layout);
+                ranges.erase(ranges.begin());    // The headers, read already
+            }
+            else
+            {
+                ranges.assign(1, DDSByteRange{ headerSize, fileSize - headerSize });
+            }
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+        return S_OK;
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // A supercompressed file, read whole, to the raw one FillInitData expects. Only the subresources
+    // that survive maxsize are decompressed, each on its own core, straight to their place in the layout
+    HRESULT ExpandTextureData(
+        std::unique_ptr<uint8_t[]>& ddsData,
+        size_t& len,
+        size_t maxsize) noexcept
+    {
+        size_t expandedSize = 0;
+        DDSStatus status = DDSCompression::getExpandedSize(ddsData.get(), len, expandedSize);
+        if (status != DDSStatus::OK)
+            return HResultFromStatus(status);
+
+        std::unique_ptr<uint8_t[]> expanded(new (std::nothrow) uint8_t[expandedSize]);
+        if (!expanded)
+            return E_OUTOFMEMORY;
+
+        try
+        {
+            status = DDSCompression::expand(ddsData.get(), len, expanded.get(), maxsize);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return E_OUTOFMEMORY;
+        }
+        catch (...)
+        {
+            // The decompression threads couldn't start
+            return E_FAIL;
+        }
+        if (status != DDSStatus::OK)
+            return HResultFromStatus(status);
+
+        ddsData = std::move(expanded);
+        len = expandedSize;
+        return S_OK;
+    }
+
+
     //--------------------------------------------------------------------------------------
     HRESULT LoadTextureDataFromFile(
         _In_z_ const wchar_t* fileName,
         std::unique_ptr<uint8_t[]>& ddsData,
         const DDS_HEADER** header,
         const uint8_t** bitData,
-        size_t* bitSize) noexcept
+        size_t* bitSize,
+        size_t maxsize) noexcept
     {
         if (!header || !bitData || !bitSize)
         {
@@ -314,27 +462,26 @@ namespace
             return E_OUTOFMEMORY;
         }
 
-        // read the data in
-        DWORD bytesRead = 0;
-        if (!ReadFile(hFile.get(),
-            ddsData.get(),
-            fileInfo.EndOfFile.LowPart,
-            &bytesRead,
-            nullptr
-        ))
+        size_t len = fileInfo.EndOfFile.LowPart;
+
+        // read the headers in, then what the subresources need of the rest
+        const size_t headerSize = std::min(len, DDSParser::MAX_HEADER_SIZE);
+        std::vector<DDSByteRange> ranges;
+        HRESULT hr = ReadFileRange(hFile.get(), 0, headerSize, ddsData.get());
+        if (SUCCEEDED(hr))
         {
-            ddsData.reset();
-            return HRESULT_FROM_WIN32(GetLastError());
+            hr = GetRangesToRead(ddsData.get(), headerSize, len, maxsize, ranges);
         }
-
-        if (bytesRead < fileInfo.EndOfFile.LowPart)
+        for (size_t i = 0; SUCCEEDED(hr) && i < ranges.size(); ++i)
+        {
+            hr = ReadFileRange(hFile.get(), ranges[i].offset, ranges[i].size, ddsData.get() + ranges[i].offset);
+        }
+        if (FAILED(hr))
         {
             ddsData.reset();
-            return E_FAIL;
+            return hr;
         }
 
-        size_t len = fileInfo.EndOfFile.LowPart;
-
     #else // !WIN32
         std::ifstream inFile(std::filesystem::path(fileName), std::ios::in | std::ios::binary | std::ios::ate);
         if (!inFile)
@@ -352,25 +499,40 @@ namespace
         if (!ddsData)
             return E_OUTOFMEMORY;
 
-        inFile.seekg(0, std::ios::beg);
-        if (!inFile)
+        size_t len = fileLen;
+
+        // read the headers in, then what the subresources need of the rest
+        const size_t headerSize = std::min(len, DDSParser::MAX_HEADER_SIZE);
+        std::vector<DDSByteRange> ranges;
+        HRESULT hr = ReadFileRange(inFile, 0, headerSize, ddsData.get());
+        if (SUCCEEDED(hr))
         {
-            ddsData.reset();
-            return E_FAIL;
+            hr = GetRangesToRead(ddsData.get(), headerSize, len, maxsize, ranges);
         }
-
-        inFile.read(reinterpret_cast<char*>(ddsData.get()), fileLen);
-        if (!inFile)
+        for (size_t i = 0; SUCCEEDED(hr) && i < ranges.size(); ++i)
+        {
+            hr = ReadFileRange(inFile, ranges[i].offset, ranges[i].size, ddsData.get() + ranges[i].offset);
+        }
+        if (FAILED(hr))
         {
             ddsData.reset();
-            return E_FAIL;
+            return hr;
         }
 
         inFile.close();
-
-        size_t len = fileLen;
     #endif
 
+        // A supercompressed file goes on as the raw one would have
+        if (DDSCompression::isCompressed(ddsData.get(), len))
+        {
+            hr = ExpandTextureData(ddsData, len, maxsize);
+            if (FAILED(hr))
+            {
+                ddsData.reset();
+                return hr;
+            }
+        }
+
         // DDS files always start with the same magic number ("DDS ")
         auto const dwMagicNumber = *reinterpret_cast<const uint32_t*>(ddsData.get());
         if (dwMagicNumber != DDS_MAGIC)
@@ -420,149 +582,7 @@ namespace
     //--------------------------------------------------------------------------------------
     size_t BitsPerPixel(_In_ DXGI_FORMAT fmt) noexcept
     {
-        switch (fmt)
-        {
-        case DXGI_FORMAT_R32G32B32A32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32A32_FLOAT:
-        case DXGI_FORMAT_R32G32B32A32_UINT:
-        case DXGI_FORMAT_R32G32B32A32_SINT:
-            return 128;
-
-        case DXGI_FORMAT_R32G32B32_TYPELESS:
-        case DXGI_FORMAT_R32G32B32_FLOAT:
-        case DXGI_FORMAT_R32G32B32_UINT:
-        case DXGI_FORMAT_R32G32B32_SINT:
-            return 96;
-
-        case DXGI_FORMAT_R16G16B16A16_TYPELESS:
-        case DXGI_FORMAT_R16G16B16A16_FLOAT:
-        case DXGI_FORMAT_R16G16B16A16_UNORM:
-        case DXGI_FORMAT_R16G16B16A16_UINT:
-        case DXGI_FORMAT_R16G16B16A16_SNORM:
-        case DXGI_FORMAT_R16G16B16A16_SINT:
-        case DXGI_FORMAT_R32G32_TYPELESS:
-        case DXGI_FORMAT_R32G32_FLOAT:
-        case DXGI_FORMAT_R32G32_UINT:
-        case DXGI_FORMAT_R32G32_SINT:
-        case DXGI_FORMAT_R32G8X24_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-        case DXGI_FORMAT_Y416:
-        case DXGI_FORMAT_Y210:
-        case DXGI_FORMAT_Y216:
-            return 64;
-
-        case DXGI_FORMAT_R10G10B10A2_TYPELESS:
-        case DXGI_FORMAT_R10G10B10A2_UNORM:
-        case DXGI_FORMAT_R10G10B10A2_UINT:
-        case DXGI_FORMAT_R11G11B10_FLOAT:
-        case DXGI_FORMAT_R8G8B8A8_TYPELESS:
-        case DXGI_FORMAT_R8G8B8A8_UNORM:
-        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-        case DXGI_FORMAT_R8G8B8A8_UINT:
-        case DXGI_FORMAT_R8G8B8A8_SNORM:
-        case DXGI_FORMAT_R8G8B8A8_SINT:
-        case DXGI_FORMAT_R16G16_TYPELESS:
-        case DXGI_FORMAT_R16G16_FLOAT:
-        case DXGI_FORMAT_R16G16_UNORM:
-        case DXGI_FORMAT_R16G16_UINT:
-        case DXGI_FORMAT_R16G16_SNORM:
-        case DXGI_FORMAT_R16G16_SINT:
-        case DXGI_FORMAT_R32_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT:
-        case DXGI_FORMAT_R32_FLOAT:
-        case DXGI_FORMAT_R32_UINT:
-        case DXGI_FORMAT_R32_SINT:
-        case DXGI_FORMAT_R24G8_TYPELESS:
-        case DXGI_FORMAT_D24_UNORM_S8_UINT:
-        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-        case DXGI_FORMAT_R9G9B9E5_SHAREDEXP:
-        case DXGI_FORMAT_R8G8_B8G8_UNORM:
-        case DXGI_FORMAT_G8R8_G8B8_UNORM:
-        case DXGI_FORMAT_B8G8R8A8_UNORM:
-        case DXGI_FORMAT_B8G8R8X8_UNORM:
-        case DXGI_FORMAT_R10G10B10_XR_BIAS_A2_UNORM:
-        case DXGI_FORMAT_B8G8R8A8_TYPELESS:
-        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-        case DXGI_FORMAT_B8G8R8X8_TYPELESS:
-        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-        case DXGI_FORMAT_AYUV:
-        case DXGI_FORMAT_Y410:
-        case DXGI_FORMAT_YUY2:
-            return 32;
-
-        case DXGI_FORMAT_P010:
-        case DXGI_FORMAT_P016:
-        case DXGI_FORMAT_V408:
-            return 24;
-
-        case DXGI_FORMAT_R8G8_TYPELESS:
-        case DXGI_FORMAT_R8G8_UNORM:
-        case DXGI_FORMAT_R8G8_UINT:
-        case DXGI_FORMAT_R8G8_SNORM:
-        case DXGI_FORMAT_R8G8_SINT:
-        case DXGI_FORMAT_R16_TYPELESS:
-        case DXGI_FORMAT_R16_FLOAT:
-        case DXGI_FORMAT_D16_UNORM:
-        case DXGI_FORMAT_R16_UNORM:
-        case DXGI_FORMAT_R16_UINT:
-        case DXGI_FORMAT_R16_SNORM:
-        case DXGI_FORMAT_R16_SINT:
-        case DXGI_FORMAT_B5G6R5_UNORM:
-        case DXGI_FORMAT_B5G5R5A1_UNORM:
-        case DXGI_FORMAT_A8P8:
-        case DXGI_FORMAT_B4G4R4A4_UNORM:
-        case DXGI_FORMAT_P208:
-        case DXGI_FORMAT_V208:
-            return 16;
-
-        case DXGI_FORMAT_NV12:
-        case DXGI_FORMAT_420_OPAQUE:
-        case DXGI_FORMAT_NV11:
-            return 12;
-
-        case DXGI_FORMAT_R8_TYPELESS:
-        case DXGI_FORMAT_R8_UNORM:
-        case DXGI_FORMAT_R8_UINT:
-        case DXGI_FORMAT_R8_SNORM:
-        case DXGI_FORMAT_R8_SINT:
-        case DXGI_FORMAT_A8_UNORM:
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-        case DXGI_FORMAT_AI44:
-        case DXGI_FORMAT_IA44:
-        case DXGI_FORMAT_P8:
-            return 8;
-
-        case DXGI_FORMAT_R1_UNORM:
-            return 1;
-
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            return 4;
-
-        default:
-            return 0;
-        }
+        return DXGIFormatTraits::get(static_cast<DXGIFormat>(fmt)).bitsPerPixel;
     }
 
 
@@ -581,131 +601,13 @@ namespace
         uint64_t rowBytes = 0;
         uint64_t numRows = 0;
 
-        bool bc = false;
-        bool packed = false;
-        bool planar = false;
-        size_t bpe = 0;
-        switch (fmt)
-        {
-        case DXGI_FORMAT_BC1_TYPELESS:
-        case DXGI_FORMAT_BC1_UNORM:
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-        case DXGI_FORMAT_BC4_TYPELESS:
-        case DXGI_FORMAT_BC4_UNORM:
-        case DXGI_FORMAT_BC4_SNORM:
-            bc = true;
-            bpe = 8;
-            break;
-
-        case DXGI_FORMAT_BC2_TYPELESS:
-        case DXGI_FORMAT_BC2_UNORM:
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-        case DXGI_FORMAT_BC3_TYPELESS:
-        case DXGI_FORMAT_BC3_UNORM:
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-        case DXGI_FORMAT_BC5_TYPELESS:
-        case DXGI_FORMAT_BC5_UNORM:
-        case DXGI_FORMAT_BC5_SNORM:
-        case DXGI_FORMAT_BC6H_TYPELESS:
-        case DXGI_FORMAT_BC6H_UF16:
-        case DXGI_FORMAT_BC6H_SF16:
-        case DXGI_FORMAT_BC7_TYPELESS:
-        case DXGI_FORMAT_BC7_UNORM:
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            bc = true;
-            bpe = 16;
-            break;
-
-        case DXGI_FORMAT_R8G8_B8G8_UNORM:
-        case DXGI_FORMAT_G8R8_G8B8_UNORM:
-        case DXGI_FORMAT_YUY2:
-            packed = true;
-            bpe = 4;
-            break;
-
-        case DXGI_FORMAT_Y210:
-        case DXGI_FORMAT_Y216:
-            packed = true;
-            bpe = 8;
-            break;
-
-        case DXGI_FORMAT_NV12:
-        case DXGI_FORMAT_420_OPAQUE:
-            if ((height % 2) != 0)
-            {
-                // Requires a height alignment of 2.
-                return E_INVALIDARG;
-            }
-            planar = true;
-            bpe = 2;
-            break;
-
-        case DXGI_FORMAT_P208:
-            planar = true;
-            bpe = 2;
-            break;
-
-        case DXGI_FORMAT_P010:
-        case DXGI_FORMAT_P016:
-            if ((height % 2) != 0)
-            {
-                // Requires a height alignment of 2.
-                return E_INVALIDARG;
-            }
-            planar = true;
-            bpe = 4;
-            break;
-
-        default:
-            break;
-        }
-
-        if (bc)
-        {
-            uint64_t numBlocksWide = 0;
-            if (width > 0)
-            {
-                numBlocksWide = std::max<uint64_t>(1u, (uint64_t(width) + 3u) / 4u);
-            }
-            uint64_t numBlocksHigh = 0;
-            if (height > 0)
-            {
-                numBlocksHigh = std::max<uint64_t>(1u, (uint64_t(height) + 3u) / 4u);
-            }
-            rowBytes = numBlocksWide * bpe;
-            numRows = numBlocksHigh;
-            numBytes = rowBytes * numBlocksHigh;
-        }
-        else if (packed)
-        {
-            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-            numRows = uint64_t(height);
-            numBytes = rowBytes * height;
-        }
-        else if (fmt == DXGI_FORMAT_NV11)
-        {
-            rowBytes = ((uint64_t(width) + 3u) >> 2) * 4u;
-            numRows = uint64_t(height) * 2u; // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
-            numBytes = rowBytes * numRows;
-        }
-        else if (planar)
-        {
-            rowBytes = ((uint64_t(width) + 1u) >> 1) * bpe;
-            numBytes = (rowBytes * uint64_t(height)) + ((rowBytes * uint64_t(height) + 1u) >> 1);
-            numRows = height + ((uint64_t(height) + 1u) >> 1);
-        }
-        else
+        if (!DXGIFormatTraits::getSurfaceInfo(static_cast<DXGIFormat>(fmt), width, height, numBytes, rowBytes, numRows))
         {
-            const size_t bpp = BitsPerPixel(fmt);
-            if (!bpp)
-                return E_INVALIDARG;
-
-            rowBytes = (uint64_t(width) * bpp + 7u) / 8u; // round up to nearest byte
-            numRows = uint64_t(height);
-            numBytes = rowBytes * height;
+            // Unknown format, or a 4:2:0 format of an odd height
+            return E_INVALIDARG;
         }
 
-    #if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
+#if defined(_M_IX86) || defined(_M_ARM) || defined(_M_HYBRID_X86_ARM64)
         static_assert(sizeof(size_t) == 4, "Not a 32-bit platform!");
         if (numBytes > UINT32_MAX || rowBytes > UINT32_MAX || numRows > UINT32_MAX)
             return HRESULT_E_ARITHMETIC_OVERFLOW;
@@ -731,399 +633,58 @@ namespace
 
 
     //--------------------------------------------------------------------------------------
-#define ISBITMASK( r,g,b,a ) ( ddpf.RBitMask == r && ddpf.GBitMask == g && ddpf.BBitMask == b && ddpf.ABitMask == a )
-
     DXGI_FORMAT GetDXGIFormat(const DDS_PIXELFORMAT& ddpf) noexcept
     {
-        if (ddpf.flags & DDS_RGB)
-        {
-            // Note that sRGB formats are written using the "DX10" extended header
-
-            switch (ddpf.RGBBitCount)
-            {
-            case 32:
-                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
-                {
-                    return DXGI_FORMAT_R8G8B8A8_UNORM;
-                }
-
-                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000))
-                {
-                    return DXGI_FORMAT_B8G8R8A8_UNORM;
-                }
-
-                if (ISBITMASK(0x00ff0000, 0x0000ff00, 0x000000ff, 0))
-                {
-                    return DXGI_FORMAT_B8G8R8X8_UNORM;
-                }
-
-                // No DXGI format maps to ISBITMASK(0x000000ff,0x0000ff00,0x00ff0000,0) aka D3DFMT_X8B8G8R8
-
-                // Note that many common DDS reader/writers (including D3DX) swap the
-                // the RED/BLUE masks for 10:10:10:2 formats. We assume
-                // below that the 'backwards' header mask is being used since it is most
-                // likely written by D3DX. The more robust solution is to use the 'DX10'
-                // header extension and specify the DXGI_FORMAT_R10G10B10A2_UNORM format directly
-
-                // For 'correct' writers, this should be 0x000003ff,0x000ffc00,0x3ff00000 for RGB data
-                if (ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000))
-                {
-                    return DXGI_FORMAT_R10G10B10A2_UNORM;
-                }
-
-                // No DXGI format maps to ISBITMASK(0x000003ff,0x000ffc00,0x3ff00000,0xc0000000) aka D3DFMT_A2R10G10B10
-
-                if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
-                {
-                    return DXGI_FORMAT_R16G16_UNORM;
-                }
-
-                if (ISBITMASK(0xffffffff, 0, 0, 0))
-                {
-                    // Only 32-bit color channel format in D3D9 was R32F
-                    return DXGI_FORMAT_R32_FLOAT; // D3DX writes this out as a FourCC of 114
-                }
-                break;
-
-            case 24:
-                // No 24bpp DXGI formats aka D3DFMT_R8G8B8
-                break;
-
-            case 16:
-                if (ISBITMASK(0x7c00, 0x03e0, 0x001f, 0x8000))
-                {
-                    return DXGI_FORMAT_B5G5R5A1_UNORM;
-                }
-                if (ISBITMASK(0xf800, 0x07e0, 0x001f, 0))
-                {
-                    return DXGI_FORMAT_B5G6R5_UNORM;
-                }
+        return static_cast<DXGI_FORMAT>(DDSParser::legacyFormat({ ddpf.size, ddpf.flags, ddpf.fourCC, ddpf.RGBBitCount,
+                ddpf.RBitMask, ddpf.GBitMask, ddpf.BBitMask, ddpf.ABitMask }));
+    }
 
-                // No DXGI format maps to ISBITMASK(0x7c00,0x03e0,0x001f,0) aka D3DFMT_X1R5G5B5
 
-                if (ISBITMASK(0x0f00, 0x00f0, 0x000f, 0xf000))
-                {
-                    return DXGI_FORMAT_B4G4R4A4_UNORM;
-                }
+    //--------------------------------------------------------------------------------------
+    DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format) noexcept
+    {
+        return static_cast<DXGI_FORMAT>(DXGIFormatTraits::get(static_cast<DXGIFormat>(format)).srgb);
+    }
 
-                // NVTT versions 1.x wrote this as RGB instead of LUMINANCE
-                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-                {
-                    return DXGI_FORMAT_R8G8_UNORM;
-                }
-                if (ISBITMASK(0xffff, 0, 0, 0))
-                {
-                    return DXGI_FORMAT_R16_UNORM;
-                }
 
-                // No DXGI format maps to ISBITMASK(0x0f00,0x00f0,0x000f,0) aka D3DFMT_X4R4G4B4
+    //--------------------------------------------------------------------------------------
+    inline DXGI_FORMAT MakeLinear(_In_ DXGI_FORMAT format) noexcept
+    {
+        return static_cast<DXGI_FORMAT>(DXGIFormatTraits::get(static_cast<DXGIFormat>(format)).linear);
+    }
 
-                // No 3:3:2:8 or paletted DXGI formats aka D3DFMT_A8R3G3B2, D3DFMT_A8P8, etc.
-                break;
 
-            case 8:
-                // NVTT versions 1.x wrote this as RGB instead of LUMINANCE
-                if (ISBITMASK(0xff, 0, 0, 0))
-                {
-                    return DXGI_FORMAT_R8_UNORM;
-                }
+    //--------------------------------------------------------------------------------------
+    inline bool IsDepthStencil(DXGI_FORMAT fmt) noexcept
+    {
+        return DXGIFormatTraits::get(static_cast<DXGIFormat>(fmt)).depthStencil;
+    }
 
-                // No 3:3:2 or paletted DXGI formats aka D3DFMT_R3G3B2, D3DFMT_P8
-                break;
 
-            default:
-                return DXGI_FORMAT_UNKNOWN;
-            }
-        }
-        else if (ddpf.flags & DDS_LUMINANCE)
+    //--------------------------------------------------------------------------------------
+    inline void AdjustPlaneResource(
+        _In_ DXGI_FORMAT fmt,
+        _In_ size_t height,
+        _In_ size_t slicePlane,
+        _Inout_ D3D12_SUBRESOURCE_DATA& res) noexcept
+    {
+        switch (fmt)
         {
-            switch (ddpf.RGBBitCount)
+        case DXGI_FORMAT_NV12:
+        case DXGI_FORMAT_P010:
+        case DXGI_FORMAT_P016:
+            if (!slicePlane)
             {
-            case 16:
-                if (ISBITMASK(0xffff, 0, 0, 0))
-                {
-                    return DXGI_FORMAT_R16_UNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-                {
-                    return DXGI_FORMAT_R8G8_UNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-                break;
-
-            case 8:
-                if (ISBITMASK(0xff, 0, 0, 0))
-                {
-                    return DXGI_FORMAT_R8_UNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-
-                // No DXGI format maps to ISBITMASK(0x0f,0,0,0xf0) aka D3DFMT_A4L4
-
-                if (ISBITMASK(0x00ff, 0, 0, 0xff00))
-                {
-                    return DXGI_FORMAT_R8G8_UNORM; // Some DDS writers assume the bitcount should be 8 instead of 16
-                }
-                break;
-
-            default:
-                return DXGI_FORMAT_UNKNOWN;
+                // Plane 0
+                res.SlicePitch = res.RowPitch * static_cast<LONG>(height);
             }
-        }
-        else if (ddpf.flags & DDS_ALPHA)
-        {
-            if (8 == ddpf.RGBBitCount)
+            else
             {
-                return DXGI_FORMAT_A8_UNORM;
+                // Plane 1
+                res.pData = reinterpret_cast<const uint8_t*>(res.pData) + uintptr_t(res.RowPitch) * height;
+                res.SlicePitch = res.RowPitch * ((static_cast<LONG>(height) + 1) >> 1);
             }
-        }
-        else if (ddpf.flags & DDS_BUMPDUDV)
-        {
-            switch (ddpf.RGBBitCount)
-            {
-            case 32:
-                if (ISBITMASK(0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000))
-                {
-                    return DXGI_FORMAT_R8G8B8A8_SNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-                if (ISBITMASK(0x0000ffff, 0xffff0000, 0, 0))
-                {
-                    return DXGI_FORMAT_R16G16_SNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-
-                // No DXGI format maps to ISBITMASK(0x3ff00000, 0x000ffc00, 0x000003ff, 0xc0000000) aka D3DFMT_A2W10V10U10
-                break;
-
-            case 16:
-                if (ISBITMASK(0x00ff, 0xff00, 0, 0))
-                {
-                    return DXGI_FORMAT_R8G8_SNORM; // D3DX10/11 writes this out as DX10 extension
-                }
-                break;
-
-            default:
-                return DXGI_FORMAT_UNKNOWN;
-            }
-
-            // No DXGI format maps to DDPF_BUMPLUMINANCE aka D3DFMT_L6V5U5, D3DFMT_X8L8V8U8
-        }
-        else if (ddpf.flags & DDS_FOURCC)
-        {
-            if (MAKEFOURCC('D', 'X', 'T', '1') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC1_UNORM;
-            }
-            if (MAKEFOURCC('D', 'X', 'T', '3') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC2_UNORM;
-            }
-            if (MAKEFOURCC('D', 'X', 'T', '5') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC3_UNORM;
-            }
-
-            // While pre-multiplied alpha isn't directly supported by the DXGI formats,
-            // they are basically the same as these BC formats so they can be mapped
-            if (MAKEFOURCC('D', 'X', 'T', '2') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC2_UNORM;
-            }
-            if (MAKEFOURCC('D', 'X', 'T', '4') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC3_UNORM;
-            }
-
-            if (MAKEFOURCC('A', 'T', 'I', '1') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC4_UNORM;
-            }
-            if (MAKEFOURCC('B', 'C', '4', 'U') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC4_UNORM;
-            }
-            if (MAKEFOURCC('B', 'C', '4', 'S') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC4_SNORM;
-            }
-
-            if (MAKEFOURCC('A', 'T', 'I', '2') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC5_UNORM;
-            }
-            if (MAKEFOURCC('B', 'C', '5', 'U') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC5_UNORM;
-            }
-            if (MAKEFOURCC('B', 'C', '5', 'S') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_BC5_SNORM;
-            }
-
-            // BC6H and BC7 are written using the "DX10" extended header
-
-            if (MAKEFOURCC('R', 'G', 'B', 'G') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_R8G8_B8G8_UNORM;
-            }
-            if (MAKEFOURCC('G', 'R', 'G', 'B') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_G8R8_G8B8_UNORM;
-            }
-
-            if (MAKEFOURCC('Y', 'U', 'Y', '2') == ddpf.fourCC)
-            {
-                return DXGI_FORMAT_YUY2;
-            }
-
-            // Check for D3DFORMAT enums being set here
-            switch (ddpf.fourCC)
-            {
-            case 36: // D3DFMT_A16B16G16R16
-                return DXGI_FORMAT_R16G16B16A16_UNORM;
-
-            case 110: // D3DFMT_Q16W16V16U16
-                return DXGI_FORMAT_R16G16B16A16_SNORM;
-
-            case 111: // D3DFMT_R16F
-                return DXGI_FORMAT_R16_FLOAT;
-
-            case 112: // D3DFMT_G16R16F
-                return DXGI_FORMAT_R16G16_FLOAT;
-
-            case 113: // D3DFMT_A16B16G16R16F
-                return DXGI_FORMAT_R16G16B16A16_FLOAT;
-
-            case 114: // D3DFMT_R32F
-                return DXGI_FORMAT_R32_FLOAT;
-
-            case 115: // D3DFMT_G32R32F
-                return DXGI_FORMAT_R32G32_FLOAT;
-
-            case 116: // D3DFMT_A32B32G32R32F
-                return DXGI_FORMAT_R32G32B32A32_FLOAT;
-
-            // No DXGI format maps to D3DFMT_CxV8U8
-
-            default:
-                return DXGI_FORMAT_UNKNOWN;
-            }
-        }
-
-        return DXGI_FORMAT_UNKNOWN;
-    }
-
-#undef ISBITMASK
-
-
-    //--------------------------------------------------------------------------------------
-    DXGI_FORMAT MakeSRGB(_In_ DXGI_FORMAT format) noexcept
-    {
-        switch (format)
-        {
-        case DXGI_FORMAT_R8G8B8A8_UNORM:
-            return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
-
-        case DXGI_FORMAT_BC1_UNORM:
-            return DXGI_FORMAT_BC1_UNORM_SRGB;
-
-        case DXGI_FORMAT_BC2_UNORM:
-            return DXGI_FORMAT_BC2_UNORM_SRGB;
-
-        case DXGI_FORMAT_BC3_UNORM:
-            return DXGI_FORMAT_BC3_UNORM_SRGB;
-
-        case DXGI_FORMAT_B8G8R8A8_UNORM:
-            return DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
-
-        case DXGI_FORMAT_B8G8R8X8_UNORM:
-            return DXGI_FORMAT_B8G8R8X8_UNORM_SRGB;
-
-        case DXGI_FORMAT_BC7_UNORM:
-            return DXGI_FORMAT_BC7_UNORM_SRGB;
-
-        default:
-            return format;
-        }
-    }
-
-
-    //--------------------------------------------------------------------------------------
-    inline DXGI_FORMAT MakeLinear(_In_ DXGI_FORMAT format) noexcept
-    {
-        switch (format)
-        {
-        case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
-            return DXGI_FORMAT_R8G8B8A8_UNORM;
-
-        case DXGI_FORMAT_BC1_UNORM_SRGB:
-            return DXGI_FORMAT_BC1_UNORM;
-
-        case DXGI_FORMAT_BC2_UNORM_SRGB:
-            return DXGI_FORMAT_BC2_UNORM;
-
-        case DXGI_FORMAT_BC3_UNORM_SRGB:
-            return DXGI_FORMAT_BC3_UNORM;
-
-        case DXGI_FORMAT_B8G8R8A8_UNORM_SRGB:
-            return DXGI_FORMAT_B8G8R8A8_UNORM;
-
-        case DXGI_FORMAT_B8G8R8X8_UNORM_SRGB:
-            return DXGI_FORMAT_B8G8R8X8_UNORM;
-
-        case DXGI_FORMAT_BC7_UNORM_SRGB:
-            return DXGI_FORMAT_BC7_UNORM;
-
-        default:
-            return format;
-        }
-    }
-
-
-    //--------------------------------------------------------------------------------------
-    inline bool IsDepthStencil(DXGI_FORMAT fmt) noexcept
-    {
-        switch (fmt)
-        {
-        case DXGI_FORMAT_R32G8X24_TYPELESS:
-        case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
-        case DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS:
-        case DXGI_FORMAT_X32_TYPELESS_G8X24_UINT:
-        case DXGI_FORMAT_D32_FLOAT:
-        case DXGI_FORMAT_R24G8_TYPELESS:
-        case DXGI_FORMAT_D24_UNORM_S8_UINT:
-        case DXGI_FORMAT_R24_UNORM_X8_TYPELESS:
-        case DXGI_FORMAT_X24_TYPELESS_G8_UINT:
-        case DXGI_FORMAT_D16_UNORM:
-            return true;
-
-        default:
-            return false;
-        }
-    }
-
-
-    //--------------------------------------------------------------------------------------
-    inline void AdjustPlaneResource(
-        _In_ DXGI_FORMAT fmt,
-        _In_ size_t height,
-        _In_ size_t slicePlane,
-        _Inout_ D3D12_SUBRESOURCE_DATA& res) noexcept
-    {
-        switch (fmt)
-        {
-        case DXGI_FORMAT_NV12:
-        case DXGI_FORMAT_P010:
-        case DXGI_FORMAT_P016:
-            if (!slicePlane)
-            {
-                // Plane 0
-                res.SlicePitch = res.RowPitch * static_cast<LONG>(height);
-            }
-            else
-            {
-                // Plane 1
-                res.pData = reinterpret_cast<const uint8_t*>(res.pData) + uintptr_t(res.RowPitch) * height;
-                res.SlicePitch = res.RowPitch * ((static_cast<LONG>(height) + 1) >> 1);
-            }
-            break;
+            break;
 
         case DXGI_FORMAT_NV11:
             if (!slicePlane)
@@ -1253,6 +814,114 @@ namespace
     }
 
 
+    //--------------------------------------------------------------------------------------
+    // The block-compressed formats the device can't sample are decoded on the CPU
+    bool NeedsDecoding(
+        _In_ ID3D12Device* d3dDevice,
+        DXGI_FORMAT format,
+        D3D12_RESOURCE_DIMENSION resDim) noexcept
+    {
+        BCFormat bcFormat;
+        if (!BCDecoder::fromDXGIFormat(static_cast<uint32_t>(format), bcFormat))
+            return false;
+
+        const D3D12_FORMAT_SUPPORT1 required = (resDim == D3D12_RESOURCE_DIMENSION_TEXTURE3D)
+            ? D3D12_FORMAT_SUPPORT1_TEXTURE3D
+            : D3D12_FORMAT_SUPPORT1_TEXTURE2D;
+        D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport = { format, D3D12_FORMAT_SUPPORT1_NONE, D3D12_FORMAT_SUPPORT2_NONE };
+        return FAILED(d3dDevice->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport)))
+            || !(formatSupport.Support1 & required);
+    }
+
+
+    //--------------------------------------------------------------------------------------
+    // Replaces the block-compressed subresources filled by FillInitData with the decoded ones.
+    // The decoded pixels live in decodedData, which has to outlive the upload
+    HRESULT DecodeInitData(
+        DXGI_FORMAT format,
+        size_t width,
+        size_t height,
+        size_t depth,
+        size_t mipCount,
+        size_t arraySize,
+        std::vector<D3D12_SUBRESOURCE_DATA>& initData,
+        std::unique_ptr<uint8_t[]>& decodedData,
+        _Out_ DXGI_FORMAT& decodedFormat) noexcept
+    {
+        BCFormat bcFormat;
+        if (!BCDecoder::fromDXGIFormat(static_cast<uint32_t>(format), bcFormat))
+            return HRESULT_E_NOT_SUPPORTED;
+
+        if (initData.size() != mipCount * arraySize)
+            return E_UNEXPECTED;
+
+        const BCOutput output = BCDecoder::preferredOutput(bcFormat);
+        const size_t pixelBytes = BCDecoder::pixelBytes(output);
+
+        // All the decoded subresources share one allocation
+        size_t totalBytes = 0;
+        for (size_t j = 0; j < arraySize; j++)
+        {
+            size_t w = width, h = height, d = depth;
+            for (size_t i = 0; i < mipCount; i++)
+            {
+                totalBytes += w * h * d * pixelBytes;
+                w = std::max<size_t>(w >> 1, 1);
+                h = std::max<size_t>(h >> 1, 1);
+                d = std::max<size_t>(d >> 1, 1);
+            }
+        }
+
+        std::unique_ptr<uint8_t[]> decoded(new (std::nothrow) uint8_t[totalBytes]);
+        if (!decoded)
+            return E_OUTOFMEMORY;
+
+        try
+        {
+            uint8_t* pDstBits = decoded.get();
+            for (size_t j = 0; j < arraySize; j++)
+            {
+                size_t w = width, h = height, d = depth;
+                for (size_t i = 0; i < mipCount; i++)
+                {
+                    D3D12_SUBRESOURCE_DATA& res = initData[j * mipCount + i];
+                    const size_t rowBytes = w * pixelBytes;
+                    const size_t numBytes = rowBytes * h;
+                    for (size_t slice = 0; slice < d; slice++)
+                    {
+                        BCDecoder::decode(bcFormat,
+                            static_cast<const uint8_t*>(res.pData) + slice * static_cast<size_t>(res.SlicePitch),
+                            static_cast<size_t>(res.RowPitch),
+                            w, h,
+                            output, pDstBits + slice * numBytes, rowBytes);
+                    }
+
+                    res.pData = pDstBits;
+                    res.RowPitch = static_cast<LONG_PTR>(rowBytes);
+                    res.SlicePitch = static_cast<LONG_PTR>(numBytes);
+                    pDstBits += numBytes * d;
+
+                    w = std::max<size_t>(w >> 1, 1);
+                    h = std::max<size_t>(h >> 1, 1);
+                    d = std::max<size_t>(d >> 1, 1);
+                }
+            }
+        }
+        catch (...)
+        {
+            // The decoder threads couldn't start
+            return E_FAIL;
+        }
+
+        decodedData = std::move(decoded);
+        if (output == BCOutput::RGBA16F)
+            decodedFormat = DXGI_FORMAT_R16G16B16A16_FLOAT;
+        else
+            decodedFormat = (MakeLinear(format) != format) ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+        return S_OK;
+    }
+
+
     //--------------------------------------------------------------------------------------
     HRESULT CreateTextureResource(
         _In_ ID3D12Device* d3dDevice,
@@ -1322,7 +991,8 @@ namespace
         DDS_LOADER_FLAGS loadFlags,
         _Outptr_ ID3D12Resource** texture,
         std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
-        _Out_opt_ bool* outIsCubeMap) noexcept(false)
+        _Out_opt_ bool* outIsCubeMap,
+        _Out_opt_ std::unique_ptr<uint8_t[]>* ownedData = nullptr) noexcept(false)
     {
         HRESULT hr = S_OK;
 
@@ -1554,6 +1224,16 @@ namespace
 
         subresources.reserve(numberOfResources);
 
+        // Without the hardware support for a block-compressed format, it is decoded on the CPU.
+        // Only when the caller can keep the decoded pixels alive until the upload
+        const bool decode = ownedData && NeedsDecoding(d3dDevice, format, resDim);
+        DXGI_FORMAT resourceFormat = format;
+
+        // Direct3D 12 has no GenerateMips, so the missing mips are built on the CPU. Same condition
+        const bool generateMips = ownedData && (loadFlags & DDS_LOADER_GENERATE_MIPS)
+            && mipCount == 1 && numberOfPlanes == 1 && resDim == D3D12_RESOURCE_DIMENSION_TEXTURE2D;
+        size_t resourceMips = mipCount;
+
         size_t skipMip = 0;
         size_t twidth = 0;
         size_t theight = 0;
@@ -1562,10 +1242,31 @@ namespace
             numberOfPlanes, format,
             maxsize, bitSize, bitData,
             twidth, theight, tdepth, skipMip, subresources);
+        if (SUCCEEDED(hr) && decode)
+        {
+            hr = DecodeInitData(format, twidth, theight, tdepth, mipCount - skipMip, arraySize,
+                subresources, *ownedData, resourceFormat);
+        }
+        MipFormat mipFormat;
+        bool srgb;
+        if (SUCCEEDED(hr) && generateMips && MipGenerator::fromDXGIFormat(static_cast<uint32_t>(resourceFormat), mipFormat, srgb))
+        {
+            // The chains start with a copy of the level 0, so they replace the decoded pixels
+            std::vector<D3D12_SUBRESOURCE_DATA> chains;
+            std::unique_ptr<uint8_t[]> mipData;
+            hr = GenerateMipChain(resourceFormat, twidth, theight, subresources.data(), arraySize,
+                loadFlags, mipData, chains);
+            if (SUCCEEDED(hr))
+            {
+                subresources = std::move(chains);
+                *ownedData = std::move(mipData);
+                resourceMips = subresources.size() / arraySize;
+            }
+        }
 
         if (SUCCEEDED(hr))
         {
-            size_t reservedMips = mipCount;
+            size_t reservedMips = resourceMips;
             if (loadFlags & DDS_LOADER_MIP_RESERVE)
             {
                 reservedMips = std::min<size_t>(D3D12_REQ_MIP_LEVELS,
@@ -1573,7 +1274,7 @@ namespace
             }
 
             hr = CreateTextureResource(d3dDevice, resDim, twidth, theight, tdepth, reservedMips - skipMip, arraySize,
-                format, resFlags, loadFlags, texture);
+                resourceFormat, resFlags, loadFlags, texture);
 
             if (FAILED(hr) && !maxsize && (mipCount > 1))
             {
@@ -1588,10 +1289,15 @@ namespace
                     numberOfPlanes, format,
                     maxsize, bitSize, bitData,
                     twidth, theight, tdepth, skipMip, subresources);
+                if (SUCCEEDED(hr) && decode)
+                {
+                    hr = DecodeInitData(format, twidth, theight, tdepth, mipCount - skipMip, arraySize,
+                        subresources, *ownedData, resourceFormat);
+                }
                 if (SUCCEEDED(hr))
                 {
                     hr = CreateTextureResource(d3dDevice, resDim, twidth, theight, tdepth, mipCount - skipMip, arraySize,
-                        format, resFlags, loadFlags, texture);
+                        resourceFormat, resFlags, loadFlags, texture);
                 }
             }
         }
@@ -1599,6 +1305,8 @@ namespace
         if (FAILED(hr))
         {
             subresources.clear();
+            if (ownedData)
+                ownedData->reset();
         }
 
         return hr;
@@ -1657,9 +1365,144 @@ namespace
         UNREFERENCED_PARAMETER(texture);
     #endif
     }
+
 } // anonymous namespace
 
 
+//--------------------------------------------------------------------------------------
+// DDSFileMapping
+//--------------------------------------------------------------------------------------
+DirectX::DDSFileMapping::DDSFileMapping(DDSFileMapping&& other) noexcept :
+    m_data(other.m_data),
+    m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+DDSFileMapping& DirectX::DDSFileMapping::operator=(DDSFileMapping&& other) noexcept
+{
+    if (this != &other)
+    {
+        Close();
+        m_data = other.m_data;
+        m_size = other.m_size;
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+    return *this;
+}
+
+DirectX::DDSFileMapping::~DDSFileMapping()
+{
+    Close();
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::DDSFileMapping::Open(const wchar_t* fileName) noexcept
+{
+    Close();
+
+    if (!fileName)
+    {
+        return E_INVALIDARG;
+    }
+
+#ifdef _WIN32
+    ScopedHandle hFile(safe_handle(CreateFile2(
+        fileName,
+        GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING,
+        nullptr)));
+
+    if (!hFile)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    FILE_STANDARD_INFO fileInfo;
+    if (!GetFileInformationByHandleEx(hFile.get(), FileStandardInfo, &fileInfo, sizeof(fileInfo)))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    // File is too big for 32-bit allocation, so reject read
+    if (fileInfo.EndOfFile.HighPart > 0)
+    {
+        return E_FAIL;
+    }
+
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (fileInfo.EndOfFile.LowPart < (sizeof(uint32_t) + sizeof(DDS_HEADER)))
+    {
+        return E_FAIL;
+    }
+
+    // The view keeps the section alive, so neither handle is needed once it is mapped
+    ScopedHandle hMapping(CreateFileMappingW(hFile.get(), nullptr, PAGE_READONLY, 0, 0, nullptr));
+    if (!hMapping)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    const void* view = MapViewOfFile(hMapping.get(), FILE_MAP_READ, 0, 0, 0);
+    if (!view)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = fileInfo.EndOfFile.LowPart;
+#else // !WIN32
+    const int fd = open(std::filesystem::path(fileName).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return E_FAIL;
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return E_FAIL;
+    }
+
+    // Need at least enough data to fill the header and magic number to be a valid DDS
+    if (static_cast<uint64_t>(st.st_size) < (sizeof(uint32_t) + sizeof(DDS_HEADER))
+        || static_cast<uint64_t>(st.st_size) > UINT32_MAX)
+    {
+        close(fd);
+        return E_FAIL;
+    }
+
+    void* view = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return E_FAIL;
+
+    // The whole payload is consumed front to back by FillInitData and the upload
+    madvise(view, size_t(st.st_size), MADV_SEQUENTIAL);
+
+    m_data = static_cast<const uint8_t*>(view);
+    m_size = size_t(st.st_size);
+#endif
+
+    return S_OK;
+}
+
+void DirectX::DDSFileMapping::Close() noexcept
+{
+    if (!m_data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+}
+
+
 //--------------------------------------------------------------------------------------
 _Use_decl_annotations_
 HRESULT DirectX::LoadDDSTextureFromMemory(
@@ -1813,13 +1656,116 @@ HRESULT DirectX::LoadDDSTextureFromFileEx(
         ddsData,
         &header,
         &bitData,
-        &bitSize
+        &bitSize,
+        maxsize
     );
     if (FAILED(hr))
     {
         return hr;
     }
 
+    std::unique_ptr<uint8_t[]> ownedData;
+    hr = CreateTextureFromDDS(d3dDevice,
+        header, bitData, bitSize, maxsize,
+        resFlags, loadFlags,
+        texture, subresources, isCubeMap, &ownedData);
+
+    if (SUCCEEDED(hr))
+    {
+        SetDebugTextureInfo(fileName, *texture);
+
+        if (alphaMode)
+            *alphaMode = GetAlphaMode(header);
+
+        // The subresources point to the decoded pixels or the generated mips now, and ddsData keeps them alive
+        if (ownedData)
+            ddsData = std::move(ownedData);
+    }
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::LoadDDSTextureFromFile(
+    ID3D12Device* d3dDevice,
+    const wchar_t* fileName,
+    ID3D12Resource** texture,
+    DDSFileMapping& ddsMapping,
+    std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+    size_t maxsize,
+    DDS_ALPHA_MODE* alphaMode,
+    bool* isCubeMap)
+{
+    return LoadDDSTextureFromFileEx(
+        d3dDevice,
+        fileName,
+        maxsize,
+        D3D12_RESOURCE_FLAG_NONE,
+        DDS_LOADER_DEFAULT,
+        texture,
+        ddsMapping,
+        subresources,
+        alphaMode,
+        isCubeMap);
+}
+
+_Use_decl_annotations_
+HRESULT DirectX::LoadDDSTextureFromFileEx(
+    ID3D12Device* d3dDevice,
+    const wchar_t* fileName,
+    size_t maxsize,
+    D3D12_RESOURCE_FLAGS resFlags,
+    DDS_LOADER_FLAGS loadFlags,
+    ID3D12Resource** texture,
+    DDSFileMapping& ddsMapping,
+    std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+    DDS_ALPHA_MODE* alphaMode,
+    bool* isCubeMap)
+{
+    if (texture)
+    {
+        *texture = nullptr;
+    }
+    if (alphaMode)
+    {
+        *alphaMode = DDS_ALPHA_MODE_UNKNOWN;
+    }
+    if (isCubeMap)
+    {
+        *isCubeMap = false;
+    }
+
+    if (!d3dDevice || !fileName || !texture)
+    {
+        return E_INVALIDARG;
+    }
+
+    HRESULT hr = ddsMapping.Open(fileName);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Validation is identical to the in-memory case, but the bits are never copied:
+    // FillInitData points the subresources straight into the mapped pages.
+    const DDS_HEADER* header = nullptr;
+    const uint8_t* bitData = nullptr;
+    size_t bitSize = 0;
+
+    hr = LoadTextureDataFromMemory(ddsMapping.data(),
+        ddsMapping.size(),
+        &header,
+        &bitData,
+        &bitSize
+    );
+    if (FAILED(hr))
+    {
+        ddsMapping.Close();
+        return hr;
+    }
+
     hr = CreateTextureFromDDS(d3dDevice,
         header, bitData, bitSize, maxsize,
         resFlags, loadFlags,
@@ -1832,6 +1778,818 @@ HRESULT DirectX::LoadDDSTextureFromFileEx(
         if (alphaMode)
             *alphaMode = GetAlphaMode(header);
     }
+    else
+    {
+        ddsMapping.Close();
+    }
 
     return hr;
 }
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::GenerateMipChain(
+    DXGI_FORMAT format,
+    size_t width,
+    size_t height,
+    const D3D12_SUBRESOURCE_DATA* topLevels,
+    size_t arraySize,
+    DDS_LOADER_FLAGS loadFlags,
+    std::unique_ptr<uint8_t[]>& mipData,
+    std::vector<D3D12_SUBRESOURCE_DATA>& subresources) noexcept
+{
+    mipData.reset();
+    subresources.clear();
+
+    if (!topLevels || !width || !height || !arraySize)
+        return E_INVALIDARG;
+
+    MipFormat mipFormat;
+    MipGenerator::Settings settings;
+    if (!MipGenerator::fromDXGIFormat(static_cast<uint32_t>(format), mipFormat, settings.srgb))
+        return HRESULT_E_NOT_SUPPORTED;
+
+    if (loadFlags & DDS_LOADER_FORCE_SRGB)
+        settings.srgb = true;
+    else if (loadFlags & DDS_LOADER_IGNORE_SRGB)
+        settings.srgb = false;
+    if (loadFlags & DDS_LOADER_MIP_FILTER_KAISER)
+        settings.filter = MipFilter::Kaiser;
+
+    const size_t mipCount = std::min<size_t>(D3D12_REQ_MIP_LEVELS, MipGenerator::countMips(width, height));
+    if (mipCount * arraySize > D3D12_REQ_SUBRESOURCES)
+        return E_INVALIDARG;
+
+    // All the chains share one allocation, one after another
+    std::vector<MipLevel> levels(mipCount);
+    const size_t chainBytes = MipGenerator::layoutChain(mipFormat, width, height, mipCount, levels.data());
+
+    std::unique_ptr<uint8_t[]> chains(new (std::nothrow) uint8_t[chainBytes * arraySize]);
+    if (!chains)
+        return E_OUTOFMEMORY;
+
+    try
+    {
+        subresources.reserve(mipCount * arraySize);
+        for (size_t j = 0; j < arraySize; j++)
+        {
+            uint8_t* chain = chains.get() + j * chainBytes;
+            MipGenerator::generate(mipFormat, settings,
+                static_cast<const uint8_t*>(topLevels[j].pData), static_cast<size_t>(topLevels[j].RowPitch),
+                mipCount, levels.data(), chain);
+
+            for (const MipLevel& level : levels)
+            {
+                D3D12_SUBRESOURCE_DATA res =
+                {
+                    chain + level.offset,
+                    static_cast<LONG_PTR>(level.rowPitch),
+                    static_cast<LONG_PTR>(level.slicePitch)
+                };
+                subresources.emplace_back(res);
+            }
+        }
+    }
+    catch (...)
+    {
+        // Out of memory, or the filter threads couldn't start
+        subresources.clear();
+        return E_FAIL;
+    }
+
+    mipData = std::move(chains);
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::UploadDDSTextureBatch(
+    ID3D12Device* d3dDevice,
+    ID3D12CommandQueue* commandQueue,
+    const std::vector<DDSBatchItem>& items,
+    D3D12_RESOURCE_FLAGS resFlags,
+    DDS_LOADER_FLAGS loadFlags,
+    std::vector<ID3D12Resource*>& textures) noexcept
+{
+    if (!d3dDevice || !commandQueue)
+        return E_INVALIDARG;
+
+    auto releaseAll = [&]()
+    {
+        for (auto& texture : textures)
+        {
+            if (texture) { texture->Release(); texture = nullptr; }
+        }
+    };
+
+    try
+    {
+        textures.assign(items.size(), nullptr);
+
+        // All the textures first, to know how much upload space the batch needs
+        std::vector<std::vector<D3D12_SUBRESOURCE_DATA>> subresources(items.size());
+        std::vector<UINT64> uploadOffsets(items.size());
+        UINT64 uploadSize = 0;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            const DDSBatchItem& item = items[i];
+            if (item.status != DDSStatus::OK)
+                continue;
+
+            const DDSLayout& layout = item.layout;
+            const DDSSubresource& top = layout.subresources[0];
+            ID3D12Resource* texture = nullptr;
+            if (FAILED(CreateTextureResource(d3dDevice, static_cast<D3D12_RESOURCE_DIMENSION>(layout.dimension),
+                top.width, top.height, top.depth, layout.getLoadedMips(), layout.arraySize,
+                static_cast<DXGI_FORMAT>(layout.format), resFlags, loadFlags, &texture)))
+            {
+                continue;
+            }
+            textures[i] = texture;
+
+            for (const DDSSubresource& sub : layout.subresources)
+            {
+                D3D12_SUBRESOURCE_DATA res =
+                {
+                    item.getPixels(sub),
+                    static_cast<LONG_PTR>(sub.rowPitch),
+                    static_cast<LONG_PTR>(sub.slicePitch)
+                };
+                subresources[i].emplace_back(res);
+            }
+
+            const UINT64 alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+            uploadOffsets[i] = uploadSize;
+            uploadSize += (GetRequiredIntermediateSize(texture, 0, static_cast<UINT>(subresources[i].size())) + alignment - 1)
+                & ~(alignment - 1);
+        }
+
+        if (uploadSize == 0)
+            return E_FAIL;
+
+        // One upload buffer, one command list and one fence wait for the whole batch
+        const CD3DX12_HEAP_PROPERTIES uploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+        const auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
+        ID3D12Resource* uploadRaw = nullptr;
+        HRESULT hr = d3dDevice->CreateCommittedResource(&uploadHeapProperties, D3D12_HEAP_FLAG_NONE, &uploadDesc,
+            D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_ID3D12Resource, reinterpret_cast<void**>(&uploadRaw));
+        ScopedCom<ID3D12Resource> upload(uploadRaw);
+
+        const D3D12_COMMAND_LIST_TYPE listType = commandQueue->GetDesc().Type;
+        ID3D12CommandAllocator* allocatorRaw = nullptr;
+        if (SUCCEEDED(hr))
+            hr = d3dDevice->CreateCommandAllocator(listType, IID_ID3D12CommandAllocator, reinterpret_cast<void**>(&allocatorRaw));
+        ScopedCom<ID3D12CommandAllocator> allocator(allocatorRaw);
+
+        ID3D12GraphicsCommandList* commandListRaw = nullptr;
+        if (SUCCEEDED(hr))
+            hr = d3dDevice->CreateCommandList(0, listType, allocator.get(), nullptr,
+                IID_ID3D12GraphicsCommandList, reinterpret_cast<void**>(&commandListRaw));
+        ScopedCom<ID3D12GraphicsCommandList> commandList(commandListRaw);
+
+        ID3D12Fence* fenceRaw = nullptr;
+        if (SUCCEEDED(hr))
+            hr = d3dDevice->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_ID3D12Fence, reinterpret_cast<void**>(&fenceRaw));
+        ScopedCom<ID3D12Fence> fence(fenceRaw);
+
+        if (FAILED(hr))
+        {
+            releaseAll();
+            return hr;
+        }
+
+        // The textures are created in COMMON and promoted to COPY_DEST by the copies
+        std::vector<D3D12_RESOURCE_BARRIER> barriers;
+        for (size_t i = 0; i < items.size(); i++)
+        {
+            if (!textures[i])
+                continue;
+
+            if (!UpdateSubresources(commandList.get(), textures[i], upload.get(), uploadOffsets[i],
+                0, static_cast<UINT>(subresources[i].size()), subresources[i].data()))
+            {
+                releaseAll();
+                return E_FAIL;
+            }
+
+            if (listType == D3D12_COMMAND_LIST_TYPE_DIRECT)
+            {
+                barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(textures[i],
+                    D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE));
+            }
+        }
+        if (!barriers.empty())
+            commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+        hr = commandList->Close();
+        if (SUCCEEDED(hr))
+        {
+            ID3D12CommandList* lists[] = { commandList.get() };
+            commandQueue->ExecuteCommandLists(1, lists);
+            hr = commandQueue->Signal(fence.get(), 1);
+        }
+        // A null event blocks until the fence gets there. The upload buffer has to live until then
+        if (SUCCEEDED(hr))
+            hr = fence->SetEventOnCompletion(1, nullptr);
+
+        if (FAILED(hr))
+            releaseAll();
+        return hr;
+    }
+    catch (...)
+    {
+        releaseAll();
+        return E_OUTOFMEMORY;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// DDSTextureStreamer
+//--------------------------------------------------------------------------------------
+DirectX::DDSTextureStreamer::DDSTextureStreamer(
+    ID3D12Device* d3dDevice,
+    ID3D12CommandQueue* commandQueue,
+    AsyncFileReader& reader,
+    MipStreamer::Settings settings) :
+    m_device(d3dDevice),
+    m_commandQueue(commandQueue),
+    m_reader(reader),
+    m_streamer(std::move(settings)),
+    m_reads(std::make_shared<ReadQueue>())
+{
+    assert(d3dDevice != nullptr && commandQueue != nullptr);
+    m_device->AddRef();
+    m_commandQueue->AddRef();
+}
+
+
+//--------------------------------------------------------------------------------------
+DirectX::DDSTextureStreamer::~DDSTextureStreamer()
+{
+    // The upload buffers and the allocators have to outlive the copies
+    if (m_fence && m_fence->GetCompletedValue() < m_fenceValue)
+        m_fence->SetEventOnCompletion(m_fenceValue, nullptr);
+
+    for (PendingUpload& upload : m_uploads)
+    {
+        upload.buffer->Release();
+        upload.allocator->Release();
+        for (ID3D12Resource* texture : upload.textures)
+            texture->Release();
+    }
+    for (ID3D12CommandAllocator* allocator : m_freeAllocators)
+        allocator->Release();
+    for (auto& entry : m_textures)
+    {
+        if (entry.second.texture)
+            entry.second.texture->Release();
+    }
+
+    if (m_commandList)
+        m_commandList->Release();
+    if (m_fence)
+        m_fence->Release();
+    m_commandQueue->Release();
+    m_device->Release();
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStreamer::Add(
+    const wchar_t* fileName,
+    size_t initialMaxSize,
+    float priority,
+    DDS_LOADER_FLAGS loadFlags,
+    MipStreamer::TextureId* id) noexcept
+{
+    if (id)
+    {
+        *id = 0;
+    }
+
+    if (!fileName || !id)
+        return E_INVALIDARG;
+
+    try
+    {
+        StreamedTexture streamed = {};
+        streamed.path = std::filesystem::path(fileName).string();
+        streamed.loadFlags = loadFlags;
+        streamed.priority = priority;
+        streamed.status = HRESULT_E_PENDING;
+
+        const MipStreamer::TextureId textureId = m_streamer.reserve();
+        const std::string path = streamed.path;
+        m_textures.emplace(textureId, std::move(streamed));
+
+        // The coarse tail of the chain, with the checks of the batch loader. The callback only
+        // queues it, Update creates the texture
+        std::shared_ptr<ReadQueue> reads = m_reads;
+        m_reader.readDDS(path, initialMaxSize,
+            [reads, textureId](DDSBatchItem tail)
+            {
+                std::lock_guard<std::mutex> lock(reads->mutex);
+                reads->tails.push_back({ textureId, std::move(tail) });
+            });
+
+        *id = textureId;
+        return S_OK;
+    }
+    catch (...)
+    {
+        return E_OUTOFMEMORY;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::DDSTextureStreamer::CreateStreamedTexture(
+    MipStreamer::TextureId id,
+    StreamedTexture& streamed,
+    const DDSBatchItem& tail)
+{
+    if (tail.status != DDSStatus::OK)
+        return HResultFromStatus(tail.status);
+
+    // The streamed levels are read straight from the file, the frames of a supercompressed one
+    // would need decompressing on the way
+    if (tail.layout.supercompressed)
+        return HRESULT_E_NOT_SUPPORTED;
+
+    // The whole chain is created, its subresources are where the streamed levels come from
+    DDSLayout layout = tail.layout;
+    const DDSStatus status = DDSParser::computeSubresources(layout);
+    if (status != DDSStatus::OK)
+        return HResultFromStatus(status);
+
+    const auto resDim = static_cast<D3D12_RESOURCE_DIMENSION>(layout.dimension);
+    const auto format = static_cast<DXGI_FORMAT>(layout.format);
+    if (NeedsDecoding(m_device, format, resDim))
+        return HRESULT_E_NOT_SUPPORTED;
+
+    const DDSSubresource& top = layout.subresources[0];
+    ID3D12Resource* resourceRaw = nullptr;
+    HRESULT hr = CreateTextureResource(m_device, resDim, top.width, top.height, top.depth,
+        layout.mipCount, layout.arraySize, format, D3D12_RESOURCE_FLAG_NONE, streamed.loadFlags, &resourceRaw);
+    if (FAILED(hr))
+        return hr;
+    ScopedCom<ID3D12Resource> resource(resourceRaw);
+
+    hr = CreateCommandList();
+    if (FAILED(hr))
+        return hr;
+
+    // The tail has the loaded mips of every item, item by item
+    const uint32_t loaded = tail.layout.getLoadedMips();
+    std::vector<UploadCopy> copies;
+    for (size_t k = 0; k < tail.layout.subresources.size(); k++)
+    {
+        const DDSSubresource& sub = tail.layout.subresources[k];
+        const size_t item = k / loaded;
+        const size_t mip = tail.layout.skipMip + k % loaded;
+        UploadCopy copy =
+        {
+            resource.get(),
+            static_cast<UINT>(item * layout.mipCount + mip),
+            { tail.getPixels(sub), static_cast<LONG_PTR>(sub.rowPitch), static_cast<LONG_PTR>(sub.slicePitch) }
+        };
+        copies.emplace_back(copy);
+    }
+
+    if (!m_streamer.add(id, layout, tail.layout.skipMip, streamed.priority))
+        return E_UNEXPECTED;
+    m_streamer.setWantedMip(id, streamed.wantedMip);
+
+    std::vector<MipStreamRequest> noRequests;
+    hr = SubmitCopies(copies, noRequests, true);
+    if (FAILED(hr))
+    {
+        m_streamer.remove(id);
+        return hr;
+    }
+
+    streamed.layout = std::move(layout);
+    streamed.texture = resource.release();
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::DDSTextureStreamer::Remove(MipStreamer::TextureId id) noexcept
+{
+    // The uploads in flight hold their own references, a tail still being read is dropped by Update
+    m_streamer.remove(id);
+
+    auto it = m_textures.find(id);
+    if (it == m_textures.end())
+        return;
+
+    if (it->second.texture)
+        it->second.texture->Release();
+    m_textures.erase(it);
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStreamer::GetStatus(MipStreamer::TextureId id) const noexcept
+{
+    auto it = m_textures.find(id);
+    return it != m_textures.end() ? it->second.status : E_INVALIDARG;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+ID3D12Resource* DirectX::DDSTextureStreamer::GetTexture(MipStreamer::TextureId id) const noexcept
+{
+    auto it = m_textures.find(id);
+    return it != m_textures.end() ? it->second.texture : nullptr;
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::DDSTextureStreamer::SetPriority(MipStreamer::TextureId id, float priority) noexcept
+{
+    auto it = m_textures.find(id);
+    if (it != m_textures.end())
+        it->second.priority = priority;
+    m_streamer.setPriority(id, priority);
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::DDSTextureStreamer::SetWantedMip(MipStreamer::TextureId id, uint32_t mip) noexcept
+{
+    auto it = m_textures.find(id);
+    if (it != m_textures.end())
+        it->second.wantedMip = mip;
+    m_streamer.setWantedMip(id, mip);
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+HRESULT DirectX::DDSTextureStreamer::Update(std::vector<MipStreamer::TextureId>& changed) noexcept
+{
+    changed.clear();
+
+    try
+    {
+        // The tails read since the last call, and the levels read after them
+        std::vector<TailResult> tails;
+        std::vector<ReadResult> results;
+        {
+            std::lock_guard<std::mutex> lock(m_reads->mutex);
+            tails.swap(m_reads->tails);
+            results.swap(m_reads->results);
+        }
+
+        // The new textures, each with its tail in a command list of its own. A failure stays in the
+        // status of the texture, the others go on
+        for (const TailResult& result : tails)
+        {
+            auto it = m_textures.find(result.id);
+            if (it == m_textures.end())
+                continue;    // Removed while the tail was read
+
+            it->second.status = CreateStreamedTexture(result.id, it->second, result.tail);
+            if (SUCCEEDED(it->second.status))
+                changed.push_back(result.id);
+        }
+
+        // The levels whose copies the GPU has finished become resident
+        const UINT64 completedValue = m_fence ? m_fence->GetCompletedValue() : 0;
+        while (!m_uploads.empty() && m_uploads.front().fenceValue <= completedValue)
+        {
+            PendingUpload upload = std::move(m_uploads.front());
+            m_uploads.pop_front();
+
+            for (const MipStreamRequest& request : upload.requests)
+            {
+                if (m_streamer.complete(request)
+                    && std::find(changed.begin(), changed.end(), request.texture) == changed.end())
+                {
+                    changed.push_back(request.texture);
+                }
+            }
+
+            upload.buffer->Release();
+            for (ID3D12Resource* texture : upload.textures)
+                texture->Release();
+            m_freeAllocators.push_back(upload.allocator);
+        }
+
+        // The levels read since the last call go up in one command list
+        std::vector<UploadCopy> copies;
+        std::vector<MipStreamRequest> requests;
+        for (ReadResult& result : results)
+        {
+            // Failed, or the texture was removed while the read was in flight
+            auto it = m_textures.find(result.request.texture);
+            if (result.error || it == m_textures.end())
+            {
+                m_streamer.fail(result.request);
+                continue;
+            }
+
+            const DDSLayout& layout = it->second.layout;
+            const uint32_t mip = result.request.mip;
+            size_t offset = 0;
+            for (size_t item = 0; item < result.request.ranges.size(); item++)
+            {
+                const DDSSubresource& sub = layout.subresources[item * layout.mipCount + mip];
+                UploadCopy copy =
+                {
+                    it->second.texture,
+                    static_cast<UINT>(item * layout.mipCount + mip),
+                    { result.data.data() + offset, static_cast<LONG_PTR>(sub.rowPitch), static_cast<LONG_PTR>(sub.slicePitch) }
+                };
+                copies.emplace_back(copy);
+                offset += result.request.ranges[item].size;
+            }
+            requests.push_back(result.request);
+        }
+
+        HRESULT hr = S_OK;
+        if (!copies.empty())
+        {
+            hr = CreateCommandList();
+            if (SUCCEEDED(hr))
+                hr = SubmitCopies(copies, requests, false);
+            if (FAILED(hr))
+            {
+                for (const MipStreamRequest& request : requests)
+                    m_streamer.fail(request);
+            }
+        }
+
+        // The next reads. The callbacks only queue the data, Update picks it up
+        for (MipStreamRequest& request : m_streamer.schedule())
+        {
+            const std::string& path = m_textures.at(request.texture).path;
+            std::vector<DDSByteRange> ranges = request.ranges;
+            std::shared_ptr<ReadQueue> reads = m_reads;
+            m_reader.readRanges(path, std::move(ranges),
+                [reads, request](int error, std::vector<uint8_t> data)
+                {
+                    std::lock_guard<std::mutex> lock(reads->mutex);
+                    reads->results.push_back({ request, error, std::move(data) });
+                });
+        }
+
+        return hr;
+    }
+    catch (...)
+    {
+        return E_OUTOFMEMORY;
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+_Use_decl_annotations_
+void DirectX::DDSTextureStreamer::CreateShaderResourceView(
+    MipStreamer::TextureId id,
+    D3D12_CPU_DESCRIPTOR_HANDLE descriptor) const noexcept
+{
+    auto it = m_textures.find(id);
+    if (it == m_textures.end())
+        return;
+
+    const DDSLayout& layout = it->second.layout;
+    const UINT mipLevels = layout.mipCount;
+    const float minLOD = GetMinLOD(id);
+
+    D3D12_SHADER_RESOURCE_VIEW_DESC desc = {};
+    desc.Format = it->second.texture->GetDesc().Format;    // With the sRGB flags applied
+    desc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+
+    switch (layout.dimension)
+    {
+    case DDSDimension::Texture1D:
+        if (layout.arraySize > 1)
+        {
+            desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1DARRAY;
+            desc.Texture1DArray.MipLevels = mipLevels;
+            desc.Texture1DArray.ArraySize = layout.arraySize;
+            desc.Texture1DArray.ResourceMinLODClamp = minLOD;
+        }
+        else
+        {
+            desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE1D;
+            desc.Texture1D.MipLevels = mipLevels;
+            desc.Texture1D.ResourceMinLODClamp = minLOD;
+        }
+        break;
+
+    case DDSDimension::Texture2D:
+        if (layout.cubeMap)
+        {
+            if (layout.arraySize > 6)
+            {
+                desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBEARRAY;
+                desc.TextureCubeArray.MipLevels = mipLevels;
+                desc.TextureCubeArray.NumCubes = layout.arraySize / 6;
+                desc.TextureCubeArray.ResourceMinLODClamp = minLOD;
+            }
+            else
+            {
+                desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+                desc.TextureCube.MipLevels = mipLevels;
+                desc.TextureCube.ResourceMinLODClamp = minLOD;
+            }
+        }
+        else if (layout.arraySize > 1)
+        {
+            desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DARRAY;
+            desc.Texture2DArray.MipLevels = mipLevels;
+            desc.Texture2DArray.ArraySize = layout.arraySize;
+            desc.Texture2DArray.ResourceMinLODClamp = minLOD;
+        }
+        else
+        {
+            desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            desc.Texture2D.MipLevels = mipLevels;
+            desc.Texture2D.ResourceMinLODClamp = minLOD;
+        }
+        break;
+
+    case DDSDimension::Texture3D:
+        desc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE3D;
+        desc.Texture3D.MipLevels = mipLevels;
+        desc.Texture3D.ResourceMinLODClamp = minLOD;
+        break;
+    }
+
+    m_device->CreateShaderResourceView(it->second.texture, &desc, descriptor);
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::DDSTextureStreamer::CreateCommandList()
+{
+    if (m_commandList)
+        return S_OK;
+
+    ID3D12CommandAllocator* allocatorRaw = nullptr;
+    HRESULT hr = m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+        IID_ID3D12CommandAllocator, reinterpret_cast<void**>(&allocatorRaw));
+    ScopedCom<ID3D12CommandAllocator> allocator(allocatorRaw);
+
+    ID3D12GraphicsCommandList* commandListRaw = nullptr;
+    if (SUCCEEDED(hr))
+        hr = m_device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, allocator.get(), nullptr,
+            IID_ID3D12GraphicsCommandList, reinterpret_cast<void**>(&commandListRaw));
+    ScopedCom<ID3D12GraphicsCommandList> commandList(commandListRaw);
+
+    // Closed, every submission resets it with an allocator of its own
+    if (SUCCEEDED(hr))
+        hr = commandList->Close();
+
+    ID3D12Fence* fenceRaw = nullptr;
+    if (SUCCEEDED(hr))
+        hr = m_device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_ID3D12Fence, reinterpret_cast<void**>(&fenceRaw));
+    ScopedCom<ID3D12Fence> fence(fenceRaw);
+
+    if (FAILED(hr))
+        return hr;
+
+    m_freeAllocators.push_back(allocator.get());
+    allocator.release();
+    m_commandList = commandList.release();
+    m_fence = fence.release();
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DirectX::DDSTextureStreamer::SubmitCopies(
+    const std::vector<UploadCopy>& copies,
+    std::vector<MipStreamRequest>& requests,
+    bool created)
+{
+    // Every subresource gets its own placement in one upload buffer
+    const UINT64 alignment = D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT;
+    std::vector<UINT64> uploadOffsets(copies.size());
+    std::vector<ID3D12Resource*> textures;
+    UINT64 uploadSize = 0;
+    for (size_t i = 0; i < copies.size(); i++)
+    {
+        uploadOffsets[i] = uploadSize;
+        uploadSize += (GetRequiredIntermediateSize(copies[i].texture, copies[i].subresource, 1) + alignment - 1)
+            & ~(alignment - 1);
+        if (std::find(textures.begin(), textures.end(), copies[i].texture) == textures.end())
+            textures.push_back(copies[i].texture);
+    }
+
+    // The bookkeeping first, so nothing can throw once the copies are submitted
+    m_uploads.emplace_back();
+
+    const CD3DX12_HEAP_PROPERTIES uploadHeapProperties(D3D12_HEAP_TYPE_UPLOAD);
+    const auto uploadDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadSize);
+    ID3D12Resource* uploadRaw = nullptr;
+    HRESULT hr = m_device->CreateCommittedResource(&uploadHeapProperties, D3D12_HEAP_FLAG_NONE, &uploadDesc,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_ID3D12Resource, reinterpret_cast<void**>(&uploadRaw));
+    ScopedCom<ID3D12Resource> upload(uploadRaw);
+
+    ID3D12CommandAllocator* allocatorRaw = nullptr;
+    if (SUCCEEDED(hr))
+    {
+        if (!m_freeAllocators.empty())
+        {
+            allocatorRaw = m_freeAllocators.back();
+            m_freeAllocators.pop_back();
+        }
+        else
+        {
+            hr = m_device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+                IID_ID3D12CommandAllocator, reinterpret_cast<void**>(&allocatorRaw));
+        }
+    }
+    ScopedCom<ID3D12CommandAllocator> allocator(allocatorRaw);
+
+    if (SUCCEEDED(hr))
+        hr = allocator->Reset();
+    if (SUCCEEDED(hr))
+        hr = m_commandList->Reset(allocator.get(), nullptr);
+    if (FAILED(hr))
+    {
+        m_uploads.pop_back();
+        return hr;
+    }
+
+    // The new textures go to COPY_DEST whole, the streamed levels one subresource at a time
+    // while the coarser ones keep being sampled
+    std::vector<D3D12_RESOURCE_BARRIER> barriers;
+    if (created)
+    {
+        for (ID3D12Resource* texture : textures)
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(texture,
+                D3D12_RESOURCE_STATE_COMMON, D3D12_RESOURCE_STATE_COPY_DEST));
+        }
+    }
+    else
+    {
+        for (const UploadCopy& copy : copies)
+        {
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(copy.texture,
+                D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST, copy.subresource));
+        }
+    }
+    m_commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    for (size_t i = 0; i < copies.size(); i++)
+    {
+        if (!UpdateSubresources(m_commandList, copies[i].texture, upload.get(), uploadOffsets[i],
+            copies[i].subresource, 1, &copies[i].data))
+        {
+            m_commandList->Close();
+            m_freeAllocators.push_back(allocator.release());
+            m_uploads.pop_back();
+            return E_FAIL;
+        }
+    }
+
+    // The same barriers the other way around
+    for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+        std::swap(barrier.Transition.StateBefore, barrier.Transition.StateAfter);
+    if (created)
+    {
+        for (D3D12_RESOURCE_BARRIER& barrier : barriers)
+            barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+    }
+    m_commandList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+
+    hr = m_commandList->Close();
+    if (SUCCEEDED(hr))
+    {
+        ID3D12CommandList* lists[] = { m_commandList };
+        m_commandQueue->ExecuteCommandLists(1, lists);
+        hr = m_commandQueue->Signal(m_fence, ++m_fenceValue);
+    }
+    if (FAILED(hr))
+    {
+        m_freeAllocators.push_back(allocator.release());
+        m_uploads.pop_back();
+        return hr;
+    }
+
+    PendingUpload& pending = m_uploads.back();
+    pending.fenceValue = m_fenceValue;
+    pending.requests = std::move(requests);
+    pending.buffer = upload.release();
+    pending.allocator = allocator.release();
+    for (ID3D12Resource* texture : textures)
+        texture->AddRef();
+    pending.textures = std::move(textures);
+    return S_OK;
+}
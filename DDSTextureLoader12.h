@@ -35,9 +35,16 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <deque>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include "DDSBatchLoader.h"
+#include "MipStreamer.h"
+
 
 namespace DirectX
 {
@@ -63,6 +70,8 @@ namespace DirectX
         DDS_LOADER_FORCE_SRGB = 0x1,
         DDS_LOADER_IGNORE_SRGB = 0x2,
         DDS_LOADER_MIP_RESERVE = 0x8,
+        DDS_LOADER_GENERATE_MIPS = 0x10,
+        DDS_LOADER_MIP_FILTER_KAISER = 0x20,
     };
 
 #ifdef __clang__
@@ -77,6 +86,46 @@ namespace DirectX
 #endif
 #endif
 
+    // Read-only view of a whole DDS file mapped into the address space (CreateFileMapping
+    // on Windows, mmap elsewhere). The subresources returned by the mapped loaders point
+    // straight into these pages, so the mapping must outlive the upload.
+    class DDSFileMapping
+    {
+    public:
+        DDSFileMapping() noexcept = default;
+        DDSFileMapping(DDSFileMapping&& other) noexcept;
+        DDSFileMapping& operator=(DDSFileMapping&& other) noexcept;
+        DDSFileMapping(const DDSFileMapping&) = delete;
+        DDSFileMapping& operator=(const DDSFileMapping&) = delete;
+        ~DDSFileMapping();
+
+        HRESULT __cdecl Open(_In_z_ const wchar_t* szFileName) noexcept;
+        void __cdecl Close() noexcept;
+
+        const uint8_t* data() const noexcept { return m_data; }
+        size_t size() const noexcept { return m_size; }
+
+    private:
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+    };
+
+    // When the device can't sample a block-compressed format, the overloads that own ddsData
+    // decode it on the CPU (BCDecoder) and create an R8G8B8A8 or R16G16B16A16_FLOAT texture.
+    // ddsData then holds the decoded pixels the subresources point to. The memory and the mapped
+    // overloads can't keep the decoded pixels alive, so they fail on such formats as before.
+    //
+    // With DDS_LOADER_GENERATE_MIPS, the same overloads build the missing mips of a 2D texture on
+    // the CPU (MipGenerator, see GenerateMipChain below) and ddsData holds the whole chain.
+    //
+    // With maxsize set, the file overload reading into ddsData reads the headers first and then only
+    // the mips that survive maxsize; the bytes of the skipped ones are left uninitialized in ddsData.
+    // The mapped overload never touches their pages either.
+    //
+    // The supercompressed files (DDSCompression, written by noflicker_dds_compress) are read whole by the
+    // overloads that own ddsData and expanded to the raw layout, the surviving subresources decompressed
+    // in parallel; ddsData then holds the raw file. The memory and the mapped overloads fail on them.
+
     // Standard version
     HRESULT __cdecl LoadDDSTextureFromMemory(
         _In_ ID3D12Device* d3dDevice,
@@ -98,6 +147,16 @@ namespace DirectX
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
         _Out_opt_ bool* isCubeMap = nullptr);
 
+    HRESULT __cdecl LoadDDSTextureFromFile(
+        _In_ ID3D12Device* d3dDevice,
+        _In_z_ const wchar_t* szFileName,
+        _Outptr_ ID3D12Resource** texture,
+        DDSFileMapping& ddsMapping,
+        std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+        size_t maxsize = 0,
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _Out_opt_ bool* isCubeMap = nullptr);
+
     // Extended version
     HRESULT __cdecl LoadDDSTextureFromMemoryEx(
         _In_ ID3D12Device* d3dDevice,
@@ -122,4 +181,173 @@ namespace DirectX
         std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
         _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
         _Out_opt_ bool* isCubeMap = nullptr);
+
+    HRESULT __cdecl LoadDDSTextureFromFileEx(
+        _In_ ID3D12Device* d3dDevice,
+        _In_z_ const wchar_t* szFileName,
+        size_t maxsize,
+        D3D12_RESOURCE_FLAGS resFlags,
+        DDS_LOADER_FLAGS loadFlags,
+        _Outptr_ ID3D12Resource** texture,
+        DDSFileMapping& ddsMapping,
+        std::vector<D3D12_SUBRESOURCE_DATA>& subresources,
+        _Out_opt_ DDS_ALPHA_MODE* alphaMode = nullptr,
+        _Out_opt_ bool* isCubeMap = nullptr);
+
+    // Creates the textures of a batch read by DDSBatchLoader and uploads all of them with a single command
+    // list on commandQueue, then waits for it. On a direct queue the textures end up in the
+    // PIXEL_SHADER_RESOURCE state, on a copy queue they decay to COMMON. textures[i] stays null for the items
+    // that failed to load or to create (no CPU decoding or mip generation here), the rest are the caller's
+    HRESULT __cdecl UploadDDSTextureBatch(
+        _In_ ID3D12Device* d3dDevice,
+        _In_ ID3D12CommandQueue* commandQueue,
+        const std::vector<DDSBatchItem>& items,
+        D3D12_RESOURCE_FLAGS resFlags,
+        DDS_LOADER_FLAGS loadFlags,
+        std::vector<ID3D12Resource*>& textures) noexcept;
+
+    // Builds the full mip chains of the 2D surfaces in topLevels (one per array item) on the CPU.
+    // Only R8G8B8A8, B8G8R8A8/X8 and R16G16B16A16_FLOAT are supported; the sRGB ones (and all of them
+    // with DDS_LOADER_FORCE_SRGB) are filtered in the linear space, DDS_LOADER_MIP_FILTER_KAISER picks
+    // the sharper filter. subresources receives arraySize chains, the level 0 included, in the
+    // subresource order UpdateSubresources expects. They point into mipData
+    HRESULT __cdecl GenerateMipChain(
+        DXGI_FORMAT format,
+        size_t width,
+        size_t height,
+        _In_reads_(arraySize) const D3D12_SUBRESOURCE_DATA* topLevels,
+        size_t arraySize,
+        DDS_LOADER_FLAGS loadFlags,
+        std::unique_ptr<uint8_t[]>& mipData,
+        std::vector<D3D12_SUBRESOURCE_DATA>& subresources) noexcept;
+
+    // Progressive mip streaming. Add returns an ID at once and reads the mips up to initialMaxSize in
+    // the background. The Update that picks them up creates the texture with its whole chain, uploads
+    // that tail and reports the texture, so the next frame can draw with it. Update then uploads the
+    // finer levels as the reader brings them in, in the order MipStreamer schedules them, and reports
+    // the textures whose min LOD clamp moved: CreateShaderResourceView rewrites a view clamped to the
+    // resident mips (ResourceMinLODClamp), or a shader takes GetMinLOD as the clamp argument of Sample.
+    // A view must not be rewritten while the frames in flight still use it.
+    //
+    // The uploads go to commandQueue, the direct queue that renders, so they are ordered before the
+    // frames that sample them and a level is reported only once the GPU is done with its upload.
+    // Neither Add nor Update waits for the GPU or the disk. Only the formats the device samples are
+    // supported (no CPU decoding or mip generation), and of the flags only DDS_LOADER_FORCE_SRGB and
+    // DDS_LOADER_IGNORE_SRGB. The supercompressed files aren't streamed.
+    //
+    // Not thread-safe: everything but the reads runs on the thread that calls Update.
+    class DDSTextureStreamer
+    {
+    public:
+        DDSTextureStreamer(
+            _In_ ID3D12Device* d3dDevice,
+            _In_ ID3D12CommandQueue* commandQueue,
+            AsyncFileReader& reader,
+            MipStreamer::Settings settings = MipStreamer::Settings());
+        DDSTextureStreamer(const DDSTextureStreamer&) = delete;
+        DDSTextureStreamer& operator=(const DDSTextureStreamer&) = delete;
+        // Waits for the uploads in flight. The reads in flight are dropped
+        ~DDSTextureStreamer();
+
+        // Queues the read of the tail and returns. GetStatus says when the texture is there
+        HRESULT __cdecl Add(
+            _In_z_ const wchar_t* fileName,
+            size_t initialMaxSize,
+            float priority,
+            DDS_LOADER_FLAGS loadFlags,
+            _Out_ MipStreamer::TextureId* id) noexcept;
+        // Also drops the tail read of a texture that isn't created yet
+        void __cdecl Remove(MipStreamer::TextureId id) noexcept;
+
+        // E_PENDING until an Update creates the texture, then S_OK, or why the tail didn't load
+        HRESULT __cdecl GetStatus(MipStreamer::TextureId id) const noexcept;
+        // The streamer's reference, nullptr before the texture is created. AddRef to keep it past Remove
+        ID3D12Resource* __cdecl GetTexture(MipStreamer::TextureId id) const noexcept;
+
+        // Kept for the textures that aren't created yet
+        void __cdecl SetPriority(MipStreamer::TextureId id, float priority) noexcept;
+        void __cdecl SetWantedMip(MipStreamer::TextureId id, uint32_t mip) noexcept;
+
+        // Once a frame: creates the textures whose tails were read, lands the uploads the GPU has finished,
+        // uploads the levels read since the last call and issues the next reads. changed receives the
+        // new textures and the ones whose min LOD moved
+        HRESULT __cdecl Update(std::vector<MipStreamer::TextureId>& changed) noexcept;
+
+        float GetMinLOD(MipStreamer::TextureId id) const noexcept { return static_cast<float>(m_streamer.getResidentMip(id)); }
+        void __cdecl CreateShaderResourceView(MipStreamer::TextureId id, D3D12_CPU_DESCRIPTOR_HANDLE descriptor) const noexcept;
+
+        const MipStreamer& GetScheduler() const noexcept { return m_streamer; }
+
+    private:
+        struct StreamedTexture
+        {
+            std::string path;
+            DDS_LOADER_FLAGS loadFlags;
+            float priority;
+            uint32_t wantedMip;
+            HRESULT status;             // E_PENDING while the tail is read
+            ID3D12Resource* texture;    // The streamer's reference, once created
+            DDSLayout layout;           // The whole chain, the subresource offsets in the file
+        };
+
+        struct TailResult
+        {
+            MipStreamer::TextureId id;
+            DDSBatchItem tail;
+        };
+
+        struct ReadResult
+        {
+            MipStreamRequest request;
+            int error;
+            std::vector<uint8_t> data;  // The ranges of the request, back to back
+        };
+
+        // Filled by the reader's threads, shared so the reads that outlive the streamer have somewhere to go
+        struct ReadQueue
+        {
+            std::mutex mutex;
+            std::vector<TailResult> tails;
+            std::vector<ReadResult> results;
+        };
+
+        struct UploadCopy
+        {
+            ID3D12Resource* texture;
+            UINT subresource;
+            D3D12_SUBRESOURCE_DATA data;
+        };
+
+        struct PendingUpload
+        {
+            UINT64 fenceValue;
+            std::vector<MipStreamRequest> requests;
+            ID3D12Resource* buffer;
+            ID3D12CommandAllocator* allocator;
+            std::vector<ID3D12Resource*> textures;    // Kept alive until the copies are done
+        };
+
+        ID3D12Device* m_device;
+        ID3D12CommandQueue* m_commandQueue;
+        AsyncFileReader& m_reader;
+        MipStreamer m_streamer;
+
+        std::map<MipStreamer::TextureId, StreamedTexture> m_textures;
+        std::shared_ptr<ReadQueue> m_reads;
+        std::deque<PendingUpload> m_uploads;
+        std::vector<ID3D12CommandAllocator*> m_freeAllocators;
+        ID3D12GraphicsCommandList* m_commandList = nullptr;
+        ID3D12Fence* m_fence = nullptr;
+        UINT64 m_fenceValue = 0;
+
+        // The command list and the fence, the first time they are needed
+        HRESULT CreateCommandList();
+        // The resource of a texture whose tail has landed, with the tail uploaded
+        HRESULT CreateStreamedTexture(MipStreamer::TextureId id, StreamedTexture& streamed, const DDSBatchItem& tail);
+        // One command list for the copies, fenced. created means new textures, all in the COMMON state,
+        // the others have their copied subresources in PIXEL_SHADER_RESOURCE. The requests move into
+        // the pending upload on success
+        HRESULT SubmitCopies(const std::vector<UploadCopy>& copies, std::vector<MipStreamRequest>& requests,
+            bool created);
+    };
 }
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "DXGIFormat.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+
+// How the texels of a format are laid out in a row
+enum class DXGIFormatLayout : uint8_t {
+	Unknown,    // Not a texture format
+	Linear,     // bitsPerPixel per texel
+	Block,      // 4x4 blocks of blockBytes (BC1 - BC7)
+	Packed,     // Pairs of texels in blockBytes (the packed 4:2:2 formats)
+	Planar,     // Pairs of luma texels in blockBytes, then the chroma rows at half the height (4:2:0, P208)
+	NV11,       // 4:1:1, Direct3D lays it out as two full-height planes
+};
+
+// What the loaders and the parser need to know of a DXGI format, one row per format.
+// The values are the ones of the DirectXTex tables the loaders came with.
+struct DXGIFormatTraits {
+	DXGIFormat format = DXGIFormat::UNKNOWN;
+	uint8_t bitsPerPixel = 0;     // Averaged over the blocks and the planes, 0 for the unknown formats
+	DXGIFormatLayout layout = DXGIFormatLayout::Unknown;
+	uint8_t blockBytes = 0;       // Of a 4x4 block or of a pair of texels, see the layout
+	uint8_t planes = 0;           // The Direct3D 12 plane count, the depth and the stencil are two
+	bool depthStencil = false;
+	bool evenHeight = false;      // The 4:2:0 formats need an even height
+	DXGIFormat typeless = DXGIFormat::UNKNOWN;    // The typeless format of the family, the format itself if none
+	DXGIFormat srgb = DXGIFormat::UNKNOWN;        // The sRGB variant, the format itself if none
+	DXGIFormat linear = DXGIFormat::UNKNOWN;      // The non-sRGB variant, the format itself if none
+
+	static constexpr const DXGIFormatTraits& get(DXGIFormat format);
+
+	// The sizes of a surface under the DDS and the Direct3D pitch rules. False for the unknown formats
+	// and the odd heights of the 4:2:0 formats
+	static constexpr bool getSurfaceInfo(DXGIFormat format, uint64_t width, uint64_t height,
+	                                     uint64_t& numBytes, uint64_t& rowBytes, uint64_t& numRows);
+};
+
+namespace DXGIFormatTable {
+
+using F = DXGIFormat;
+using L = DXGIFormatLayout;
+
+// The largest DXGIFormat value, plus one
+constexpr size_t COUNT = size_t(F::V408) + 1;
+
+constexpr DXGIFormatTraits row(F format, uint8_t bits, L layout, uint8_t blockBytes, uint8_t planes, F typeless) {
+	DXGIFormatTraits traits;
+	traits.format = format;
+	traits.bitsPerPixel = bits;
+	traits.layout = layout;
+	traits.blockBytes = blockBytes;
+	traits.planes = planes;
+	traits.typeless = typeless;
+	traits.srgb = traits.linear = format;
+	return traits;
+}
+
+constexpr DXGIFormatTraits linear(F format, uint8_t bits, F typeless) {
+	return row(format, bits, L::Linear, 0, 1, typeless);
+}
+
+constexpr DXGIFormatTraits linear(F format, uint8_t bits) {
+	return linear(format, bits, format);
+}
+
+// The BC formats: half a byte or a byte per texel
+constexpr DXGIFormatTraits block(F format, uint8_t blockBytes, F typeless) {
+	return row(format, uint8_t(blockBytes / 2), L::Block, blockBytes, 1, typeless);
+}
+
+constexpr DXGIFormatTraits packed(F format, uint8_t bits, uint8_t pairBytes) {
+	return row(format, bits, L::Packed, pairBytes, 1, format);
+}
+
+constexpr DXGIFormatTraits planar(F format, uint8_t bits, L layout, uint8_t pairBytes, bool evenHeight) {
+	DXGIFormatTraits traits = row(format, bits, layout, pairBytes, 2, format);
+	traits.evenHeight = evenHeight;
+	return traits;
+}
+
+constexpr DXGIFormatTraits depth(F format, uint8_t bits, uint8_t planes, F typeless) {
+	DXGIFormatTraits traits = row(format, bits, L::Linear, 0, planes, typeless);
+	traits.depthStencil = true;
+	return traits;
+}
+
+constexpr DXGIFormatTraits ROWS[] = {
+	linear(F::R32G32B32A32_TYPELESS, 128), linear(F::R32G32B32A32_FLOAT, 128, F::R32G32B32A32_TYPELESS),
+	linear(F::R32G32B32A32_UINT, 128, F::R32G32B32A32_TYPELESS), linear(F::R32G32B32A32_SINT, 128, F::R32G32B32A32_TYPELESS),
+
+	linear(F::R32G32B32_TYPELESS, 96), linear(F::R32G32B32_FLOAT, 96, F::R32G32B32_TYPELESS),
+	linear(F::R32G32B32_UINT, 96, F::R32G32B32_TYPELESS), linear(F::R32G32B32_SINT, 96, F::R32G32B32_TYPELESS),
+
+	linear(F::R16G16B16A16_TYPELESS, 64), linear(F::R16G16B16A16_FLOAT, 64, F::R16G16B16A16_TYPELESS),
+	linear(F::R16G16B16A16_UNORM, 64, F::R16G16B16A16_TYPELESS), linear(F::R16G16B16A16_UINT, 64, F::R16G16B16A16_TYPELESS),
+	linear(F::R16G16B16A16_SNORM, 64, F::R16G16B16A16_TYPELESS), linear(F::R16G16B16A16_SINT, 64, F::R16G16B16A16_TYPELESS),
+
+	linear(F::R32G32_TYPELESS, 64), linear(F::R32G32_FLOAT, 64, F::R32G32_TYPELESS),
+	linear(F::R32G32_UINT, 64, F::R32G32_TYPELESS), linear(F::R32G32_SINT, 64, F::R32G32_TYPELESS),
+
+	depth(F::R32G8X24_TYPELESS, 64, 2, F::R32G8X24_TYPELESS), depth(F::D32_FLOAT_S8X24_UINT, 64, 2, F::R32G8X24_TYPELESS),
+	depth(F::R32_FLOAT_X8X24_TYPELESS, 64, 2, F::R32G8X24_TYPELESS), depth(F::X32_TYPELESS_G8X24_UINT, 64, 2, F::R32G8X24_TYPELESS),
+
+	linear(F::R10G10B10A2_TYPELESS, 32), linear(F::R10G10B10A2_UNORM, 32, F::R10G10B10A2_TYPELESS),
+	linear(F::R10G10B10A2_UINT, 32, F::R10G10B10A2_TYPELESS),
+	linear(F::R11G11B10_FLOAT, 32),
+
+	linear(F::R8G8B8A8_TYPELESS, 32), linear(F::R8G8B8A8_UNORM, 32, F::R8G8B8A8_TYPELESS),
+	linear(F::R8G8B8A8_UNORM_SRGB, 32, F::R8G8B8A8_TYPELESS), linear(F::R8G8B8A8_UINT, 32, F::R8G8B8A8_TYPELESS),
+	linear(F::R8G8B8A8_SNORM, 32, F::R8G8B8A8_TYPELESS), linear(F::R8G8B8A8_SINT, 32, F::R8G8B8A8_TYPELESS),
+
+	linear(F::R16G16_TYPELESS, 32), linear(F::R16G16_FLOAT, 32, F::R16G16_TYPELESS),
+	linear(F::R16G16_UNORM, 32, F::R16G16_TYPELESS), linear(F::R16G16_UINT, 32, F::R16G16_TYPELESS),
+	linear(F::R16G16_SNORM, 32, F::R16G16_TYPELESS), linear(F::R16G16_SINT, 32, F::R16G16_TYPELESS),
+
+	linear(F::R32_TYPELESS, 32), depth(F::D32_FLOAT, 32, 1, F::R32_TYPELESS),
+	linear(F::R32_FLOAT, 32, F::R32_TYPELESS), linear(F::R32_UINT, 32, F::R32_TYPELESS), linear(F::R32_SINT, 32, F::R32_TYPELESS),
+
+	depth(F::R24G8_TYPELESS, 32, 2, F::R24G8_TYPELESS), depth(F::D24_UNORM_S8_UINT, 32, 2, F::R24G8_TYPELESS),
+	depth(F::R24_UNORM_X8_TYPELESS, 32, 2, F::R24G8_TYPELESS), depth(F::X24_TYPELESS_G8_UINT, 32, 2, F::R24G8_TYPELESS),
+
+	linear(F::R8G8_TYPELESS, 16), linear(F::R8G8_UNORM, 16, F::R8G8_TYPELESS), linear(F::R8G8_UINT, 16, F::R8G8_TYPELESS),
+	linear(F::R8G8_SNORM, 16, F::R8G8_TYPELESS), linear(F::R8G8_SINT, 16, F::R8G8_TYPELESS),
+
+	linear(F::R16_TYPELESS, 16), linear(F::R16_FLOAT, 16, F::R16_TYPELESS), depth(F::D16_UNORM, 16, 1, F::R16_TYPELESS),
+	linear(F::R16_UNORM, 16, F::R16_TYPELESS), linear(F::R16_UINT, 16, F::R16_TYPELESS),
+	linear(F::R16_SNORM, 16, F::R16_TYPELESS), linear(F::R16_SINT, 16, F::R16_TYPELESS),
+
+	linear(F::R8_TYPELESS, 8), linear(F::R8_UNORM, 8, F::R8_TYPELESS), linear(F::R8_UINT, 8, F::R8_TYPELESS),
+	linear(F::R8_SNORM, 8, F::R8_TYPELESS), linear(F::R8_SINT, 8, F::R8_TYPELESS),
+	linear(F::A8_UNORM, 8),
+	linear(F::R1_UNORM, 1),
+	linear(F::R9G9B9E5_SHAREDEXP, 32),
+	packed(F::R8G8_B8G8_UNORM, 32, 4), packed(F::G8R8_G8B8_UNORM, 32, 4),
+
+	block(F::BC1_TYPELESS, 8, F::BC1_TYPELESS), block(F::BC1_UNORM, 8, F::BC1_TYPELESS), block(F::BC1_UNORM_SRGB, 8, F::BC1_TYPELESS),
+	block(F::BC2_TYPELESS, 16, F::BC2_TYPELESS), block(F::BC2_UNORM, 16, F::BC2_TYPELESS), block(F::BC2_UNORM_SRGB, 16, F::BC2_TYPELESS),
+	block(F::BC3_TYPELESS, 16, F::BC3_TYPELESS), block(F::BC3_UNORM, 16, F::BC3_TYPELESS), block(F::BC3_UNORM_SRGB, 16, F::BC3_TYPELESS),
+	block(F::BC4_TYPELESS, 8, F::BC4_TYPELESS), block(F::BC4_UNORM, 8, F::BC4_TYPELESS), block(F::BC4_SNORM, 8, F::BC4_TYPELESS),
+	block(F::BC5_TYPELESS, 16, F::BC5_TYPELESS), block(F::BC5_UNORM, 16, F::BC5_TYPELESS), block(F::BC5_SNORM, 16, F::BC5_TYPELESS),
+
+	linear(F::B5G6R5_UNORM, 16), linear(F::B5G5R5A1_UNORM, 16),
+	linear(F::B8G8R8A8_UNORM, 32, F::B8G8R8A8_TYPELESS), linear(F::B8G8R8X8_UNORM, 32, F::B8G8R8X8_TYPELESS),
+	linear(F::R10G10B10_XR_BIAS_A2_UNORM, 32),
+	linear(F::B8G8R8A8_TYPELESS, 32), linear(F::B8G8R8A8_UNORM_SRGB, 32, F::B8G8R8A8_TYPELESS),
+	linear(F::B8G8R8X8_TYPELESS, 32), linear(F::B8G8R8X8_UNORM_SRGB, 32, F::B8G8R8X8_TYPELESS),
+
+	block(F::BC6H_TYPELESS, 16, F::BC6H_TYPELESS), block(F::BC6H_UF16, 16, F::BC6H_TYPELESS), block(F::BC6H_SF16, 16, F::BC6H_TYPELESS),
+	block(F::BC7_TYPELESS, 16, F::BC7_TYPELESS), block(F::BC7_UNORM, 16, F::BC7_TYPELESS), block(F::BC7_UNORM_SRGB, 16, F::BC7_TYPELESS),
+
+	// The video formats
+	linear(F::AYUV, 32), linear(F::Y410, 32), linear(F::Y416, 64),
+	planar(F::NV12, 12, L::Planar, 2, true), planar(F::P010, 24, L::Planar, 4, true), planar(F::P016, 24, L::Planar, 4, true),
+	planar(F::OPAQUE_420, 12, L::Planar, 2, true),
+	packed(F::YUY2, 32, 4), packed(F::Y210, 64, 8), packed(F::Y216, 64, 8),
+	planar(F::NV11, 12, L::NV11, 0, false),
+	linear(F::AI44, 8), linear(F::IA44, 8), linear(F::P8, 8), linear(F::A8P8, 16),
+	linear(F::B4G4R4A4_UNORM, 16),
+	// The pitches of V208 and V408 follow their bits per pixel, as the loaders always did
+	planar(F::P208, 16, L::Planar, 2, false), planar(F::V208, 16, L::Linear, 0, false), planar(F::V408, 24, L::Linear, 0, false),
+};
+
+// The formats with an sRGB variant, the linear one first
+constexpr F SRGB_PAIRS[][2] = {
+	{ F::R8G8B8A8_UNORM, F::R8G8B8A8_UNORM_SRGB }, { F::B8G8R8A8_UNORM, F::B8G8R8A8_UNORM_SRGB },
+	{ F::B8G8R8X8_UNORM, F::B8G8R8X8_UNORM_SRGB },
+	{ F::BC1_UNORM, F::BC1_UNORM_SRGB }, { F::BC2_UNORM, F::BC2_UNORM_SRGB }, { F::BC3_UNORM, F::BC3_UNORM_SRGB },
+	{ F::BC7_UNORM, F::BC7_UNORM_SRGB },
+};
+
+constexpr std::array<DXGIFormatTraits, COUNT> makeTable() {
+	std::array<DXGIFormatTraits, COUNT> table{};
+	for (size_t i = 0; i < COUNT; i++) {
+		table[i].format = table[i].typeless = table[i].srgb = table[i].linear = F(i);
+	}
+	for (const DXGIFormatTraits& traits : ROWS) table[size_t(traits.format)] = traits;
+	for (const auto& pair : SRGB_PAIRS) {
+		table[size_t(pair[0])].srgb = table[size_t(pair[1])].srgb = pair[1];
+		table[size_t(pair[0])].linear = table[size_t(pair[1])].linear = pair[0];
+	}
+	return table;
+}
+
+inline constexpr std::array<DXGIFormatTraits, COUNT> TABLE = makeTable();
+
+}
+
+constexpr const DXGIFormatTraits& DXGIFormatTraits::get(DXGIFormat format) {
+	// The numbers past the table are unknown formats
+	return size_t(format) < DXGIFormatTable::COUNT ? DXGIFormatTable::TABLE[size_t(format)] : DXGIFormatTable::TABLE[0];
+}
+
+constexpr bool DXGIFormatTraits::getSurfaceInfo(DXGIFormat format, uint64_t width, uint64_t height,
+                                                uint64_t& numBytes, uint64_t& rowBytes, uint64_t& numRows) {
+	const DXGIFormatTraits& traits = get(format);
+	switch (traits.layout) {
+		case DXGIFormatLayout::Block: {
+			const uint64_t blocksWide = width > 0 ? std::max<uint64_t>(1, (width + 3) / 4) : 0;
+			const uint64_t blocksHigh = height > 0 ? std::max<uint64_t>(1, (height + 3) / 4) : 0;
+			rowBytes = blocksWide * traits.blockBytes;
+			numRows = blocksHigh;
+			numBytes = rowBytes * blocksHigh;
+			return true;
+		}
+
+		case DXGIFormatLayout::Packed:
+			rowBytes = ((width + 1) >> 1) * traits.blockBytes;
+			numRows = height;
+			numBytes = rowBytes * height;
+			return true;
+
+		case DXGIFormatLayout::Planar:
+			if (traits.evenHeight && height % 2 != 0) return false;
+			rowBytes = ((width + 1) >> 1) * traits.blockBytes;
+			numBytes = rowBytes * height + ((rowBytes * height + 1) >> 1);
+			numRows = height + ((height + 1) >> 1);
+			return true;
+
+		case DXGIFormatLayout::NV11:
+			rowBytes = ((width + 3) >> 2) * 4;
+			numRows = height * 2;    // Direct3D makes this simplifying assumption, although it is larger than the 4:1:1 data
+			numBytes = rowBytes * numRows;
+			return true;
+
+		case DXGIFormatLayout::Linear:
+			rowBytes = (width * traits.bitsPerPixel + 7) / 8;    // Rounded up to the nearest byte
+			numRows = height;
+			numBytes = rowBytes * height;
+			return true;
+
+		case DXGIFormatLayout::Unknown:
+			break;
+	}
+	return false;
+}
+
+// The table pinned against the switch statements it replaced: every format, by its bits per pixel
+namespace DXGIFormatTable {
+
+constexpr bool hasBits(std::initializer_list<F> formats, uint8_t bits) {
+	for (F format : formats) {
+		if (DXGIFormatTraits::get(format).bitsPerPixel != bits) return false;
+	}
+	return true;
+}
+
+constexpr size_t countKnown() {
+	size_t known = 0;
+	for (const DXGIFormatTraits& traits : TABLE) known += traits.bitsPerPixel != 0;
+	return known;
+}
+
+constexpr bool isConsistent() {
+	for (size_t i = 0; i < COUNT; i++) {
+		const DXGIFormatTraits& traits = TABLE[i];
+		if (size_t(traits.format) != i) return false;
+		// Every format or none has a layout and bits, the typeless formats and the sRGB pairs are closed
+		if ((traits.layout == L::Unknown) != (traits.bitsPerPixel == 0)) return false;
+		if ((traits.layout == L::Unknown) != (traits.planes == 0)) return false;
+		if (DXGIFormatTraits::get(traits.typeless).typeless != traits.typeless) return false;
+		if (DXGIFormatTraits::get(traits.srgb).linear != traits.linear) return false;
+		if (DXGIFormatTraits::get(traits.linear).srgb != traits.srgb) return false;
+		if (traits.layout == L::Block && traits.bitsPerPixel * 16 != traits.blockBytes * 8) return false;
+	}
+	return true;
+}
+
+static_assert(isConsistent());
+static_assert(hasBits({ F::R32G32B32A32_TYPELESS, F::R32G32B32A32_FLOAT, F::R32G32B32A32_UINT, F::R32G32B32A32_SINT }, 128));
+static_assert(hasBits({ F::R32G32B32_TYPELESS, F::R32G32B32_FLOAT, F::R32G32B32_UINT, F::R32G32B32_SINT }, 96));
+static_assert(hasBits({
+	F::R16G16B16A16_TYPELESS, F::R16G16B16A16_FLOAT, F::R16G16B16A16_UNORM, F::R16G16B16A16_UINT, F::R16G16B16A16_SNORM,
+	F::R16G16B16A16_SINT, F::R32G32_TYPELESS, F::R32G32_FLOAT, F::R32G32_UINT, F::R32G32_SINT, F::R32G8X24_TYPELESS,
+	F::D32_FLOAT_S8X24_UINT, F::R32_FLOAT_X8X24_TYPELESS, F::X32_TYPELESS_G8X24_UINT, F::Y416, F::Y210, F::Y216 }, 64));
+static_assert(hasBits({
+	F::R10G10B10A2_TYPELESS, F::R10G10B10A2_UNORM, F::R10G10B10A2_UINT, F::R11G11B10_FLOAT, F::R8G8B8A8_TYPELESS,
+	F::R8G8B8A8_UNORM, F::R8G8B8A8_UNORM_SRGB, F::R8G8B8A8_UINT, F::R8G8B8A8_SNORM, F::R8G8B8A8_SINT, F::R16G16_TYPELESS,
+	F::R16G16_FLOAT, F::R16G16_UNORM, F::R16G16_UINT, F::R16G16_SNORM, F::R16G16_SINT, F::R32_TYPELESS, F::D32_FLOAT,
+	F::R32_FLOAT, F::R32_UINT, F::R32_SINT, F::R24G8_TYPELESS, F::D24_UNORM_S8_UINT, F::R24_UNORM_X8_TYPELESS,
+	F::X24_TYPELESS_G8_UINT, F::R9G9B9E5_SHAREDEXP, F::R8G8_B8G8_UNORM, F::G8R8_G8B8_UNORM, F::B8G8R8A8_UNORM,
+	F::B8G8R8X8_UNORM, F::R10G10B10_XR_BIAS_A2_UNORM, F::B8G8R8A8_TYPELESS, F::B8G8R8A8_UNORM_SRGB, F::B8G8R8X8_TYPELESS,
+	F::B8G8R8X8_UNORM_SRGB, F::AYUV, F::Y410, F::YUY2 }, 32));
+static_assert(hasBits({ F::P010, F::P016, F::V408 }, 24));
+static_assert(hasBits({
+	F::R8G8_TYPELESS, F::R8G8_UNORM, F::R8G8_UINT, F::R8G8_SNORM, F::R8G8_SINT, F::R16_TYPELESS, F::R16_FLOAT,
+	F::D16_UNORM, F::R16_UNORM, F::R16_UINT, F::R16_SNORM, F::R16_SINT, F::B5G6R5_UNORM, F::B5G5R5A1_UNORM, F::A8P8,
+	F::B4G4R4A4_UNORM, F::P208, F::V208 }, 16));
+static_assert(hasBits({ F::NV12, F::OPAQUE_420, F::NV11 }, 12));
+static_assert(hasBits({
+	F::R8_TYPELESS, F::R8_UNORM, F::R8_UINT, F::R8_SNORM, F::R8_SINT, F::A8_UNORM, F::BC2_TYPELESS, F::BC2_UNORM,
+	F::BC2_UNORM_SRGB, F::BC3_TYPELESS, F::BC3_UNORM, F::BC3_UNORM_SRGB, F::BC5_TYPELESS, F::BC5_UNORM, F::BC5_SNORM,
+	F::BC6H_TYPELESS, F::BC6H_UF16, F::BC6H_SF16, F::BC7_TYPELESS, F::BC7_UNORM, F::BC7_UNORM_SRGB,
+	F::AI44, F::IA44, F::P8 }, 8));
+static_assert(hasBits({ F::R1_UNORM }, 1));
+static_assert(hasBits({ F::BC1_TYPELESS, F::BC1_UNORM, F::BC1_UNORM_SRGB, F::BC4_TYPELESS, F::BC4_UNORM, F::BC4_SNORM }, 4));
+// The lists above are all the known formats: 4 + 4 + 17 + 38 + 3 + 18 + 3 + 24 + 1 + 6
+static_assert(countKnown() == 118);
+static_assert(hasBits({ F::UNKNOWN, F(116), F(129), F(1000) }, 0));
+
+static_assert(DXGIFormatTraits::get(F::BC1_UNORM).srgb == F::BC1_UNORM_SRGB);
+static_assert(DXGIFormatTraits::get(F::B8G8R8X8_UNORM_SRGB).linear == F::B8G8R8X8_UNORM);
+static_assert(DXGIFormatTraits::get(F::R16G16B16A16_FLOAT).srgb == F::R16G16B16A16_FLOAT);
+static_assert(DXGIFormatTraits::get(F::D24_UNORM_S8_UINT).typeless == F::R24G8_TYPELESS);
+static_assert(DXGIFormatTraits::get(F::D24_UNORM_S8_UINT).planes == 2 && DXGIFormatTraits::get(F::D32_FLOAT).planes == 1);
+static_assert(DXGIFormatTraits::get(F::NV12).planes == 2 && !DXGIFormatTraits::get(F::NV12).depthStencil);
+
+constexpr bool hasSurface(F format, uint64_t width, uint64_t height, uint64_t bytes, uint64_t row, uint64_t rows) {
+	uint64_t numBytes = 0, rowBytes = 0, numRows = 0;
+	return DXGIFormatTraits::getSurfaceInfo(format, width, height, numBytes, rowBytes, numRows) &&
+	       numBytes == bytes && rowBytes == row && numRows == rows;
+}
+
+static_assert(hasSurface(F::BC1_UNORM, 1, 1, 8, 8, 1) && hasSurface(F::BC7_UNORM, 10, 6, 96, 48, 2));
+static_assert(hasSurface(F::R8G8B8A8_UNORM, 3, 2, 24, 12, 2) && hasSurface(F::R1_UNORM, 9, 1, 2, 2, 1));
+static_assert(hasSurface(F::YUY2, 3, 2, 16, 8, 2) && hasSurface(F::NV12, 4, 2, 12, 4, 3));
+static_assert(hasSurface(F::NV11, 5, 2, 32, 8, 4) && hasSurface(F::V208, 2, 2, 8, 4, 2));
+static_assert(!hasSurface(F::NV12, 4, 3, 0, 0, 0) && hasSurface(F::P208, 4, 3, 18, 4, 5));
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "GraphicContents.h"
+
+#include <cmath>
+#include <span>
+#include <string>
+
+// The demo contents. Both Direct3D backends and the headless platform draw these
+
+class TriangleGraphicContents : public _GraphicContents<RGBAVertex> {
+private:
+    static constexpr float ROTATION_SPEED = 1.0f;     // Radians per second
+
+    int width = 0, height = 0;
+    float angle = 0;
+
+public:
+    void updateLayout(int width, int height) override {
+        this->width = width; this->height = height;
+
+        // Uncomment this fake resizing load here to see how the app handles it
+        // 100ms is a huge time pretty enough to recalculate even a very complicated layout
+        //
+        // Sleep(100);
+    }
+
+    void update(double deltaSeconds) override {
+        angle = fmodf(angle + ROTATION_SPEED * (float) deltaSeconds, 6.2831853f);
+    }
+
+    size_t getVertexCount() override {
+        return 3;
+    }
+
+    void writeVertices(std::span<RGBAVertex> dst) override {
+        float aspect = (float) width / (float) height;
+        float k = 760.f / (float) width;
+        float sin60 = sqrtf(3.f) / 2;
+		float d = 0.3f;
+        // Rotated in the pixel space, so the triangle keeps its shape whatever the aspect
+        float c = cosf(angle), s = sinf(angle);
+        auto x = [&](float u, float v) { return (u * c - v * s) * k; };
+        auto y = [&](float u, float v) { return (u * s + v * c) * aspect * k; };
+        dst[0] = {x(0.0f, 0.5f * sin60),   y(0.0f, 0.5f * sin60),   0.0f,  0.5f, 0.0f, 0.5f};
+        dst[1] = {x(0.5f, -0.5f * sin60),  y(0.5f, -0.5f * sin60),  0.0f,  0.5f + d, 1.0f, 0.5f};
+        dst[2] = {x(-0.5f, -0.5f * sin60), y(-0.5f, -0.5f * sin60), 0.0f,  0.5f - d, 1.0f, 0.5f};
+    }
+
+//	std::string getShader() override {
+//		return {
+//				"Texture2D txDiffuse : register( t0 );\n"
+//				"SamplerState samLinear : register( s0 );\n"
+//				"\n"
+//				"struct VSInput {\n"
+//				"	float4 position : POSITION;\n"
+//				"	float2 Tex  : TEXCOORD0;\n"
+//				"};\n"
+//				"struct PSInput {\n"
+//				"	float4 position : SV_POSITION;\n"
+//				"	float2 Tex  : TEXCOORD0;\n"
+//				"};\n"
+//				"PSInput VSMain(VSInput input) {\n"
+//				"	PSInput output;\n"
+//				"	output.position = input.position;\n"
+//				"	output.Tex = input.Tex;\n"
+//				"	return output;\n"
+//				"}\n"
+//				"float4 PSMain(PSInput input) : SV_TARGET {\n"
+//				"	 return txDiffuse.Sample( samLinear, input.Tex );\n"
+//				"}\n"
+//		};
+//	}
+    std::string getShader() override {
+        return {
+            "struct PSInput {\n"
+            "	float4 position : SV_POSITION;\n"
+            "	float4 color : COLOR;\n"
+            "};\n"
+            "PSInput VSMain(float4 position : POSITION0, float4 color : COLOR0) {\n"
+            "	PSInput result;\n"
+            "	result.position = position;\n"
+            "	result.color = color;\n"
+            "	return result;\n"
+            "}\n"
+            "float4 PSMain(PSInput input) : SV_TARGET {\n"
+            "	return input.color;\n"
+            "}\n"
+        };
+    }
+};
+class FullScreenImageGraphicContents : public _GraphicContents<TextureVertex> {
+private:
+	int width = 0, height = 0;
+
+public:
+	void updateLayout(int width, int height) override {
+		this->width = width; this->height = height;
+
+		// Uncomment this fake resizing load here to see how the app handles it
+		// 100ms is a huge time pretty enough to recalculate even a very complicated layout
+		//
+		//Sleep(100);
+	}
+
+	size_t getVertexCount() override {
+		return 6;
+	}
+
+	void writeVertices(std::span<TextureVertex> dst) override {
+		float aspect = (float) width / (float) height;
+		float k = 1;//760.f / (float) width;
+		//float sin60 = sqrtf(3.f) / 2;
+		dst[0] = {-1.0f * k,  1.0f * k,  0.0f,  0.0f, 0.0f};
+		dst[1] = { 1.0f * k,  1.0f * k,  0.0f,  1.0f, 0.0f};
+		dst[2] = { 1.0f * k, -1.0f * k,  0.0f,  1.0f, 1.0f};
+
+		dst[3] = {-1.0f * k, -1.0f * k,  0.0f,  0.0f, 1.0f};
+		dst[4] = { 1.0f * k, -1.0f * k,  0.0f,  1.0f, 1.0f};
+		dst[5] = {-1.0f * k,  1.0f * k,  0.0f,  0.0f, 0.0f};
+	}
+
+	std::string getShader() override {
+		return {
+			"Texture2D txDiffuse : register( t0 );\n"
+			    "SamplerState samLinear : register( s0 );\n"
+				"\n"
+				"struct VSInput {\n"
+				"	float4 position : POSITION;\n"
+				"	float2 Tex  : TEXCOORD0;\n"
+				"};\n"
+				"struct PSInput {\n"
+				"	float4 position : SV_POSITION;\n"
+				"	float2 Tex  : TEXCOORD0;\n"
+				"};\n"
+				"PSInput VSMain(VSInput input) {\n"
+				"	PSInput output;\n"
+				"	output.position = input.position;\n"
+				"	output.Tex = input.Tex;\n"
+				"	return output;\n"
+				"}\n"
+				"float4 PSMain(PSInput input) : SV_TARGET {\n"
+				"	 return txDiffuse.Sample( samLinear, input.Tex );\n"
+				"}\n"
+		};
+	}
+};
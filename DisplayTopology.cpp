@@ -0,0 +1,56 @@
+#include "DisplayTopology.h"
+
+#include <algorithm>
+#include <utility>
+
+DisplayTopology::DisplayTopology(std::vector<DisplayOutput> outputs) : outputs(std::move(outputs)) {
+	for (const auto& o : this->outputs) {
+		if (!o.attached) continue;
+		bounds.left = std::min(bounds.left, o.desktop.left);
+		bounds.top = std::min(bounds.top, o.desktop.top);
+		bounds.right = std::max(bounds.right, o.desktop.right);
+		bounds.bottom = std::max(bounds.bottom, o.desktop.bottom);
+
+		slabEdges.push_back(o.desktop.left);
+		slabEdges.push_back(o.desktop.right);
+	}
+
+	std::sort(slabEdges.begin(), slabEdges.end());
+	slabEdges.erase(std::unique(slabEdges.begin(), slabEdges.end()), slabEdges.end());
+
+	if (slabEdges.size() < 2) return;
+	slabs.resize(slabEdges.size() - 1);
+	for (size_t i = 0; i < this->outputs.size(); i++) {
+		const auto& o = this->outputs[i];
+		if (!o.attached) continue;
+		auto first = std::lower_bound(slabEdges.begin(), slabEdges.end(), o.desktop.left) - slabEdges.begin();
+		auto last = std::lower_bound(slabEdges.begin(), slabEdges.end(), o.desktop.right) - slabEdges.begin();
+		for (auto s = first; s < last; s++) slabs[s].push_back(i);
+	}
+
+	for (auto& slab : slabs) {
+		std::sort(slab.begin(), slab.end(), [this](size_t a, size_t b) {
+			return this->outputs[a].desktop.top < this->outputs[b].desktop.top;
+		});
+	}
+}
+
+int DisplayTopology::findOutputAt(long x, long y) const {
+	if (slabs.empty() || x < slabEdges.front() || x >= slabEdges.back()) return -1;
+
+	size_t s = std::upper_bound(slabEdges.begin(), slabEdges.end(), x) - slabEdges.begin() - 1;
+	const auto& slab = slabs[s];
+
+	// The last output that starts at or above y is the only candidate
+	auto it = std::upper_bound(slab.begin(), slab.end(), y, [this](long value, size_t i) {
+		return value < outputs[i].desktop.top;
+	});
+	if (it == slab.begin()) return -1;
+	--it;
+
+	return y < outputs[*it].desktop.bottom ? static_cast<int>(*it) : -1;
+}
+
+int DisplayTopology::findOutputContaining(const DisplayRect& rect) const {
+	return findOutputAt(rect.left + (rect.right - rect.left) / 2, rect.top + (rect.bottom - rect.top) / 2);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Platform-neutral copies of the Win32 RECT and the interesting part of DXGI_OUTPUT_DESC,
+// so that the topology logic can be checked against synthetic monitor layouts anywhere
+struct DisplayRect {
+	long left = 0, top = 0, right = 0, bottom = 0;
+};
+
+struct DisplayOutput {
+	DisplayRect desktop;        // DXGI_OUTPUT_DESC::DesktopCoordinates
+	uint32_t vendorId = 0;      // The vendor of the adapter the output belongs to
+	size_t adapterIndex = 0;
+	size_t outputIndex = 0;
+	bool attached = false;      // Has a monitor
+};
+
+// A snapshot of the adapters' outputs and their positions on the virtual desktop.
+//
+// It is built once (and rebuilt only when the displays change), so that the resizing code
+// doesn't have to enumerate the adapters and outputs again and again.
+// The point queries take O(log n): the desktop is cut into vertical slabs by the outputs'
+// left and right edges, and every slab keeps its outputs sorted from top to bottom.
+// This relies on the outputs not overlapping, which is how the desktop is arranged.
+class DisplayTopology {
+	std::vector<DisplayOutput> outputs;
+	DisplayRect bounds;
+
+	std::vector<long> slabEdges;                // Sorted, slab i is [slabEdges[i], slabEdges[i + 1])
+	std::vector<std::vector<size_t>> slabs;     // The outputs covering each slab, sorted by top
+
+public:
+	DisplayTopology() = default;
+	explicit DisplayTopology(std::vector<DisplayOutput> outputs);
+
+	const std::vector<DisplayOutput>& getOutputs() const { return outputs; }
+
+	// The whole virtual desktop. Always includes the origin (the primary display corner)
+	DisplayRect getBounds() const { return bounds; }
+
+	// Return the index of the attached output, or -1 if there is none
+	int findOutputAt(long x, long y) const;
+	int findOutputContaining(const DisplayRect& rect) const;     // The one under the rect center
+};
@@ -0,0 +1,58 @@
+#include "FenceTimeline.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+FenceTimeline::FenceTimeline(FenceQueue& queue, size_t frameCount) :
+		queue(&queue), frameValues(frameCount, 0) {}
+
+uint64_t FenceTimeline::getCompletedValue() {
+	completed = std::max(completed, queue->getCompletedValue());
+	return completed;
+}
+
+bool FenceTimeline::isComplete(uint64_t value) {
+	return value <= completed || value <= getCompletedValue();
+}
+
+void FenceTimeline::waitFor(uint64_t value) {
+	if (isComplete(value)) return;
+	blockingWaits++;
+	queue->wait(value);
+	completed = value;
+}
+
+void FenceTimeline::waitForFrame(size_t frame) {
+	waitFor(frameValues[frame % frameValues.size()]);
+}
+
+uint64_t FenceTimeline::endFrame(size_t frame) {
+	const uint64_t value = ++lastSignaled;
+	queue->signal(value);
+	frameValues[frame % frameValues.size()] = value;
+	return value;
+}
+
+void FenceTimeline::waitForBackBuffers() {
+	// The last frame rendered to one of them, and the values complete in order
+	waitFor(lastSignaled);
+}
+
+void FenceTimeline::waitForIdle() {
+	// A fresh value covers the work submitted after the last frame too, the texture uploads for one
+	const uint64_t value = ++lastSignaled;
+	queue->signal(value);
+	waitFor(value);
+}
+
+void SimulatedFenceQueue::signal(uint64_t value) {
+	if (value <= lastSignaled) throw std::logic_error("The fence values must grow");
+	lastSignaled = value;
+	// The GPU finishes the frames latency signals behind
+	if (lastSignaled > latency) completed = std::max(completed, lastSignaled - latency);
+}
+
+void SimulatedFenceQueue::wait(uint64_t value) {
+	if (value > lastSignaled) throw std::logic_error("Waiting for a fence value that was never signaled");
+	completed = std::max(completed, value);
+}
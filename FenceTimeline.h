@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The GPU side of a FenceTimeline: a Direct3D 12 queue and fence in the backend,
+// SimulatedFenceQueue in the headless build
+class FenceQueue {
+public:
+	virtual ~FenceQueue() = default;
+
+	// The fence reaches value once the work submitted so far is done
+	virtual void signal(uint64_t value) = 0;
+	virtual uint64_t getCompletedValue() = 0;
+	// Blocks until the fence reaches value, which has been signaled
+	virtual void wait(uint64_t value) = 0;
+};
+
+// What the CPU has to wait for before it reuses something the GPU may still read, and no more.
+//
+// Every frame ends with one signal of the next fence value. The value is remembered for the frame
+// slot (its command allocator and upload region), a slot is reused once its value completes.
+//
+// The back buffers are released for ResizeBuffers once the last frame completes. The values complete
+// in order and every frame renders to a back buffer, so no buffer is done any earlier than that: as much
+// as a flush of the frames. What a resize saves over waitForIdle is the extra signal, and the wait
+// itself when the GPU has caught up already (a second resize with no frame since, say).
+class FenceTimeline {
+	FenceQueue* queue;
+	uint64_t lastSignaled = 0;
+	uint64_t completed = 0;     // The last value the queue reported, so the completed ones don't ask it again
+	std::vector<uint64_t> frameValues;
+	size_t blockingWaits = 0;
+
+	void waitFor(uint64_t value);
+
+public:
+	FenceTimeline(FenceQueue& queue, size_t frameCount);
+
+	// The value the current frame signals at its end
+	uint64_t getNextValue() const { return lastSignaled + 1; }
+	uint64_t getLastSignaled() const { return lastSignaled; }
+	uint64_t getCompletedValue();
+	bool isComplete(uint64_t value);
+
+	// Before the frame (g_frameIndex, any number) reuses the allocator and the upload memory of its slot
+	void waitForFrame(size_t frame);
+	// After the frame's work is submitted. Returns the signaled value
+	uint64_t endFrame(size_t frame);
+
+	// Before the back buffers are released. Waits for the last frame, see above
+	void waitForBackBuffers();
+
+	// Everything submitted so far, before the device goes
+	void waitForIdle();
+
+	// The waits that found their value incomplete and blocked
+	size_t getBlockingWaits() const { return blockingWaits; }
+};
+
+// A queue that runs a fixed number of frames behind the CPU, for the headless build. The waits
+// complete at once (the CPU "catches up" with the GPU) and the ones that would deadlock a real
+// queue, on a value nobody signaled, throw std::logic_error
+class SimulatedFenceQueue : public FenceQueue {
+	uint64_t lastSignaled = 0;
+	uint64_t completed = 0;
+	uint64_t latency;
+
+public:
+	explicit SimulatedFenceQueue(uint64_t latency = 2) : latency(latency) {}
+
+	void signal(uint64_t value) override;
+	uint64_t getCompletedValue() override { return completed; }
+	void wait(uint64_t value) override;
+};
@@ -0,0 +1,54 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+FramePacer::FramePacer(int64_t refreshPeriodNs) {
+	reset(refreshPeriodNs);
+}
+
+void FramePacer::reset(int64_t refreshPeriodNs) {
+	this->refreshPeriodNs = refreshPeriodNs > 0 ? refreshPeriodNs : DEFAULT_REFRESH_PERIOD_NS;
+	lastFrameNs = -1;
+	frames = intervals = missedFrames = 0;
+	intervalSumNs = deviationSquareSumNs = 0;
+	maxIntervalNs = 0;
+}
+
+double FramePacer::beginFrame(int64_t nowNs) {
+	frames++;
+	const int64_t last = std::exchange(lastFrameNs, nowNs);
+	if (last < 0) return 0;
+
+	const int64_t interval = std::max<int64_t>(nowNs - last, 0);
+	// A frame that came early still took a vblank
+	const int64_t periods = std::max<int64_t>((interval + refreshPeriodNs / 2) / refreshPeriodNs, 1);
+	const double deviation = double(interval - periods * refreshPeriodNs);
+
+	intervals++;
+	missedFrames += size_t(periods - 1);
+	intervalSumNs += double(interval);
+	deviationSquareSumNs += deviation * deviation;
+	maxIntervalNs = std::max(maxIntervalNs, interval);
+	return double(interval) * 1e-9;
+}
+
+FramePacer::Stats FramePacer::getStats() const {
+	Stats stats;
+	stats.frames = frames;
+	stats.missedFrames = missedFrames;
+	if (intervals > 0) {
+		stats.meanIntervalUs = intervalSumNs / double(intervals) * 1e-3;
+		stats.jitterUs = std::sqrt(deviationSquareSumNs / double(intervals)) * 1e-3;
+	}
+	stats.maxIntervalUs = double(maxIntervalNs) * 1e-3;
+	return stats;
+}
+
+void FramePacer::writeStats(std::ostream& out) const {
+	Stats s = getStats();
+	out << "Frames: " << s.frames << ", missed vblanks: " << s.missedFrames
+	    << ", refresh period " << double(refreshPeriodNs) * 1e-3 << " us, mean interval " << s.meanIntervalUs
+	    << " us, jitter " << s.jitterUs << " us, max " << s.maxIntervalUs << " us" << std::endl;
+}
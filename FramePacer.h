@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// The timing side of the continuous animation: the time delta for the contents and the
+// statistics of how evenly the frames came.
+//
+// It doesn't wait itself. The frames are paced by the surface (the frame-latency waitable or a
+// vblank wait), and the pacer is told when each one starts. An interval is counted in refresh
+// periods, rounded to the nearest: every period above one is a missed vblank. The jitter is the
+// RMS distance of the intervals from the period multiple they landed on, so the misses don't
+// inflate it. The times are nanoseconds, TraceRecorder::now() in the app.
+class FramePacer {
+public:
+	struct Stats {
+		size_t frames = 0;
+		size_t missedFrames = 0;
+		double meanIntervalUs = 0, jitterUs = 0, maxIntervalUs = 0;
+	};
+
+	static constexpr int64_t DEFAULT_REFRESH_PERIOD_NS = 16666667;     // 60 Hz
+
+private:
+	int64_t refreshPeriodNs;
+	int64_t lastFrameNs;
+
+	size_t frames, intervals, missedFrames;
+	double intervalSumNs, deviationSquareSumNs;
+	int64_t maxIntervalNs;
+
+public:
+	explicit FramePacer(int64_t refreshPeriodNs = DEFAULT_REFRESH_PERIOD_NS);
+
+	int64_t getRefreshPeriodNs() const { return refreshPeriodNs; }
+
+	// Starts a new measurement. 0 or less means the default period
+	void reset(int64_t refreshPeriodNs);
+
+	// At the same point of every frame. Returns the time since the previous frame in seconds,
+	// 0 for the first one after the reset
+	double beginFrame(int64_t nowNs);
+
+	Stats getStats() const;
+	void writeStats(std::ostream& out) const;
+};
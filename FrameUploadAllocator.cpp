@@ -0,0 +1,37 @@
+#include "FrameUploadAllocator.h"
+
+size_t FrameUploadAllocator::grownRegionSize(size_t current, size_t required) {
+	size_t result = current < MIN_REGION_SIZE ? MIN_REGION_SIZE : current;
+	while (result < required) result *= 2;
+	return result;
+}
+
+void FrameUploadAllocator::reset(size_t newRegionSize) {
+	regionSize = newRegionSize;
+	for (size_t& head : heads) head = 0;
+}
+
+void FrameUploadAllocator::beginFrame(size_t frameIndex) {
+	frame = frameIndex % heads.size();
+	heads[frame] = 0;
+}
+
+static size_t alignUp(size_t value, size_t alignment) {
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+bool FrameUploadAllocator::allocate(size_t size, size_t alignment, Allocation& allocation) {
+	// The offsets are aligned within the buffer, not the region
+	const size_t start = frame * regionSize;
+	const size_t offset = alignUp(start + heads[frame], alignment);
+	if (offset - start > regionSize || size > regionSize - (offset - start)) return false;
+
+	heads[frame] = offset - start + size;
+	allocation = { offset, size };
+	return true;
+}
+
+size_t FrameUploadAllocator::getRequiredRegionSize(size_t size, size_t alignment) const {
+	// What the frame has used so far and the request, with room for any alignment of the new region
+	return heads[frame] + alignment + size;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Backend-neutral bookkeeping for the per-frame upload memory of the Direct3D 12 backend.
+//
+// One persistently mapped upload buffer is split into a region per frame in flight. A frame
+// carves its vertices, constants and staging data linearly out of its own region, so nothing
+// it writes can overlap the data the GPU may still read for the other frames. The backend calls
+// beginFrame() once the fence of the frame that last used the region has completed, which
+// empties the region again.
+//
+// When a frame outgrows its region the backend creates a larger buffer (see grownRegionSize),
+// keeps the old one alive until the frames that reference it complete, and calls reset().
+class FrameUploadAllocator {
+public:
+	struct Allocation {
+		size_t offset;      // From the start of the buffer
+		size_t size;
+	};
+
+private:
+	std::vector<size_t> heads;      // Used bytes of every region
+	size_t regionSize = 0;
+	size_t frame = 0;
+
+public:
+	static const size_t MIN_REGION_SIZE = 64 * 1024;
+
+	explicit FrameUploadAllocator(size_t frameCount) : heads(frameCount, 0) {}
+
+	// Geometric growth, so that a steadily growing frame reallocates O(log n) times
+	static size_t grownRegionSize(size_t current, size_t required);
+
+	// Starts over on a newly (re)created buffer of getCapacity() bytes: all the regions are empty
+	// and the current frame stays the same
+	void reset(size_t newRegionSize);
+
+	// Makes frame (g_frameIndex % the frame count) the current one and empties its region.
+	// The GPU must be done with it
+	void beginFrame(size_t frameIndex);
+
+	// Returns false if the request (including the alignment) doesn't fit the rest of the region
+	// of the current frame. getRequiredRegionSize() tells how large the region should be then
+	bool allocate(size_t size, size_t alignment, Allocation& allocation);
+	size_t getRequiredRegionSize(size_t size, size_t alignment) const;
+
+	size_t getRegionSize() const { return regionSize; }
+	size_t getCapacity() const { return regionSize * heads.size(); }
+	size_t getFrameCount() const { return heads.size(); }
+	size_t getFrame() const { return frame; }
+	size_t getUsed() const { return heads[frame]; }
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <span>
 #include <string>
 #include <vector>
 
@@ -12,14 +13,30 @@ struct RGBAVertex {
 
 template <typename V> struct _GraphicContents {
     virtual void updateLayout(int width, int height) = 0;
-    virtual std::vector<V> getVertices() = 0;
+
+    // Advances the animation by the time since the previous frame, in the continuous mode only.
+    // The contents that don't move ignore it
+    virtual void update(double /*deltaSeconds*/) { }
+
+    // The vertices are written straight into the mapped GPU memory, so the renderer asks
+    // for their count first and then provides a destination of exactly that size
+    virtual size_t getVertexCount() = 0;
+    virtual void writeVertices(std::span<V> dst) = 0;
+
     virtual std::string getShader() = 0;
+
+    // A copying convenience wrapper. Don't use it on the hot path
+    std::vector<V> getVertices() {
+        std::vector<V> vertices(getVertexCount());
+        writeVertices(vertices);
+        return vertices;
+    }
 };
 
 #if defined(USE_DX11)
 typedef _GraphicContents<TextureVertex> GraphicContents;
 #elif defined(USE_DX12)
 typedef _GraphicContents<RGBAVertex> GraphicContents;
-#else
-#error "You should set either USE_DX11 or USE_DX12"
+#elif !defined(USE_HEADLESS)
+#error "You should set either USE_DX11, USE_DX12 or USE_HEADLESS"
 #endif
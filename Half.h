@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 half-precision conversions, for the R16G16B16A16_FLOAT pixels.
+// The float to half conversion rounds to the nearest even, like the GPUs do
+
+inline uint16_t floatToHalf(float value) {
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = (bits >> 16) & 0x8000;
+	const uint32_t magnitude = bits & 0x7FFFFFFF;
+
+	if (magnitude >= 0x7F800000) return uint16_t(sign | (magnitude > 0x7F800000 ? 0x7E00 : 0x7C00));   // NaN, infinity
+	if (magnitude >= 0x477FF000) return uint16_t(sign | 0x7C00);    // Rounds to infinity
+	if (magnitude < 0x38800000) {
+		// A half subnormal (or zero), rounded to the nearest even
+		if (magnitude < 0x33000000) return uint16_t(sign);
+		uint32_t exponent = magnitude >> 23;
+		uint32_t mantissa = (magnitude & 0x7FFFFF) | 0x800000;
+		uint32_t shift = 126 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+		if (remainder > halfway || (remainder == halfway && (half & 1))) half++;
+		return uint16_t(sign | half);
+	}
+
+	uint32_t half = (magnitude - 0x38000000) >> 13;
+	uint32_t remainder = magnitude & 0x1FFF;
+	if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) half++;
+	return uint16_t(sign | half);
+}
+
+inline float halfToFloat(uint16_t value) {
+	const uint32_t sign = uint32_t(value & 0x8000) << 16;
+	const uint32_t exponent = (value >> 10) & 0x1F;
+	const uint32_t mantissa = value & 0x3FF;
+
+	if (exponent == 0) {
+		float f = std::ldexp(float(mantissa), -24);
+		return sign ? -f : f;
+	}
+
+	uint32_t bits = exponent == 31
+	                ? sign | 0x7F800000 | (mantissa << 13)
+	                : sign | ((exponent + 112) << 23) | (mantissa << 13);
+	float f;
+	std::memcpy(&f, &bits, sizeof(f));
+	return f;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Incremental 64-bit FNV-1a hash.
+// Stable across runs and platforms, so it is suitable for the keys of on-disk caches.
+struct Fnv1a64 {
+	static const uint64_t OFFSET_BASIS = 0xcbf29ce484222325ull;
+	static const uint64_t PRIME = 0x100000001b3ull;
+
+	uint64_t value = OFFSET_BASIS;
+
+	Fnv1a64& add(const void* data, size_t size) {
+		auto bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++) {
+			value ^= bytes[i];
+			value *= PRIME;
+		}
+		return *this;
+	}
+
+	// Strings are hashed together with their length, so that ("ab", "c") and ("a", "bc") differ
+	Fnv1a64& add(std::string_view str) {
+		addValue(static_cast<uint64_t>(str.size()));
+		return add(str.data(), str.size());
+	}
+
+	template<typename T> Fnv1a64& addValue(const T& v) {
+		return add(&v, sizeof(T));
+	}
+};
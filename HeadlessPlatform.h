@@ -0,0 +1,185 @@
+#pragma once
+
+#include "FenceTimeline.h"
+#include "FramePacer.h"
+#include "GraphicContents.h"
+#include "Platform.h"
+#include "RenderThread.h"
+#include "ResizePolicy.h"
+#include "SoftwareRasterizer.h"
+#include "TraceRecorder.h"
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// The RenderSurface without a window or a GPU.
+//
+// It runs everything the Direct3D backends do on the CPU side of a resize: the buffer
+// bucketing, the "reallocation" of the swap chain (a CPU framebuffer here), writing the vertices
+// into the persistent upload memory, clearing, drawing and presenting. The drawing goes through
+// the SoftwareRasterizer, so the frames are real and the cost of the resize path can be measured
+// on machines with neither Windows nor a GPU. The fence waits of the Direct3D 12 backend run
+// against a SimulatedFenceQueue, which throws if they are out of order. The animation frames
+// wait for an emulated vblank, every refresh period of the steady clock.
+template <typename V>
+class HeadlessSurface : public RenderSurface {
+public:
+	// The same as the Direct3D 12 backend
+	static const size_t NUM_FRAMES_IN_FLIGHT = 3;
+
+private:
+	std::shared_ptr<_GraphicContents<V>> contents;
+	ResizePolicy resizePolicy;
+
+	SimulatedFenceQueue queue;
+	FenceTimeline fenceTimeline { queue, NUM_FRAMES_IN_FLIGHT };
+	size_t frameIndex = 0;
+
+	SoftwareRasterizer rasterizer;         // Owns the framebuffer that emulates the swap chain buffers
+	std::shared_ptr<const SoftwareTexture> texture;     // For the TextureVertex contents
+	std::vector<V> uploadBuffer;           // Emulates the persistently mapped vertex buffer
+	BufferSize sourceSize;                 // The part of the buffers that is presented
+	DisplayRect lastPosition;
+	size_t presentedFrames = 0;
+	int64_t refreshPeriodNs = FramePacer::DEFAULT_REFRESH_PERIOD_NS;
+	bool resizeVBlankWait = false;
+
+public:
+	explicit HeadlessSurface(std::shared_ptr<_GraphicContents<V>> contents, unsigned threads = 0) :
+			contents(std::move(contents)), rasterizer(threads) { }
+
+	void setTexture(std::shared_ptr<const SoftwareTexture> texture) { this->texture = std::move(texture); }
+	void setRefreshPeriod(int64_t periodNs) { refreshPeriodNs = periodNs; }
+	// The Direct3D backends end the resizes on a vblank wait too. Off by default,
+	// so that the replays measure the CPU side only
+	void setResizeVBlankWait(bool wait) { resizeVBlankWait = wait; }
+
+	void reposition(const DisplayRect& position) override {
+		ScopedTimer timer("reposition");
+		drawFrame(position);
+		if (resizeVBlankWait) waitForVBlank();
+	}
+
+	void presentFrame() override {
+		ScopedTimer timer("presentFrame");
+		// Nothing to redraw before the first resize
+		if (presentedFrames > 0) drawFrame(lastPosition);
+		waitForVBlank();
+	}
+
+	size_t getPresentedFrames() const { return presentedFrames; }
+	size_t getReallocations() const { return resizePolicy.getReallocations(); }
+	size_t getBlockingFenceWaits() const { return fenceTimeline.getBlockingWaits(); }
+	BufferSize getSourceSize() const { return sourceSize; }
+	const SoftwareRasterizer& getRasterizer() const { return rasterizer; }
+
+private:
+	void waitForVBlank() const {
+		ScopedTimer timer("Present (vblank)");
+		const std::chrono::nanoseconds period(refreshPeriodNs);
+		auto now = std::chrono::steady_clock::now().time_since_epoch();
+		std::this_thread::sleep_until(std::chrono::steady_clock::time_point(
+				std::chrono::duration_cast<std::chrono::steady_clock::duration>((now / period + 1) * period)));
+	}
+
+	void drawFrame(const DisplayRect& position) {
+		lastPosition = position;
+		int width = position.right - position.left;
+		int height = position.bottom - position.top;
+
+		frameIndex++;
+		{
+			ScopedTimer fenceTimer("WaitForFence");
+			fenceTimeline.waitForFrame(frameIndex);
+		}
+
+		// The vertices don't depend on the buffers, so they are written before the resize waits for the GPU
+		size_t vertexCount = contents->getVertexCount();
+		{
+			ScopedTimer prepareTimer("PrepareFrame");
+			if (uploadBuffer.size() < vertexCount) uploadBuffer.resize(vertexCount);
+			contents->writeVertices(std::span<V>(uploadBuffer.data(), vertexCount));
+		}
+
+		if (resizePolicy.update({ width, height })) {
+			ScopedTimer resizeTimer("ResizeBuffers");
+			BufferSize allocated = resizePolicy.getAllocated();
+			fenceTimeline.waitForBackBuffers();
+			rasterizer.resize(allocated.width, allocated.height);
+		}
+		rasterizer.setViewport(width, height);
+		sourceSize = { width, height };
+
+		{
+			ScopedTimer drawTimer("DrawTriangle");
+			// The same clear color and topologies as the Direct3D backends
+			rasterizer.clear(SoftwareRasterizer::packColor(0.0f, 0.2f, 0.4f, 1.0f));
+			std::span<const V> vertices(uploadBuffer.data(), vertexCount);
+			if constexpr (std::is_same_v<V, TextureVertex>) {
+				static const SoftwareTexture missing = { 1, 1, { 0xFF000000u } };
+				rasterizer.draw(vertices, SoftwareRasterizer::Topology::TriangleStrip, texture ? *texture : missing);
+			} else {
+				rasterizer.draw(vertices, SoftwareRasterizer::Topology::TriangleList);
+			}
+		}
+
+		{
+			ScopedTimer presentTimer("Present");
+			presentedFrames++;
+		}
+		fenceTimeline.endFrame(frameIndex);
+	}
+};
+
+// Replays synthetic resize sequences through the same code path the Win32 window procedure
+// runs on WM_NCCALCSIZE: on the calling thread, or handed off to a RenderThread
+template <typename V>
+class HeadlessPlatform {
+	std::shared_ptr<_GraphicContents<V>> contents;
+	std::shared_ptr<RenderSurface> surface;
+	std::unique_ptr<RenderThread<V>> renderThread;
+
+public:
+	HeadlessPlatform(std::shared_ptr<_GraphicContents<V>> contents, std::shared_ptr<RenderSurface> surface,
+	                 bool useRenderThread = false) :
+			contents(std::move(contents)), surface(std::move(surface)) {
+		if (useRenderThread) {
+			renderThread = std::make_unique<RenderThread<V>>(this->contents, [this] { return this->surface; });
+		}
+	}
+
+	void resize(const DisplayRect& rect) {
+		ScopedTimer timer("WM_NCCALCSIZE");
+		if (renderThread) {
+			renderThread->resize(rect);
+		} else {
+			handleResize(*contents, *surface, rect);
+		}
+	}
+
+	// Null unless the platform was created with one
+	RenderThread<V>* getRenderThread() const { return renderThread.get(); }
+
+	void replay(const std::vector<DisplayRect>& trace) {
+		for (const auto& rect : trace) resize(rect);
+	}
+
+	// A window of the initial size dragged by its bottom-right corner: out by (dx, dy) and back
+	static std::vector<DisplayRect> makeDragTrace(DisplayRect initial, int dx, int dy, int steps) {
+		std::vector<DisplayRect> trace;
+		for (int i = 0; i <= 2 * steps; i++) {
+			int k = i <= steps ? i : 2 * steps - i;
+			DisplayRect r = initial;
+			r.right += dx * k / steps;
+			r.bottom += dy * k / steps;
+			trace.push_back(r);
+		}
+		return trace;
+	}
+};
@@ -0,0 +1,144 @@
+#include "LZ4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;      // The block ends with at least this many literals
+constexpr size_t MATCH_FIND_LIMIT = 12;  // And no match starts this close to its end
+constexpr size_t MAX_OFFSET = 65535;
+constexpr unsigned HASH_LOG = 16;
+
+uint32_t read32(const uint8_t* p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+uint32_t hash(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+uint8_t* writeLength(uint8_t* op, size_t length) {
+	for (; length >= 255; length -= 255) *op++ = 255;
+	*op++ = uint8_t(length);
+	return op;
+}
+
+uint8_t* writeSequence(uint8_t* op, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength) {
+	uint8_t* token = op++;
+	*token = uint8_t(std::min<size_t>(literalLength, 15) << 4);
+	if (literalLength >= 15) op = writeLength(op, literalLength - 15);
+	if (literalLength) std::memcpy(op, literals, literalLength);
+	op += literalLength;
+	if (matchLength == 0) return op;    // The last literals
+
+	*op++ = uint8_t(offset);
+	*op++ = uint8_t(offset >> 8);
+	matchLength -= MIN_MATCH;
+	*token |= uint8_t(std::min<size_t>(matchLength, 15));
+	if (matchLength >= 15) op = writeLength(op, matchLength - 15);
+	return op;
+}
+
+// A length continued in 255 steps. False past the end of the block or past limit
+bool readLength(const uint8_t*& ip, const uint8_t* end, size_t& length, size_t limit) {
+	uint8_t byte;
+	do {
+		if (ip >= end) return false;
+		byte = *ip++;
+		length += byte;
+		if (length > limit) return false;
+	} while (byte == 255);
+	return true;
+}
+
+}
+
+size_t LZ4::compress(const uint8_t* src, size_t srcSize, uint8_t* dst) {
+	uint8_t* op = dst;
+	size_t anchor = 0;
+
+	if (srcSize > MATCH_FIND_LIMIT) {
+		// Positions + 1, 0 is an empty slot
+		std::unique_ptr<uint32_t[]> table(new uint32_t[size_t(1) << HASH_LOG]());
+		const size_t matchStartLimit = srcSize - MATCH_FIND_LIMIT;
+		const size_t matchEndLimit = srcSize - LAST_LITERALS;
+
+		size_t ip = 0;
+		size_t misses = 0;
+		while (ip < matchStartLimit) {
+			const uint32_t sequence = read32(src + ip);
+			uint32_t& slot = table[hash(sequence)];
+			const size_t candidate = slot;
+			slot = uint32_t(ip + 1);
+
+			if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence) {
+				// The incompressible stretches are skipped faster and faster, the way the reference does
+				ip += 1 + (misses++ >> 6);
+				continue;
+			}
+			misses = 0;
+
+			size_t match = candidate - 1;
+			// Back over the literals that match too
+			while (ip > anchor && match > 0 && src[ip - 1] == src[match - 1]) {
+				ip--;
+				match--;
+			}
+			size_t length = MIN_MATCH;
+			while (ip + length < matchEndLimit && src[ip + length] == src[match + length]) length++;
+
+			op = writeSequence(op, src + anchor, ip - anchor, ip - match, length);
+			ip += length;
+			anchor = ip;
+			if (ip - 2 < matchStartLimit) table[hash(read32(src + ip - 2))] = uint32_t(ip - 2 + 1);
+		}
+	}
+
+	op = writeSequence(op, src + anchor, srcSize - anchor, 0, 0);
+	return size_t(op - dst);
+}
+
+bool LZ4::decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+	const uint8_t* ip = src;
+	const uint8_t* const srcEnd = src + srcSize;
+	uint8_t* op = dst;
+	uint8_t* const dstEnd = dst + dstSize;
+
+	for (;;) {
+		if (ip >= srcEnd) return false;
+		const uint8_t token = *ip++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(ip, srcEnd, literalLength, dstSize)) return false;
+		if (literalLength > size_t(srcEnd - ip) || literalLength > size_t(dstEnd - op)) return false;
+		if (literalLength) std::memcpy(op, ip, literalLength);
+		ip += literalLength;
+		op += literalLength;
+		if (ip == srcEnd) break;    // The last sequence has no match
+
+		if (srcEnd - ip < 2) return false;
+		const size_t offset = size_t(ip[0]) | size_t(ip[1]) << 8;
+		ip += 2;
+		if (offset == 0 || offset > size_t(op - dst)) return false;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(ip, srcEnd, matchLength, dstSize)) return false;
+		matchLength += MIN_MATCH;
+		if (matchLength > size_t(dstEnd - op)) return false;
+
+		const uint8_t* match = op - offset;
+		if (offset >= matchLength) {
+			std::memcpy(op, match, matchLength);
+			op += matchLength;
+		} else {
+			// Overlapping, a run of the last offset bytes
+			for (size_t i = 0; i < matchLength; i++) *op++ = match[i];
+		}
+	}
+	return op == dstEnd;
+}
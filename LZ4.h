@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The LZ4 block format (no frame header, no checksums): what the reference liblz4 LZ4_compress_default
+// writes and LZ4_decompress_safe reads, so the files can be made and checked with the usual tools.
+//
+// The compressor is the greedy single-hash one, the ratio of the "fast" reference level. The decompressor
+// checks every length and offset against both buffers, a corrupted block fails instead of overrunning.
+class LZ4 {
+public:
+	// The worst case of compress: the incompressible data with the length bytes
+	static size_t compressBound(size_t size) { return size + size / 255 + 16; }
+
+	// dst has compressBound(srcSize) bytes. Returns the size of the block
+	static size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst);
+
+	// The whole block into exactly dstSize bytes. False if the block is corrupted or of another size
+	static bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+};
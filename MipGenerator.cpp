@@ -0,0 +1,432 @@
+#include "MipGenerator.h"
+#include "Half.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Every thread filters at least this many destination rows, smaller levels aren't worth a thread
+const size_t MIN_ROWS_PER_THREAD = 32;
+
+// The linear to sRGB table is indexed by the linear value scaled to this. It's fine enough to stay
+// within a fraction of the 8-bit step even in the steep dark part of the curve
+const size_t LINEAR_TO_SRGB_STEPS = 16384;
+
+const float PI = 3.14159265358979f;
+
+const std::array<float, 256>& srgbToLinearTable() {
+	static const std::array<float, 256> table = [] {
+		std::array<float, 256> t = {};
+		for (int i = 0; i < 256; i++) {
+			float c = float(i) / 255.f;
+			t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		return t;
+	}();
+	return table;
+}
+
+const std::vector<uint8_t>& linearToSrgbTable() {
+	static const std::vector<uint8_t> table = [] {
+		std::vector<uint8_t> t(LINEAR_TO_SRGB_STEPS + 1);
+		for (size_t i = 0; i <= LINEAR_TO_SRGB_STEPS; i++) {
+			float c = float(i) / float(LINEAR_TO_SRGB_STEPS);
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+			t[i] = uint8_t(std::clamp(s, 0.f, 1.f) * 255.f + 0.5f);
+		}
+		return t;
+	}();
+	return table;
+}
+
+// The filter weights of one dimension. Every destination pixel has the same number of taps,
+// the unused ones have zero weights. The indices are clamped to the source edges
+struct Kernel {
+	size_t taps = 0;
+	std::vector<uint32_t> indices;
+	std::vector<float> weights;
+};
+
+// The modified Bessel function of the first kind, for the Kaiser window
+float besselI0(float x) {
+	float sum = 1.f, term = 1.f;
+	for (int k = 1; k < 32; k++) {
+		float f = x / (2.f * float(k));
+		term *= f * f;
+		sum += term;
+		if (term < sum * 1e-7f) break;
+	}
+	return sum;
+}
+
+Kernel makeKernel(const MipGenerator::Settings& settings, size_t srcSize, size_t dstSize) {
+	Kernel kernel;
+	const float scale = float(srcSize) / float(dstSize);
+	const int64_t last = int64_t(srcSize) - 1;
+
+	if (settings.filter == MipFilter::Box) {
+		// The weight of a source pixel is the part of it the destination pixel covers
+		kernel.taps = size_t(std::ceil(scale)) + 1;
+		kernel.indices.resize(dstSize * kernel.taps);
+		kernel.weights.resize(dstSize * kernel.taps);
+		for (size_t x = 0; x < dstSize; x++) {
+			float lo = float(x) * scale, hi = float(x + 1) * scale;
+			int64_t first = int64_t(lo);
+			for (size_t k = 0; k < kernel.taps; k++) {
+				int64_t i = first + int64_t(k);
+				float overlap = std::max(0.f, std::min(hi, float(i + 1)) - std::max(lo, float(i)));
+				kernel.indices[x * kernel.taps + k] = uint32_t(std::min(i, last));
+				kernel.weights[x * kernel.taps + k] = i <= last ? overlap / scale : 0.f;
+			}
+		}
+		return kernel;
+	}
+
+	// Kaiser-windowed sinc. The radius is in the destination pixels, so the filter stretches with the scale
+	const float radius = std::max(settings.kaiserRadius, 1.f);
+	const float support = radius * scale;
+	const float windowNorm = 1.f / besselI0(settings.kaiserAlpha);
+	kernel.taps = size_t(std::ceil(2.f * support)) + 1;
+	kernel.indices.resize(dstSize * kernel.taps);
+	kernel.weights.resize(dstSize * kernel.taps);
+	for (size_t x = 0; x < dstSize; x++) {
+		const float center = (float(x) + 0.5f) * scale;
+		const int64_t first = int64_t(std::ceil(center - support - 0.5f));
+		float sum = 0.f;
+		for (size_t k = 0; k < kernel.taps; k++) {
+			int64_t i = first + int64_t(k);
+			float t = (float(i) + 0.5f - center) / scale;
+			float weight = 0.f;
+			if (std::abs(t) < radius) {
+				float sinc = t == 0.f ? 1.f : std::sin(PI * t) / (PI * t);
+				float r = t / radius;
+				weight = sinc * besselI0(settings.kaiserAlpha * std::sqrt(1.f - r * r)) * windowNorm;
+			}
+			kernel.indices[x * kernel.taps + k] = uint32_t(std::clamp<int64_t>(i, 0, last));
+			kernel.weights[x * kernel.taps + k] = weight;
+			sum += weight;
+		}
+		for (size_t k = 0; k < kernel.taps; k++) kernel.weights[x * kernel.taps + k] /= sum;
+	}
+	return kernel;
+}
+
+// One row of pixels into (linear) RGBA floats
+void loadRow(MipFormat format, bool srgb, const uint8_t* row, size_t width, float* out) {
+	if (format == MipFormat::RGBA16F) {
+		auto halves = reinterpret_cast<const uint16_t*>(row);
+		for (size_t i = 0; i < width * 4; i++) out[i] = halfToFloat(halves[i]);
+		return;
+	}
+
+	const auto& toLinear = srgbToLinearTable();
+	for (size_t x = 0; x < width; x++) {
+		for (size_t c = 0; c < 3; c++) {
+			uint8_t value = row[4 * x + c];
+			out[4 * x + c] = srgb ? toLinear[value] : float(value) * (1.f / 255.f);
+		}
+		out[4 * x + 3] = float(row[4 * x + 3]) * (1.f / 255.f);
+	}
+}
+
+void storeRow(MipFormat format, bool srgb, const float* in, size_t width, uint8_t* row) {
+	if (format == MipFormat::RGBA16F) {
+		auto halves = reinterpret_cast<uint16_t*>(row);
+		for (size_t i = 0; i < width * 4; i++) halves[i] = floatToHalf(in[i]);
+		return;
+	}
+
+	// The sinc has negative lobes, so the results may overshoot
+	const auto& toSrgb = linearToSrgbTable();
+	for (size_t x = 0; x < width; x++) {
+		for (size_t c = 0; c < 3; c++) {
+			float value = std::clamp(in[4 * x + c], 0.f, 1.f);
+			row[4 * x + c] = srgb ? toSrgb[size_t(value * float(LINEAR_TO_SRGB_STEPS) + 0.5f)]
+			                      : uint8_t(value * 255.f + 0.5f);
+		}
+		row[4 * x + 3] = uint8_t(std::clamp(in[4 * x + 3], 0.f, 1.f) * 255.f + 0.5f);
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// The weighted sums of the passes, a set of kernels per SIMDLevel. They all multiply and add
+// in the same order, without FMA, so they round alike
+//--------------------------------------------------------------------------------------
+
+struct Kernels {
+	SIMDLevel level;
+	// The vertical pass: out = the sum of weights[k] * rows[k] over the taps, for size floats
+	void (*sumRows)(const float* const* rows, const float* weights, size_t taps, size_t size, float* out);
+	// The horizontal pass: the RGBA pixels of out from those of the column under the kernel
+	void (*sumPixels)(const float* column, const Kernel& kernel, size_t dstWidth, float* out);
+};
+
+void sumRowsScalar(const float* const* rows, const float* weights, size_t taps, size_t size, float* out) {
+	std::fill(out, out + size, 0.f);
+	for (size_t k = 0; k < taps; k++) {
+		for (size_t i = 0; i < size; i++) out[i] += weights[k] * rows[k][i];
+	}
+}
+
+void sumPixelsScalar(const float* column, const Kernel& kernel, size_t dstWidth, float* out) {
+	for (size_t x = 0; x < dstWidth; x++) {
+		float rgba[4] = {};
+		for (size_t k = 0; k < kernel.taps; k++) {
+			const float weight = kernel.weights[x * kernel.taps + k];
+			const float* pixel = column + kernel.indices[x * kernel.taps + k] * 4;
+			for (size_t c = 0; c < 4; c++) rgba[c] += weight * pixel[c];
+		}
+		for (size_t c = 0; c < 4; c++) out[x * 4 + c] = rgba[c];
+	}
+}
+
+const Kernels SCALAR_KERNELS = { SIMDLevel::Scalar, sumRowsScalar, sumPixelsScalar };
+
+#if defined(SIMD_X86)
+
+// The sums stay in the registers over all the taps, the rows are read once and the output written once
+
+SIMD_TARGET_SSE41 void sumRowsSSE41(const float* const* rows, const float* weights, size_t taps, size_t size, float* out) {
+	size_t i = 0;
+	for (; i + 16 <= size; i += 16) {
+		__m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps(), sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+		for (size_t k = 0; k < taps; k++) {
+			const __m128 weight = _mm_set1_ps(weights[k]);
+			const float* row = rows[k] + i;
+			sum0 = _mm_add_ps(sum0, _mm_mul_ps(weight, _mm_loadu_ps(row)));
+			sum1 = _mm_add_ps(sum1, _mm_mul_ps(weight, _mm_loadu_ps(row + 4)));
+			sum2 = _mm_add_ps(sum2, _mm_mul_ps(weight, _mm_loadu_ps(row + 8)));
+			sum3 = _mm_add_ps(sum3, _mm_mul_ps(weight, _mm_loadu_ps(row + 12)));
+		}
+		_mm_storeu_ps(out + i, sum0);
+		_mm_storeu_ps(out + i + 4, sum1);
+		_mm_storeu_ps(out + i + 8, sum2);
+		_mm_storeu_ps(out + i + 12, sum3);
+	}
+	// The rows are whole pixels, 4 floats each
+	for (; i < size; i += 4) {
+		__m128 sum = _mm_setzero_ps();
+		for (size_t k = 0; k < taps; k++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+		_mm_storeu_ps(out + i, sum);
+	}
+}
+
+// A pixel is a register
+SIMD_TARGET_SSE41 void sumPixelsSSE41(const float* column, const Kernel& kernel, size_t dstWidth, float* out) {
+	const uint32_t* indices = kernel.indices.data();
+	const float* weights = kernel.weights.data();
+	for (size_t x = 0; x < dstWidth; x++, indices += kernel.taps, weights += kernel.taps) {
+		__m128 sum = _mm_setzero_ps();
+		for (size_t k = 0; k < kernel.taps; k++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(column + indices[k] * 4)));
+		}
+		_mm_storeu_ps(out + x * 4, sum);
+	}
+}
+
+const Kernels SSE41_KERNELS = { SIMDLevel::SSE41, sumRowsSSE41, sumPixelsSSE41 };
+
+SIMD_TARGET_AVX2 void sumRowsAVX2(const float* const* rows, const float* weights, size_t taps, size_t size, float* out) {
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32) {
+		__m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps(), sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+		for (size_t k = 0; k < taps; k++) {
+			const __m256 weight = _mm256_set1_ps(weights[k]);
+			const float* row = rows[k] + i;
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(weight, _mm256_loadu_ps(row)));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 8)));
+			sum2 = _mm256_add_ps(sum2, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 16)));
+			sum3 = _mm256_add_ps(sum3, _mm256_mul_ps(weight, _mm256_loadu_ps(row + 24)));
+		}
+		_mm256_storeu_ps(out + i, sum0);
+		_mm256_storeu_ps(out + i + 8, sum1);
+		_mm256_storeu_ps(out + i + 16, sum2);
+		_mm256_storeu_ps(out + i + 24, sum3);
+	}
+	for (; i + 8 <= size; i += 8) {
+		__m256 sum = _mm256_setzero_ps();
+		for (size_t k = 0; k < taps; k++) sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+		_mm256_storeu_ps(out + i, sum);
+	}
+	if (i < size) {
+		__m128 sum = _mm_setzero_ps();
+		for (size_t k = 0; k < taps; k++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+		_mm_storeu_ps(out + i, sum);
+	}
+}
+
+// Two pixels to a register, one in each half
+SIMD_TARGET_AVX2 void sumPixelsAVX2(const float* column, const Kernel& kernel, size_t dstWidth, float* out) {
+	const size_t taps = kernel.taps;
+	const uint32_t* indices = kernel.indices.data();
+	const float* weights = kernel.weights.data();
+	size_t x = 0;
+	for (; x + 2 <= dstWidth; x += 2, indices += 2 * taps, weights += 2 * taps) {
+		__m256 sum = _mm256_setzero_ps();
+		for (size_t k = 0; k < taps; k++) {
+			const __m256 pixels = _mm256_set_m128(_mm_loadu_ps(column + indices[taps + k] * 4), _mm_loadu_ps(column + indices[k] * 4));
+			const __m256 weight = _mm256_set_m128(_mm_set1_ps(weights[taps + k]), _mm_set1_ps(weights[k]));
+			sum = _mm256_add_ps(sum, _mm256_mul_ps(weight, pixels));
+		}
+		_mm256_storeu_ps(out + x * 4, sum);
+	}
+	if (x < dstWidth) {
+		__m128 sum = _mm_setzero_ps();
+		for (size_t k = 0; k < taps; k++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(column + indices[k] * 4)));
+		_mm_storeu_ps(out + x * 4, sum);
+	}
+}
+
+const Kernels AVX2_KERNELS = { SIMDLevel::AVX2, sumRowsAVX2, sumPixelsAVX2 };
+
+#endif
+
+const Kernels& kernelsFor(SIMDLevel level) {
+#if defined(SIMD_X86)
+	if (level == SIMDLevel::AVX2) return AVX2_KERNELS;
+	if (level == SIMDLevel::SSE41) return SSE41_KERNELS;
+#endif
+	return SCALAR_KERNELS;
+}
+
+std::atomic<const Kernels*>& selectedKernels() {
+	static std::atomic<const Kernels*> kernels = &kernelsFor(detectSIMDLevel());
+	return kernels;
+}
+
+}
+
+bool MipGenerator::fromDXGIFormat(uint32_t dxgiFormat, MipFormat& format, bool& srgb) {
+	srgb = false;
+	switch (dxgiFormat) {
+		case 10: format = MipFormat::RGBA16F; return true;                       // DXGI_FORMAT_R16G16B16A16_FLOAT
+		case 27: case 28: format = MipFormat::RGBA8; return true;                // DXGI_FORMAT_R8G8B8A8_TYPELESS, _UNORM
+		case 87: case 88: format = MipFormat::RGBA8; return true;                // DXGI_FORMAT_B8G8R8A8_UNORM, B8G8R8X8_UNORM
+		case 90: case 92: format = MipFormat::RGBA8; return true;                // DXGI_FORMAT_B8G8R8A8_TYPELESS, B8G8R8X8_TYPELESS
+		case 29: case 91: case 93:                                               // DXGI_FORMAT_R8G8B8A8_SRGB, B8G8R8A8_SRGB, B8G8R8X8_SRGB
+			format = MipFormat::RGBA8;
+			srgb = true;
+			return true;
+		default: return false;
+	}
+}
+
+size_t MipGenerator::countMips(size_t width, size_t height) {
+	size_t count = 1;
+	for (size_t size = std::max(width, height); size > 1; size >>= 1) count++;
+	return count;
+}
+
+size_t MipGenerator::layoutChain(MipFormat format, size_t width, size_t height, size_t mipCount, MipLevel* levels) {
+	size_t offset = 0;
+	for (size_t level = 0; level < mipCount; level++) {
+		MipLevel& mip = levels[level];
+		mip.width = std::max<size_t>(1, width >> level);
+		mip.height = std::max<size_t>(1, height >> level);
+		mip.rowPitch = mip.width * pixelBytes(format);
+		mip.slicePitch = mip.rowPitch * mip.height;
+		mip.offset = offset;
+		offset += mip.slicePitch;
+	}
+	return offset;
+}
+
+void MipGenerator::generate(MipFormat format, const Settings& settings,
+                            const uint8_t* src, size_t srcRowPitch,
+                            size_t mipCount, const MipLevel* levels, uint8_t* dst) {
+	if (mipCount == 0) return;
+
+	const MipLevel& top = levels[0];
+	for (size_t y = 0; y < top.height; y++) {
+		std::memcpy(dst + top.offset + y * top.rowPitch, src + y * srcRowPitch, top.rowPitch);
+	}
+
+	// Every level comes from the one right above it, that one is small and warm in the cache
+	for (size_t level = 1; level < mipCount; level++) {
+		const MipLevel& from = levels[level - 1];
+		const MipLevel& to = levels[level];
+		downsample(format, settings,
+		           dst + from.offset, from.rowPitch, from.width, from.height,
+		           dst + to.offset, to.rowPitch, to.width, to.height);
+	}
+}
+
+void MipGenerator::downsample(MipFormat format, const Settings& settings,
+                              const uint8_t* src, size_t srcRowPitch, size_t srcWidth, size_t srcHeight,
+                              uint8_t* dst, size_t dstRowPitch, size_t dstWidth, size_t dstHeight) {
+	const bool srgb = settings.srgb && format == MipFormat::RGBA8;
+	const Kernel horizontal = makeKernel(settings, srcWidth, dstWidth);
+	const Kernel vertical = makeKernel(settings, srcHeight, dstHeight);
+	const Kernels& kernels = *selectedKernels().load(std::memory_order_relaxed);
+
+	auto filterRows = [&](size_t firstRow, size_t endRow) {
+		// The source rows converted to floats, each once. The taps of a destination row are consecutive
+		// source rows (repeated at the edges), and the next destination rows move down, so a ring of
+		// as many rows as taps holds them all and every row replaces one that is no longer needed
+		const size_t rowSize = srcWidth * 4;
+		std::vector<float> converted(vertical.taps * rowSize);
+		std::vector<size_t> convertedRows(vertical.taps, SIZE_MAX);
+		std::vector<const float*> rows(vertical.taps);
+		std::vector<float> weights(vertical.taps), column(rowSize), out(dstWidth * 4);
+
+		for (size_t y = firstRow; y < endRow; y++) {
+			// Vertical pass into a single row of the source width...
+			size_t taps = 0;
+			for (size_t k = 0; k < vertical.taps; k++) {
+				const float weight = vertical.weights[y * vertical.taps + k];
+				if (weight == 0.f) continue;
+				const size_t index = vertical.indices[y * vertical.taps + k];
+				const size_t slot = index % vertical.taps;
+				if (convertedRows[slot] != index) {
+					loadRow(format, srgb, src + index * srcRowPitch, srcWidth, converted.data() + slot * rowSize);
+					convertedRows[slot] = index;
+				}
+				rows[taps] = converted.data() + slot * rowSize;
+				weights[taps++] = weight;
+			}
+			kernels.sumRows(rows.data(), weights.data(), taps, rowSize, column.data());
+
+			// ...then the horizontal one
+			kernels.sumPixels(column.data(), horizontal, dstWidth, out.data());
+
+			storeRow(format, srgb, out.data(), dstWidth, dst + y * dstRowPitch);
+		}
+	};
+
+	unsigned threads = settings.threads;
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t workers = std::min<size_t>(threads, std::max<size_t>(1, dstHeight / MIN_ROWS_PER_THREAD));
+	if (workers <= 1) {
+		filterRows(0, dstHeight);
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	size_t rowsPerWorker = (dstHeight + workers - 1) / workers;
+	for (size_t w = 1; w < workers; w++) {
+		size_t first = std::min(dstHeight, w * rowsPerWorker), end = std::min(dstHeight, first + rowsPerWorker);
+		pool.emplace_back(filterRows, first, end);
+	}
+	filterRows(0, std::min(dstHeight, rowsPerWorker));
+	for (auto& thread : pool) thread.join();
+}
+
+SIMDLevel MipGenerator::getSIMDLevel() {
+	return selectedKernels().load(std::memory_order_relaxed)->level;
+}
+
+bool MipGenerator::setSIMDLevel(SIMDLevel level) {
+	if (level > detectSIMDLevel()) return false;
+	selectedKernels().store(&kernelsFor(level), std::memory_order_relaxed);
+	return true;
+}
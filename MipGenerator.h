@@ -0,0 +1,68 @@
+#pragma once
+
+#include "CpuFeatures.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// The pixel layouts MipGenerator filters. RGBA8 covers R8G8B8A8 and B8G8R8A8/X8 (the filters treat
+// the channels alike, only the alpha has to be the last one), RGBA16F is R16G16B16A16_FLOAT
+enum class MipFormat { RGBA8, RGBA16F };
+
+// Box averages the covered source pixels (the classic 2x2 for the even sizes, exact weights for the odd ones).
+// Kaiser is a Kaiser-windowed sinc. It keeps the small levels sharper at the cost of more taps
+enum class MipFilter { Box, Kaiser };
+
+// One level of a chain. The levels are packed one after another in a single allocation
+struct MipLevel {
+	size_t width = 0, height = 0;
+	size_t rowPitch = 0, slicePitch = 0;
+	size_t offset = 0;    // From the start of the chain
+};
+
+// The CPU mip-chain builder for the uncompressed formats, for when the GPU can't generate the mips
+// (no D3D11 context, no MIP_AUTOGEN support, or Direct3D 12 that has no GenerateMips at all).
+//
+// Every level is filtered from the previous one with a separable filter. The sRGB colors are converted
+// to linear before filtering and back after, the alpha is always linear. The rows of a level are split
+// between threads, and every thread converts each source row it needs to floats once. The weighted
+// sums of the two passes have SSE4.1 and AVX2 kernels, picked at run time (see CpuFeatures.h); the
+// scalar ones are the fallback. Every level gives the same pixels.
+//
+// The class is pure logic, it doesn't touch Direct3D. The DXGI formats are passed as numbers.
+class MipGenerator {
+public:
+	struct Settings {
+		MipFilter filter = MipFilter::Box;
+		bool srgb = false;              // The color channels are sRGB-encoded. Ignored for RGBA16F
+		float kaiserRadius = 3.f;       // In the destination pixels
+		float kaiserAlpha = 4.f;        // The window shape. Higher is smoother, lower is sharper
+		unsigned threads = 0;           // 0 means "as many as the hardware has"
+	};
+
+	// Maps a DXGI_FORMAT. srgb is set for the _SRGB variants
+	static bool fromDXGIFormat(uint32_t dxgiFormat, MipFormat& format, bool& srgb);
+	static size_t pixelBytes(MipFormat format) { return format == MipFormat::RGBA8 ? 4 : 8; }
+
+	// The full chain down to 1x1
+	static size_t countMips(size_t width, size_t height);
+
+	// Fills mipCount levels (the level 0 included) with tightly packed rows, returns the size of the whole chain
+	static size_t layoutChain(MipFormat format, size_t width, size_t height, size_t mipCount, MipLevel* levels);
+
+	// Copies the level 0 from src into dst and builds the levels 1..mipCount-1 after it.
+	// levels and dst come from layoutChain
+	static void generate(MipFormat format, const Settings& settings,
+	                     const uint8_t* src, size_t srcRowPitch,
+	                     size_t mipCount, const MipLevel* levels, uint8_t* dst);
+
+	// A single level from any larger one
+	static void downsample(MipFormat format, const Settings& settings,
+	                       const uint8_t* src, size_t srcRowPitch, size_t srcWidth, size_t srcHeight,
+	                       uint8_t* dst, size_t dstRowPitch, size_t dstWidth, size_t dstHeight);
+
+	// The kernels downsample uses, the best ones of the CPU unless set otherwise (for the tests and
+	// the benchmarks). A level the CPU doesn't have isn't set
+	static SIMDLevel getSIMDLevel();
+	static bool setSIMDLevel(SIMDLevel level);
+};
@@ -0,0 +1,144 @@
+#include "MipStreamer.h"
+
+#include <algorithm>
+#include <utility>
+
+MipStreamer::MipStreamer(Settings settings) : settings(std::move(settings)) {
+	this->settings.maxInFlight = std::max(this->settings.maxInFlight, 1u);
+	this->settings.maxInFlightPerTexture = std::max(this->settings.maxInFlightPerTexture, 1u);
+}
+
+MipStreamer::MipStreamer() : MipStreamer(Settings()) { }
+
+MipStreamer::TextureId MipStreamer::add(const DDSLayout& layout, uint32_t residentMip, float priority) {
+	const TextureId id = reserve();
+	return add(id, layout, residentMip, priority) ? id : 0;
+}
+
+bool MipStreamer::add(TextureId id, const DDSLayout& layout, uint32_t residentMip, float priority) {
+	const uint32_t items = layout.dimension == DDSDimension::Texture3D ? 1 : layout.arraySize;
+	if (id == 0 || id >= nextId || textures.count(id) != 0 ||
+	    layout.mipCount == 0 || layout.mipCount > MAX_MIPS || residentMip >= layout.mipCount ||
+	    layout.subresources.size() != size_t(items) * layout.mipCount) {
+		return false;
+	}
+
+	Texture texture;
+	texture.layout = layout;
+	texture.items = items;
+	texture.priority = priority;
+	texture.residentMip = residentMip;
+	for (uint32_t mip = residentMip; mip < layout.mipCount; mip++) texture.landed |= 1u << mip;
+
+	textures.emplace(id, std::move(texture));
+	return true;
+}
+
+void MipStreamer::remove(TextureId texture) {
+	textures.erase(texture);
+}
+
+void MipStreamer::setPriority(TextureId texture, float priority) {
+	auto it = textures.find(texture);
+	if (it != textures.end()) it->second.priority = priority;
+}
+
+void MipStreamer::setWantedMip(TextureId texture, uint32_t mip) {
+	auto it = textures.find(texture);
+	if (it != textures.end()) it->second.wantedMip = std::min(mip, it->second.layout.mipCount - 1);
+}
+
+uint32_t MipStreamer::nextMip(const Texture& texture) {
+	for (uint32_t mip = texture.residentMip; mip-- > texture.wantedMip;) {
+		if (!((texture.landed | texture.inFlight) & (1u << mip))) return mip;
+	}
+	return NO_MIP;
+}
+
+size_t MipStreamer::levelSize(const Texture& texture, uint32_t mip) {
+	const DDSSubresource& sub = texture.layout.subresources[mip];    // Every item has the same
+	return sub.slicePitch * sub.depth * texture.items;
+}
+
+std::vector<MipStreamRequest> MipStreamer::schedule() {
+	std::vector<MipStreamRequest> requests;
+	while (stats.inFlight < settings.maxInFlight) {
+		Texture* best = nullptr;
+		TextureId bestId = 0;
+		uint32_t bestMip = NO_MIP;
+		for (auto& [id, texture] : textures) {
+			if (texture.inFlightCount >= settings.maxInFlightPerTexture) continue;
+			const uint32_t mip = nextMip(texture);
+			if (mip == NO_MIP) continue;
+			if (stats.inFlight > 0 && stats.inFlightBytes + levelSize(texture, mip) > settings.maxInFlightBytes) continue;
+
+			if (!best || texture.priority > best->priority ||
+			    (texture.priority == best->priority && texture.residentMip > best->residentMip)) {
+				best = &texture;
+				bestId = id;
+				bestMip = mip;
+			}
+		}
+		if (!best) break;
+
+		MipStreamRequest request;
+		request.texture = bestId;
+		request.mip = bestMip;
+		for (uint32_t item = 0; item < best->items; item++) {
+			const DDSSubresource& sub = best->layout.subresources[size_t(item) * best->layout.mipCount + bestMip];
+			request.ranges.push_back({ sub.offset, sub.slicePitch * sub.depth });
+			request.size += sub.slicePitch * sub.depth;
+		}
+
+		best->inFlight |= 1u << bestMip;
+		best->inFlightCount++;
+		stats.inFlight++;
+		stats.inFlightBytes += request.size;
+		stats.requested++;
+		requests.push_back(std::move(request));
+	}
+	return requests;
+}
+
+void MipStreamer::release(const MipStreamRequest& request) {
+	stats.inFlight--;
+	stats.inFlightBytes -= request.size;
+
+	auto it = textures.find(request.texture);
+	if (it == textures.end()) return;
+	it->second.inFlight &= ~(1u << request.mip);
+	it->second.inFlightCount--;
+}
+
+bool MipStreamer::complete(const MipStreamRequest& request) {
+	release(request);
+	stats.completed++;
+
+	auto it = textures.find(request.texture);
+	if (it == textures.end()) return false;
+	Texture& texture = it->second;
+
+	texture.landed |= 1u << request.mip;
+	const uint32_t before = texture.residentMip;
+	while (texture.residentMip > 0 && (texture.landed & (1u << (texture.residentMip - 1)))) texture.residentMip--;
+	return texture.residentMip != before;
+}
+
+void MipStreamer::fail(const MipStreamRequest& request) {
+	release(request);
+	stats.failed++;
+
+	// The finer levels can't become resident without this one
+	auto it = textures.find(request.texture);
+	if (it != textures.end()) it->second.wantedMip = std::max(it->second.wantedMip, request.mip + 1);
+}
+
+uint32_t MipStreamer::getResidentMip(TextureId texture) const {
+	auto it = textures.find(texture);
+	return it != textures.end() ? it->second.residentMip : MAX_MIPS;
+}
+
+bool MipStreamer::isStreamed(TextureId texture) const {
+	auto it = textures.find(texture);
+	return it != textures.end() && it->second.residentMip <= it->second.wantedMip;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "DDSParser.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <vector>
+
+// One read of a streamed texture: a mip level of every array item
+struct MipStreamRequest {
+	uint32_t texture = 0;
+	uint32_t mip = 0;
+	std::vector<DDSByteRange> ranges;    // One per array item, in the subresource order
+	size_t size = 0;                     // Of all the ranges
+};
+
+// The scheduling and the residency of progressively streamed textures, without the I/O and the GPU,
+// so the same rules drive any backend (DDSTextureStreamer in DDSTextureLoader12.h).
+//
+// A texture starts with the coarse tail of its chain resident (what was uploaded at creation), and
+// its finer mips are read one level at a time, coarse to fine, down to the wanted mip. A level becomes
+// resident, and the min LOD clamp of the texture drops to it, only when all the coarser ones are: the
+// uploads may land in any order, the sampling never sees a hole. The textures with the highest priority
+// (say, their area on the screen) go first, the blurriest ones first among equals. The reads in flight
+// are bounded in number and in bytes.
+//
+// Not thread-safe, it belongs to the thread that issues the reads and the uploads.
+class MipStreamer {
+public:
+	using TextureId = uint32_t;
+
+	struct Settings {
+		size_t maxInFlightBytes = size_t(64) << 20;    // A larger level still goes, alone
+		uint32_t maxInFlight = 16;
+		uint32_t maxInFlightPerTexture = 2;            // The levels of one texture read together
+	};
+
+	struct Stats {
+		uint64_t requested = 0, completed = 0, failed = 0;
+		uint32_t inFlight = 0;
+		size_t inFlightBytes = 0;
+	};
+
+	explicit MipStreamer(Settings settings);
+	MipStreamer();
+
+	// The layout needs all the subresources (computeSubresources without maxsize). The mips from
+	// residentMip on are resident already. Returns 0 if the layout has no such mip
+	TextureId add(const DDSLayout& layout, uint32_t residentMip, float priority = 1);
+	// An ID for a texture whose layout isn't known yet, so that the caller can hand it out before
+	// the header is read. The texture is unknown until add takes the ID
+	TextureId reserve() { return nextId++; }
+	// With a reserved ID. Returns false if the layout has no such mip or the ID is taken
+	bool add(TextureId texture, const DDSLayout& layout, uint32_t residentMip, float priority = 1);
+	// The reads in flight for it are dropped when they come back
+	void remove(TextureId texture);
+	void setPriority(TextureId texture, float priority);
+	// The finest mip to stream in, 0 (the default) is the whole chain. A coarser one than the resident
+	// mip stops the streaming but evicts nothing
+	void setWantedMip(TextureId texture, uint32_t mip);
+
+	// The reads to issue now, the most important first
+	std::vector<MipStreamRequest> schedule();
+	// The level is read and uploaded. Returns true if the resident mip of the texture moved
+	bool complete(const MipStreamRequest& request);
+	// The read or the upload failed. The texture stops above that level, setWantedMip restarts it
+	void fail(const MipStreamRequest& request);
+
+	bool contains(TextureId texture) const { return textures.count(texture) != 0; }
+	// The min LOD clamp of the views, past any chain if the texture is unknown
+	uint32_t getResidentMip(TextureId texture) const;
+	// Resident down to the wanted mip, nothing left to read
+	bool isStreamed(TextureId texture) const;
+	const Stats& getStats() const { return stats; }
+
+private:
+	struct Texture {
+		DDSLayout layout;
+		uint32_t items = 0;           // Array items, the cube faces included (1 for the 3D textures)
+		float priority = 1;
+		uint32_t residentMip = 0;
+		uint32_t wantedMip = 0;
+		uint32_t landed = 0;          // A bit per mip: resident, or uploaded before the coarser ones
+		uint32_t inFlight = 0;        // A bit per mip
+		uint32_t inFlightCount = 0;
+	};
+
+	static constexpr uint32_t NO_MIP = UINT32_MAX;
+	static constexpr uint32_t MAX_MIPS = 32;    // The bit masks. Direct3D allows 15
+
+	Settings settings;
+	std::map<TextureId, Texture> textures;    // Ordered, so the ties break the same way every time
+	TextureId nextId = 1;
+	Stats stats;
+
+	// The coarsest mip that is needed and neither landed nor in flight
+	static uint32_t nextMip(const Texture& texture);
+	static size_t levelSize(const Texture& texture, uint32_t mip);
+	void release(const MipStreamRequest& request);
+};
@@ -0,0 +1,118 @@
+#include "PipelineCache.h"
+
+#include <cwchar>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+PipelineCache::PipelineCache(ID3D12Device* device, std::filesystem::path libraryPath) :
+		device(device), libraryPath(std::move(libraryPath)) {
+	if (!this->libraryPath.empty()) openLibrary();
+}
+
+void PipelineCache::openLibrary() {
+	ID3D12Device1* device1 = nullptr;
+	if (FAILED(device->QueryInterface(IID_PPV_ARGS(&device1)))) return;   // Pipeline libraries need Windows 10 1607+
+
+	{
+		std::ifstream file(libraryPath, std::ios::in | std::ios::binary | std::ios::ate);
+		if (file) {
+			std::streamoff size = file.tellg();
+			if (size > 0) {
+				libraryBlob.resize(static_cast<size_t>(size));
+				file.seekg(0, std::ios::beg);
+				file.read(reinterpret_cast<char*>(libraryBlob.data()), size);
+				if (!file) libraryBlob.clear();
+			}
+		}
+	}
+
+	HRESULT hr = device1->CreatePipelineLibrary(libraryBlob.data(), libraryBlob.size(), IID_PPV_ARGS(&library));
+	if (FAILED(hr) && !libraryBlob.empty()) {
+		// The blob was made by another driver or adapter (or is just corrupted). Starting from scratch
+		libraryBlob.clear();
+		hr = device1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&library));
+	}
+	if (FAILED(hr)) library = nullptr;
+
+	device1->Release();
+}
+
+ID3D12RootSignature* PipelineCache::getRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc) {
+	uint64_t key = hashRootSignature(desc);
+	if (auto it = rootSignatures.find(key); it != rootSignatures.end()) {
+		return it->second;
+	}
+
+	ID3DBlob* serializedDesc = nullptr;
+	hr_check(D3D12SerializeVersionedRootSignature(&desc, &serializedDesc, nullptr));
+
+	ID3D12RootSignature* rootSignature;
+	hr_check(device->CreateRootSignature(0,
+	                                     serializedDesc->GetBufferPointer(),
+	                                     serializedDesc->GetBufferSize(),
+	                                     IID_PPV_ARGS(&rootSignature)));
+	serializedDesc->Release();
+
+	rootSignatures.emplace(key, rootSignature);
+	rootSignatureKeys.emplace(rootSignature, key);
+	return rootSignature;
+}
+
+ID3D12PipelineState* PipelineCache::getGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc) {
+	uint64_t rootSignatureKey = 0;
+	if (auto it = rootSignatureKeys.find(desc.pRootSignature); it != rootSignatureKeys.end()) {
+		rootSignatureKey = it->second;
+	} else {
+		// A root signature created outside of this cache. Its pointer is the only identity we know
+		rootSignatureKey = reinterpret_cast<uintptr_t>(desc.pRootSignature);
+	}
+
+	uint64_t key = hashGraphicsPipeline(desc, rootSignatureKey);
+	if (auto it = pipelines.find(key); it != pipelines.end()) {
+		return it->second;
+	}
+
+	ID3D12PipelineState* pipeline = nullptr;
+	wchar_t name[32];
+	swprintf(name, sizeof(name) / sizeof(name[0]), L"%016llx", static_cast<unsigned long long>(key));
+
+	if (library == nullptr || FAILED(library->LoadGraphicsPipeline(name, &desc, IID_PPV_ARGS(&pipeline)))) {
+		hr_check(device->CreateGraphicsPipelineState(&desc, IID_PPV_ARGS(&pipeline)));
+		if (library != nullptr && SUCCEEDED(library->StorePipeline(name, pipeline))) {
+			libraryDirty = true;
+		}
+	}
+
+	pipelines.emplace(key, pipeline);
+	return pipeline;
+}
+
+void PipelineCache::save() {
+	if (library == nullptr || !libraryDirty) return;
+
+	std::vector<uint8_t> blob(library->GetSerializedSize());
+	if (FAILED(library->Serialize(blob.data(), blob.size()))) return;
+
+	// Writing to a temporary file and renaming it, so that a crash never leaves a truncated library
+	auto tmpPath = libraryPath;
+	tmpPath += ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file) return;
+		file.write(reinterpret_cast<const char*>(blob.data()), static_cast<std::streamsize>(blob.size()));
+		if (!file) return;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, libraryPath, ec);
+	if (ec) std::filesystem::remove(tmpPath, ec);
+	else libraryDirty = false;
+}
+
+PipelineCache::~PipelineCache() {
+	save();
+	for (auto& p : pipelines) { p.second->Release(); }
+	if (library != nullptr) { library->Release(); }
+	for (auto& rs : rootSignatures) { rs.second->Release(); }
+}
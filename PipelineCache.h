@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Base.h"
+#include "PipelineHash.h"
+
+#include <directx/d3d12.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <unordered_map>
+#include <vector>
+
+// Root signature and graphics pipeline state cache for the D3D12 backend.
+//
+// Both kinds of objects are keyed by stable hashes of their descriptions, so any number
+// of different GraphicContents shaders can share one cache. The pipeline states are also
+// stored into an ID3D12PipelineLibrary that is serialized to disk, so that the next start
+// of the app doesn't have to wait for the driver to compile them again.
+class PipelineCache : public Base {
+	ID3D12Device* device;
+
+	std::unordered_map<uint64_t, ID3D12RootSignature*> rootSignatures;
+	std::unordered_map<ID3D12RootSignature*, uint64_t> rootSignatureKeys;
+	std::unordered_map<uint64_t, ID3D12PipelineState*> pipelines;
+
+	std::filesystem::path libraryPath;
+	std::vector<uint8_t> libraryBlob;       // Has to outlive the library, which references it
+	ID3D12PipelineLibrary* library = nullptr;
+	bool libraryDirty = false;
+
+	void openLibrary();
+
+public:
+	// The hashing layer, see PipelineHash.h. It doesn't touch the device, so it is tested without one
+	static uint64_t hashRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc) {
+		return PipelineHash::hashRootSignature(desc);
+	}
+	static uint64_t hashGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc, uint64_t rootSignatureKey) {
+		return PipelineHash::hashGraphicsPipeline(desc, rootSignatureKey);
+	}
+
+	// An empty path disables the on-disk pipeline library
+	explicit PipelineCache(ID3D12Device* device, std::filesystem::path libraryPath = {});
+
+	// The returned objects are owned by the cache. A hit costs a hash of the description,
+	// the root signature is serialized only when it is created
+	ID3D12RootSignature* getRootSignature(const D3D12_VERSIONED_ROOT_SIGNATURE_DESC& desc);
+	ID3D12PipelineState* getGraphicsPipeline(const D3D12_GRAPHICS_PIPELINE_STATE_DESC& desc);
+
+	// Writes the pipeline library to disk if any new pipeline has been added to it
+	void save();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+	~PipelineCache();
+};
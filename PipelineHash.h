@@ -0,0 +1,148 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+// The hashing layer of PipelineCache, the stable keys of the D3D12 root signature and pipeline descriptions.
+//
+// The functions are templates over the description structures, so this header doesn't need d3d12.h:
+// the backend instantiates them with the D3D12 structures, the tests with look-alikes that have
+// the same fields. The structures are hashed field by field, because the padding bytes between
+// the small fields are not guaranteed to be initialized. Everything behind a pointer is hashed
+// by contents: the shader bytecode, the input layout, the root parameters and the samplers.
+namespace PipelineHash {
+	// The values of D3D_ROOT_SIGNATURE_VERSION and D3D12_ROOT_PARAMETER_TYPE
+	static const int ROOT_SIGNATURE_VERSION_1_0 = 1;
+	static const int ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE = 0;
+	static const int ROOT_PARAMETER_TYPE_32BIT_CONSTANTS = 1;
+
+	inline void addString(Fnv1a64& h, const char* str) {
+		h.add(str != nullptr ? str : "");
+	}
+
+	template <typename Bytecode>
+	void addBytecode(Fnv1a64& h, const Bytecode& bytecode) {
+		h.addValue(static_cast<uint64_t>(bytecode.BytecodeLength));
+		if (bytecode.pShaderBytecode != nullptr) h.add(bytecode.pShaderBytecode, bytecode.BytecodeLength);
+	}
+
+	template <typename StencilOp>
+	void addStencilOp(Fnv1a64& h, const StencilOp& op) {
+		h.addValue(op.StencilFailOp).addValue(op.StencilDepthFailOp).addValue(op.StencilPassOp).addValue(op.StencilFunc);
+	}
+
+	// The version 1.1 structures add the Flags fields to the 1.0 ones
+	template <typename Range>
+	void addDescriptorRange(Fnv1a64& h, const Range& range) {
+		h.addValue(range.RangeType).addValue(range.NumDescriptors).addValue(range.BaseShaderRegister)
+		 .addValue(range.RegisterSpace).addValue(range.OffsetInDescriptorsFromTableStart);
+		if constexpr (requires { range.Flags; }) h.addValue(range.Flags);
+	}
+
+	template <typename Parameter>
+	void addRootParameter(Fnv1a64& h, const Parameter& parameter) {
+		h.addValue(parameter.ParameterType).addValue(parameter.ShaderVisibility);
+		if (int(parameter.ParameterType) == ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE) {
+			const auto& table = parameter.DescriptorTable;
+			h.addValue(table.NumDescriptorRanges);
+			for (size_t i = 0; i < table.NumDescriptorRanges; i++) addDescriptorRange(h, table.pDescriptorRanges[i]);
+		} else if (int(parameter.ParameterType) == ROOT_PARAMETER_TYPE_32BIT_CONSTANTS) {
+			const auto& constants = parameter.Constants;
+			h.addValue(constants.ShaderRegister).addValue(constants.RegisterSpace).addValue(constants.Num32BitValues);
+		} else {
+			const auto& descriptor = parameter.Descriptor;
+			h.addValue(descriptor.ShaderRegister).addValue(descriptor.RegisterSpace);
+			if constexpr (requires { descriptor.Flags; }) h.addValue(descriptor.Flags);
+		}
+	}
+
+	template <typename Sampler>
+	void addStaticSampler(Fnv1a64& h, const Sampler& s) {
+		h.addValue(s.Filter).addValue(s.AddressU).addValue(s.AddressV).addValue(s.AddressW)
+		 .addValue(s.MipLODBias).addValue(s.MaxAnisotropy).addValue(s.ComparisonFunc).addValue(s.BorderColor)
+		 .addValue(s.MinLOD).addValue(s.MaxLOD).addValue(s.ShaderRegister).addValue(s.RegisterSpace)
+		 .addValue(s.ShaderVisibility);
+	}
+
+	template <typename RootSignatureDesc>
+	void addRootSignatureDesc(Fnv1a64& h, const RootSignatureDesc& desc) {
+		h.addValue(desc.NumParameters);
+		for (size_t i = 0; i < desc.NumParameters; i++) addRootParameter(h, desc.pParameters[i]);
+		h.addValue(desc.NumStaticSamplers);
+		for (size_t i = 0; i < desc.NumStaticSamplers; i++) addStaticSampler(h, desc.pStaticSamplers[i]);
+		h.addValue(desc.Flags);
+	}
+
+	// D3D12_VERSIONED_ROOT_SIGNATURE_DESC. Any version above 1.0 is hashed as 1.1
+	template <typename VersionedDesc>
+	uint64_t hashRootSignature(const VersionedDesc& desc) {
+		Fnv1a64 h;
+		h.addValue(desc.Version);
+		if (int(desc.Version) == ROOT_SIGNATURE_VERSION_1_0) addRootSignatureDesc(h, desc.Desc_1_0);
+		else addRootSignatureDesc(h, desc.Desc_1_1);
+		return h.value;
+	}
+
+	// D3D12_GRAPHICS_PIPELINE_STATE_DESC. The root signature is hashed by its own key
+	template <typename PipelineDesc>
+	uint64_t hashGraphicsPipeline(const PipelineDesc& desc, uint64_t rootSignatureKey) {
+		Fnv1a64 h;
+		h.addValue(rootSignatureKey);
+
+		addBytecode(h, desc.VS);
+		addBytecode(h, desc.PS);
+		addBytecode(h, desc.DS);
+		addBytecode(h, desc.HS);
+		addBytecode(h, desc.GS);
+
+		h.addValue(desc.StreamOutput.NumEntries);
+		for (size_t i = 0; i < desc.StreamOutput.NumEntries; i++) {
+			const auto& e = desc.StreamOutput.pSODeclaration[i];
+			h.addValue(e.Stream);
+			addString(h, e.SemanticName);
+			h.addValue(e.SemanticIndex).addValue(e.StartComponent).addValue(e.ComponentCount).addValue(e.OutputSlot);
+		}
+		h.addValue(desc.StreamOutput.NumStrides);
+		for (size_t i = 0; i < desc.StreamOutput.NumStrides; i++) h.addValue(desc.StreamOutput.pBufferStrides[i]);
+		h.addValue(desc.StreamOutput.RasterizedStream);
+
+		h.addValue(desc.BlendState.AlphaToCoverageEnable).addValue(desc.BlendState.IndependentBlendEnable);
+		for (const auto& rt : desc.BlendState.RenderTarget) {
+			h.addValue(rt.BlendEnable).addValue(rt.LogicOpEnable)
+			 .addValue(rt.SrcBlend).addValue(rt.DestBlend).addValue(rt.BlendOp)
+			 .addValue(rt.SrcBlendAlpha).addValue(rt.DestBlendAlpha).addValue(rt.BlendOpAlpha)
+			 .addValue(rt.LogicOp).addValue(rt.RenderTargetWriteMask);
+		}
+		h.addValue(desc.SampleMask);
+
+		const auto& rs = desc.RasterizerState;
+		h.addValue(rs.FillMode).addValue(rs.CullMode).addValue(rs.FrontCounterClockwise)
+		 .addValue(rs.DepthBias).addValue(rs.DepthBiasClamp).addValue(rs.SlopeScaledDepthBias)
+		 .addValue(rs.DepthClipEnable).addValue(rs.MultisampleEnable).addValue(rs.AntialiasedLineEnable)
+		 .addValue(rs.ForcedSampleCount).addValue(rs.ConservativeRaster);
+
+		const auto& ds = desc.DepthStencilState;
+		h.addValue(ds.DepthEnable).addValue(ds.DepthWriteMask).addValue(ds.DepthFunc)
+		 .addValue(ds.StencilEnable).addValue(ds.StencilReadMask).addValue(ds.StencilWriteMask);
+		addStencilOp(h, ds.FrontFace);
+		addStencilOp(h, ds.BackFace);
+
+		h.addValue(desc.InputLayout.NumElements);
+		for (size_t i = 0; i < desc.InputLayout.NumElements; i++) {
+			const auto& e = desc.InputLayout.pInputElementDescs[i];
+			addString(h, e.SemanticName);
+			h.addValue(e.SemanticIndex).addValue(e.Format).addValue(e.InputSlot).addValue(e.AlignedByteOffset)
+			 .addValue(e.InputSlotClass).addValue(e.InstanceDataStepRate);
+		}
+
+		h.addValue(desc.IBStripCutValue).addValue(desc.PrimitiveTopologyType).addValue(desc.NumRenderTargets);
+		for (size_t i = 0; i < desc.NumRenderTargets && i < std::size(desc.RTVFormats); i++) h.addValue(desc.RTVFormats[i]);
+		h.addValue(desc.DSVFormat).addValue(desc.SampleDesc.Count).addValue(desc.SampleDesc.Quality)
+		 .addValue(desc.NodeMask).addValue(desc.Flags);
+
+		return h.value;
+	}
+}
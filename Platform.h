@@ -0,0 +1,35 @@
+#pragma once
+
+#include "DisplayTopology.h"
+#include "GraphicContents.h"
+#include "TraceRecorder.h"
+
+// The platform abstraction of the resize pipeline.
+//
+// A RenderSurface owns the swap chain (or its emulation), draws the contents into it and
+// presents the frame. D3DContext is the Windows implementation, HeadlessSurface is the one
+// that runs anywhere without a window or a GPU.
+struct RenderSurface {
+	// Resize the buffers to the new client rect (in the desktop coordinates), redraw and present.
+	// Must not return before the frame with the new size is presented
+	virtual void reposition(const DisplayRect& position) = 0;
+
+	// Redraw at the last position and present on a vblank, for the continuous animation.
+	// Blocks as long as the vsync pacing needs, so the caller's loop runs at the refresh rate
+	virtual void presentFrame() = 0;
+
+	virtual ~RenderSurface() = default;
+};
+
+// The code path every platform runs for a resize request (WM_NCCALCSIZE on Windows).
+// Keeping it in one place is what makes the headless measurements representative
+template <typename V>
+void handleResize(_GraphicContents<V>& contents, RenderSurface& surface, const DisplayRect& rect) {
+	if (rect.right > rect.left && rect.bottom > rect.top) {
+		{
+			ScopedTimer layoutTimer("updateLayout");
+			contents.updateLayout(rect.right - rect.left, rect.bottom - rect.top);
+		}
+		surface.reposition(rect);
+	}
+}
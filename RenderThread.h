@@ -0,0 +1,208 @@
+#pragma once
+
+#include "DisplayTopology.h"
+#include "FramePacer.h"
+#include "GraphicContents.h"
+#include "Platform.h"
+#include "SPSCQueue.h"
+#include "TraceRecorder.h"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+// The thread that owns the RenderSurface and the contents, decoupled from the message pump.
+//
+// The message thread posts its requests through an SPSCQueue and doesn't touch the surface itself.
+// Every request has a sequence number, and the render thread publishes the last one it finished.
+// A resize waits for its own number, that is for the frame with the new size to be presented:
+// WM_NCCALCSIZE must not return before that, or the window flickers. Nothing else blocks the
+// message thread. The surface is created and destroyed on the render thread too.
+//
+// In the continuous mode the render thread doesn't sleep on the queue: it polls it between the
+// frames and presents an animation frame whenever it is empty. The surface paces those to the
+// vblanks, the FramePacer times every frame and feeds the delta to the contents. A resize still
+// waits for its own frame, which the loop picks up before the next animation one.
+//
+// An exception thrown on the render thread is rethrown on the message thread by the next wait
+// (the only lock here, and only taken once something has failed).
+template <typename V>
+class RenderThread {
+public:
+	typedef std::function<std::shared_ptr<RenderSurface>()> SurfaceFactory;
+	typedef std::function<void(RenderSurface&)> Task;
+
+	static const size_t DEFAULT_QUEUE_CAPACITY = 64;
+
+private:
+	struct Request {
+		enum class Type { Resize, Task, Stop } type = Type::Stop;
+		uint64_t sequence = 0;
+		DisplayRect rect = {};
+		Task task;
+	};
+
+	std::shared_ptr<_GraphicContents<V>> contents;
+	std::shared_ptr<RenderSurface> surface;
+	SPSCQueue<Request> queue;
+
+	uint64_t posted = 0;                    // The message thread's side
+	std::atomic<uint64_t> completed = 0;    // The render thread's side
+	// The first exception of the render thread, until a wait rethrows it
+	std::atomic<bool> failed = false;
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	// The render thread's only
+	bool animating = false;
+	FramePacer pacer;
+
+	std::thread thread;
+
+	void run(SurfaceFactory factory) {
+		try {
+			surface = factory();
+		} catch (...) {
+			fail(std::current_exception());
+		}
+		complete(1);
+		if (!surface) return;
+
+		Request request;
+		while (true) {
+			if (!animating) {
+				queue.pop(request);
+			} else if (!queue.tryPop(request)) {
+				animate();
+				continue;
+			}
+			if (request.type == Request::Type::Stop) break;
+			try {
+				if (request.type == Request::Type::Resize) {
+					if (animating) contents->update(pacer.beginFrame(TraceRecorder::now()));
+					handleResize(*contents, *surface, request.rect);
+				} else {
+					request.task(*surface);
+				}
+			} catch (...) {
+				fail(std::current_exception());
+			}
+			request.task = nullptr;
+			complete(request.sequence);
+		}
+		surface.reset();
+	}
+
+	void animate() {
+		try {
+			contents->update(pacer.beginFrame(TraceRecorder::now()));
+			surface->presentFrame();
+		} catch (...) {
+			// Back to the requests only, rather than failing every frame
+			animating = false;
+			fail(std::current_exception());
+		}
+	}
+
+	void fail(std::exception_ptr exception) {
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if (!error) error = std::move(exception);
+		failed.store(true, std::memory_order_release);
+	}
+
+	void complete(uint64_t sequence) {
+		completed.store(sequence, std::memory_order_release);
+		completed.notify_all();
+	}
+
+	uint64_t enqueue(Request&& request) {
+		const uint64_t sequence = request.sequence = ++posted;
+		queue.push(std::move(request));
+		return sequence;
+	}
+
+	void waitFor(uint64_t sequence) {
+		uint64_t current;
+		while ((current = completed.load(std::memory_order_acquire)) < sequence) {
+			completed.wait(current, std::memory_order_acquire);
+		}
+		if (!failed.load(std::memory_order_acquire)) return;
+
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock(errorMutex);
+			exception = std::exchange(error, nullptr);
+			failed.store(false, std::memory_order_relaxed);
+		}
+		if (exception) std::rethrow_exception(exception);
+	}
+
+public:
+	// Blocks until the factory has created the surface on the new thread
+	RenderThread(std::shared_ptr<_GraphicContents<V>> contents, SurfaceFactory factory,
+	             size_t queueCapacity = DEFAULT_QUEUE_CAPACITY) :
+			contents(std::move(contents)), queue(queueCapacity) {
+		posted = 1;     // The creation
+		thread = std::thread(&RenderThread::run, this, std::move(factory));
+		try {
+			waitFor(posted);
+		} catch (...) {
+			thread.join();
+			throw;
+		}
+	}
+
+	~RenderThread() {
+		enqueue({ Request::Type::Stop, 0, {}, nullptr });
+		thread.join();
+	}
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	// For the setup on the message thread that has to see the surface, DirectComposition binding
+	// it to the window for one. Don't draw with it
+	const std::shared_ptr<RenderSurface>& getSurface() const { return surface; }
+
+	// Lays the contents out for the new rect and returns once the frame is presented
+	void resize(const DisplayRect& rect) {
+		uint64_t sequence = enqueue({ Request::Type::Resize, 0, rect, nullptr });
+		ScopedTimer timer("WaitForPresent");
+		waitFor(sequence);
+	}
+
+	// Runs the task on the render thread between the frames and returns at once
+	void post(Task task) {
+		enqueue({ Request::Type::Task, 0, {}, std::move(task) });
+	}
+
+	// Returns once everything posted so far has run
+	void flush() {
+		waitFor(posted);
+	}
+
+	// Renders continuously from the next frame on. The period is only for the statistics, 0 means the default
+	void startAnimation(int64_t refreshPeriodNs) {
+		post([this, refreshPeriodNs](RenderSurface&) {
+			pacer.reset(refreshPeriodNs);
+			animating = true;
+		});
+	}
+
+	void stopAnimation() {
+		post([this](RenderSurface&) { animating = false; });
+	}
+
+	// A copy taken between the frames, with the statistics since the last start
+	FramePacer getFramePacer() {
+		FramePacer result;
+		post([this, &result](RenderSurface&) { result = pacer; });
+		flush();
+		return result;
+	}
+};
@@ -0,0 +1,56 @@
+#include "ResizePolicy.h"
+
+#include <algorithm>
+#include <utility>
+
+ResizePolicy::ResizePolicy(Settings settings) : settings(std::move(settings)) { }
+
+ResizePolicy::ResizePolicy() : ResizePolicy(Settings()) { }
+
+int ResizePolicy::roundUp(int value, int limit) const {
+	int g = std::max(settings.granularity, 1);
+	int rounded = (value + g - 1) / g * g;
+	// Never exceed the limit, unless the requested size does that itself
+	return std::max(value, std::min(rounded, limit));
+}
+
+bool ResizePolicy::update(BufferSize requested) {
+	bool grow = requested.width > allocated.width || requested.height > allocated.height;
+
+	bool tooSmall = requested.width < allocated.width * settings.shrinkThreshold ||
+	                requested.height < allocated.height * settings.shrinkThreshold;
+	tooSmallUpdates = tooSmall ? tooSmallUpdates + 1 : 0;
+	bool shrink = !grow && tooSmallUpdates >= settings.shrinkDelay;
+
+	if (!grow && !shrink) return false;
+
+	BufferSize next;
+	if (grow) {
+		// Only the overflowing dimensions grow, the other ones keep their allocation.
+		// The growth stops at the limits, the requested size doesn't
+		next.width = requested.width > allocated.width
+				? roundUp(std::max(requested.width, std::min(int(allocated.width * settings.growthFactor), settings.maxWidth)),
+				          settings.maxWidth)
+				: allocated.width;
+		next.height = requested.height > allocated.height
+				? roundUp(std::max(requested.height, std::min(int(allocated.height * settings.growthFactor), settings.maxHeight)),
+				          settings.maxHeight)
+				: allocated.height;
+	} else {
+		next.width = roundUp(requested.width, settings.maxWidth);
+		next.height = roundUp(requested.height, settings.maxHeight);
+	}
+
+	tooSmallUpdates = 0;
+	if (next == allocated) return false;
+
+	allocated = next;
+	reallocations++;
+	return true;
+}
+
+size_t ResizePolicy::replay(const Settings& settings, const std::vector<BufferSize>& trace) {
+	ResizePolicy policy(settings);
+	for (const auto& size : trace) policy.update(size);
+	return policy.getReallocations();
+}
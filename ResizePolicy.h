@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct BufferSize {
+	int width = 0, height = 0;
+
+	bool operator==(const BufferSize& other) const = default;
+};
+
+// Decides when the swap chain buffers have to be reallocated during a live resize.
+//
+// The buffers are allocated in size buckets: they grow geometrically (and are rounded
+// to a granularity), so a dragged window edge crosses a bucket boundary only now and then.
+// Shrinking happens with a hysteresis: only after the requested size has stayed well below
+// the allocated one for several updates in a row. In between, the renderer draws into
+// the top-left part of the buffers and presents just that part (SetSourceSize).
+//
+// The class is pure logic, it doesn't touch DXGI.
+class ResizePolicy {
+public:
+	struct Settings {
+		int granularity = 64;           // Allocated sizes are multiples of this
+		float growthFactor = 1.25f;     // A growing dimension gets at least this much bigger
+		float shrinkThreshold = 0.5f;   // A dimension below this part of the allocation is "too small"
+		int shrinkDelay = 30;           // ...for this many updates in a row, then the buffers shrink
+		int maxWidth = 16384, maxHeight = 16384;   // D3D11/D3D12 texture size limits
+	};
+
+private:
+	Settings settings;
+	BufferSize allocated;
+	int tooSmallUpdates = 0;
+	size_t reallocations = 0;
+
+	int roundUp(int value, int limit) const;
+
+public:
+	explicit ResizePolicy(Settings settings);
+	ResizePolicy();
+
+	// Takes the new client size. Returns true if the buffers have to be reallocated to getAllocated()
+	bool update(BufferSize requested);
+
+	BufferSize getAllocated() const { return allocated; }
+	size_t getReallocations() const { return reallocations; }
+
+	// Replays a recorded drag trace (the sequence of client sizes) through a fresh policy
+	// and returns the number of reallocations it causes
+	static size_t replay(const Settings& settings, const std::vector<BufferSize>& trace);
+};
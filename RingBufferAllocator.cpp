@@ -0,0 +1,32 @@
+#include "RingBufferAllocator.h"
+
+size_t RingBufferAllocator::grownCapacity(size_t current, size_t required) {
+	size_t result = current < MIN_CAPACITY ? MIN_CAPACITY : current;
+	while (result < required) result *= 2;
+	return result;
+}
+
+void RingBufferAllocator::reset(size_t newCapacity) {
+	capacity = newCapacity;
+	head = 0;
+	discardPending = true;
+}
+
+bool RingBufferAllocator::allocate(size_t size, size_t alignment, Allocation& allocation) {
+	if (size > capacity) return false;
+
+	size_t offset = head;
+	if (alignment > 1) offset = (offset + alignment - 1) / alignment * alignment;
+
+	bool discard = discardPending;
+	if (offset > capacity || size > capacity - offset) {
+		// Wrapping around. The whole buffer is renamed by the driver, so we start from zero
+		offset = 0;
+		discard = true;
+	}
+
+	discardPending = false;
+	head = offset + size;
+	allocation = { offset, discard };
+	return true;
+}
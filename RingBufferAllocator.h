@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+
+// Backend-neutral bookkeeping for a persistent dynamic buffer that is used as a ring.
+//
+// Allocations are carved one after another until the buffer end. An allocation that
+// doesn't fit restarts from the beginning and is marked "discard": the backend must map
+// the buffer with the discard semantics (D3D11_MAP_WRITE_DISCARD) to get fresh memory
+// from the driver, while all the other allocations may be mapped without overwrite
+// (D3D11_MAP_WRITE_NO_OVERWRITE), because they never touch data the GPU may still read.
+class RingBufferAllocator {
+public:
+	struct Allocation {
+		size_t offset;
+		bool discard;
+	};
+
+private:
+	size_t capacity = 0;
+	size_t head = 0;
+	bool discardPending = true;     // The first map of a fresh buffer has to discard it
+
+public:
+	static constexpr size_t MIN_CAPACITY = 4096;
+
+	// Geometric growth, so that a steadily growing request reallocates O(log n) times
+	static size_t grownCapacity(size_t current, size_t required);
+
+	// Starts over on a newly (re)created buffer
+	void reset(size_t newCapacity);
+
+	// Returns false if the request (including the alignment) can't fit the buffer at all,
+	// the caller should recreate the buffer with grownCapacity() and reset() then
+	bool allocate(size_t size, size_t alignment, Allocation& allocation);
+
+	size_t getCapacity() const { return capacity; }
+	size_t getHead() const { return head; }
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// A bounded lock-free queue for exactly one producer thread and one consumer thread.
+//
+// The two indices only grow and live on their own cache lines. Each side caches the other's index
+// and reloads it only when the queue looks full (or empty), so a push or a pop is one release store
+// in the common case. The blocking calls sleep on the indices with C++20 atomic waits, no mutex.
+template <typename T>
+class SPSCQueue {
+	static constexpr size_t CACHE_LINE = 64;
+
+	const size_t mask;
+	std::unique_ptr<T[]> items;
+
+	alignas(CACHE_LINE) std::atomic<uint64_t> tail = 0;     // Written by the producer
+	uint64_t cachedHead = 0;                                // The producer's copy
+
+	alignas(CACHE_LINE) std::atomic<uint64_t> head = 0;     // Written by the consumer
+	uint64_t cachedTail = 0;                                // The consumer's copy
+
+public:
+	// Rounded up to a power of two
+	explicit SPSCQueue(size_t capacity) : mask(roundUp(capacity) - 1), items(new T[mask + 1]) {}
+
+	SPSCQueue(const SPSCQueue&) = delete;
+	SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+	size_t getCapacity() const { return mask + 1; }
+
+	// The producer side
+	bool tryPush(T&& item) {
+		const uint64_t t = tail.load(std::memory_order_relaxed);
+		if (t - cachedHead > mask) {
+			cachedHead = head.load(std::memory_order_acquire);
+			if (t - cachedHead > mask) return false;
+		}
+		items[t & mask] = std::move(item);
+		tail.store(t + 1, std::memory_order_release);
+		tail.notify_one();
+		return true;
+	}
+
+	// Sleeps while the queue is full
+	void push(T item) {
+		while (!tryPush(std::move(item))) head.wait(cachedHead, std::memory_order_acquire);
+	}
+
+	// The consumer side
+	bool tryPop(T& item) {
+		const uint64_t h = head.load(std::memory_order_relaxed);
+		if (h == cachedTail) {
+			cachedTail = tail.load(std::memory_order_acquire);
+			if (h == cachedTail) return false;
+		}
+		item = std::move(items[h & mask]);
+		head.store(h + 1, std::memory_order_release);
+		head.notify_one();
+		return true;
+	}
+
+	// Sleeps while the queue is empty
+	void pop(T& item) {
+		while (!tryPop(item)) tail.wait(cachedTail, std::memory_order_acquire);
+	}
+
+	// Either side, a snapshot
+	bool isEmpty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+
+private:
+	static size_t roundUp(size_t capacity) {
+		size_t result = 1;
+		while (result < capacity) result *= 2;
+		return result;
+	}
+};
@@ -0,0 +1,83 @@
+#include "ShaderCache.h"
+#include "Hash.h"
+
+#include <cstdio>
+#include <fstream>
+#include <system_error>
+#include <utility>
+
+ShaderCache::ShaderCache(ShaderCompiler& compiler, std::filesystem::path directory) :
+		compiler(compiler), directory(std::move(directory)) {
+	if (!this->directory.empty()) {
+		std::error_code ec;
+		std::filesystem::create_directories(this->directory, ec);
+		// If we can't create the directory, we just work without the disk tier
+		if (ec) this->directory.clear();
+	}
+}
+
+uint64_t ShaderCache::makeKey(const std::string& source, const std::string& entryPoint,
+                              const std::string& target, uint32_t flags) {
+	return Fnv1a64().add(source).add(entryPoint).add(target).addValue(flags).value;
+}
+
+std::filesystem::path ShaderCache::pathForKey(uint64_t key) const {
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.cso", static_cast<unsigned long long>(key));
+	return directory / name;
+}
+
+bool ShaderCache::loadFromDisk(uint64_t key, std::vector<uint8_t>& bytecode) const {
+	if (directory.empty()) return false;
+
+	std::ifstream file(pathForKey(key), std::ios::in | std::ios::binary | std::ios::ate);
+	if (!file) return false;
+
+	std::streamoff size = file.tellg();
+	if (size <= 0) return false;
+
+	bytecode.resize(static_cast<size_t>(size));
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(bytecode.data()), size);
+	return static_cast<bool>(file);
+}
+
+void ShaderCache::storeToDisk(uint64_t key, const std::vector<uint8_t>& bytecode) const {
+	if (directory.empty()) return;
+
+	// Writing to a temporary file and renaming it, so that a crash never leaves a truncated entry
+	auto path = pathForKey(key);
+	auto tmpPath = path;
+	tmpPath += ".tmp";
+	{
+		std::ofstream file(tmpPath, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!file) return;
+		file.write(reinterpret_cast<const char*>(bytecode.data()), static_cast<std::streamsize>(bytecode.size()));
+		if (!file) return;
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(tmpPath, path, ec);
+	if (ec) std::filesystem::remove(tmpPath, ec);
+}
+
+const std::vector<uint8_t>& ShaderCache::get(const std::string& source, const std::string& entryPoint,
+                                             const std::string& target, uint32_t flags) {
+	uint64_t key = makeKey(source, entryPoint, target, flags);
+
+	if (auto it = memory.find(key); it != memory.end()) {
+		stats.memoryHits++;
+		return it->second;
+	}
+
+	std::vector<uint8_t> bytecode;
+	if (loadFromDisk(key, bytecode)) {
+		stats.diskHits++;
+	} else {
+		bytecode = compiler.compile(source, entryPoint, target, flags);
+		stats.compilations++;
+		storeToDisk(key, bytecode);
+	}
+
+	return memory.emplace(key, std::move(bytecode)).first->second;
+}
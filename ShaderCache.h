@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Turns HLSL source into bytecode. Hidden behind an interface so that
+// the cache logic doesn't depend on d3dcompiler and can run with a stub compiler.
+struct ShaderCompiler {
+	virtual std::vector<uint8_t> compile(const std::string& source, const std::string& entryPoint,
+	                                     const std::string& target, uint32_t flags) = 0;
+	virtual ~ShaderCompiler() = default;
+};
+
+// Two-tier shader bytecode cache.
+// The memory tier lives as long as the object, the disk tier (a directory of .cso files) survives restarts.
+// The key is a hash of the source, the entry point, the target profile and the compile flags.
+class ShaderCache {
+public:
+	struct Stats {
+		size_t memoryHits = 0;
+		size_t diskHits = 0;
+		size_t compilations = 0;
+	};
+
+private:
+	ShaderCompiler& compiler;
+	std::filesystem::path directory;
+	std::unordered_map<uint64_t, std::vector<uint8_t>> memory;
+	Stats stats;
+
+	std::filesystem::path pathForKey(uint64_t key) const;
+	bool loadFromDisk(uint64_t key, std::vector<uint8_t>& bytecode) const;
+	void storeToDisk(uint64_t key, const std::vector<uint8_t>& bytecode) const;
+
+public:
+	// An empty directory disables the disk tier
+	explicit ShaderCache(ShaderCompiler& compiler, std::filesystem::path directory = {});
+
+	static uint64_t makeKey(const std::string& source, const std::string& entryPoint,
+	                        const std::string& target, uint32_t flags);
+
+	// The returned reference stays valid until clear() or the cache destruction
+	const std::vector<uint8_t>& get(const std::string& source, const std::string& entryPoint,
+	                                const std::string& target, uint32_t flags);
+
+	// Drops the memory tier only. The files on disk are kept
+	void clear() { memory.clear(); }
+
+	const Stats& getStats() const { return stats; }
+};
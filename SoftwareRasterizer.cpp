@@ -0,0 +1,445 @@
+#include "SoftwareRasterizer.h"
+#include "BCDecoder.h"
+#include "DDSParser.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(SIMD_X86)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+const int SUBPIXEL_BITS = 8;
+const int64_t SUBPIXEL_ONE = int64_t(1) << SUBPIXEL_BITS;
+const int64_t SUBPIXEL_HALF = SUBPIXEL_ONE / 2;
+
+// Keeps the snapped coordinates far enough from the int64 limits for the edge products
+const float MAX_SCREEN_COORD = 1 << 20;
+
+// The pixels are tested in runs of this length, the coverage of a run is a bit mask
+const int RUN_LENGTH = 64;
+static_assert(RUN_LENGTH <= 64);
+
+struct EdgeSet {
+	int64_t stepX[3], stepY[3], bias[3];
+	int64_t row[3];           // The biased edge functions at the first pixel of the current row
+
+	EdgeSet(const SoftwareRasterizer::Triangle& t, int x, int y) {
+		for (int k = 0; k < 3; k++) {
+			// The edge k is opposite to the vertex k, so its function is the vertex k barycentric weight
+			int a = (k + 1) % 3, b = (k + 2) % 3;
+			int64_t dx = t.x[b] - t.x[a], dy = t.y[b] - t.y[a];
+			stepX[k] = -dy * SUBPIXEL_ONE;
+			stepY[k] = dx * SUBPIXEL_ONE;
+			bias[k] = ((dy == 0 && dx > 0) || dy < 0) ? 0 : -1;
+
+			int64_t px = int64_t(x) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+			int64_t py = int64_t(y) * SUBPIXEL_ONE + SUBPIXEL_HALF;
+			row[k] = (py - t.y[a]) * dx - (px - t.x[a]) * dy + bias[k];
+		}
+	}
+};
+
+// The bits of the first n pixels of a run
+inline uint64_t runMask(int n) {
+	return n >= 64 ? ~uint64_t(0) : (uint64_t(1) << n) - 1;
+}
+
+//--------------------------------------------------------------------------------------
+// The coverage test, a kernel per SIMDLevel. The bit i of the result is set when the pixel i
+// of the run is inside the three edges: the biased edge functions, stepped from start, are
+// all non-negative. The sign bits are what counts, so the test is an OR of the three
+//--------------------------------------------------------------------------------------
+
+struct Kernels {
+	SIMDLevel level;
+	uint64_t (*coverRun)(const int64_t start[3], const int64_t step[3], int n);
+};
+
+uint64_t coverRunScalar(const int64_t start[3], const int64_t step[3], int n) {
+	uint64_t covered = 0;
+	int64_t w0 = start[0], w1 = start[1], w2 = start[2];
+	for (int i = 0; i < n; i++) {
+		covered |= ((uint64_t(w0 | w1 | w2) >> 63) ^ 1) << i;
+		w0 += step[0]; w1 += step[1]; w2 += step[2];
+	}
+	return covered;
+}
+
+const Kernels SCALAR_KERNELS = { SIMDLevel::Scalar, coverRunScalar };
+
+#if defined(SIMD_X86)
+
+// Two pixels to a register. The sign bits come out with movmskpd; the lanes past n are dropped
+SIMD_TARGET_SSE41 uint64_t coverRunSSE41(const int64_t start[3], const int64_t step[3], int n) {
+	__m128i w0 = _mm_set_epi64x(start[0] + step[0], start[0]);
+	__m128i w1 = _mm_set_epi64x(start[1] + step[1], start[1]);
+	__m128i w2 = _mm_set_epi64x(start[2] + step[2], start[2]);
+	const __m128i step0 = _mm_set1_epi64x(2 * step[0]);
+	const __m128i step1 = _mm_set1_epi64x(2 * step[1]);
+	const __m128i step2 = _mm_set1_epi64x(2 * step[2]);
+	uint64_t outside = 0;
+	for (int i = 0; i < n; i += 2) {
+		const __m128i any = _mm_or_si128(_mm_or_si128(w0, w1), w2);
+		outside |= uint64_t(_mm_movemask_pd(_mm_castsi128_pd(any))) << i;
+		w0 = _mm_add_epi64(w0, step0); w1 = _mm_add_epi64(w1, step1); w2 = _mm_add_epi64(w2, step2);
+	}
+	return ~outside & runMask(n);
+}
+
+const Kernels SSE41_KERNELS = { SIMDLevel::SSE41, coverRunSSE41 };
+
+SIMD_TARGET_AVX2 __m256i edgeLanes(int64_t start, int64_t step) {
+	return _mm256_set_epi64x(start + 3 * step, start + 2 * step, start + step, start);
+}
+
+// Four pixels to a register
+SIMD_TARGET_AVX2 uint64_t coverRunAVX2(const int64_t start[3], const int64_t step[3], int n) {
+	__m256i w0 = edgeLanes(start[0], step[0]), w1 = edgeLanes(start[1], step[1]), w2 = edgeLanes(start[2], step[2]);
+	const __m256i step0 = _mm256_set1_epi64x(4 * step[0]);
+	const __m256i step1 = _mm256_set1_epi64x(4 * step[1]);
+	const __m256i step2 = _mm256_set1_epi64x(4 * step[2]);
+	uint64_t outside = 0;
+	for (int i = 0; i < n; i += 4) {
+		const __m256i any = _mm256_or_si256(_mm256_or_si256(w0, w1), w2);
+		outside |= uint64_t(_mm256_movemask_pd(_mm256_castsi256_pd(any))) << i;
+		w0 = _mm256_add_epi64(w0, step0); w1 = _mm256_add_epi64(w1, step1); w2 = _mm256_add_epi64(w2, step2);
+	}
+	return ~outside & runMask(n);
+}
+
+const Kernels AVX2_KERNELS = { SIMDLevel::AVX2, coverRunAVX2 };
+
+#endif
+
+const Kernels& kernelsFor(SIMDLevel level) {
+#if defined(SIMD_X86)
+	if (level == SIMDLevel::AVX2) return AVX2_KERNELS;
+	if (level == SIMDLevel::SSE41) return SSE41_KERNELS;
+#endif
+	return SCALAR_KERNELS;
+}
+
+std::atomic<const Kernels*>& selectedKernels() {
+	static std::atomic<const Kernels*> kernels = &kernelsFor(detectSIMDLevel());
+	return kernels;
+}
+
+// Blends two pixels with an 8-bit weight, two channels at a time
+inline uint32_t lerpPixel(uint32_t a, uint32_t b, uint32_t w) {
+	uint32_t rb = ((a & 0x00FF00FFu) * (256 - w) + (b & 0x00FF00FFu) * w) >> 8;
+	uint32_t ag = (((a >> 8) & 0x00FF00FFu) * (256 - w) + ((b >> 8) & 0x00FF00FFu) * w) >> 8;
+	return (rb & 0x00FF00FFu) | ((ag & 0x00FF00FFu) << 8);
+}
+
+// Bilinear filtering with clamping, like the D3D11 default sampler (the top mip only)
+uint32_t sampleBilinear(const SoftwareTexture& texture, float u, float v) {
+	if (texture.width <= 0 || texture.height <= 0) return 0xFF000000u;
+
+	// The filter weights have 8 bits, like the hardware samplers
+	// (and the coordinates are clamped early, so that they fit an int)
+	auto fixedPoint = [](float t, int size) {
+		return int(std::floor(std::clamp((t * float(size) - 0.5f) * 256.f, -256.f, float(size) * 256.f)));
+	};
+	int fx = fixedPoint(u, texture.width), fy = fixedPoint(v, texture.height);
+	int x0 = fx >> 8, y0 = fy >> 8;
+	auto wx = uint32_t(fx & 0xFF), wy = uint32_t(fy & 0xFF);
+
+	int x1 = std::clamp(x0 + 1, 0, texture.width - 1), y1 = std::clamp(y0 + 1, 0, texture.height - 1);
+	x0 = std::clamp(x0, 0, texture.width - 1);
+	y0 = std::clamp(y0, 0, texture.height - 1);
+
+	const uint32_t* row0 = texture.texels.data() + size_t(y0) * texture.width;
+	const uint32_t* row1 = texture.texels.data() + size_t(y1) * texture.width;
+	return lerpPixel(lerpPixel(row0[x0], row0[x1], wx), lerpPixel(row1[x0], row1[x1], wx), wy);
+}
+
+}
+
+bool SoftwareTexture::loadDDS(const std::string& fileName) {
+	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
+	if (!file) return false;
+	std::vector<uint8_t> bytes(size_t(std::max<std::streamoff>(file.tellg(), 0)));
+	file.seekg(0, std::ios::beg);
+	if (!file.read(reinterpret_cast<char*>(bytes.data()), std::streamsize(bytes.size()))) return false;
+
+	DDSLayout layout;
+	if (DDSParser::parse(bytes.data(), bytes.size(), layout) != DDSStatus::OK) return false;
+	if (layout.dimension != DDSDimension::Texture2D) return false;
+	const DDSSubresource& top = layout.subresources[0];
+	const uint8_t* pixels = bytes.data() + top.offset;
+
+	bool swapRB = false;    // The texels are R8G8B8A8, B8G8R8A8 or B8G8R8X8 (or block-compressed), and we want B8G8R8A8
+	bool opaque = false;
+	std::vector<uint32_t> data(size_t(top.width) * top.height);
+	BCFormat bcFormat;
+	switch (layout.format) {
+		case DXGIFormat::R8G8B8A8_UNORM: case DXGIFormat::R8G8B8A8_UNORM_SRGB: swapRB = true; break;
+		case DXGIFormat::B8G8R8A8_UNORM: case DXGIFormat::B8G8R8A8_UNORM_SRGB: break;
+		case DXGIFormat::B8G8R8X8_UNORM: case DXGIFormat::B8G8R8X8_UNORM_SRGB: opaque = true; break;
+		default:
+			if (!BCDecoder::fromDXGIFormat(uint32_t(layout.format), bcFormat)) return false;
+			BCDecoder::decode(bcFormat, pixels, top.rowPitch, top.width, top.height,
+			                  BCOutput::RGBA8, reinterpret_cast<uint8_t*>(data.data()), size_t(top.width) * sizeof(uint32_t));
+			swapRB = true;
+			pixels = nullptr;
+			break;
+	}
+	if (pixels) {
+		for (uint32_t y = 0; y < top.height; y++) {
+			std::memcpy(data.data() + size_t(y) * top.width, pixels + y * top.rowPitch, size_t(top.width) * sizeof(uint32_t));
+		}
+	}
+
+	for (auto& texel : data) {
+		if (swapRB) texel = (texel & 0xFF00FF00u) | ((texel & 0xFFu) << 16) | ((texel >> 16) & 0xFFu);
+		if (opaque) texel |= 0xFF000000u;
+	}
+
+	width = int(top.width);
+	height = int(top.height);
+	texels = std::move(data);
+	return true;
+}
+
+SoftwareRasterizer::SoftwareRasterizer(unsigned threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	// The calling thread works too
+	for (unsigned i = 1; i < threads; i++) {
+		workers.emplace_back(&SoftwareRasterizer::workerLoop, this);
+	}
+}
+
+SoftwareRasterizer::~SoftwareRasterizer() {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+void SoftwareRasterizer::workerLoop() {
+	size_t seenGeneration = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(poolMutex);
+			workAvailable.wait(lock, [&] { return stopping || generation != seenGeneration; });
+			if (stopping) return;
+			seenGeneration = generation;
+		}
+		runItems();
+		{
+			std::lock_guard<std::mutex> lock(poolMutex);
+			if (--activeWorkers == 0) workDone.notify_one();
+		}
+	}
+}
+
+void SoftwareRasterizer::runItems() {
+	for (size_t i = nextItem.fetch_add(1); i < jobSize; i = nextItem.fetch_add(1)) {
+		(*job)(i);
+	}
+}
+
+void SoftwareRasterizer::parallelFor(size_t count, const std::function<void(size_t)>& f) {
+	if (workers.empty() || count <= 1) {
+		for (size_t i = 0; i < count; i++) f(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		job = &f;
+		jobSize = count;
+		nextItem = 0;
+		activeWorkers = workers.size();
+		generation++;
+	}
+	workAvailable.notify_all();
+
+	runItems();
+
+	// Every worker has to see the generation through before the next job may start
+	std::unique_lock<std::mutex> lock(poolMutex);
+	workDone.wait(lock, [&] { return activeWorkers == 0; });
+	job = nullptr;
+	jobSize = 0;
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+	bufferWidth = std::max(width, 0);
+	bufferHeight = std::max(height, 0);
+	pixels.assign(size_t(bufferWidth) * size_t(bufferHeight), 0);
+	setViewport(bufferWidth, bufferHeight);
+}
+
+void SoftwareRasterizer::setViewport(int width, int height) {
+	viewportWidth = std::clamp(width, 0, bufferWidth);
+	viewportHeight = std::clamp(height, 0, bufferHeight);
+}
+
+void SoftwareRasterizer::clear(uint32_t color) {
+	// Only the viewport, the rest of the buffer is never presented
+	for (int y = 0; y < viewportHeight; y++) {
+		std::fill_n(pixels.begin() + size_t(y) * bufferWidth, viewportWidth, color);
+	}
+}
+
+uint32_t SoftwareRasterizer::packColor(float r, float g, float b, float a) {
+	auto channel = [](float c) { return uint32_t(std::clamp(c, 0.f, 1.f) * 255.f + 0.5f); };
+	return (channel(a) << 24) | (channel(r) << 16) | (channel(g) << 8) | channel(b);
+}
+
+template <typename V>
+void SoftwareRasterizer::setupAndBin(std::span<const V> vertices, Topology topology) {
+	triangles.clear();
+	bins.resize(size_t(tilesX()) * size_t(tilesY()));
+	for (auto& bin : bins) bin.clear();
+
+	if (viewportWidth == 0 || viewportHeight == 0 || vertices.size() < 3) return;
+
+	size_t count = topology == Topology::TriangleList ? vertices.size() / 3 : vertices.size() - 2;
+	for (size_t i = 0; i < count; i++) {
+		uint32_t index[3];
+		if (topology == Topology::TriangleList) {
+			index[0] = uint32_t(3 * i); index[1] = uint32_t(3 * i + 1); index[2] = uint32_t(3 * i + 2);
+		} else if (i % 2 == 0) {
+			index[0] = uint32_t(i); index[1] = uint32_t(i + 1); index[2] = uint32_t(i + 2);
+		} else {
+			// The odd triangles of a strip are flipped to keep the winding
+			index[0] = uint32_t(i + 1); index[1] = uint32_t(i); index[2] = uint32_t(i + 2);
+		}
+
+		Triangle t = {};
+		bool finite = true;
+		for (int k = 0; k < 3; k++) {
+			const V& v = vertices[index[k]];
+			// The viewport transform. The demo shaders pass the positions through with w = 1
+			float sx = (v.x * 0.5f + 0.5f) * float(viewportWidth);
+			float sy = (0.5f - v.y * 0.5f) * float(viewportHeight);
+			finite = finite && std::isfinite(sx) && std::isfinite(sy);
+			sx = std::clamp(sx, -MAX_SCREEN_COORD, MAX_SCREEN_COORD);
+			sy = std::clamp(sy, -MAX_SCREEN_COORD, MAX_SCREEN_COORD);
+			t.x[k] = std::llround(sx * float(SUBPIXEL_ONE));
+			t.y[k] = std::llround(sy * float(SUBPIXEL_ONE));
+		}
+		if (!finite) continue;
+
+		// Twice the signed area. The clockwise triangles are positive; the others are back faces
+		t.area = (t.y[2] - t.y[0]) * (t.x[1] - t.x[0]) - (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+		if (t.area <= 0) continue;
+
+		int64_t minX = std::min({ t.x[0], t.x[1], t.x[2] }), maxX = std::max({ t.x[0], t.x[1], t.x[2] });
+		int64_t minY = std::min({ t.y[0], t.y[1], t.y[2] }), maxY = std::max({ t.y[0], t.y[1], t.y[2] });
+		t.minX = int(std::max<int64_t>(minX >> SUBPIXEL_BITS, 0));
+		t.minY = int(std::max<int64_t>(minY >> SUBPIXEL_BITS, 0));
+		t.maxX = int(std::min<int64_t>(maxX >> SUBPIXEL_BITS, viewportWidth - 1));
+		t.maxY = int(std::min<int64_t>(maxY >> SUBPIXEL_BITS, viewportHeight - 1));
+		if (t.minX > t.maxX || t.minY > t.maxY) continue;
+
+		t.first = index[0]; t.second = index[1]; t.third = index[2];
+
+		auto triangleIndex = uint32_t(triangles.size());
+		triangles.push_back(t);
+		for (int ty = t.minY / TILE_SIZE; ty <= t.maxY / TILE_SIZE; ty++) {
+			for (int tx = t.minX / TILE_SIZE; tx <= t.maxX / TILE_SIZE; tx++) {
+				bins[size_t(ty) * tilesX() + tx].push_back(triangleIndex);
+			}
+		}
+	}
+}
+
+template <typename V, typename Shade>
+void SoftwareRasterizer::rasterizeTiles(std::span<const V> vertices, const Shade& shade) {
+	const int columns = tilesX();
+	const Kernels& kernels = *selectedKernels().load(std::memory_order_relaxed);
+	auto rasterizeTile = [&](size_t tile) {
+		const int tileX = int(tile % columns) * TILE_SIZE;
+		const int tileY = int(tile / columns) * TILE_SIZE;
+
+		for (uint32_t triangleIndex : bins[tile]) {
+			const Triangle& t = triangles[triangleIndex];
+			const V& v0 = vertices[t.first];
+			const V& v1 = vertices[t.second];
+			const V& v2 = vertices[t.third];
+
+			int x0 = std::max(t.minX, tileX), x1 = std::min(t.maxX, tileX + TILE_SIZE - 1);
+			int y0 = std::max(t.minY, tileY), y1 = std::min(t.maxY, tileY + TILE_SIZE - 1);
+			if (x0 > x1 || y0 > y1) continue;
+
+			EdgeSet edges(t, x0, y0);
+			const float invArea = 1.f / float(t.area);
+
+			for (int y = y0; y <= y1; y++) {
+				uint32_t* row = pixels.data() + size_t(y) * bufferWidth;
+
+				for (int runStart = x0; runStart <= x1; runStart += RUN_LENGTH) {
+					const int n = std::min(RUN_LENGTH, x1 - runStart + 1);
+					const int64_t offset = int64_t(runStart - x0);
+					int64_t e[3];
+					for (int k = 0; k < 3; k++) e[k] = edges.row[k] + offset * edges.stepX[k];
+
+					// The coverage of the whole run at once
+					const uint64_t covered = kernels.coverRun(e, edges.stepX, n);
+					if (covered == 0) continue;
+
+					// The barycentric weights from the unbiased edge functions, stepped along the run
+					float l0 = float(e[0] - edges.bias[0]) * invArea, dl0 = float(edges.stepX[0]) * invArea;
+					float l1 = float(e[1] - edges.bias[1]) * invArea, dl1 = float(edges.stepX[1]) * invArea;
+					uint32_t* dst = row + runStart;
+					if (covered == runMask(n)) {
+						for (int i = 0; i < n; i++) {
+							float w0 = l0 + float(i) * dl0, w1 = l1 + float(i) * dl1;
+							dst[i] = shade(v0, v1, v2, w0, w1, 1.f - w0 - w1);
+						}
+					} else {
+						for (uint64_t bits = covered; bits != 0; bits &= bits - 1) {
+							const int i = std::countr_zero(bits);
+							float w0 = l0 + float(i) * dl0, w1 = l1 + float(i) * dl1;
+							dst[i] = shade(v0, v1, v2, w0, w1, 1.f - w0 - w1);
+						}
+					}
+				}
+
+				for (int k = 0; k < 3; k++) edges.row[k] += edges.stepY[k];
+			}
+		}
+	};
+
+	// By reference: the captures don't fit the small buffer of std::function, and a frame shouldn't allocate
+	parallelFor(bins.size(), std::function<void(size_t)>(std::ref(rasterizeTile)));
+}
+
+void SoftwareRasterizer::draw(std::span<const RGBAVertex> vertices, Topology topology) {
+	setupAndBin(vertices, topology);
+	rasterizeTiles(vertices, [](const RGBAVertex& v0, const RGBAVertex& v1, const RGBAVertex& v2, float l0, float l1, float l2) {
+		return packColor(v0.r * l0 + v1.r * l1 + v2.r * l2,
+		                 v0.g * l0 + v1.g * l1 + v2.g * l2,
+		                 v0.b * l0 + v1.b * l1 + v2.b * l2,
+		                 v0.a * l0 + v1.a * l1 + v2.a * l2);
+	});
+}
+
+void SoftwareRasterizer::draw(std::span<const TextureVertex> vertices, Topology topology, const SoftwareTexture& texture) {
+	setupAndBin(vertices, topology);
+	rasterizeTiles(vertices, [&texture](const TextureVertex& v0, const TextureVertex& v1, const TextureVertex& v2, float l0, float l1, float l2) {
+		return sampleBilinear(texture, v0.tx * l0 + v1.tx * l1 + v2.tx * l2, v0.ty * l0 + v1.ty * l1 + v2.ty * l2);
+	});
+}
+
+SIMDLevel SoftwareRasterizer::getSIMDLevel() {
+	return selectedKernels().load(std::memory_order_relaxed)->level;
+}
+
+bool SoftwareRasterizer::setSIMDLevel(SIMDLevel level) {
+	if (level > detectSIMDLevel()) return false;
+	selectedKernels().store(&kernelsFor(level), std::memory_order_relaxed);
+	return true;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "GraphicContents.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A texture for the software rasterizer. The texels are 0xAARRGGBB (B8G8R8A8 in memory)
+struct SoftwareTexture {
+	int width = 0, height = 0;
+	std::vector<uint32_t> texels;
+
+	// Reads the top mip of a 2D DDS (validated by DDSParser): an uncompressed 32-bit one (R8G8B8A8,
+	// B8G8R8A8 or B8G8R8X8) or a block-compressed one (BC1 - BC7, decoded with BCDecoder).
+	// Returns false if the file can't be read or has an unsupported format
+	bool loadDDS(const std::string& fileName);
+};
+
+// The reference CPU rendering backend for the GraphicContents.
+//
+// It follows the Direct3D rasterization rules closely enough for pixel-exact comparisons:
+// the vertices are snapped to 1/256 pixel, the edges are tested in integer arithmetic with
+// the top-left fill rule, the pixel centers are at +0.5, and the back faces (counter-clockwise
+// on screen) are culled. The pipelines match the demo shaders: RGBAVertex interpolates
+// the color, TextureVertex samples a texture with bilinear filtering and clamping
+// (the D3D11 default sampler).
+//
+// The framebuffer is split into TILE_SIZE x TILE_SIZE tiles. The triangles are set up once,
+// binned into the tiles they touch, and the tiles are rasterized in parallel on a worker pool.
+// The triangle setup and the shading are scalar. The coverage test works on runs of pixels and has
+// SSE4.1 and AVX2 kernels (two and four pixels to a register), picked at run time (see CpuFeatures.h);
+// the scalar one is the fallback. Every level covers the same pixels.
+class SoftwareRasterizer {
+public:
+	enum class Topology { TriangleList, TriangleStrip };
+
+	static const int TILE_SIZE = 64;
+
+	struct Triangle {
+		int64_t x[3], y[3];                     // Snapped screen positions, 1/256 pixel
+		int64_t area;                           // Twice the triangle area, 1/256^2 pixel
+		int minX, minY, maxX, maxY;             // The pixel bounding box (inclusive), clipped to the viewport
+		uint32_t first;                         // The indices of its vertices
+		uint32_t second;
+		uint32_t third;
+	};
+
+private:
+	int bufferWidth = 0, bufferHeight = 0;
+	int viewportWidth = 0, viewportHeight = 0;
+	std::vector<uint32_t> pixels;
+
+	std::vector<Triangle> triangles;
+	std::vector<std::vector<uint32_t>> bins;    // The triangle indices touching each tile, in the draw order
+
+	// The worker pool
+	std::vector<std::thread> workers;
+	std::mutex poolMutex;
+	std::condition_variable workAvailable, workDone;
+	const std::function<void(size_t)>* job = nullptr;
+	size_t jobSize = 0;
+	std::atomic<size_t> nextItem = 0;
+	size_t generation = 0;
+	size_t activeWorkers = 0;
+	bool stopping = false;
+
+	void workerLoop();
+	void runItems();
+	void parallelFor(size_t count, const std::function<void(size_t)>& f);
+
+	int tilesX() const { return (viewportWidth + TILE_SIZE - 1) / TILE_SIZE; }
+	int tilesY() const { return (viewportHeight + TILE_SIZE - 1) / TILE_SIZE; }
+
+	template <typename V> void setupAndBin(std::span<const V> vertices, Topology topology);
+	template <typename V, typename Shade> void rasterizeTiles(std::span<const V> vertices, const Shade& shade);
+
+public:
+	// 0 threads means "as many as the hardware has"
+	explicit SoftwareRasterizer(unsigned threads = 0);
+	~SoftwareRasterizer();
+
+	SoftwareRasterizer(const SoftwareRasterizer&) = delete;
+	SoftwareRasterizer& operator=(const SoftwareRasterizer&) = delete;
+
+	// Reallocates the framebuffer (the "swap chain buffer"). The viewport is reset to the whole buffer
+	void resize(int width, int height);
+	// The top-left part of the buffer that is drawn into (and presented)
+	void setViewport(int width, int height);
+
+	void clear(uint32_t color);
+	void draw(std::span<const RGBAVertex> vertices, Topology topology);
+	void draw(std::span<const TextureVertex> vertices, Topology topology, const SoftwareTexture& texture);
+
+	int getBufferWidth() const { return bufferWidth; }
+	int getBufferHeight() const { return bufferHeight; }
+	int getViewportWidth() const { return viewportWidth; }
+	int getViewportHeight() const { return viewportHeight; }
+	// Row-major, getBufferWidth() pixels per row, 0xAARRGGBB
+	const std::vector<uint32_t>& getPixels() const { return pixels; }
+
+	static uint32_t packColor(float r, float g, float b, float a);
+
+	// The coverage kernels draw uses, the best ones of the CPU unless set otherwise (for the tests and
+	// the benchmarks). A level the CPU doesn't have isn't set
+	static SIMDLevel getSIMDLevel();
+	static bool setSIMDLevel(SIMDLevel level);
+};
@@ -0,0 +1,180 @@
+#include "TextureCache.h"
+
+#include <cassert>
+#include <filesystem>
+#include <system_error>
+
+TextureCache::Reference::Reference(Reference&& other) noexcept :
+		cache(std::exchange(other.cache, nullptr)), entry(std::exchange(other.entry, nullptr)) { }
+
+TextureCache::Reference& TextureCache::Reference::operator=(Reference&& other) noexcept {
+	if (this != &other) {
+		reset();
+		cache = std::exchange(other.cache, nullptr);
+		entry = std::exchange(other.entry, nullptr);
+	}
+	return *this;
+}
+
+void TextureCache::Reference::reset() {
+	if (entry) cache->release(entry);
+	cache = nullptr;
+	entry = nullptr;
+}
+
+const CachedTexture& TextureCache::Reference::get() const {
+	assert(entry != nullptr);
+	return entry->texture;    // Doesn't change while referenced
+}
+
+TextureCache::TextureCache(TextureResidency& residency, Settings settings) :
+		residency(residency), settings(settings) { }
+
+TextureCache::TextureCache(TextureResidency& residency) : TextureCache(residency, Settings()) { }
+
+TextureCache::~TextureCache() {
+	std::vector<CachedTexture> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(lru.size() == entries.size() && "A texture is still referenced or loading");
+		evicted = takeEvictedLocked(true);
+	}
+	evict(evicted);
+}
+
+std::string TextureCache::canonicalPath(const std::string& path) {
+	// weakly_canonical leaves a relative path relative when its first component doesn't exist
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	if (error) return std::filesystem::path(path).lexically_normal().string();
+
+	std::filesystem::path canonical = std::filesystem::weakly_canonical(absolute, error);
+	return (error ? absolute.lexically_normal() : canonical).string();
+}
+
+TextureCache::Reference TextureCache::acquire(const std::string& path, uint32_t flags) {
+	Key key{ canonicalPath(path), flags };
+
+	std::unique_lock<std::mutex> lock(mutex);
+	auto it = entries.find(key);
+	if (it != entries.end()) {
+		Entry* entry = &it->second;
+		entry->references++;    // Keeps the entry while waiting, too
+		if (entry->loading) {
+			stats.joined++;
+			loaded.wait(lock, [entry] { return !entry->loading; });
+		} else {
+			stats.hits++;
+		}
+
+		if (entry->failed) {
+			if (--entry->references == 0) erase(entry);
+			return {};
+		}
+
+		lru.splice(lru.begin(), lru, entry->lruPosition);
+		return Reference(this, entry);
+	}
+
+	stats.misses++;
+	it = entries.emplace(std::move(key), Entry()).first;
+	Entry* entry = &it->second;
+	entry->key = &it->first;
+	entry->references = 1;
+
+	// The other files load meanwhile, the requests for this one wait on the entry
+	lock.unlock();
+	CachedTexture texture;
+	bool succeeded = false;
+	try {
+		succeeded = residency.load(entry->key->path, entry->key->flags, texture);
+	} catch (...) {
+		succeeded = false;
+	}
+	lock.lock();
+
+	entry->loading = false;
+	loaded.notify_all();
+	if (!succeeded) {
+		stats.failures++;
+		entry->failed = true;
+		if (--entry->references == 0) erase(entry);
+		return {};
+	}
+
+	entry->texture = texture;
+	lru.push_front(entry);
+	entry->lruPosition = lru.begin();
+	stats.entries++;
+	stats.cpuBytes += texture.cpuBytes;
+	stats.gpuBytes += texture.gpuBytes;
+
+	// The new texture may push the others out, never itself
+	std::vector<CachedTexture> evicted = takeEvictedLocked(false);
+	lock.unlock();
+	evict(evicted);
+	return Reference(this, entry);
+}
+
+void TextureCache::release(Entry* entry) {
+	std::vector<CachedTexture> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		assert(entry->references > 0);
+		if (--entry->references == 0) evicted = takeEvictedLocked(false);
+	}
+	evict(evicted);
+}
+
+void TextureCache::setSettings(Settings settings) {
+	std::vector<CachedTexture> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		this->settings = settings;
+		evicted = takeEvictedLocked(false);
+	}
+	evict(evicted);
+}
+
+void TextureCache::clear() {
+	std::vector<CachedTexture> evicted;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		evicted = takeEvictedLocked(true);
+	}
+	evict(evicted);
+}
+
+TextureCache::Stats TextureCache::getStats() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+bool TextureCache::overBudget() const {
+	return stats.cpuBytes > settings.cpuBudget || stats.gpuBytes > settings.gpuBudget;
+}
+
+std::vector<CachedTexture> TextureCache::takeEvictedLocked(bool force) {
+	std::vector<CachedTexture> evicted;
+	for (auto it = lru.end(); it != lru.begin() && (force || overBudget());) {
+		Entry* entry = *--it;
+		if (entry->references > 0) continue;
+
+		evicted.push_back(entry->texture);
+		stats.evictions++;
+		stats.entries--;
+		stats.cpuBytes -= entry->texture.cpuBytes;
+		stats.gpuBytes -= entry->texture.gpuBytes;
+		it = lru.erase(it);
+		erase(entry);
+	}
+	return evicted;
+}
+
+void TextureCache::erase(Entry* entry) {
+	entries.erase(entries.find(*entry->key));    // Not by the key, it lives in the node
+}
+
+void TextureCache::evict(const std::vector<CachedTexture>& evicted) {
+	for (const CachedTexture& texture : evicted) residency.evict(texture);
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A texture the cache keeps: the backend's object (an ID3D11ShaderResourceView*, an ID3D12Resource*...)
+// and what it costs. cpuBytes is what stays in the system memory, the copies kept for re-uploads and such
+struct CachedTexture {
+	void* texture = nullptr;
+	size_t cpuBytes = 0;
+	size_t gpuBytes = 0;
+};
+
+// Makes the textures resident and evicts them. Hidden behind an interface so that
+// the cache policy doesn't depend on Direct3D and can run with fake textures.
+struct TextureResidency {
+	// The path is canonical. Fills the texture, false if it can't be loaded. Runs on the thread that
+	// asked for the texture first, without the cache lock, so the other files load meanwhile
+	virtual bool load(const std::string& path, uint32_t flags, CachedTexture& texture) = 0;
+	// Releases what load created, without the cache lock
+	virtual void evict(const CachedTexture& texture) = 0;
+	virtual ~TextureResidency() = default;
+};
+
+// Shares the textures between their users and keeps them within a memory budget.
+// The key is the canonical path of the file and the loader flags. Concurrent requests for the same key
+// wait for one load. The textures nobody holds stay cached until the budget is exceeded, then they are
+// evicted least recently used first; the textures in use are never evicted, even over the budget.
+//
+// Thread-safe.
+class TextureCache {
+private:
+	struct Key {
+		std::string path;
+		uint32_t flags;
+
+		bool operator<(const Key& other) const {
+			return flags != other.flags ? flags < other.flags : path < other.path;
+		}
+	};
+	struct Entry;
+
+public:
+	struct Settings {
+		size_t cpuBudget = size_t(64) << 20;
+		size_t gpuBudget = size_t(512) << 20;
+	};
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;          // Loads
+		uint64_t joined = 0;          // Requests that waited for the load of another one
+		uint64_t failures = 0;
+		uint64_t evictions = 0;
+		size_t entries = 0;           // Resident
+		size_t cpuBytes = 0;
+		size_t gpuBytes = 0;
+	};
+
+	// Holds a texture in the cache, move-only. Empty if the texture couldn't be loaded
+	class Reference {
+	public:
+		Reference() = default;
+		Reference(Reference&& other) noexcept;
+		Reference& operator=(Reference&& other) noexcept;
+		Reference(const Reference&) = delete;
+		Reference& operator=(const Reference&) = delete;
+		~Reference() { reset(); }
+
+		void reset();
+
+		explicit operator bool() const { return entry != nullptr; }
+		const CachedTexture& get() const;
+		template<class T> T* as() const { return entry ? static_cast<T*>(get().texture) : nullptr; }
+
+	private:
+		friend class TextureCache;
+		TextureCache* cache = nullptr;
+		Entry* entry = nullptr;
+
+		Reference(TextureCache* cache, Entry* entry) : cache(cache), entry(entry) { }
+	};
+
+	TextureCache(TextureResidency& residency, Settings settings);
+	explicit TextureCache(TextureResidency& residency);
+	// Evicts everything. All the references must be gone by then
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+	Reference acquire(const std::string& path, uint32_t flags = 0);
+
+	// A smaller budget evicts right away
+	void setSettings(Settings settings);
+	// Evicts all the textures nobody holds
+	void clear();
+
+	Stats getStats() const;
+
+	// Absolute, normalized, the symbolic links resolved as far as the path exists
+	static std::string canonicalPath(const std::string& path);
+
+private:
+	struct Entry {
+		const Key* key = nullptr;              // Of its node in entries
+		CachedTexture texture;
+		bool loading = true;
+		bool failed = false;
+		uint32_t references = 0;               // The references and the requests waiting for the load
+		std::list<Entry*>::iterator lruPosition;    // Valid once loaded, the most recent at the front
+	};
+
+	TextureResidency& residency;
+	Settings settings;
+
+	mutable std::mutex mutex;
+	std::condition_variable loaded;
+	std::map<Key, Entry> entries;              // The nodes don't move, the references point into them
+	std::list<Entry*> lru;                     // The resident entries
+	Stats stats;
+
+	bool overBudget() const;
+	// Takes the unreferenced entries out, oldest first, while over the budget (all of them with force)
+	std::vector<CachedTexture> takeEvictedLocked(bool force);
+	void erase(Entry* entry);
+	void evict(const std::vector<CachedTexture>& evicted);
+	void release(Entry* entry);
+};
@@ -0,0 +1,275 @@
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <thread>
+
+// Never reused, unlike the addresses, so a thread can't mistake a new recorder for a destroyed one
+static std::atomic<uint64_t> nextRecorderId = 1;
+
+TraceRecorder::TraceRecorder() : recorderId(nextRecorderId.fetch_add(1, std::memory_order_relaxed)) { }
+
+TraceRecorder& TraceRecorder::instance() {
+	static TraceRecorder recorder;
+	return recorder;
+}
+
+int64_t TraceRecorder::now() {
+	static const auto origin = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::threadBuffer() {
+	// The buffer of the recorder this thread wrote to last, almost always the only one
+	thread_local uint64_t cachedRecorderId = 0;
+	thread_local ThreadBuffer* cachedBuffer = nullptr;
+	if (cachedRecorderId != recorderId) {
+		std::lock_guard<std::mutex> lock(registryMutex);
+		auto it = std::find_if(buffers.begin(), buffers.end(), [](const auto& buffer) {
+			return buffer->owner == std::this_thread::get_id();
+		});
+		if (it == buffers.end()) {
+			buffers.push_back(std::make_unique<ThreadBuffer>());
+			buffers.back()->threadId = static_cast<uint32_t>(buffers.size());
+			buffers.back()->owner = std::this_thread::get_id();
+			it = buffers.end() - 1;
+		}
+		cachedRecorderId = recorderId;
+		cachedBuffer = it->get();
+	}
+	return *cachedBuffer;
+}
+
+size_t TraceRecorder::histogramBucket(int64_t durationNs) {
+	if (durationNs < int64_t(HISTOGRAM_SUB_BUCKETS)) return size_t(std::max<int64_t>(durationNs, 0));
+	// The octave and the next three bits below its top one
+	int octave = std::bit_width(uint64_t(durationNs)) - 1;
+	size_t sub = size_t(durationNs >> (octave - 3)) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return size_t(octave - 2) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+int64_t TraceRecorder::histogramValue(size_t bucket) {
+	if (bucket < HISTOGRAM_SUB_BUCKETS) return int64_t(bucket);
+	int octave = int(bucket / HISTOGRAM_SUB_BUCKETS) + 2;
+	int64_t width = int64_t(1) << (octave - 3);
+	// The middle of the bucket
+	return int64_t(HISTOGRAM_SUB_BUCKETS + bucket % HISTOGRAM_SUB_BUCKETS) * width + width / 2;
+}
+
+void TraceRecorder::Counters::clear() {
+	count.store(0, std::memory_order_relaxed);
+	sumNs.store(0, std::memory_order_relaxed);
+	for (auto& bucket : histogram) bucket.store(0, std::memory_order_relaxed);
+}
+
+void TraceRecorder::Counters::add(int64_t durationNs) {
+	uint64_t n = count.load(std::memory_order_relaxed);
+	sumNs.store(sumNs.load(std::memory_order_relaxed) + durationNs, std::memory_order_relaxed);
+	if (n == 0 || durationNs < minNs.load(std::memory_order_relaxed)) minNs.store(durationNs, std::memory_order_relaxed);
+	if (n == 0 || durationNs > maxNs.load(std::memory_order_relaxed)) maxNs.store(durationNs, std::memory_order_relaxed);
+	auto& bucket = histogram[histogramBucket(durationNs)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	// Publishing the event for the readers
+	count.store(n + 1, std::memory_order_release);
+}
+
+void TraceRecorder::count(ThreadBuffer& buffer, const char* name, int64_t endNs, int64_t durationNs, uint64_t window) {
+	const size_t first = std::hash<const char*>()(name) % MAX_PHASES;
+	for (size_t i = 0; i < MAX_PHASES; i++) {
+		PhaseCounters& phase = buffer.phases[(first + i) % MAX_PHASES];
+		const char* phaseName = phase.name.load(std::memory_order_relaxed);
+		if (phaseName == nullptr) {
+			phase.name.store(name, std::memory_order_relaxed);
+		} else if (phaseName != name) {
+			continue;
+		}
+
+		// The first event of the phase since resetStats. The phase keeps its slot, the readers skip
+		// the counters until they are of the current window
+		if (phase.window.load(std::memory_order_relaxed) != window) {
+			phase.total.clear();
+			for (auto& slice : phase.slices) slice.index.store(-1, std::memory_order_relaxed);
+			phase.window.store(window, std::memory_order_relaxed);
+		}
+		phase.total.add(durationNs);
+
+		// The first event of a newer slice takes over the counters of the one ROLLING_SLICES before.
+		// An event that ends before the slice in its place is too late for the rolling statistics
+		const int64_t index = std::max<int64_t>(endNs, 0) / ROLLING_SLICE_NS;
+		RollingSlice& slice = phase.slices[size_t(index) % ROLLING_SLICES];
+		const int64_t sliceIndex = slice.index.load(std::memory_order_relaxed);
+		if (sliceIndex < index) {
+			slice.counters.clear();
+			slice.index.store(index, std::memory_order_relaxed);
+		}
+		if (sliceIndex <= index) slice.counters.add(durationNs);
+		return;
+	}
+
+	if (buffer.uncountedWindow.load(std::memory_order_relaxed) != window) {
+		buffer.uncounted.store(0, std::memory_order_relaxed);
+		buffer.uncountedWindow.store(window, std::memory_order_relaxed);
+	}
+	buffer.uncounted.store(buffer.uncounted.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void TraceRecorder::record(const char* name, int64_t startNs, int64_t durationNs) {
+	ThreadBuffer& buffer = threadBuffer();
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	buffer.events[head % RING_SIZE] = { name, startNs, durationNs };
+	// Publishing the event for the readers
+	buffer.head.store(head + 1, std::memory_order_release);
+	count(buffer, name, startNs + durationNs, durationNs, statsWindow.load(std::memory_order_relaxed));
+}
+
+std::vector<std::pair<uint32_t, TraceEvent>> TraceRecorder::snapshot() {
+	std::vector<std::pair<uint32_t, TraceEvent>> result;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+	for (const auto& buffer : buffers) {
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t first = head > RING_SIZE ? head - RING_SIZE : 0;
+		for (uint64_t i = first; i < head; i++) {
+			result.emplace_back(buffer->threadId, buffer->events[i % RING_SIZE]);
+		}
+	}
+
+	std::sort(result.begin(), result.end(), [](const auto& a, const auto& b) {
+		return a.second.startNs < b.second.startNs;
+	});
+	return result;
+}
+
+static void writeJsonString(std::ostream& out, const char* str) {
+	out << '"';
+	for (const char* c = str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\') out << '\\';
+		out << *c;
+	}
+	out << '"';
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream& out) {
+	auto events = snapshot();
+
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const auto& [threadId, e] : events) {
+		if (!first) out << ",";
+		first = false;
+
+		// The timestamps are in microseconds, fractions are allowed
+		out << "\n{\"name\":";
+		writeJsonString(out, e.name);
+		out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+		    << ",\"ts\":" << e.startNs / 1000.0
+		    << ",\"dur\":" << e.durationNs / 1000.0 << "}";
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+template<typename Select>
+std::map<std::string, TraceRecorder::PhaseStats> TraceRecorder::sumCounters(Select select) {
+	// Summed over the threads, and over the different copies of the same literal
+	struct Totals {
+		uint64_t count = 0;
+		int64_t sumNs = 0, minNs = 0, maxNs = 0;
+		std::vector<uint64_t> histogram = std::vector<uint64_t>(HISTOGRAM_BUCKETS);
+	};
+	std::map<std::string, Totals> totals;
+	{
+		const uint64_t window = statsWindow.load(std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (const auto& buffer : buffers) {
+			for (const auto& phase : buffer->phases) {
+				if (phase.name.load(std::memory_order_relaxed) == nullptr) continue;
+				if (phase.window.load(std::memory_order_relaxed) != window) continue;
+				select(phase, [&](const Counters& counters) {
+					uint64_t count = counters.count.load(std::memory_order_acquire);
+					if (count == 0) return;
+					Totals& t = totals[phase.name.load(std::memory_order_relaxed)];
+					int64_t minNs = counters.minNs.load(std::memory_order_relaxed);
+					int64_t maxNs = counters.maxNs.load(std::memory_order_relaxed);
+					t.minNs = t.count == 0 ? minNs : std::min(t.minNs, minNs);
+					t.maxNs = t.count == 0 ? maxNs : std::max(t.maxNs, maxNs);
+					t.count += count;
+					t.sumNs += counters.sumNs.load(std::memory_order_relaxed);
+					for (size_t i = 0; i < HISTOGRAM_BUCKETS; i++) {
+						t.histogram[i] += counters.histogram[i].load(std::memory_order_relaxed);
+					}
+				});
+			}
+		}
+	}
+
+	std::map<std::string, PhaseStats> result;
+	for (const auto& [name, t] : totals) {
+		// The bucket of the event of that rank, kept within the exact extremes
+		auto percentile = [&t](double p) {
+			uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(p * double(t.count))), 1);
+			uint64_t seen = 0;
+			size_t bucket = 0;
+			while (bucket < HISTOGRAM_BUCKETS - 1 && (seen += t.histogram[bucket]) < rank) bucket++;
+			return std::clamp(histogramValue(bucket), t.minNs, t.maxNs) / 1000.0;
+		};
+
+		PhaseStats& stats = result[name];
+		stats.count = t.count;
+		stats.meanUs = double(t.sumNs) / double(t.count) / 1000.0;
+		stats.minUs = t.minNs / 1000.0;
+		stats.p50Us = percentile(0.50);
+		stats.p90Us = percentile(0.90);
+		stats.p99Us = percentile(0.99);
+		stats.maxUs = t.maxNs / 1000.0;
+	}
+	return result;
+}
+
+std::map<std::string, TraceRecorder::PhaseStats> TraceRecorder::computeStats() {
+	return sumCounters([](const PhaseCounters& phase, const auto& add) { add(phase.total); });
+}
+
+std::map<std::string, TraceRecorder::PhaseStats> TraceRecorder::computeRollingStats(int64_t nowNs) {
+	// The slice of nowNs and the ones before it, not the older ones still waiting to be reused
+	const int64_t last = std::max<int64_t>(nowNs, 0) / ROLLING_SLICE_NS;
+	return sumCounters([last](const PhaseCounters& phase, const auto& add) {
+		for (const auto& slice : phase.slices) {
+			int64_t index = slice.index.load(std::memory_order_relaxed);
+			if (index > last - int64_t(ROLLING_SLICES) && index <= last) add(slice.counters);
+		}
+	});
+}
+
+void TraceRecorder::writePhaseStats(std::ostream& out, const std::map<std::string, PhaseStats>& stats) {
+	for (const auto& [name, s] : stats) {
+		out << name << ": count " << s.count << ", mean " << s.meanUs << " us, min " << s.minUs
+		    << " us, p50 " << s.p50Us << " us, p90 " << s.p90Us << " us, p99 " << s.p99Us
+		    << " us, max " << s.maxUs << " us" << std::endl;
+	}
+}
+
+void TraceRecorder::writeStats(std::ostream& out) {
+	writePhaseStats(out, computeStats());
+	if (uint64_t uncounted = getUncountedEvents()) {
+		out << "Events of the phases past " << MAX_PHASES << " per thread: " << uncounted << std::endl;
+	}
+}
+
+void TraceRecorder::writeRollingStats(std::ostream& out, int64_t nowNs) {
+	writePhaseStats(out, computeRollingStats(nowNs));
+}
+
+uint64_t TraceRecorder::getUncountedEvents() {
+	const uint64_t window = statsWindow.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(registryMutex);
+	uint64_t result = 0;
+	for (const auto& buffer : buffers) {
+		if (buffer->uncountedWindow.load(std::memory_order_relaxed) == window) {
+			result += buffer->uncounted.load(std::memory_order_relaxed);
+		}
+	}
+	return result;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct TraceEvent {
+	const char* name;       // Must be a string literal (or live as long as the recorder)
+	int64_t startNs;        // Since the recorder creation
+	int64_t durationNs;
+};
+
+// Low-overhead recorder for the timings of the resize pipeline phases.
+//
+// Every thread writes into its own buffer, so recording an event takes no locks:
+// the only lock is taken once per thread, when its buffer is registered.
+// The ring keeps the latest RING_SIZE events of each thread for the Chrome trace
+// (chrome://tracing, Perfetto). The statistics don't depend on it: every event is also
+// added to the counters of its phase (count, sum, min, max and a histogram with buckets
+// an eighth of an octave wide), so they cover the whole window however long it is.
+// resetStats() starts a new window. The writers notice it at their next event of a phase
+// and clear the counters of that phase themselves, so the reset takes no locks from them either.
+// The rolling statistics cover the last ROLLING_SLICES slices of time only: every phase also has
+// counters per slice, reused in turn and cleared the same way by the writer that moves on to a new slice.
+// Snapshots read the buffers without stopping the writers, so an event that is being
+// recorded while a snapshot is taken may come out torn. Take them when the app is idle.
+//
+// Platform-neutral, the only dependency is the C++ standard library.
+class TraceRecorder {
+public:
+	static constexpr size_t RING_SIZE = 4096;
+	// The distinct phase names a thread can have counters for. The events of the others
+	// only go to the ring, and to getUncountedEvents()
+	static constexpr size_t MAX_PHASES = 64;
+	// The rolling window: the events that ended within the last second, the current slice in progress
+	static constexpr size_t ROLLING_SLICES = 4;
+	static constexpr int64_t ROLLING_SLICE_NS = 250000000;
+
+	// Count, mean, min and max are exact; the percentiles are exact to an eighth of an octave
+	struct PhaseStats {
+		size_t count = 0;
+		double meanUs = 0, minUs = 0, p50Us = 0, p90Us = 0, p99Us = 0, maxUs = 0;
+	};
+
+private:
+	// Durations below 8 ns get a bucket each, the longer ones 8 buckets per power of two
+	static const size_t HISTOGRAM_SUB_BUCKETS = 8;
+	static const size_t HISTOGRAM_BUCKETS = 61 * HISTOGRAM_SUB_BUCKETS;
+
+	// Written by the owning thread only, so the updates are plain loads and stores
+	struct Counters {
+		std::atomic<uint64_t> count = 0;
+		std::atomic<int64_t> sumNs = 0, minNs = 0, maxNs = 0;
+		std::array<std::atomic<uint32_t>, HISTOGRAM_BUCKETS> histogram = {};
+
+		void clear();
+		void add(int64_t durationNs);
+	};
+
+	struct RollingSlice {
+		std::atomic<int64_t> index = -1;       // The end times of the events divided by ROLLING_SLICE_NS
+		Counters counters;
+	};
+
+	struct PhaseCounters {
+		std::atomic<const char*> name = nullptr;
+		std::atomic<uint64_t> window = 0;      // The counters are of that window of statistics
+		Counters total;
+		std::array<RollingSlice, ROLLING_SLICES> slices;
+	};
+
+	struct ThreadBuffer {
+		uint32_t threadId = 0;
+		std::thread::id owner;
+		std::array<TraceEvent, RING_SIZE> events = {};
+		std::atomic<uint64_t> head = 0;     // The total number of events ever written
+		std::array<PhaseCounters, MAX_PHASES> phases;     // Open addressing by the name pointer
+		std::atomic<uint64_t> uncounted = 0;
+		std::atomic<uint64_t> uncountedWindow = 0;
+	};
+
+	const uint64_t recorderId;
+	std::atomic<bool> enabled = true;
+	std::atomic<uint64_t> statsWindow = 0;
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	ThreadBuffer& threadBuffer();
+	static void count(ThreadBuffer& buffer, const char* name, int64_t endNs, int64_t durationNs, uint64_t window);
+	// The statistics of the counters of the current window that pass the filter, summed per phase name
+	template<typename Select>
+	std::map<std::string, PhaseStats> sumCounters(Select select);
+	static void writePhaseStats(std::ostream& out, const std::map<std::string, PhaseStats>& stats);
+	static size_t histogramBucket(int64_t durationNs);
+	static int64_t histogramValue(size_t bucket);
+
+public:
+	TraceRecorder();
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	static TraceRecorder& instance();
+	static int64_t now();
+
+	void setEnabled(bool value) { enabled.store(value, std::memory_order_relaxed); }
+	bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+	void record(const char* name, int64_t startNs, int64_t durationNs);
+
+	// The events currently held by the rings, tagged with the thread IDs
+	std::vector<std::pair<uint32_t, TraceEvent>> snapshot();
+
+	// The Chrome trace event format (the JSON object flavour with complete "X" events)
+	void writeChromeTrace(std::ostream& out);
+
+	// The statistics of the events recorded since the last resetStats (or the creation), per phase name
+	std::map<std::string, PhaseStats> computeStats();
+	void writeStats(std::ostream& out);
+	// The statistics of the window limited to the events that ended in the last ROLLING_SLICES slices
+	// before nowNs, on the clock of now()
+	std::map<std::string, PhaseStats> computeRollingStats(int64_t nowNs = now());
+	void writeRollingStats(std::ostream& out, int64_t nowNs = now());
+	// Starts a new window of statistics. The rings, and so the Chrome trace, keep their events
+	void resetStats() { statsWindow.fetch_add(1, std::memory_order_relaxed); }
+
+	// The events of the window in the phases past MAX_PHASES of their thread, missing from the statistics
+	uint64_t getUncountedEvents();
+};
+
+// Records the lifetime of the object as an event, if the recorder is enabled
+class ScopedTimer {
+	const char* name;
+	int64_t start;
+
+public:
+	explicit ScopedTimer(const char* name) : name(name),
+			start(TraceRecorder::instance().isEnabled() ? TraceRecorder::now() : -1) { }
+
+	~ScopedTimer() {
+		if (start >= 0) TraceRecorder::instance().record(name, start, TraceRecorder::now() - start);
+	}
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
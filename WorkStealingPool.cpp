@@ -0,0 +1,86 @@
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace {
+
+// The pool and the queue of the current worker thread, so submit knows where to push
+thread_local const WorkStealingPool* currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+}
+
+WorkStealingPool::WorkStealingPool(unsigned threads) {
+	if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned i = 0; i < threads; i++) queues.push_back(std::make_unique<Queue>());
+	for (unsigned i = 0; i < threads; i++) workers.emplace_back(&WorkStealingPool::workerLoop, this, size_t(i));
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	state.fetch_or(STOPPING, std::memory_order_release);
+	state.notify_all();
+	for (auto& worker : workers) worker.join();
+}
+
+void WorkStealingPool::submit(std::function<void()> task) {
+	const size_t index = currentPool == this ? currentQueue : nextQueue.fetch_add(1) % queues.size();
+	{
+		std::lock_guard<std::mutex> lock(queues[index]->mutex);
+		queues[index]->tasks.push_back(std::move(task));
+	}
+	state.fetch_add(1, std::memory_order_release);
+	state.notify_one();
+}
+
+// Sleeps until there is a task to claim, or returns false when the pool stops and nothing is left
+bool WorkStealingPool::claimTask() {
+	uint64_t current = state.load(std::memory_order_acquire);
+	for (;;) {
+		if ((current & ~STOPPING) != 0) {
+			if (state.compare_exchange_weak(current, current - 1, std::memory_order_acquire)) return true;
+		} else if (current & STOPPING) {
+			return false;
+		} else {
+			state.wait(current, std::memory_order_acquire);
+			current = state.load(std::memory_order_acquire);
+		}
+	}
+}
+
+bool WorkStealingPool::takeTask(size_t index, std::function<void()>& task) {
+	// The newest task of our own queue first...
+	{
+		Queue& own = *queues[index];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+	// ...then the oldest one of somebody else's
+	for (size_t i = 1; i < queues.size(); i++) {
+		Queue& victim = *queues[(index + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::workerLoop(size_t index) {
+	currentPool = this;
+	currentQueue = index;
+
+	// The tasks are counted after they are pushed, so a claimed one is always in some queue. Not always
+	// in one we look at in time: another worker may take the task we were heading for while a new one
+	// lands in a queue we scanned already. Dropping the claim would leave that task with no count
+	while (claimTask()) {
+		std::function<void()> task;
+		while (!takeTask(index, task)) std::this_thread::yield();
+		task();
+	}
+}
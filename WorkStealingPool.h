@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// A thread pool where every worker has its own task queue. The tasks submitted from a worker go to
+// its own queue (and run in the LIFO order, while their data is still in the cache); an idle worker
+// steals the oldest tasks from the others. The tasks submitted from outside are spread round-robin.
+//
+// The idle workers sleep on the task count with an atomic wait, so submitting a task takes only
+// the lock of its queue, and waking a worker is a syscall only when one sleeps.
+//
+// The tasks given to submit must not throw: an exception escaping a worker terminates the process,
+// like on any other thread. async passes the exceptions on through the future.
+//
+// The destructor runs all the tasks that are still queued before joining the workers.
+class WorkStealingPool {
+public:
+	// 0 threads means "as many as the hardware has"
+	explicit WorkStealingPool(unsigned threads = 0);
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	void submit(std::function<void()> task);
+
+	template<class F>
+	auto async(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+		using R = std::invoke_result_t<std::decay_t<F>>;
+		// std::function needs a copyable target, and packaged_task isn't one
+		auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+		auto result = task->get_future();
+		submit([task] { (*task)(); });
+		return result;
+	}
+
+	unsigned getThreadCount() const { return unsigned(workers.size()); }
+
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::atomic<size_t> nextQueue = 0;
+
+	// The tasks pushed and not claimed yet, and the stop flag in the top bit: the workers wait
+	// for the whole word to change, so the destructor wakes them the same way a task does
+	static constexpr uint64_t STOPPING = uint64_t(1) << 63;
+	std::atomic<uint64_t> state = 0;
+
+	bool claimTask();
+	bool takeTask(size_t index, std::function<void()>& task);
+	void workerLoop(size_t index);
+};
@@ -0,0 +1,71 @@
+// Local headers
+#include "BCDecoder.h"
+
+// C++ stl
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Measures the BCDecoder throughput on random blocks (every mode of every format shows up),
+// with the scalar kernels and with every SIMD level the CPU has.
+// Usage: noflicker_bc_benchmark [size] [iterations]
+int main(int argc, char* argv[]) {
+	size_t size = argc > 1 ? size_t(std::atoi(argv[1])) : 2048;
+	if (size == 0) size = 2048;
+	int iterations = argc > 2 ? std::atoi(argv[2]) : 3;
+	if (iterations <= 0) iterations = 3;
+
+	const struct { BCFormat format; const char* name; } formats[] = {
+		{ BCFormat::BC1, "BC1" }, { BCFormat::BC2, "BC2" }, { BCFormat::BC3, "BC3" },
+		{ BCFormat::BC4, "BC4" }, { BCFormat::BC4Signed, "BC4 signed" },
+		{ BCFormat::BC5, "BC5" }, { BCFormat::BC5Signed, "BC5 signed" },
+		{ BCFormat::BC6H, "BC6H" }, { BCFormat::BC6HSigned, "BC6H signed" },
+		{ BCFormat::BC7, "BC7" },
+	};
+
+	const size_t blocks = (size / BCDecoder::BLOCK_SIZE) * (size / BCDecoder::BLOCK_SIZE);
+	std::mt19937 random(42);
+	std::vector<uint8_t> src(blocks * 16);
+	for (auto& byte : src) byte = uint8_t(random());
+
+	const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	const SIMDLevel best = detectSIMDLevel();
+	std::cout << size << "x" << size << ", " << iterations << " iterations, megapixels per second"
+	          << " with 1 and " << hardwareThreads << " threads:" << std::endl;
+
+	for (const auto& entry : formats) {
+		for (BCOutput output : { BCOutput::RGBA8, BCOutput::RGBA16F }) {
+			const size_t pixelSize = BCDecoder::pixelBytes(output);
+			std::vector<uint8_t> dst(size * size * pixelSize);
+			const size_t srcRowPitch = size / BCDecoder::BLOCK_SIZE * BCDecoder::blockBytes(entry.format);
+
+			std::cout << "  " << std::left << std::setw(12) << entry.name
+			          << (output == BCOutput::RGBA8 ? "-> RGBA8  " : "-> RGBA16F") << std::right;
+			for (SIMDLevel level : { SIMDLevel::Scalar, SIMDLevel::SSE41, SIMDLevel::AVX2 }) {
+				if (level > best) break;
+				BCDecoder::setSIMDLevel(level);
+				std::cout << "  " << simdLevelName(level) << " ";
+				const unsigned threadCounts[] = { 1u, hardwareThreads };
+				for (size_t t = 0; t < 2; t++) {
+					const unsigned threads = threadCounts[t];
+					auto start = std::chrono::steady_clock::now();
+					for (int i = 0; i < iterations; i++) {
+						BCDecoder::decode(entry.format, src.data(), srcRowPitch, size, size,
+						                  output, dst.data(), size * pixelSize, threads);
+					}
+					double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+					double megapixels = double(size) * double(size) * iterations / 1e6;
+					std::cout << (t > 0 ? " / " : "") << std::fixed << std::setprecision(1) << megapixels / seconds;
+				}
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	BCDecoder::setSIMDLevel(best);
+	return 0;
+}
@@ -0,0 +1,418 @@
+// Local headers
+#include "AsyncFileReader.h"
+#include "DDSBatchLoader.h"
+#include "DDSCompression.h"
+#include "DDSParser.h"
+#include "MipStreamer.h"
+#include "TextureCache.h"
+
+// C++ stl
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+struct CorpusFormat {
+	DXGIFormat format;
+	bool legacy;    // Written with the Direct3D 9 pixel format instead of the "DX10" header
+};
+
+// A DDS file with random pixels: a full mip chain, sometimes an array or a cube map
+std::vector<uint8_t> makeDDS(const CorpusFormat& entry, uint32_t width, uint32_t height,
+                             uint32_t arraySize, bool cubeMap, std::mt19937& random) {
+	uint32_t header[31] = {};
+	header[0] = 124;                      // size
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+	header[2] = height;
+	header[3] = width;
+	uint32_t mips = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1) mips++;
+	header[6] = mips;
+	header[18] = 32;                      // ddspf.size
+	header[26] = 0x1000 | 0x400000 | 0x8;    // caps: TEXTURE | MIPMAP | COMPLEX
+
+	uint32_t dx10[5] = {};
+	if (entry.legacy) {
+		if (entry.format == DXGIFormat::BC1_UNORM) {
+			header[19] = 0x4;                 // DDPF_FOURCC
+			header[20] = 0x31545844;          // "DXT1"
+		} else {
+			header[19] = 0x40 | 0x1;          // DDPF_RGB | DDPF_ALPHAPIXELS
+			header[21] = 32;
+			header[22] = 0x00ff0000; header[23] = 0x0000ff00; header[24] = 0x000000ff; header[25] = 0xff000000;
+		}
+		if (cubeMap) header[27] = 0x200 | 0xFC00;    // caps2: CUBEMAP and all the faces
+	} else {
+		header[19] = 0x4;
+		header[20] = 0x30315844;              // "DX10"
+		dx10[0] = uint32_t(entry.format);
+		dx10[1] = 3;                          // Texture2D
+		dx10[2] = cubeMap ? 0x4 : 0;
+		dx10[3] = arraySize;
+	}
+
+	DDSLayout layout;
+	std::vector<uint8_t> file(4 + sizeof(header) + (entry.legacy ? 0 : sizeof(dx10)));
+	std::memcpy(file.data(), "DDS ", 4);
+	std::memcpy(file.data() + 4, header, sizeof(header));
+	if (!entry.legacy) std::memcpy(file.data() + 4 + sizeof(header), dx10, sizeof(dx10));
+	if (DDSParser::parseHeader(file.data(), file.size(), layout) != DDSStatus::OK ||
+	    DDSParser::computeSubresources(layout) != DDSStatus::OK) {
+		return {};
+	}
+
+	file.resize(layout.headerSize + layout.dataSize);
+	for (size_t i = layout.headerSize; i < file.size(); i += 4) {
+		uint32_t bits = uint32_t(random());
+		std::memcpy(file.data() + i, &bits, std::min<size_t>(4, file.size() - i));
+	}
+	return file;
+}
+
+// The pixels of the file redrawn as runs of 16 byte blocks, half from a small palette and half noise:
+// about what the flat and the detailed areas of a real texture give a byte compressor, unlike the random pixels
+void makeCompressible(std::vector<uint8_t>& file, std::mt19937& random) {
+	DDSLayout layout;
+	if (DDSParser::parse(file.data(), file.size(), layout) != DDSStatus::OK) return;
+
+	uint8_t palette[256][16];
+	for (auto& block : palette) {
+		for (auto& byte : block) byte = uint8_t(random());
+	}
+	uint8_t noise[16];
+	for (size_t i = layout.headerSize; i < file.size();) {
+		// Every other run is noise
+		const uint8_t* block = palette[random() % 256];
+		if (random() % 2) {
+			for (auto& byte : noise) byte = uint8_t(random());
+			block = noise;
+		}
+		for (size_t run = 1 + random() % 4; run > 0 && i < file.size(); run--) {
+			const size_t size = std::min<size_t>(16, file.size() - i);
+			std::memcpy(file.data() + i, block, size);
+			i += size;
+		}
+	}
+}
+
+// Drops the file out of the page cache, so the next read goes to the disk. A no-op on tmpfs,
+// where the cache is all the storage there is
+void evictFromPageCache(const std::string& path) {
+#ifndef _WIN32
+	const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return;
+	fdatasync(fd);    // The dirty pages stay otherwise
+	posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+	close(fd);
+#endif
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+// Measures the DDS read and parse stages on a synthetic corpus, on one thread and on the batch loader pool,
+// then the asynchronous readers with the corpus dropped out of the page cache first (cold) and in it (warm),
+// the LZ4 supercompressed files against the raw ones, the mip streaming of the whole corpus from its 64 pixel tails, cold, without the GPU, and last
+// the texture cache under a budget of a quarter of the corpus, the files kept in memory.
+// Usage: noflicker_dds_benchmark [files] [directory]
+int main(int argc, char* argv[]) {
+	size_t count = argc > 1 ? size_t(std::atoi(argv[1])) : 400;
+	if (count == 0) count = 400;
+	std::filesystem::path directory = argc > 2 ? std::filesystem::path(argv[2])
+	                                           : std::filesystem::temp_directory_path() / "noflicker_dds_corpus";
+	std::filesystem::create_directories(directory);
+
+	const CorpusFormat formats[] = {
+		{ DXGIFormat::R8G8B8A8_UNORM_SRGB, false }, { DXGIFormat::B8G8R8A8_UNORM, true },
+		{ DXGIFormat::BC1_UNORM, true }, { DXGIFormat::BC3_UNORM, false }, { DXGIFormat::BC7_UNORM_SRGB, false },
+		{ DXGIFormat::R16G16B16A16_FLOAT, false },
+	};
+
+	std::mt19937 random(42);
+	std::vector<std::string> paths;
+	size_t corpusBytes = 0;
+	for (size_t i = 0; i < count; i++) {
+		const CorpusFormat& entry = formats[i % std::size(formats)];
+		uint32_t width = 32u << (random() % 5), height = 32u << (random() % 5);    // 32 - 512
+		bool cubeMap = i % 7 == 0;
+		if (cubeMap) height = width;
+		uint32_t arraySize = (!entry.legacy && !cubeMap && i % 5 == 0) ? 4 : 1;
+
+		std::vector<uint8_t> file = makeDDS(entry, width, height, arraySize, cubeMap, random);
+		std::string path = (directory / ("texture" + std::to_string(i) + ".dds")).string();
+		std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(file.data()), std::streamsize(file.size()));
+		corpusBytes += file.size();
+		paths.push_back(std::move(path));
+	}
+	std::cout << count << " files, " << double(corpusBytes) / 1e6 << " MB in " << directory.string() << std::endl;
+
+	// The parse stage alone, the headers and the subresource tables of the files already in memory
+	{
+		std::vector<DDSBatchItem> items(paths.size());
+		for (size_t i = 0; i < paths.size(); i++) {
+			items[i].path = paths[i];
+			DDSBatchLoader::loadItem(items[i]);
+		}
+
+		const int iterations = 100;
+		size_t subresources = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int it = 0; it < iterations; it++) {
+			for (auto& item : items) {
+				DDSParser::parse(item.data.data(), item.data.size(), item.layout);
+				subresources += item.layout.subresources.size();
+			}
+		}
+		double seconds = secondsSince(start);
+		std::cout << "  parse only:         " << double(count) * iterations / seconds / 1e6 << " M files/s ("
+		          << double(subresources) / seconds / 1e6 << " M subresources/s)" << std::endl;
+	}
+
+	// Read and parse, the way the loaders do it. The first pass only warms the page cache up
+	const unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+	{
+		WorkStealingPool pool(hardwareThreads);
+		DDSBatchLoader::load(pool, paths).get();
+	}
+	for (unsigned threads : { 1u, hardwareThreads }) {
+		WorkStealingPool pool(threads);
+		auto start = std::chrono::steady_clock::now();
+		std::vector<DDSBatchItem> items = DDSBatchLoader::load(pool, paths).get();
+		double seconds = secondsSince(start);
+
+		size_t failed = std::count_if(items.begin(), items.end(), [](const DDSBatchItem& item) {
+			return item.status != DDSStatus::OK;
+		});
+		std::cout << "  batch, " << threads << (threads == 1 ? " thread:  " : " threads: ")
+		          << double(count) / seconds << " files/s, " << double(corpusBytes) / seconds / 1e6 << " MB/s";
+		if (failed) std::cout << " (" << failed << " failed)";
+		std::cout << std::endl;
+	}
+
+	// The asynchronous readers. The header and the payload of every file are separate reads
+	for (auto backend : { AsyncFileReader::Backend::ThreadPool, AsyncFileReader::Backend::IoUring }) {
+		auto reader = AsyncFileReader::create(backend, hardwareThreads);
+		if (reader->getBackend() != backend) {
+			std::cout << "  " << AsyncFileReader::toString(backend) << ": not available" << std::endl;
+			continue;
+		}
+
+		// The last run loads the 64 pixel variants, reading only the small mips
+		const struct { bool cold; size_t maxsize; const char* name; } runs[] = {
+			{ true, 0, ", cold:            " }, { false, 0, ", warm:            " }, { true, 64, ", cold, maxsize 64: " },
+		};
+		for (const auto& run : runs) {
+			if (run.cold) {
+				for (const auto& path : paths) evictFromPageCache(path);
+			}
+			auto start = std::chrono::steady_clock::now();
+			std::vector<DDSBatchItem> items = DDSBatchLoader::load(*reader, paths, run.maxsize).get();
+			double seconds = secondsSince(start);
+
+			size_t failed = std::count_if(items.begin(), items.end(), [](const DDSBatchItem& item) {
+				return item.status != DDSStatus::OK;
+			});
+			size_t bytes = 0;
+			for (const auto& item : items) bytes += item.data.size();
+			std::cout << "  " << AsyncFileReader::toString(backend) << run.name
+			          << double(count) / seconds << " files/s, " << double(bytes) / 1e6 << " MB read";
+			if (failed) std::cout << " (" << failed << " failed)";
+			std::cout << std::endl;
+		}
+	}
+
+	// The supercompressed corpus against the same files raw, read and expanded by the batch loader pool.
+	// The pixels are made compressible first, see makeCompressible
+	{
+		std::vector<std::string> rawPaths, compressedPaths;
+		size_t rawBytes = 0, compressedBytes = 0;
+		for (size_t i = 0; i < paths.size(); i++) {
+			std::ifstream in(paths[i], std::ios::binary);
+			std::vector<uint8_t> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+			makeCompressible(file, random);
+			std::vector<uint8_t> compressed;
+			if (DDSCompression::compress(file.data(), file.size(), DDSCodec::LZ4, compressed) != DDSStatus::OK) continue;
+
+			const std::string stem = (directory / ("flat" + std::to_string(i))).string();
+			rawPaths.push_back(stem + ".dds");
+			compressedPaths.push_back(stem + ".lz4.dds");
+			std::ofstream(rawPaths.back(), std::ios::binary).write(reinterpret_cast<const char*>(file.data()),
+			                                                       std::streamsize(file.size()));
+			std::ofstream(compressedPaths.back(), std::ios::binary).write(reinterpret_cast<const char*>(compressed.data()),
+			                                                              std::streamsize(compressed.size()));
+			rawBytes += file.size();
+			compressedBytes += compressed.size();
+		}
+		std::cout << "  lz4 supercompression: " << double(rawBytes) / 1e6 << " MB -> " << double(compressedBytes) / 1e6
+		          << " MB, " << double(rawBytes) / double(compressedBytes) << ":1" << std::endl;
+
+		WorkStealingPool pool(hardwareThreads);
+		const struct { const std::vector<std::string>* paths; const char* name; } corpora[] = {
+			{ &rawPaths, "raw" }, { &compressedPaths, "lz4" },
+		};
+		for (bool cold : { true, false }) {
+			for (const auto& corpus : corpora) {
+				if (cold) {
+					for (const auto& path : *corpus.paths) evictFromPageCache(path);
+				}
+				auto start = std::chrono::steady_clock::now();
+				std::vector<DDSBatchItem> items = DDSBatchLoader::load(pool, *corpus.paths).get();
+				double seconds = secondsSince(start);
+
+				size_t failed = std::count_if(items.begin(), items.end(), [](const DDSBatchItem& item) {
+					return item.status != DDSStatus::OK;
+				});
+				std::cout << "  batch " << corpus.name << (cold ? ", cold: " : ", warm: ") << double(items.size()) / seconds
+				          << " files/s, " << double(rawBytes) / seconds / 1e6 << " MB/s of pixels";
+				if (failed) std::cout << " (" << failed << " failed)";
+				std::cout << std::endl;
+			}
+		}
+
+		// A single large file expanded the way the Direct3D loaders do it, its subresources on all the cores
+		std::vector<uint8_t> file = makeDDS({ DXGIFormat::BC7_UNORM, false }, 4096, 4096, 1, false, random);
+		makeCompressible(file, random);
+		std::vector<uint8_t> compressed;
+		DDSCompression::compress(file.data(), file.size(), DDSCodec::LZ4, compressed);
+		std::vector<uint8_t> expanded(file.size());
+		for (unsigned threads : { 1u, hardwareThreads }) {
+			const int iterations = 10;
+			auto start = std::chrono::steady_clock::now();
+			for (int it = 0; it < iterations; it++) {
+				DDSCompression::expand(compressed.data(), compressed.size(), expanded.data(), 0, threads);
+			}
+			double seconds = secondsSince(start);
+			std::cout << "  expand 4096x4096 BC7, " << threads << (threads == 1 ? " thread:  " : " threads: ")
+			          << double(file.size()) * iterations / seconds / 1e6 << " MB/s"
+			          << (expanded == file ? "" : " (mismatch)") << std::endl;
+		}
+	}
+
+	// The mip streaming the way DDSTextureStreamer drives it, the landed reads standing in for the uploads
+	{
+		auto reader = AsyncFileReader::create(AsyncFileReader::Backend::IoUring, hardwareThreads);
+		for (const auto& path : paths) evictFromPageCache(path);
+
+		MipStreamer streamer;
+		std::vector<std::string> texturePaths(paths.size() + 1);    // By id, the ids start at 1
+		auto start = std::chrono::steady_clock::now();
+		for (const auto& path : paths) {
+			DDSBatchItem tail = reader->readDDS(path, 64).get();
+			if (tail.status != DDSStatus::OK) continue;
+			DDSLayout layout = tail.layout;
+			if (DDSParser::computeSubresources(layout) != DDSStatus::OK) continue;
+			texturePaths.at(streamer.add(layout, tail.layout.skipMip)) = path;
+		}
+		double tailSeconds = secondsSince(start);
+
+		struct Landed {
+			MipStreamRequest request;
+			int error;
+		};
+		std::mutex mutex;
+		std::condition_variable cv;
+		std::vector<Landed> landed;
+		size_t bytes = 0, peakBytes = 0;
+		for (;;) {
+			for (MipStreamRequest& request : streamer.schedule()) {
+				bytes += request.size;
+				reader->readRanges(texturePaths[request.texture], request.ranges,
+				                   [&, request](int error, std::vector<uint8_t>) {
+					std::lock_guard<std::mutex> lock(mutex);
+					landed.push_back({ request, error });
+					cv.notify_one();
+				});
+			}
+			peakBytes = std::max(peakBytes, streamer.getStats().inFlightBytes);
+			if (streamer.getStats().inFlight == 0) break;
+
+			std::vector<Landed> batch;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cv.wait(lock, [&] { return !landed.empty(); });
+				batch.swap(landed);
+			}
+			for (const Landed& entry : batch) {
+				if (entry.error) streamer.fail(entry.request);
+				else streamer.complete(entry.request);
+			}
+		}
+		double seconds = secondsSince(start);
+
+		const MipStreamer::Stats& stats = streamer.getStats();
+		std::cout << "  streaming, " << AsyncFileReader::toString(reader->getBackend()) << ": tails in " << tailSeconds * 1e3
+		          << " ms, resident in " << seconds * 1e3 << " ms, " << stats.completed << " levels, "
+		          << double(bytes) / 1e6 << " MB, " << double(peakBytes) / 1e6 << " MB in flight at most";
+		if (stats.failed) std::cout << " (" << stats.failed << " failed)";
+		std::cout << std::endl;
+	}
+
+	// The texture cache with the parsed files standing in for the textures. The requests favour
+	// a few files the way the scenes do (a Zipf distribution)
+	{
+		struct CpuResidency : TextureResidency {
+			bool load(const std::string& path, uint32_t, CachedTexture& texture) override {
+				auto item = std::make_unique<DDSBatchItem>();
+				item->path = path;
+				DDSBatchLoader::loadItem(*item);
+				if (item->status != DDSStatus::OK) return false;
+				texture.cpuBytes = item->data.size();
+				texture.texture = item.release();
+				return true;
+			}
+			void evict(const CachedTexture& texture) override {
+				delete static_cast<DDSBatchItem*>(texture.texture);
+			}
+		} residency;
+
+		TextureCache::Settings settings;
+		settings.cpuBudget = corpusBytes / 4;
+		TextureCache cache(residency, settings);
+
+		std::vector<double> weights(paths.size());
+		for (size_t i = 0; i < weights.size(); i++) weights[i] = 1.0 / double(i + 1);
+
+		const size_t requestsPerThread = 20000;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < hardwareThreads; t++) {
+			threads.emplace_back([&, t] {
+				std::mt19937 threadRandom(t);
+				std::discrete_distribution<size_t> pick(weights.begin(), weights.end());
+				for (size_t i = 0; i < requestsPerThread; i++) {
+					TextureCache::Reference texture = cache.acquire(paths[pick(threadRandom)]);
+				}
+			});
+		}
+		for (auto& thread : threads) thread.join();
+		double seconds = secondsSince(start);
+
+		const TextureCache::Stats stats = cache.getStats();
+		const double requests = double(requestsPerThread) * hardwareThreads;
+		std::cout << "  cache, " << double(settings.cpuBudget) / 1e6 << " MB budget: " << requests / seconds
+		          << " requests/s, " << double(stats.hits) / requests * 100 << "% hits, " << stats.misses
+		          << " loads, " << stats.joined << " joined, " << stats.evictions << " evictions" << std::endl;
+	}
+
+	return 0;
+}
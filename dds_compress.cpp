@@ -0,0 +1,75 @@
+// Local headers
+#include "DDSCompression.h"
+#include "DDSParser.h"
+
+// C++ stl
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Writes the supercompressed DDS files the loaders expand (see DDSCompression.h), and back:
+//
+//     noflicker_dds_compress [--codec lz4|stored] input.dds output.dds
+//     noflicker_dds_compress --expand input.dds output.dds
+int main(int argc, char* argv[]) {
+	DDSCodec codec = DDSCodec::LZ4;
+	bool expand = false;
+	std::vector<std::string> paths;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--expand") == 0) {
+			expand = true;
+		} else if (std::strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+			const std::string name = argv[++i];
+			if (name == "lz4") codec = DDSCodec::LZ4;
+			else if (name == "stored") codec = DDSCodec::Stored;
+			else {
+				std::cerr << "Unknown codec " << name << std::endl;
+				return 2;
+			}
+		} else {
+			paths.push_back(argv[i]);
+		}
+	}
+	if (paths.size() != 2) {
+		std::cerr << "Usage: " << argv[0] << " [--codec lz4|stored] input.dds output.dds" << std::endl
+		          << "       " << argv[0] << " --expand input.dds output.dds" << std::endl;
+		return 2;
+	}
+
+	std::ifstream in(paths[0], std::ios::binary);
+	std::vector<uint8_t> input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	if (!in && !in.eof()) {
+		std::cerr << "Can't read " << paths[0] << std::endl;
+		return 1;
+	}
+
+	std::vector<uint8_t> output;
+	DDSStatus status;
+	if (expand) {
+		size_t size = 0;
+		status = DDSCompression::getExpandedSize(input.data(), input.size(), size);
+		if (status == DDSStatus::OK) {
+			output.resize(size);
+			status = DDSCompression::expand(input.data(), input.size(), output.data());
+		}
+	} else {
+		status = DDSCompression::compress(input.data(), input.size(), codec, output);
+	}
+	if (status != DDSStatus::OK) {
+		std::cerr << paths[0] << ": " << toString(status) << std::endl;
+		return 1;
+	}
+
+	std::ofstream out(paths[1], std::ios::binary);
+	if (!out.write(reinterpret_cast<const char*>(output.data()), std::streamsize(output.size()))) {
+		std::cerr << "Can't write " << paths[1] << std::endl;
+		return 1;
+	}
+	std::cout << paths[0] << " " << input.size() << " bytes -> " << paths[1] << " " << output.size() << " bytes";
+	if (!expand) std::cout << " (" << toString(codec) << ", " << double(input.size()) / double(output.size()) << ":1)";
+	std::cout << std::endl;
+	return 0;
+}
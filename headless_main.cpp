@@ -0,0 +1,169 @@
+// Local headers
+#include "DemoContents.h"
+#include "HeadlessPlatform.h"
+#include "SoftwareRasterizer.h"
+#include "TraceRecorder.h"
+
+// C++ stl
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Every heap allocation of the process, for the allocations per resize. The contents write their
+// vertices straight into the upload memory, so a resize that keeps the buffers should allocate nothing
+static std::atomic<size_t> heapAllocations = 0;
+
+void* operator new(size_t size) {
+	heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size != 0 ? size : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// Writes the presented part of the last frame as a binary PPM, for comparing the frames pixel by pixel
+static bool writeFrame(const SoftwareRasterizer& rasterizer, const std::string& fileName) {
+	std::ofstream file(fileName, std::ios::binary);
+	if (!file) return false;
+	int width = rasterizer.getViewportWidth(), height = rasterizer.getViewportHeight();
+	file << "P6\n" << width << " " << height << "\n255\n";
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint32_t pixel = rasterizer.getPixels()[size_t(y) * rasterizer.getBufferWidth() + x];
+			char rgb[3] = { char((pixel >> 16) & 0xFF), char((pixel >> 8) & 0xFF), char(pixel & 0xFF) };
+			file.write(rgb, 3);
+		}
+	}
+	return bool(file);
+}
+
+template <typename V>
+static void run(std::shared_ptr<_GraphicContents<V>> contents, std::shared_ptr<HeadlessSurface<V>> surface,
+                bool renderThread, bool animate, int steps, const char* traceFileName, const char* frameFileName) {
+	HeadlessPlatform<V> platform(contents, surface, renderThread || animate);
+
+	auto trace = HeadlessPlatform<V>::makeDragTrace({ 100, 100, 900, 700 }, 1200, 600, steps);
+
+	// The animation runs on its own for a while before and after the drag. The resizes wait for the
+	// vblanks like on Windows, so the drag takes a refresh period per step
+	const auto idleAnimation = std::chrono::milliseconds(500);
+	if (animate) {
+		surface->setResizeVBlankWait(true);
+		platform.resize(trace.front());
+		platform.getRenderThread()->startAnimation(FramePacer::DEFAULT_REFRESH_PERIOD_NS);
+		std::this_thread::sleep_for(idleAnimation);
+	}
+
+	// The reallocation count belongs to the thread that draws, so the resizes that keep the buffers
+	// are told apart only when nothing draws between them
+	size_t allocations = 0, keepingResizes = 0, keepingAllocations = 0;
+	// The statistics from the drag on, without the frames of the warm-up
+	TraceRecorder::instance().resetStats();
+	auto start = std::chrono::steady_clock::now();
+	if (animate) {
+		size_t before = heapAllocations.load(std::memory_order_relaxed);
+		platform.replay(trace);
+		allocations = heapAllocations.load(std::memory_order_relaxed) - before;
+	} else {
+		for (const auto& rect : trace) {
+			size_t reallocations = surface->getReallocations();
+			size_t before = heapAllocations.load(std::memory_order_relaxed);
+			platform.resize(rect);
+			size_t count = heapAllocations.load(std::memory_order_relaxed) - before;
+			allocations += count;
+			if (surface->getReallocations() == reallocations) {
+				keepingResizes++;
+				keepingAllocations += count;
+			}
+		}
+	}
+	auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	// The end of the drag, before the idle animation adds its frames
+	std::ostringstream rollingStats;
+	TraceRecorder::instance().writeRollingStats(rollingStats);
+
+	if (animate) {
+		std::this_thread::sleep_for(idleAnimation);
+		platform.getRenderThread()->stopAnimation();
+		platform.getRenderThread()->getFramePacer().writeStats(std::cout);
+	}
+
+	std::cout << "Resizes: " << trace.size()
+	          << ", presented frames: " << surface->getPresentedFrames()
+	          << ", buffer reallocations: " << surface->getReallocations()
+	          << ", blocking fence waits: " << surface->getBlockingFenceWaits() << std::endl;
+	std::cout << "Total: " << elapsed << " ms, " << elapsed * 1000.0 / trace.size() << " us per resize" << std::endl;
+	std::cout << "Heap allocations: " << allocations << ", " << double(allocations) / trace.size() << " per resize";
+	if (!animate) {
+		std::cout << ", " << (keepingResizes > 0 ? double(keepingAllocations) / keepingResizes : 0.0)
+		          << " per resize that keeps the buffers (" << keepingResizes << ")";
+	}
+	std::cout << std::endl;
+	TraceRecorder::instance().writeStats(std::cout);
+	std::cout << "The last " << TraceRecorder::ROLLING_SLICES * TraceRecorder::ROLLING_SLICE_NS / 1000000
+	          << " ms of the drag:" << std::endl << rollingStats.str();
+
+	if (traceFileName) {
+		std::ofstream traceFile(traceFileName);
+		TraceRecorder::instance().writeChromeTrace(traceFile);
+	}
+	if (frameFileName && !writeFrame(surface->getRasterizer(), frameFileName)) {
+		std::cerr << "Can't write " << frameFileName << std::endl;
+	}
+}
+
+// Runs the resize pipeline without a window and a GPU and reports where the time goes.
+// Usage: noflicker_headless [--image] [--render-thread] [--animate] [--frame last_frame.ppm] [steps] [trace.json]
+//   --image          draws grass.dds full screen (the DirectX 11 demo) instead of the triangle (the DirectX 12 demo)
+//   --render-thread  renders on a RenderThread, the way the Win32 demos do, instead of the replaying thread
+//   --animate        renders continuously on the RenderThread at 60 Hz during the drag (and half a second
+//                    before and after it) and reports the frame pacing. The resizes wait for the vblanks
+//                    then, so the steps default to 30
+int main(int argc, char* argv[]) {
+	bool image = false;
+	bool renderThread = false;
+	bool animate = false;
+	const char* frameFileName = nullptr;
+	const char* positional[2] = {};
+	int positionalCount = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--image") == 0) image = true;
+		else if (std::strcmp(argv[i], "--render-thread") == 0) renderThread = true;
+		else if (std::strcmp(argv[i], "--animate") == 0) animate = true;
+		else if (std::strcmp(argv[i], "--frame") == 0 && i + 1 < argc) frameFileName = argv[++i];
+		else if (positionalCount < 2) positional[positionalCount++] = argv[i];
+	}
+
+	// A second of the drag in the animation mode
+	const int defaultSteps = animate ? 30 : 2000;
+	int steps = positional[0] ? std::atoi(positional[0]) : defaultSteps;
+	if (steps <= 0) steps = defaultSteps;
+	const char* traceFileName = positional[1];
+
+	if (image) {
+		auto texture = std::make_shared<SoftwareTexture>();
+		if (!texture->loadDDS("grass.dds")) {
+			std::cerr << "Can't load grass.dds" << std::endl;
+			return 1;
+		}
+		auto contents = std::make_shared<FullScreenImageGraphicContents>();
+		auto surface = std::make_shared<HeadlessSurface<TextureVertex>>(contents);
+		surface->setTexture(texture);
+		run<TextureVertex>(contents, surface, renderThread, animate, steps, traceFileName, frameFileName);
+	} else {
+		auto contents = std::make_shared<TriangleGraphicContents>();
+		auto surface = std::make_shared<HeadlessSurface<RGBAVertex>>(contents);
+		run<RGBAVertex>(contents, surface, renderThread, animate, steps, traceFileName, frameFileName);
+	}
+
+	return 0;
+}
@@ -2,149 +2,35 @@
 #include "D3DContext.h"
 #include "DCompContext.h"
 #include "GraphicContents.h"
+#include "DemoContents.h"
+#include "Platform.h"
+#include "RenderThread.h"
+#include "TraceRecorder.h"
 
 // OS headers
 #include <Windows.h>
 
 // C++ stl
+#include <exception>
+#include <fstream>
+#include <iostream>
 #include <memory>
 #include <mutex>
 
 #if defined(USE_DX12)
-class TriangleGraphicContents : public GraphicContents {
-private:
-    int width = 0, height = 0;
-
-public:
-    void updateLayout(int width, int height) override {
-        this->width = width; this->height = height;
-
-        // Uncomment this fake resizing load here to see how the app handles it
-        // 100ms is a huge time pretty enough to recalculate even a very complicated layout
-        //
-        // Sleep(100);
-    }
-
-    std::vector<RGBAVertex> getVertices() override {
-        float aspect = (float) width / (float) height;
-        float k = 760.f / (float) width;
-        float sin60 = sqrtf(3.f) / 2;
-		float d = 0.3f;
-        std::vector<RGBAVertex> vertices = {
-            {0.0f * k,   0.5f * sin60 * aspect * k, 0.0f,  0.5f, 0.0f, 0.5f},
-            {0.5f * k,  -0.5f * sin60 * aspect * k, 0.0f,  0.5f + d, 1.0f, 0.5f},
-            {-0.5f * k, -0.5f * sin60 * aspect * k, 0.0f,  0.5f - d, 1.0f, 0.5f}
-        };
-        return vertices;
-    }
-
-//	std::string getShader() override {
-//		return {
-//				"Texture2D txDiffuse : register( t0 );\n"
-//				"SamplerState samLinear : register( s0 );\n"
-//				"\n"
-//				"struct VSInput {\n"
-//				"	float4 position : POSITION;\n"
-//				"	float2 Tex  : TEXCOORD0;\n"
-//				"};\n"
-//				"struct PSInput {\n"
-//				"	float4 position : SV_POSITION;\n"
-//				"	float2 Tex  : TEXCOORD0;\n"
-//				"};\n"
-//				"PSInput VSMain(VSInput input) {\n"
-//				"	PSInput output;\n"
-//				"	output.position = input.position;\n"
-//				"	output.Tex = input.Tex;\n"
-//				"	return output;\n"
-//				"}\n"
-//				"float4 PSMain(PSInput input) : SV_TARGET {\n"
-//				"	 return txDiffuse.Sample( samLinear, input.Tex );\n"
-//				"}\n"
-//		};
-//	}
-    std::string getShader() override {
-        return {
-            "struct PSInput {\n"
-            "	float4 position : SV_POSITION;\n"
-            "	float4 color : COLOR;\n"
-            "};\n"
-            "PSInput VSMain(float4 position : POSITION0, float4 color : COLOR0) {\n"
-            "	PSInput result;\n"
-            "	result.position = position;\n"
-            "	result.color = color;\n"
-            "	return result;\n"
-            "}\n"
-            "float4 PSMain(PSInput input) : SV_TARGET {\n"
-            "	return input.color;\n"
-            "}\n"
-        };
-    }
-};
+typedef RenderThread<RGBAVertex> D3DRenderThread;
 #elif defined(USE_DX11)
-class FullScreenImageGraphicContents : public GraphicContents {
-private:
-	int width = 0, height = 0;
-
-public:
-	void updateLayout(int width, int height) override {
-		this->width = width; this->height = height;
-
-		// Uncomment this fake resizing load here to see how the app handles it
-		// 100ms is a huge time pretty enough to recalculate even a very complicated layout
-		//
-		//Sleep(100);
-	}
-
-	std::vector<TextureVertex> getVertices() override {
-		float aspect = (float) width / (float) height;
-		float k = 1;//760.f / (float) width;
-		//float sin60 = sqrtf(3.f) / 2;
-		std::vector<TextureVertex> vertices = {
-				{-1.0f * k,  1.0f * k,  0.0f,  0.0f, 0.0f},
-				{ 1.0f * k,  1.0f * k,  0.0f,  1.0f, 0.0f},
-				{ 1.0f * k, -1.0f * k,  0.0f,  1.0f, 1.0f},
-
-				{-1.0f * k, -1.0f * k,  0.0f,  0.0f, 1.0f},
-				{ 1.0f * k, -1.0f * k,  0.0f,  1.0f, 1.0f},
-				{-1.0f * k,  1.0f * k,  0.0f,  0.0f, 0.0f},
-		};
-		return vertices;
-	}
-
-	std::string getShader() override {
-		return {
-			"Texture2D txDiffuse : register( t0 );\n"
-			    "SamplerState samLinear : register( s0 );\n"
-				"\n"
-				"struct VSInput {\n"
-				"	float4 position : POSITION;\n"
-				"	float2 Tex  : TEXCOORD0;\n"
-				"};\n"
-				"struct PSInput {\n"
-				"	float4 position : SV_POSITION;\n"
-				"	float2 Tex  : TEXCOORD0;\n"
-				"};\n"
-				"PSInput VSMain(VSInput input) {\n"
-				"	PSInput output;\n"
-				"	output.position = input.position;\n"
-				"	output.Tex = input.Tex;\n"
-				"	return output;\n"
-				"}\n"
-				"float4 PSMain(PSInput input) : SV_TARGET {\n"
-				"	 return txDiffuse.Sample( samLinear, input.Tex );\n"
-				"}\n"
-		};
-	}
-};
-#else
-	#error "You should set either USE_DX11 or USE_DX12"
+typedef RenderThread<TextureVertex> D3DRenderThread;
 #endif
 
 // Global declarations
-std::shared_ptr<D3DContext> context;
+std::unique_ptr<D3DRenderThread> renderThread;     // Owns the D3DContext
 std::shared_ptr<DCompContext> dcompContext;
 std::shared_ptr<GraphicContents> contents;
 bool exitPending;
+bool animating;     // The continuous mode, toggled with the A key
+// What the render thread threw, caught in window_proc so that it doesn't unwind through DispatchMessage
+std::exception_ptr renderError;
 
 // Passthrough (t) if truthy. Crash otherwise.
 template<class T> T win32_check(T t)
@@ -157,6 +43,15 @@ template<class T> T win32_check(T t)
 }
 
 
+// The refresh period of the primary display, for the frame pacing statistics
+static int64_t getRefreshPeriodNs()
+{
+    DEVMODE mode = {};
+    mode.dmSize = sizeof(mode);
+    if (!EnumDisplaySettings(nullptr, ENUM_CURRENT_SETTINGS, &mode) || mode.dmDisplayFrequency <= 1) return 0;
+    return 1000000000ll / mode.dmDisplayFrequency;
+}
+
 // Win32 message handler.
 LRESULT window_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
 {
@@ -174,14 +69,49 @@ LRESULT window_proc(HWND hwnd, UINT message, WPARAM wparam, LPARAM lparam)
             return 0;
         }
 
+        case WM_DISPLAYCHANGE: {
+            // The monitors were added, removed or rearranged
+            renderThread->post([](RenderSurface& surface) { static_cast<D3DContext&>(surface).invalidateDisplayTopology(); });
+            // The refresh rate may have changed too
+            if (animating) renderThread->startAnimation(getRefreshPeriodNs());
+            return DefWindowProc(hwnd, message, wparam, lparam);
+        }
+
+        case WM_KEYDOWN: {
+            // A: the continuous animation on and off. The resizes keep working the same way in both modes
+            if (wparam == 'A') {
+                animating = !animating;
+                if (animating) renderThread->startAnimation(getRefreshPeriodNs());
+                else renderThread->stopAnimation();
+                return 0;
+            }
+#if defined(USE_DX12)
+            // 1 to 3: the maximum frame latency, the lowest input-to-photon latency to the highest throughput
+            if (wparam >= '1' && wparam <= '3') {
+                UINT latency = UINT(wparam - '0');
+                renderThread->post([latency](RenderSurface& surface) { static_cast<D3DContext&>(surface).setMaximumFrameLatency(latency); });
+                return 0;
+            }
+#endif
+            return DefWindowProc(hwnd, message, wparam, lparam);
+        }
+
         case WM_NCCALCSIZE: {
             // Use the result of DefWindowProc's WM_NCCALCSIZE handler to get the upcoming client rect.
             // Technically, when wparam is TRUE, lparam points to NCCALCSIZE_PARAMS, but its first
             // member is a RECT with the same meaning as the one lparam points to when wparam is FALSE.
+            ScopedTimer timer("WM_NCCALCSIZE");
             DefWindowProc(hwnd, message, wparam, lparam);
-            if (RECT *rect = (RECT *) lparam; rect->right > rect->left && rect->bottom > rect->top) {
-                contents->updateLayout(rect->right - rect->left, rect->bottom - rect->top);
-                context->reposition(*rect);
+            // The frame is rendered on the render thread, and we wait only until it is presented.
+            // A failure of the render thread comes back here, the message loop ends after this message
+            RECT *rect = (RECT *) lparam;
+            if (!renderError) {
+                try {
+                    renderThread->resize({ rect->left, rect->top, rect->right, rect->bottom });
+                } catch (...) {
+                    renderError = std::current_exception();
+                    exitPending = true;
+                }
             }
             // We're never preserving the client area, so we always return 0.
             return 0;
@@ -203,7 +133,8 @@ int WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int)
 	#error "You should set either USE_DX11 or USE_DX12"
 #endif
 
-    context = std::make_shared<D3DContext>(contents);
+    // The device and the swap chain are created on the render thread, and used from there only
+    renderThread = std::make_unique<D3DRenderThread>(contents, [] { return std::make_shared<D3DContext>(contents); });
 
     // Register the window class.
     WNDCLASS wc = {};
@@ -232,12 +163,14 @@ int WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int)
     // The DCompContext creation/destruction is fundamentally asymmetric.
     // We are cleaning up the resources in WM_DESTROY, but should NOT create the object in WM_CREATE.
     // Instead, we create it here between construction of the window and showing it
-    dcompContext = std::make_shared<DCompContext>(hwnd, context);
+    dcompContext = std::make_shared<DCompContext>(hwnd, std::static_pointer_cast<D3DContext>(renderThread->getSurface()));
 
     // Show the window and enter the message loop.
     ShowWindow(hwnd, SW_SHOWNORMAL);
 
     exitPending = false;
+    animating = false;
+    // The render thread paces the frames itself, so the message loop can sleep in GetMessage in both modes
     while (!exitPending)
     {
         MSG msg;
@@ -246,5 +179,40 @@ int WinMain(HINSTANCE hinstance, HINSTANCE, LPSTR, int)
         DispatchMessage(&msg);
     }
 
+#ifdef _DEBUG
+    // How evenly the animation frames came, since the last time it was switched on. Taking them waits for
+    // the render thread, which rethrows a failure no resize has seen yet
+    if (!renderError) {
+        try {
+            renderThread->getFramePacer().writeStats(std::cout);
+        } catch (...) {
+            renderError = std::current_exception();
+        }
+    }
+#endif
+
+    // Releases the device on the render thread and joins it
+    renderThread.reset();
+
+    if (renderError) {
+        try {
+            std::rethrow_exception(renderError);
+        } catch (const std::exception& e) {
+            std::cerr << "Rendering failed: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Rendering failed" << std::endl;
+        }
+        return 1;
+    }
+
+#ifdef _DEBUG
+    // Where the resizing time went. Open the trace in chrome://tracing or ui.perfetto.dev
+    {
+        std::ofstream traceFile("resize_trace.json");
+        TraceRecorder::instance().writeChromeTrace(traceFile);
+        TraceRecorder::instance().writeStats(std::cout);
+    }
+#endif
+
     return 0;
 }
\ No newline at end of file
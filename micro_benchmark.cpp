@@ -0,0 +1,79 @@
+// Local headers
+#include "RingBufferAllocator.h"
+#include "ShaderCache.h"
+
+// C++ stl
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A compiler that costs nothing, so the benchmark measures the cache itself
+struct StubCompiler : ShaderCompiler {
+	std::vector<uint8_t> compile(const std::string& source, const std::string&, const std::string&, uint32_t) override {
+		return std::vector<uint8_t>(source.begin(), source.end());
+	}
+};
+
+template <typename F>
+static double nanosecondsPerCall(int iterations, F&& f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++) f(i);
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+// The per-frame cost of a shader lookup, a hit in each tier and a miss
+static void benchmarkShaderCache(int iterations) {
+	StubCompiler compiler;
+	// A shader of a realistic size, the triangle demo's is about 300 bytes
+	std::string source(2048, 'x');
+	auto directory = std::filesystem::temp_directory_path() / "noflicker_micro_benchmark_shaders";
+	std::filesystem::remove_all(directory);
+
+	std::cout << "ShaderCache, ns per get():" << std::endl;
+	{
+		ShaderCache cache(compiler);
+		cache.get(source, "VSMain", "vs_5_0", 0);
+		std::cout << "  memory hit  " << nanosecondsPerCall(iterations, [&](int) { cache.get(source, "VSMain", "vs_5_0", 0); }) << std::endl;
+		std::cout << "  miss        " << nanosecondsPerCall(iterations, [&](int i) { cache.get(source, "VSMain", "vs_5_0", uint32_t(i + 1)); }) << std::endl;
+	}
+	{
+		ShaderCache cache(compiler, directory);
+		const int files = std::min(iterations, 1000);
+		std::cout << "  disk store  " << nanosecondsPerCall(files, [&](int i) { cache.get(source, "VSMain", "vs_5_0", uint32_t(i)); }) << std::endl;
+		cache.clear();
+		std::cout << "  disk hit    " << nanosecondsPerCall(files, [&](int i) { cache.get(source, "VSMain", "vs_5_0", uint32_t(i)); }) << std::endl;
+	}
+	std::filesystem::remove_all(directory);
+}
+
+// The per-frame vertex allocations of the D3D11 backend: the triangle (3 vertices) and a heavier frame
+static void benchmarkRingBuffer(int iterations) {
+	std::cout << "RingBufferAllocator, ns per allocate():" << std::endl;
+	for (size_t vertices : { size_t(3), size_t(4096) }) {
+		const size_t size = vertices * 28;
+		RingBufferAllocator ring;
+		ring.reset(RingBufferAllocator::grownCapacity(0, size * 64));
+		size_t discards = 0;
+		RingBufferAllocator::Allocation allocation = {};
+		double ns = nanosecondsPerCall(iterations, [&](int) {
+			ring.allocate(size, 28, allocation);
+			discards += allocation.discard;
+		});
+		std::cout << "  " << vertices << " vertices  " << ns << " (" << discards << " discards)" << std::endl;
+	}
+}
+
+// Microbenchmarks of the per-frame bookkeeping of the resize path.
+// Usage: noflicker_micro_benchmark [iterations]
+int main(int argc, char* argv[]) {
+	int iterations = argc > 1 ? std::atoi(argv[1]) : 100000;
+	if (iterations <= 0) iterations = 100000;
+
+	benchmarkShaderCache(iterations);
+	benchmarkRingBuffer(iterations * 100);
+	return 0;
+}
@@ -0,0 +1,144 @@
+#include "TestFramework.h"
+#include "../AsyncFileReader.h"
+#include "../DDSCompression.h"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct TempDirectory {
+	std::filesystem::path path;
+
+	explicit TempDirectory(const char* name) : path(std::filesystem::temp_directory_path() / name) {
+		std::filesystem::remove_all(path);
+		std::filesystem::create_directories(path);
+	}
+	~TempDirectory() {
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+// An RGBA texture with the full mip chain, its pixels in long runs so that LZ4 has something to do
+std::vector<uint8_t> makeDDS(uint32_t size) {
+	uint32_t header[31] = {};
+	header[0] = 124;
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+	header[2] = header[3] = size;
+	uint32_t mips = 1;
+	for (uint32_t s = size; s > 1; s >>= 1) mips++;
+	header[6] = mips;
+	header[18] = 32;
+	header[19] = 0x4;                       // DDPF_FOURCC
+	header[20] = 0x30315844;                // "DX10"
+	header[26] = 0x1000 | 0x400000 | 0x8;
+	const uint32_t dx10[5] = { uint32_t(DXGIFormat::R8G8B8A8_UNORM), 3, 0, 1, 0 };
+
+	std::vector<uint8_t> file(4 + sizeof(header) + sizeof(dx10));
+	std::memcpy(file.data(), "DDS ", 4);
+	std::memcpy(file.data() + 4, header, sizeof(header));
+	std::memcpy(file.data() + 4 + sizeof(header), dx10, sizeof(dx10));
+
+	DDSLayout layout;
+	DDSParser::parse(file.data(), file.size(), layout);
+	DDSParser::computeSubresources(layout);
+	file.resize(layout.headerSize + layout.dataSize);
+	for (size_t i = layout.headerSize; i < file.size(); i++) file[i] = uint8_t(i / 64 * 7);
+	return file;
+}
+
+void writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(data.data()), std::streamsize(data.size()));
+}
+
+struct TestFiles {
+	TempDirectory directory { "noflicker_async_reader_test" };
+	std::vector<uint8_t> raw = makeDDS(256);
+	std::string rawPath = (directory.path / "raw.dds").string();
+	std::string compressedPath = (directory.path / "compressed.dds").string();
+	std::string truncatedPath = (directory.path / "truncated.dds").string();
+
+	TestFiles() {
+		writeFile(rawPath, raw);
+		std::vector<uint8_t> compressed;
+		DDSCompression::compress(raw.data(), raw.size(), DDSCodec::LZ4, compressed, 1);
+		writeFile(compressedPath, compressed);
+		writeFile(truncatedPath, std::vector<uint8_t>(raw.begin(), raw.begin() + raw.size() / 2));
+	}
+};
+
+void checkReads(AsyncFileReader& reader, const TestFiles& files) {
+	DDSBatchItem raw = reader.readDDS(files.rawPath).get();
+	CHECK(raw.status == DDSStatus::OK);
+	CHECK(raw.data == files.raw);
+
+	DDSBatchItem compressed = reader.readDDS(files.compressedPath).get();
+	CHECK(compressed.status == DDSStatus::OK);
+	CHECK(compressed.data == files.raw);
+
+	CHECK(reader.readDDS(files.truncatedPath).get().status == DDSStatus::Truncated);
+	CHECK(reader.readDDS(files.rawPath + ".missing").get().status == DDSStatus::ReadFailed);
+}
+
+}
+
+TEST(AsyncFileReader, ThreadPoolReadsRawAndCompressedAlike) {
+	TestFiles files;
+	auto reader = AsyncFileReader::create(AsyncFileReader::Backend::ThreadPool, 2);
+	CHECK(reader->getBackend() == AsyncFileReader::Backend::ThreadPool);
+	checkReads(*reader, files);
+}
+
+TEST(AsyncFileReader, IoUringReadsRawAndCompressedAlike) {
+	TestFiles files;
+	// The thread pool where the containers don't allow io_uring
+	auto reader = AsyncFileReader::create(AsyncFileReader::Backend::IoUring, 2);
+	checkReads(*reader, files);
+}
+
+TEST(AsyncFileReader, DecompressesOffTheCompletionThread) {
+	TestFiles files;
+	auto reader = AsyncFileReader::create(AsyncFileReader::Backend::IoUring, 2);
+	if (reader->getBackend() != AsyncFileReader::Backend::IoUring) return;
+
+	// The plain reads complete on the ring thread
+	std::promise<std::thread::id> ringThread;
+	reader->submit(files.rawPath, 0, 16, [&ringThread](int, std::vector<uint8_t>) {
+		ringThread.set_value(std::this_thread::get_id());
+	});
+
+	// No CHECK on the reader's threads, the failure would terminate
+	std::promise<std::thread::id> decompressThread;
+	std::atomic<bool> decompressed = false;
+	reader->readDDS(files.compressedPath, 0, [&decompressThread, &decompressed](DDSBatchItem item) {
+		decompressed = item.status == DDSStatus::OK;
+		decompressThread.set_value(std::this_thread::get_id());
+	});
+	CHECK(decompressThread.get_future().get() != ringThread.get_future().get());
+	CHECK(decompressed.load());
+}
+
+TEST(AsyncFileReader, DestructorWaitsForTheWholeChain) {
+	TestFiles files;
+	for (auto backend : { AsyncFileReader::Backend::ThreadPool, AsyncFileReader::Backend::IoUring }) {
+		std::atomic<int> done = 0;
+		{
+			auto reader = AsyncFileReader::create(backend, 2);
+			// The header, the index and the frames, with the pool in between
+			for (int i = 0; i < 8; i++) {
+				reader->readDDS(files.compressedPath, 0, [&done, &files](DDSBatchItem item) {
+					if (item.status == DDSStatus::OK && item.data == files.raw) done++;
+				});
+			}
+		}
+		CHECK_EQ(done.load(), 8);
+	}
+}
@@ -0,0 +1,526 @@
+#include "TestFramework.h"
+#include "../BCDecoder.h"
+#include "../Half.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Block = std::array<uint8_t, 16>;
+
+Block fromHex(const char* hex) {
+	Block block = {};
+	for (size_t i = 0; i < block.size() && hex[2 * i]; i++) block[i] = uint8_t(std::stoi(std::string(hex + 2 * i, 2), nullptr, 16));
+	return block;
+}
+
+// Packs the fields of a block in the stored order, the least significant bit first, like the specifications list them
+struct BlockWriter {
+	Block block = {};
+	unsigned position = 0;
+
+	BlockWriter& write(uint32_t value, unsigned count) {
+		for (unsigned i = 0; i < count; i++, position++) block[position / 8] |= uint8_t(((value >> i) & 1) << (position % 8));
+		return *this;
+	}
+};
+
+struct Pixels {
+	uint8_t rgba[16 * 4];
+
+	Pixels(BCFormat format, const Block& block) { BCDecoder::decodeBlock(format, block.data(), rgba); }
+
+	// 0xRRGGBBAA, for the readable expectations
+	uint32_t operator[](size_t i) const {
+		const uint8_t* p = rgba + 4 * i;
+		return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+	}
+};
+
+struct HalfPixels {
+	uint16_t rgba[16 * 4];
+
+	HalfPixels(BCFormat format, const Block& block) { BCDecoder::decodeBlock(format, block.data(), rgba); }
+
+	uint16_t at(size_t i, size_t channel) const { return rgba[4 * i + channel]; }
+	float value(size_t i, size_t channel) const { return halfToFloat(rgba[4 * i + channel]); }
+};
+
+bool near(float actual, float expected) {
+	return std::abs(actual - expected) < 1e-3f;
+}
+
+}
+
+//--------------------------------------------------------------------------------------
+// BC1 - BC5
+//--------------------------------------------------------------------------------------
+
+TEST(BCDecoder, BC1FourColors) {
+	// Red over blue, the pixel i has the index i % 4
+	Block block = fromHex("00F81F00E4E4E4E4");
+	Pixels pixels(BCFormat::BC1, block);
+	const uint32_t palette[4] = { 0xFF0000FFu, 0x0000FFFFu, 0xAA0055FFu, 0x5500AAFFu };
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(pixels[i], palette[i % 4]);
+}
+
+TEST(BCDecoder, BC1ThreeColorsAndTransparency) {
+	// The same endpoints swapped: the midpoint and transparent black
+	Block block = fromHex("1F0000F8E4E4E4E4");
+	Pixels pixels(BCFormat::BC1, block);
+	const uint32_t palette[4] = { 0x0000FFFFu, 0xFF0000FFu, 0x800080FFu, 0x00000000u };
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(pixels[i], palette[i % 4]);
+
+	// Equal endpoints are the three-color mode too
+	CHECK_EQ(Pixels(BCFormat::BC1, fromHex("FFFFFFFFFFFFFFFF"))[0], 0x00000000u);
+	// 5:6:5 expands by replicating the top bits
+	CHECK_EQ(Pixels(BCFormat::BC1, fromHex("5A5A000000000000"))[0], 0x5A49D6FFu);
+}
+
+TEST(BCDecoder, BC2ExplicitAlpha) {
+	// The pixel i has the 4-bit alpha i. The color block always has four colors, even with c0 <= c1
+	Block block = fromHex("1032547698BADCFE1F0000F8FFFFFFFF");
+	Pixels pixels(BCFormat::BC2, block);
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(pixels[i], 0xAA005500u | uint32_t(i * 17));
+}
+
+TEST(BCDecoder, BC3AndBC4UnormRamps) {
+	// The pixel i has the index i % 8
+	auto ramp = [](uint8_t a0, uint8_t a1) {
+		BlockWriter writer;
+		writer.write(a0, 8).write(a1, 8);
+		for (uint32_t i = 0; i < 16; i++) writer.write(i % 8, 3);
+		return writer.block;
+	};
+
+	// Eight values
+	const uint8_t eight[8] = { 255, 0, 219, 182, 146, 109, 73, 36 };
+	Block bc4 = ramp(255, 0);
+	Pixels red(BCFormat::BC4, bc4);
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(red[i], uint32_t(eight[i % 8]) << 24 | 0xFFu);
+
+	// Six values, 0 and 255
+	const uint8_t six[8] = { 50, 200, 80, 110, 140, 170, 0, 255 };
+	Block bc3 = {};
+	std::memcpy(bc3.data(), ramp(50, 200).data(), 8);
+	std::memcpy(bc3.data() + 8, fromHex("FFFFFFFF00000000").data(), 8);
+	Pixels white(BCFormat::BC3, bc3);
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(white[i], 0xFFFFFF00u | six[i % 8]);
+
+	// BC5 is two BC4 blocks, red and green
+	Block bc5 = {};
+	std::memcpy(bc5.data(), ramp(255, 0).data(), 8);
+	std::memcpy(bc5.data() + 8, ramp(50, 200).data(), 8);
+	Pixels rg(BCFormat::BC5, bc5);
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(rg[i], uint32_t(eight[i % 8]) << 24 | uint32_t(six[i % 8]) << 16 | 0xFFu);
+}
+
+TEST(BCDecoder, BC4AndBC5SnormRamps) {
+	auto ramp = [](int8_t a0, int8_t a1) {
+		BlockWriter writer;
+		writer.write(uint8_t(a0), 8).write(uint8_t(a1), 8);
+		for (uint32_t i = 0; i < 16; i++) writer.write(i % 8, 3);
+		return writer.block;
+	};
+
+	// Eight values from 1 to -1
+	const float eight[8] = { 1.f, -1.f, 5.f / 7, 3.f / 7, 1.f / 7, -1.f / 7, -3.f / 7, -5.f / 7 };
+	HalfPixels red(BCFormat::BC4Signed, ramp(127, -127));
+	for (size_t i = 0; i < 16; i++) {
+		CHECK(near(red.value(i, 0), eight[i % 8]));
+		CHECK_EQ(red.at(i, 1), uint16_t(0));
+		CHECK_EQ(red.at(i, 3), uint16_t(0x3C00));
+	}
+
+	// -128 is -127, so a0 <= a1 and there are six values, -1 and 1
+	const float six[8] = { -1.f, 1.f, -3.f / 5, -1.f / 5, 1.f / 5, 3.f / 5, -1.f, 1.f };
+	Block bc5 = {};
+	std::memcpy(bc5.data(), ramp(127, -127).data(), 8);
+	std::memcpy(bc5.data() + 8, ramp(-128, 127).data(), 8);
+	HalfPixels rg(BCFormat::BC5Signed, bc5);
+	for (size_t i = 0; i < 16; i++) {
+		CHECK(near(rg.value(i, 0), eight[i % 8]));
+		CHECK(near(rg.value(i, 1), six[i % 8]));
+		CHECK_EQ(rg.at(i, 2), uint16_t(0));
+		CHECK_EQ(rg.at(i, 3), uint16_t(0x3C00));
+	}
+
+	// Into RGBA8, the negative values clamp to 0
+	Pixels clamped(BCFormat::BC4Signed, ramp(127, -127));
+	CHECK_EQ(clamped[0], 0xFF0000FFu);
+	CHECK_EQ(clamped[1], 0x000000FFu);
+	CHECK_EQ(clamped[2], 0xB60000FFu);     // 5/7
+}
+
+//--------------------------------------------------------------------------------------
+// BC7
+//--------------------------------------------------------------------------------------
+
+TEST(BCDecoder, BC7EveryMode) {
+	// A block of every mode with all of its texels, cross-checked against an independent decoder.
+	// Mode 4 has the rotation 1 and the index selection 1, mode 5 has the rotation 2
+	struct Case { const char* block; uint32_t texels[16]; };
+	const Case cases[8] = {
+		{ "53f22665a60c12d289185d950ee88136", {
+			0x52313EFF, 0x41312AFF, 0x74316AFF, 0x41312AFF, 0x6359BBFF, 0x396B4AFF, 0x7352E7FF, 0x7352E7FF,
+			0x6359BBFF, 0x416760FF, 0x5B5DA5FF, 0x7352E7FF, 0x565A93FF, 0x3886BAFF, 0x3886BAFF, 0x940042FF } },
+		{ "0a166f6b113d178d6c0fd3901ff239a1", {
+			0x5A4636FF, 0x8A4A48FF, 0xCBB5BEFF, 0x9A6464FF, 0xB2988CFF, 0x6A160EFF, 0xAB8185FF, 0xDBCFDBFF,
+			0x705A4BFF, 0x6A160EFF, 0xAB8185FF, 0x7A302BFF, 0x705A4BFF, 0xCBB5BEFF, 0x9A6464FF, 0xBB9BA1FF } },
+		{ "a495f20f9395650cf9380b8edb224a6b", {
+			0x52804CFF, 0x90494CFF, 0x21CE73FF, 0x578D60FF, 0x525A39FF, 0xF794B5FF, 0xCE917AFF, 0xF794B5FF,
+			0x52804CFF, 0xCE917AFF, 0xA48F3BFF, 0xA48F3BFF, 0x52804CFF, 0x90494CFF, 0x21CE73FF, 0xC60839FF } },
+		{ "288a1e924e8fd0ae2e1a9492a3305f18", {
+			0x447A16FF, 0x25DB29FF, 0x385518FF, 0x2CCB34FF, 0x25DB29FF, 0x2B2E19FF, 0x2CCB34FF, 0x447A16FF,
+			0x1F091BFF, 0x3BAB4BFF, 0x385518FF, 0x2CCB34FF, 0x25DB29FF, 0x2B2E19FF, 0x2CCB34FF, 0x447A16FF } },
+		{ "b072499bfa121e836b2ac15726ee7d6b", {
+			0x4A944A94, 0x86944A94, 0x2CB5EF5A, 0x68A2907C, 0x4AACC16A, 0x2CA7A972, 0x2C99618C, 0x8699618C,
+			0x4AB0D862, 0x4AACC16A, 0x86B5EF5A, 0x2CB0D862, 0x4AB5EF5A, 0x4AB0D862, 0x4A9D7884, 0x68A2907C } },
+		{ "a0cc7411d717f14579b2aa100fbbb34f", {
+			0x996EFB8B, 0xD3514470, 0xD37C4470, 0x997CFB8B, 0xAC51BF82, 0xC05F8079, 0xAC51BF82, 0xAC5FBF82,
+			0xAC51BF82, 0xAC7CBF82, 0xAC51BF82, 0xAC5FBF82, 0x9951FB8B, 0xC0518079, 0x997CFB8B, 0xC06E8079 } },
+		{ "c093feaed27248b762e3ab5805f0765a", {
+			0x59E5AD4B, 0x92B08258, 0x71D09C51, 0xEA5E406C, 0xC87D5964, 0xBE876162, 0xA79D735D, 0x85BC8C55,
+			0x85BC8C55, 0x4FEFB549, 0x4FEFB549, 0xF454386E, 0x92B08258, 0x9CA67A5A, 0xBE876162, 0x85BC8C55 } },
+		{ "809c1d7e0f37c44921bd3f6564eadf7f", {
+			0x823840A6, 0xB61C3C7D, 0x187149FB, 0xF318089A, 0x823840A6, 0xEB151D97, 0xDB104992, 0xDB104992,
+			0xEB151D97, 0xDB104992, 0xEB151D97, 0x187149FB, 0xDB104992, 0x187149FB, 0x187149FB, 0x823840A6 } },
+	};
+
+	for (const Case& c : cases) {
+		Pixels pixels(BCFormat::BC7, fromHex(c.block));
+		for (size_t i = 0; i < 16; i++) CHECK_EQ(pixels[i], c.texels[i]);
+	}
+}
+
+TEST(BCDecoder, BC7RotationAndIndexSelection) {
+	// Mode 5: opaque red and the alpha 0x40 (the 7-bit color endpoints replicate their top bit)
+	auto mode5 = [](uint32_t rotation) {
+		BlockWriter writer;
+		writer.write(1 << 5, 6).write(rotation, 2);
+		writer.write(127, 7).write(127, 7).write(0, 7).write(0, 7).write(0, 7).write(0, 7);
+		writer.write(0x40, 8).write(0x40, 8);
+		writer.write(0, 31).write(0, 31);
+		return writer.block;
+	};
+	CHECK_EQ(Pixels(BCFormat::BC7, mode5(0))[7], 0xFF000040u);
+	// The rotations swap the alpha with the red, the green or the blue
+	CHECK_EQ(Pixels(BCFormat::BC7, mode5(1))[7], 0x400000FFu);
+	CHECK_EQ(Pixels(BCFormat::BC7, mode5(2))[7], 0xFF400000u);
+	CHECK_EQ(Pixels(BCFormat::BC7, mode5(3))[7], 0xFF004000u);
+
+	// Mode 4: red and alpha from 0 to 255. Every 2-bit index is 1 (the weight 21), every 3-bit one is 2 (18)
+	auto mode4 = [](uint32_t indexSelection) {
+		BlockWriter writer;
+		writer.write(1 << 4, 5).write(0, 2).write(indexSelection, 1);
+		writer.write(0, 5).write(31, 5).write(0, 5).write(0, 5).write(0, 5).write(0, 5);
+		writer.write(0, 6).write(63, 6);
+		writer.write(1, 1);
+		for (int i = 1; i < 16; i++) writer.write(1, 2);
+		writer.write(2, 2);
+		for (int i = 1; i < 16; i++) writer.write(2, 3);
+		return writer.block;
+	};
+	// The color takes the 2-bit indices and the alpha the 3-bit ones, unless the selection bit swaps them
+	const uint32_t weight21 = (21 * 255 + 32) >> 6, weight18 = (18 * 255 + 32) >> 6;
+	for (size_t i = 0; i < 16; i++) {
+		CHECK_EQ(Pixels(BCFormat::BC7, mode4(0))[i], weight21 << 24 | weight18);
+		CHECK_EQ(Pixels(BCFormat::BC7, mode4(1))[i], weight18 << 24 | weight21);
+	}
+}
+
+TEST(BCDecoder, BC7PartitionsAndAnchors) {
+	// Every partition of mode 1 (two subsets) and mode 2 (three subsets), as the 16 pixels row by row:
+	// the subset of each pixel, or A, B and C for the anchor pixels of the subsets 0, 1 and 2.
+	// The maps were cross-checked against an independent decoder
+	const char* const twoSubsets[64] = {
+		"A01100110011001B", "A00100010001000B", "A11101110111011B", "A00100110011011B",
+		"A00000010001001B", "A01101110111111B", "A00100110111111B", "A00000010011011B",
+		"A00000000001001B", "A01101111111111B", "A00000010111111B", "A00000000001011B",
+		"A00101111111111B", "A00000001111111B", "A00011111111111B", "A00000000000111B",
+		"A00010001110111B", "A1B1000100000000", "A0000000B0001110", "A1B1001100010000",
+		"A0B1000100000000", "A0001000B1001110", "A0000000B0001100", "A11100110011000B",
+		"A0B1000100010000", "A0001000B0001100", "A1B0011001100110", "A0B1011001101100",
+		"A0010111B1101000", "A0001111B1110000", "A1B1000110001110", "A0B1100110011100",
+		"A10101010101010B", "A00011110000111B", "A10110B001011010", "A0110011B1001100",
+		"A0B1110000111100", "A1010101B0101010", "A11010010110100B", "A10110101010010B",
+		"A1B1001111001110", "A0010011B1001000", "A0B1001001001100", "A0B1101111011100",
+		"A1B0100110010110", "A01111001100001B", "A11001101001100B", "A00001B001100000",
+		"A10011B001000000", "A0B0011100100000", "A00000B001110010", "A0000100B1100100",
+		"A11011001001001B", "A01101101100100B", "A1B0001110011100", "A0B1100111000110",
+		"A11011001100100B", "A11000110011100B", "A11111101000000B", "A00110001110011B",
+		"A00011110011001B", "A0B1001111110000", "A0B0001011101110", "A10001000111011B",
+	};
+	const char* const threeSubsets[64] = {
+		"A01B00110221222C", "A00B0011C2112221", "A0002001C211221B", "A22C00220011011B",
+		"A0000000B122112C", "A01B00110022002C", "A02C00221111111B", "A0110011C211221B",
+		"A0000000B111222C", "A0001111B111222C", "A00011B12222222C", "A01200B20012001C",
+		"A11201B20112011C", "A1220B220122012C", "A01B01121122122C", "A01B2001C2002220",
+		"A00B00110112112C", "A11B0011C0012200", "A0001122B122112C", "A02C00220022111B",
+		"A11B01110222022C", "A00B0001C2212221", "A00000B10122012C", "A0001100C2B02210",
+		"A12C0B2200110000", "A0120012B122222C", "A11012C1B2210110", "A00001B012C11221",
+		"A0221102B102002C", "A1100B102002222C", "A011012201C2001B", "A0002000C211222B",
+		"A0000002B122122C", "A22C00220012001B", "A01B00120022022C", "A1200B2001C00120",
+		"A00011B122C20000", "A1201201C0B20120", "A1202012BC010120", "A011220011C2001B",
+		"A01111C22200001B", "A10B01012222222C", "A0000000C121212B", "A0221B220022112C",
+		"A02C00110022001B", "A22012C10220122B", "A10122C22222010B", "A0002121C121212B",
+		"A10B01010101222C", "A22C01110222011B", "A0021B120002111C", "A0002B122112211C",
+		"A2220B110111022C", "A0021112B112000C", "A1100B100110222C", "A000000021B2211C",
+		"A1100B102222222C", "A022001100B1002C", "A0221122B122002C", "A000000000002B1C",
+		"A00C00010002000B", "A22212220222B22C", "A10B22222222222C", "A11B2011C2012220",
+	};
+
+	// The subset s goes from black to full in the channel s. All the index bits are set, so the pixels
+	// take the second endpoint, except for the anchors: their top index bit is implied 0
+	auto classify = [](const Pixels& pixels, uint32_t full) {
+		std::string map;
+		for (size_t i = 0; i < 16; i++) {
+			const uint8_t* p = pixels.rgba + 4 * i;
+			size_t subset = p[0] ? 0 : p[1] ? 1 : 2;
+			map += p[subset] == full ? char('0' + subset) : char('A' + subset);
+		}
+		return map;
+	};
+
+	for (uint32_t partition = 0; partition < 64; partition++) {
+		BlockWriter mode1;
+		mode1.write(1 << 1, 2).write(partition, 6);
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			for (uint32_t endpoint = 0; endpoint < 4; endpoint++) mode1.write(endpoint == 2 * channel + 1 ? 63 : 0, 6);
+		}
+		mode1.write(0, 2).write(~0u, 32).write(~0u, 14);
+		CHECK_EQ(classify(Pixels(BCFormat::BC7, mode1.block), 253), std::string(twoSubsets[partition]));
+
+		BlockWriter mode2;
+		mode2.write(1 << 2, 3).write(partition, 6);
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			for (uint32_t endpoint = 0; endpoint < 6; endpoint++) mode2.write(endpoint == 2 * channel + 1 ? 31 : 0, 5);
+		}
+		mode2.write(~0u, 29);
+		CHECK_EQ(classify(Pixels(BCFormat::BC7, mode2.block), 255), std::string(threeSubsets[partition]));
+	}
+}
+
+TEST(BCDecoder, BC7ReservedMode) {
+	Block block = fromHex("00FFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+	Pixels pixels(BCFormat::BC7, block);
+	for (size_t i = 0; i < 16; i++) CHECK_EQ(pixels[i], 0u);
+}
+
+//--------------------------------------------------------------------------------------
+// BC6H
+//--------------------------------------------------------------------------------------
+
+TEST(BCDecoder, BC6HUnsignedEveryMode) {
+	// A block of every mode (1 - 10 have two subsets, 1 - 9 and 12 - 14 are transformed), cross-checked
+	// against an independent decoder. The RGB of the pixels 0, 5, 10 and 15
+	struct Case { const char* block; uint16_t rgb[12]; };
+	const Case cases[14] = {
+		{ "f89f735213d40847df9b0aadb547925a", { 0x1F01, 0x1C3C, 0x3400, 0x1F0A, 0x1C56, 0x343D, 0x1EF9, 0x1C22, 0x33C3, 0x1F01, 0x1C3C, 0x3400 } },
+		{ "a967912e88136383ff7fa436b31ec365", { 0x3988, 0x24B1, 0x1795, 0x3572, 0x2B3B, 0x1937, 0x3A9C, 0x39F5, 0x1F93, 0x3A9C, 0x2CBA, 0x2EE4 } },
+		{ "e27b66d7b46840e6e89f060293243a52", { 0x3BF2, 0x2B68, 0x2579, 0x3B83, 0x2B89, 0x254C, 0x3C08, 0x2B61, 0x2582, 0x3BDC, 0x2B6E, 0x2570 } },
+		{ "e6589c9f5b4e3202fe11b134bcb75cde", { 0x2B14, 0x31EB, 0x1C10, 0x2AE7, 0x316E, 0x1C34, 0x2B09, 0x31CD, 0x1C18, 0x2B1E, 0x3251, 0x1BFC } },
+		{ "4ac568332512a1446c5fd19c68477422", { 0x2192, 0x2BAF, 0x284B, 0x2192, 0x2BAF, 0x284B, 0x21EF, 0x2B42, 0x286A, 0x21EF, 0x2B42, 0x286A } },
+		{ "ae9c3e03695f2197e5dd40636b47571a", { 0x3795, 0x1E65, 0x1F5D, 0x38E9, 0x1F6A, 0x20CB, 0x3610, 0x1BDC, 0x22AF, 0x3431, 0x1E27, 0x2245 } },
+		{ "72ec32e1b41a6a237c3114b17c078ef0", { 0x31B1, 0x3013, 0x36E6, 0x365B, 0x2CAF, 0x382C, 0x365B, 0x2CAF, 0x382C, 0x2981, 0x2FB6, 0x2F05 } },
+		{ "b6493fa29c268c6f9b5a6de63d2c4de6", { 0x22E1, 0x36F0, 0x2745, 0x2103, 0x327B, 0x2720, 0x2891, 0x3E74, 0x24A5, 0x26EE, 0x3E51, 0x2471 } },
+		{ "7acb9ca06818a7e75773a7ac35d27d7d", { 0x2D34, 0x1B4E, 0x2803, 0x30A0, 0x2007, 0x295E, 0x2F3A, 0x1DCA, 0x2D4A, 0x2EFA, 0x1A37, 0x2A0E } },
+		{ "fed2aa34f766e22b692c2e85be582677", { 0x3340, 0x2805, 0x30E4, 0x3747, 0x26DF, 0x2F2A, 0x2F70, 0x291C, 0x3286, 0x3340, 0x2805, 0x30E4 } },
+		{ "2337a51a73eeaf5f28a19beef08dca9a", { 0x3623, 0x29B9, 0x2982, 0x36F9, 0x2BD5, 0x2152, 0x37A5, 0x2D89, 0x1AB2, 0x36F9, 0x2BD5, 0x2152 } },
+		{ "e7666ccf3600a946f27a22724db14b7e", { 0x31E2, 0x2B69, 0x354C, 0x31E9, 0x2A8A, 0x35F7, 0x31E2, 0x2B69, 0x354C, 0x3207, 0x26E2, 0x38C4 } },
+		{ "cb5747549af2c7143327526f469d6e94", { 0x346C, 0x236E, 0x281D, 0x3517, 0x23F0, 0x2871, 0x366D, 0x24F3, 0x291A, 0x35C2, 0x2472, 0x28C6 } },
+		{ "6f8bb79c64310516804bf675d34b25f1", { 0x211C, 0x1FB1, 0x201D, 0x211A, 0x1FAE, 0x201B, 0x211A, 0x1FAF, 0x201C, 0x211A, 0x1FAE, 0x201B } },
+	};
+
+	for (const Case& c : cases) {
+		HalfPixels pixels(BCFormat::BC6H, fromHex(c.block));
+		for (size_t p = 0; p < 4; p++) {
+			for (size_t channel = 0; channel < 3; channel++) CHECK_EQ(pixels.at(5 * p, channel), c.rgb[3 * p + channel]);
+			CHECK_EQ(pixels.at(5 * p, 3), uint16_t(0x3C00));
+		}
+	}
+}
+
+TEST(BCDecoder, BC6HUntransformed) {
+	// Mode 11: one subset, 10-bit endpoints stored as they are. The pixel i has the index i
+	BlockWriter writer;
+	writer.write(3, 5);
+	writer.write(0, 10).write(512, 10).write(1023, 10);       // R0, G0, B0
+	writer.write(1023, 10).write(0, 10).write(256, 10);       // R1, G1, B1
+	writer.write(0, 3);
+	for (uint32_t i = 1; i < 16; i++) writer.write(i, 4);
+	const Block block = writer.block;
+
+	// Unsigned: 0 and the maximum are exact, the rest is scaled to 16 bits, then everything by 31/64 into a half
+	HalfPixels unsignedPixels(BCFormat::BC6H, block);
+	CHECK_EQ(unsignedPixels.at(0, 0), uint16_t(0x0000));
+	CHECK_EQ(unsignedPixels.at(0, 1), uint16_t(0x3E0F));
+	CHECK_EQ(unsignedPixels.at(0, 2), uint16_t(0x7BFF));
+	CHECK_EQ(unsignedPixels.at(8, 0), uint16_t(0x41DF));     // The weight 34
+	CHECK_EQ(unsignedPixels.at(15, 0), uint16_t(0x7BFF));
+	CHECK_EQ(unsignedPixels.at(15, 1), uint16_t(0x0000));
+	CHECK_EQ(unsignedPixels.at(15, 2), uint16_t(0x1F0F));
+
+	// Signed: 512 and 1023 are -512 and -1, the magnitudes past 511 saturate
+	HalfPixels signedPixels(BCFormat::BC6HSigned, block);
+	CHECK_EQ(signedPixels.at(0, 0), uint16_t(0x0000));
+	CHECK_EQ(signedPixels.at(0, 1), uint16_t(0xFBFF));
+	CHECK_EQ(signedPixels.at(0, 2), uint16_t(0x805D));
+	CHECK_EQ(signedPixels.at(15, 0), uint16_t(0x805D));
+	CHECK_EQ(signedPixels.at(15, 1), uint16_t(0x0000));
+	CHECK_EQ(signedPixels.at(15, 2), uint16_t(0x3E1F));
+
+	// Into RGBA8, the values are clamped to [0, 1]
+	CHECK_EQ(Pixels(BCFormat::BC6H, block)[0], 0x00FFFFFFu);
+	CHECK_EQ(Pixels(BCFormat::BC6HSigned, block)[0], 0x000000FFu);
+}
+
+TEST(BCDecoder, BC6HTransformedSigned) {
+	// Mode 12: one subset, an 11-bit base endpoint and 9-bit signed deltas. The pixel 0 has the index 0, the rest 15
+	const uint32_t r0 = 0x7FE, g0 = 100, b0 = 0;     // -2, 100, 0
+	BlockWriter writer;
+	writer.write(7, 5);
+	writer.write(r0, 10).write(g0, 10).write(b0, 10);
+	writer.write(5, 9).write(r0 >> 10, 1);           // R1 = R0 + 5
+	writer.write(0x1FF, 9).write(g0 >> 10, 1);       // G1 = G0 - 1
+	writer.write(0, 9).write(b0 >> 10, 1);
+	writer.write(0, 3);
+	for (int i = 1; i < 16; i++) writer.write(15, 4);
+
+	HalfPixels pixels(BCFormat::BC6HSigned, writer.block);
+	CHECK_EQ(pixels.at(0, 0), uint16_t(0x804D));
+	CHECK_EQ(pixels.at(0, 1), uint16_t(0x0C2B));
+	CHECK_EQ(pixels.at(0, 2), uint16_t(0x0000));
+	for (size_t i = 1; i < 16; i++) {
+		CHECK_EQ(pixels.at(i, 0), uint16_t(0x006C));
+		CHECK_EQ(pixels.at(i, 1), uint16_t(0x0C0C));
+		CHECK_EQ(pixels.at(i, 2), uint16_t(0x0000));
+		CHECK_EQ(pixels.at(i, 3), uint16_t(0x3C00));
+	}
+}
+
+TEST(BCDecoder, BC6HReservedModes) {
+	for (uint8_t code : { 19, 23, 27, 31 }) {
+		Block block = fromHex("FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF");
+		block[0] = uint8_t(0xE0 | code);
+		for (BCFormat format : { BCFormat::BC6H, BCFormat::BC6HSigned }) {
+			HalfPixels pixels(format, block);
+			for (size_t i = 0; i < 16; i++) {
+				CHECK_EQ(pixels.at(i, 0), uint16_t(0));
+				CHECK_EQ(pixels.at(i, 1), uint16_t(0));
+				CHECK_EQ(pixels.at(i, 2), uint16_t(0));
+				CHECK_EQ(pixels.at(i, 3), uint16_t(0x3C00));
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------------------
+// Surfaces
+//--------------------------------------------------------------------------------------
+
+TEST(BCDecoder, DropsThePixelsPastTheEdges) {
+	// 6x5 pixels in 2x2 BC1 blocks of solid red, green, blue and white
+	const char* solid[4] = { "00F8000000000000", "E007000000000000", "1F00000000000000", "FFFF000000000000" };
+	std::vector<uint8_t> src;
+	for (const char* hex : solid) {
+		Block block = fromHex(hex);
+		src.insert(src.end(), block.begin(), block.begin() + 8);
+	}
+	const uint32_t colors[4] = { 0xFF0000FFu, 0x00FF00FFu, 0x0000FFFFu, 0xFFFFFFFFu };
+
+	// The destination rows are padded, the padding and the rows past the image stay untouched
+	const size_t width = 6, height = 5, pitch = width * 4 + 8;
+	std::vector<uint8_t> dst(pitch * (height + 1), 0xCD);
+	BCDecoder::decode(BCFormat::BC1, src.data(), 16, width, height, BCOutput::RGBA8, dst.data(), pitch, 1);
+
+	for (size_t y = 0; y < height + 1; y++) {
+		for (size_t x = 0; x < pitch / 4; x++) {
+			const uint8_t* p = dst.data() + y * pitch + x * 4;
+			uint32_t pixel = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+			if (x < width && y < height) CHECK_EQ(pixel, colors[(y / 4) * 2 + x / 4]);
+			else CHECK_EQ(pixel, 0xCDCDCDCDu);
+		}
+	}
+
+	// The same into halves
+	std::vector<uint8_t> halves(width * 8 * height);
+	BCDecoder::decode(BCFormat::BC1, src.data(), 16, width, height, BCOutput::RGBA16F, halves.data(), width * 8, 1);
+	uint16_t last[4];
+	std::memcpy(last, halves.data() + (height - 1) * width * 8 + (width - 1) * 8, sizeof(last));
+	for (uint16_t channel : last) CHECK_EQ(channel, uint16_t(0x3C00));
+}
+
+TEST(BCDecoder, ThreadsDontChangeTheOutput) {
+	// Pseudo-random BC7 and BC6H blocks, tall enough for several threads, with partial edge blocks
+	const size_t width = 250, height = 298;
+	const size_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	std::vector<uint8_t> src(blocksX * blocksY * 16);
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+	for (auto& byte : src) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		byte = uint8_t(state >> 56);
+	}
+
+	for (BCFormat format : { BCFormat::BC7, BCFormat::BC6H }) {
+		const BCOutput output = BCDecoder::preferredOutput(format);
+		const size_t pitch = width * BCDecoder::pixelBytes(output);
+		std::vector<uint8_t> single(pitch * height), multi(pitch * height);
+		BCDecoder::decode(format, src.data(), blocksX * 16, width, height, output, single.data(), pitch, 1);
+		for (unsigned threads : { 2u, 4u, 8u }) {
+			std::fill(multi.begin(), multi.end(), 0);
+			BCDecoder::decode(format, src.data(), blocksX * 16, width, height, output, multi.data(), pitch, threads);
+			CHECK(multi == single);
+		}
+	}
+}
+
+TEST(BCDecoder, SIMDLevelsDecodeTheSame) {
+	// Pseudo-random blocks of every format (every mode shows up), after 256 BC4 blocks of every unorm value
+	const size_t width = 256, height = 128;
+	const size_t blocks = (width / 4) * (height / 4);
+	std::vector<uint8_t> src(blocks * 16);
+	uint64_t state = 0x2545F4914F6CDD1Dull;
+	for (auto& byte : src) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		byte = uint8_t(state >> 56);
+	}
+	for (size_t i = 0; i < 256; i++) {
+		std::memset(src.data() + 8 * i, 0, 8);
+		src[8 * i] = src[8 * i + 1] = uint8_t(i);
+	}
+
+	const SIMDLevel best = detectSIMDLevel();
+	CHECK(BCDecoder::getSIMDLevel() == best);
+	CHECK(BCDecoder::setSIMDLevel(SIMDLevel::Scalar));
+	CHECK(BCDecoder::getSIMDLevel() == SIMDLevel::Scalar);
+
+	const BCFormat formats[] = {
+		BCFormat::BC1, BCFormat::BC2, BCFormat::BC3, BCFormat::BC4, BCFormat::BC4Signed, BCFormat::BC5,
+		BCFormat::BC5Signed, BCFormat::BC6H, BCFormat::BC6HSigned, BCFormat::BC7,
+	};
+	for (BCFormat format : formats) {
+		for (BCOutput output : { BCOutput::RGBA8, BCOutput::RGBA16F }) {
+			const size_t pitch = width * BCDecoder::pixelBytes(output);
+			const size_t srcPitch = width / 4 * BCDecoder::blockBytes(format);
+			std::vector<uint8_t> scalar(pitch * height), simd(pitch * height);
+			BCDecoder::setSIMDLevel(SIMDLevel::Scalar);
+			BCDecoder::decode(format, src.data(), srcPitch, width, height, output, scalar.data(), pitch, 1);
+			for (SIMDLevel level : { SIMDLevel::SSE41, SIMDLevel::AVX2 }) {
+				if (level > best) break;
+				CHECK(BCDecoder::setSIMDLevel(level));
+				std::fill(simd.begin(), simd.end(), 0);
+				BCDecoder::decode(format, src.data(), srcPitch, width, height, output, simd.data(), pitch, 1);
+				CHECK(simd == scalar);
+			}
+		}
+	}
+
+	// The levels past the CPU's aren't set
+	if (best != SIMDLevel::AVX2) CHECK(!BCDecoder::setSIMDLevel(SIMDLevel::AVX2));
+	CHECK(BCDecoder::setSIMDLevel(best));
+}
@@ -0,0 +1,238 @@
+#include "TestFramework.h"
+#include "../DDSCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const size_t INDEX_HEADER_SIZE = 12;
+const size_t INDEX_ENTRY_SIZE = 8;
+
+// An RGBA array texture with the full mip chain. The pixels are in runs so that LZ4 has something
+// to do, or noise that it can't shrink
+std::vector<uint8_t> makeDDS(uint32_t size, uint32_t arraySize, bool noise = false) {
+	uint32_t header[31] = {};
+	header[0] = 124;
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+	header[2] = header[3] = size;
+	uint32_t mips = 1;
+	for (uint32_t s = size; s > 1; s >>= 1) mips++;
+	header[6] = mips;
+	header[18] = 32;
+	header[19] = 0x4;                       // DDPF_FOURCC
+	header[20] = 0x30315844;                // "DX10"
+	header[26] = 0x1000 | 0x400000 | 0x8;
+	const uint32_t dx10[5] = { uint32_t(DXGIFormat::R8G8B8A8_UNORM), 3, 0, arraySize, 0 };
+
+	std::vector<uint8_t> file(4 + sizeof(header) + sizeof(dx10));
+	std::memcpy(file.data(), "DDS ", 4);
+	std::memcpy(file.data() + 4, header, sizeof(header));
+	std::memcpy(file.data() + 4 + sizeof(header), dx10, sizeof(dx10));
+
+	DDSLayout layout;
+	DDSParser::parseHeader(file.data(), file.size(), layout);
+	DDSParser::computeSubresources(layout);
+	file.resize(layout.headerSize + layout.dataSize);
+	uint32_t seed = 1;
+	for (size_t i = layout.headerSize; i < file.size(); i++) {
+		seed = seed * 1664525u + 1013904223u;
+		file[i] = noise ? uint8_t(seed >> 24) : uint8_t(i / 64 * 7);
+	}
+	return file;
+}
+
+std::vector<uint8_t> compress(const std::vector<uint8_t>& raw, DDSCodec codec) {
+	std::vector<uint8_t> compressed;
+	CHECK(DDSCompression::compress(raw.data(), raw.size(), codec, compressed, 1) == DDSStatus::OK);
+	return compressed;
+}
+
+DDSStatus expand(const std::vector<uint8_t>& compressed, std::vector<uint8_t>& dst, size_t maxsize = 0, unsigned threads = 1) {
+	size_t size;
+	DDSStatus status = DDSCompression::getExpandedSize(compressed.data(), compressed.size(), size);
+	if (status != DDSStatus::OK) return status;
+	dst.assign(size, 0xCD);
+	return DDSCompression::expand(compressed.data(), compressed.size(), dst.data(), maxsize, threads);
+}
+
+uint32_t read32(const std::vector<uint8_t>& data, size_t offset) {
+	uint32_t value;
+	std::memcpy(&value, data.data() + offset, sizeof(value));
+	return value;
+}
+
+void write32(std::vector<uint8_t>& data, size_t offset, uint32_t value) {
+	std::memcpy(data.data() + offset, &value, sizeof(value));
+}
+
+DDSStatus parseIndex(const std::vector<uint8_t>& file, size_t fileSize, std::vector<DDSFrame>& frames) {
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	DDSCodec codec;
+	return DDSCompression::parseIndex(file.data() + layout.headerSize, file.size() - layout.headerSize, layout,
+	                                  fileSize, codec, frames);
+}
+
+}
+
+TEST(DDSCompression, RoundTripsEveryCodec) {
+	const std::vector<uint8_t> raw = makeDDS(64, 3);
+	CHECK(!DDSCompression::isCompressed(raw.data(), raw.size()));
+
+	for (DDSCodec codec : { DDSCodec::Stored, DDSCodec::LZ4 }) {
+		std::vector<uint8_t> compressed = compress(raw, codec);
+		CHECK(DDSCompression::isCompressed(compressed.data(), compressed.size()));
+		if (codec == DDSCodec::LZ4) CHECK(compressed.size() < raw.size() / 4);
+
+		std::vector<uint8_t> expanded;
+		CHECK(expand(compressed, expanded) == DDSStatus::OK);
+		CHECK(expanded == raw);
+		CHECK(!DDSCompression::isCompressed(expanded.data(), expanded.size()));
+	}
+
+	// The noise is stored as is under LZ4 too: every frame is as large as its subresource
+	const std::vector<uint8_t> noise = makeDDS(32, 1, true);
+	std::vector<uint8_t> compressed = compress(noise, DDSCodec::LZ4);
+	std::vector<DDSFrame> frames;
+	CHECK(parseIndex(compressed, compressed.size(), frames) == DDSStatus::OK);
+	DDSLayout layout;
+	CHECK(DDSParser::parse(noise.data(), noise.size(), layout) == DDSStatus::OK);
+	for (size_t i = 0; i < frames.size(); i++) CHECK_EQ(frames[i].size, layout.subresources[i].slicePitch);
+	std::vector<uint8_t> expanded;
+	CHECK(expand(compressed, expanded) == DDSStatus::OK);
+	CHECK(expanded == noise);
+
+	// Zstd has no encoder, the raw file must be valid
+	std::vector<uint8_t> out;
+	CHECK(DDSCompression::compress(raw.data(), raw.size(), DDSCodec::Zstd, out) == DDSStatus::NotSupported);
+	CHECK(DDSCompression::compress(raw.data(), raw.size() - 1, DDSCodec::LZ4, out) == DDSStatus::Truncated);
+}
+
+TEST(DDSCompression, ExpandsTheFramesWithinMaxsize) {
+	// 32x32, 6 mips per item: maxsize 8 skips the 32 and 16 ones of both items
+	const std::vector<uint8_t> raw = makeDDS(32, 2);
+	const std::vector<uint8_t> compressed = compress(raw, DDSCodec::LZ4);
+
+	DDSLayout layout;
+	CHECK(DDSParser::parse(raw.data(), raw.size(), layout, 8) == DDSStatus::OK);
+	CHECK_EQ(layout.skipMip, 2u);
+
+	std::vector<uint8_t> expanded;
+	CHECK(expand(compressed, expanded, 8) == DDSStatus::OK);
+	CHECK_EQ(expanded.size(), raw.size());
+	CHECK(std::equal(raw.begin(), raw.begin() + long(layout.headerSize), expanded.begin()));
+
+	// The loaded subresources are those of the raw file, the skipped ones aren't touched
+	std::vector<bool> loaded(raw.size(), false);
+	for (const DDSSubresource& sub : layout.subresources) {
+		for (size_t i = sub.offset; i < sub.offset + sub.slicePitch; i++) loaded[i] = true;
+	}
+	size_t skipped = 0;
+	for (size_t i = layout.headerSize; i < raw.size(); i++) {
+		if (loaded[i]) {
+			CHECK_EQ(expanded[i], raw[i]);
+		} else {
+			CHECK_EQ(expanded[i], uint8_t(0xCD));
+			skipped++;
+		}
+	}
+	CHECK_EQ(skipped, size_t(2 * (32 * 32 * 4 + 16 * 16 * 4)));
+
+	// selectFrames picks the last four frames of every item
+	std::vector<DDSFrame> frames;
+	CHECK(parseIndex(compressed, compressed.size(), frames) == DDSStatus::OK);
+	CHECK_EQ(frames.size(), size_t(12));
+	std::vector<DDSFrame> selected = DDSCompression::selectFrames(layout, frames);
+	CHECK_EQ(selected.size(), size_t(8));
+	const size_t expected[8] = { 2, 3, 4, 5, 8, 9, 10, 11 };
+	for (size_t i = 0; i < 8; i++) CHECK_EQ(selected[i].offset, frames[expected[i]].offset);
+
+	// packFrames reads the frames of an item in one range
+	std::vector<DDSByteRange> ranges = DDSCompression::packFrames(selected);
+	CHECK_EQ(ranges.size(), size_t(2));
+	CHECK_EQ(ranges[0].offset, frames[2].offset);
+	CHECK_EQ(ranges[1].offset, frames[8].offset);
+	CHECK_EQ(selected[4].offset, ranges[0].size);
+
+	// Past the largest mip nothing is skipped
+	CHECK(expand(compressed, expanded, 32) == DDSStatus::OK);
+	CHECK(expanded == raw);
+}
+
+TEST(DDSCompression, ThreadsDontChangeTheOutput) {
+	// Enough megabytes for the frames to spread over the threads
+	const std::vector<uint8_t> raw = makeDDS(1024, 2);
+	const std::vector<uint8_t> compressed = compress(raw, DDSCodec::LZ4);
+	for (unsigned threads : { 1u, 4u, 0u }) {
+		std::vector<uint8_t> expanded;
+		CHECK(expand(compressed, expanded, 0, threads) == DDSStatus::OK);
+		CHECK(expanded == raw);
+	}
+}
+
+TEST(DDSCompression, RejectsTheBrokenIndices) {
+	const std::vector<uint8_t> compressed = compress(makeDDS(16, 1), DDSCodec::LZ4);
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(compressed.data(), compressed.size(), layout) == DDSStatus::OK);
+	const size_t index = layout.headerSize;
+	const size_t dataStart = index + DDSCompression::getIndexSize(layout);
+	const size_t entry = index + INDEX_HEADER_SIZE + 2 * INDEX_ENTRY_SIZE;
+	std::vector<DDSFrame> frames;
+	CHECK_EQ(size_t(read32(compressed, index + INDEX_HEADER_SIZE)), dataStart);
+
+	auto check = [&](std::vector<uint8_t> broken, size_t fileSize, DDSStatus status) {
+		CHECK(parseIndex(broken, fileSize, frames) == status);
+		std::vector<uint8_t> expanded;
+		CHECK(expand(broken, expanded) == status);
+	};
+
+	// A frame that starts within the index, or ends past the end of the file
+	std::vector<uint8_t> broken = compressed;
+	write32(broken, entry, uint32_t(dataStart - 1));
+	check(broken, broken.size(), DDSStatus::InvalidData);
+	broken = compressed;
+	write32(broken, entry + 4, uint32_t(compressed.size() - read32(compressed, entry) + 1));
+	check(broken, broken.size(), DDSStatus::Truncated);
+
+	// When the size of the file is unknown, the reads bound the frames
+	CHECK(parseIndex(broken, 0, frames) == DDSStatus::OK);
+
+	// The file cut short, within the index and within the frames
+	check(std::vector<uint8_t>(compressed.begin(), compressed.begin() + long(dataStart - 1)), 0, DDSStatus::Truncated);
+	broken.assign(compressed.begin(), compressed.end() - 1);
+	CHECK(parseIndex(broken, broken.size(), frames) == DDSStatus::Truncated);
+
+	// The magic number, the frame count, the version and the codecs
+	broken = compressed;
+	broken[index]++;
+	check(broken, broken.size(), DDSStatus::InvalidData);
+	broken = compressed;
+	write32(broken, index + 8, read32(compressed, index + 8) + 1);
+	check(broken, broken.size(), DDSStatus::InvalidData);
+	broken = compressed;
+	broken[index + 4] = 2;
+	check(broken, broken.size(), DDSStatus::NotSupported);
+	broken = compressed;
+	broken[index + 6] = uint8_t(DDSCodec::Zstd);
+	check(broken, broken.size(), DDSStatus::NotSupported);
+	broken = compressed;
+	broken[index + 6] = 7;
+	check(broken, broken.size(), DDSStatus::InvalidData);
+
+	// A raw file has no index
+	const std::vector<uint8_t> raw = makeDDS(16, 1);
+	CHECK(DDSParser::parseHeader(raw.data(), raw.size(), layout) == DDSStatus::OK);
+	DDSCodec codec;
+	CHECK(DDSCompression::parseIndex(raw.data() + layout.headerSize, raw.size() - layout.headerSize, layout, raw.size(),
+	                                 codec, frames) == DDSStatus::InvalidData);
+	std::vector<uint8_t> expanded(raw.size());
+	CHECK(DDSCompression::expand(raw.data(), raw.size(), expanded.data()) == DDSStatus::InvalidData);
+
+	// A corrupted frame fails the whole file
+	broken = compressed;
+	write32(broken, index + INDEX_HEADER_SIZE + 4, read32(compressed, index + INDEX_HEADER_SIZE + 4) - 1);
+	CHECK(parseIndex(broken, broken.size(), frames) == DDSStatus::OK);
+	CHECK(expand(broken, expanded) == DDSStatus::InvalidData);
+}
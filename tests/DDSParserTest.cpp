@@ -0,0 +1,278 @@
+#include "TestFramework.h"
+#include "../DDSParser.h"
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+const uint32_t MISC_TEXTURECUBE = 0x4;
+
+struct Texture {
+	DXGIFormat format = DXGIFormat::R8G8B8A8_UNORM;
+	DDSDimension dimension = DDSDimension::Texture2D;
+	uint32_t width = 16, height = 16, depth = 1;
+	uint32_t mips = 1;
+	uint32_t arraySize = 1;
+	uint32_t miscFlag = 0;
+};
+
+// The headers of a "DX10" DDS file, without the pixels
+std::vector<uint8_t> makeHeaders(const Texture& texture) {
+	uint32_t header[31] = {};
+	header[0] = 124;
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+	if (texture.dimension == DDSDimension::Texture3D) header[1] |= 0x800000;    // DEPTH
+	header[2] = texture.height;
+	header[3] = texture.width;
+	header[5] = texture.depth;
+	header[6] = texture.mips;
+	header[18] = 32;
+	header[19] = 0x4;                       // DDPF_FOURCC
+	header[20] = 0x30315844;                // "DX10"
+	header[26] = 0x1000 | 0x400000 | 0x8;
+	const uint32_t dx10[5] = { uint32_t(texture.format), uint32_t(texture.dimension), texture.miscFlag, texture.arraySize, 0 };
+
+	std::vector<uint8_t> file(4 + sizeof(header) + sizeof(dx10));
+	std::memcpy(file.data(), "DDS ", 4);
+	std::memcpy(file.data() + 4, header, sizeof(header));
+	std::memcpy(file.data() + 4 + sizeof(header), dx10, sizeof(dx10));
+	return file;
+}
+
+DDSStatus parseHeader(const Texture& texture) {
+	std::vector<uint8_t> file = makeHeaders(texture);
+	DDSLayout layout;
+	return DDSParser::parseHeader(file.data(), file.size(), layout);
+}
+
+DDSLayout makeLayout(const Texture& texture, size_t maxsize) {
+	std::vector<uint8_t> file = makeHeaders(texture);
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	CHECK(DDSParser::computeSubresources(layout, maxsize) == DDSStatus::OK);
+	return layout;
+}
+
+Texture rgbaArray(uint32_t size, uint32_t mips, uint32_t arraySize) {
+	Texture texture;
+	texture.width = texture.height = size;
+	texture.mips = mips;
+	texture.arraySize = arraySize;
+	return texture;
+}
+
+}
+
+TEST(DDSParser, SkipsTheMipsLargerThanMaxsize) {
+	// 64x64 RGBA, 7 mips: the 64 and 32 ones are larger than 16
+	const size_t header = DDSParser::MAX_HEADER_SIZE;
+	DDSLayout layout = makeLayout(rgbaArray(64, 7, 1), 16);
+	CHECK_EQ(layout.skipMip, 2u);
+	CHECK_EQ(layout.getLoadedMips(), 5u);
+	CHECK_EQ(layout.subresources.size(), size_t(5));
+	CHECK_EQ(layout.subresources[0].offset, header + 64 * 64 * 4 + 32 * 32 * 4);
+	CHECK_EQ(layout.subresources[0].width, 16u);
+	CHECK_EQ(layout.subresources[0].rowPitch, size_t(16 * 4));
+	CHECK_EQ(layout.dataSize, size_t(21844));    // The skipped mips are still counted
+
+	// maxsize is inclusive, 0 keeps everything
+	CHECK_EQ(makeLayout(rgbaArray(64, 7, 1), 64).skipMip, 0u);
+	CHECK_EQ(makeLayout(rgbaArray(64, 7, 1), 0).skipMip, 0u);
+	CHECK_EQ(makeLayout(rgbaArray(64, 7, 1), 63).skipMip, 1u);
+
+	// Any dimension larger than maxsize skips the mip
+	Texture wide = rgbaArray(64, 7, 1);
+	wide.height = 8;
+	CHECK_EQ(makeLayout(wide, 16).skipMip, 2u);
+
+	Texture volume;
+	volume.dimension = DDSDimension::Texture3D;
+	volume.depth = 64;
+	volume.mips = 7;
+	layout = makeLayout(volume, 16);
+	CHECK_EQ(layout.skipMip, 2u);
+	CHECK_EQ(layout.subresources[0].depth, 16u);
+	CHECK_EQ(layout.subresources[0].offset, header + 16 * 16 * 4 * 64 + 8 * 8 * 4 * 32);
+
+	// A single mip is never skipped, whatever its size
+	layout = makeLayout(rgbaArray(64, 1, 1), 16);
+	CHECK_EQ(layout.skipMip, 0u);
+	CHECK_EQ(layout.subresources.size(), size_t(1));
+
+	// parse checks the file holds the skipped mips too, they are in the way of the rest
+	std::vector<uint8_t> file = makeHeaders(rgbaArray(64, 7, 1));
+	file.resize(file.size() + 21844 - 1);
+	CHECK(DDSParser::parse(file.data(), file.size(), layout, 16) == DDSStatus::Truncated);
+	file.push_back(0);
+	CHECK(DDSParser::parse(file.data(), file.size(), layout, 16) == DDSStatus::OK);
+	CHECK_EQ(layout.skipMip, 2u);
+}
+
+TEST(DDSParser, ReadsTheTailOfEveryArrayItem) {
+	// 16x16 RGBA, 5 mips of 1024, 256, 64, 16 and 4 bytes, 1364 per item. Without the 16 and 8 mips
+	// every item is a gap of 1280 bytes and a tail of 84
+	const size_t header = DDSParser::MAX_HEADER_SIZE;
+	DDSLayout layout = makeLayout(rgbaArray(16, 5, 3), 4);
+	CHECK_EQ(layout.skipMip, 2u);
+	CHECK_EQ(layout.subresources.size(), size_t(9));
+
+	std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(layout);
+	CHECK_EQ(ranges.size(), size_t(4));
+	CHECK_EQ(ranges[0].offset, size_t(0));
+	CHECK_EQ(ranges[0].size, header);
+	for (size_t item = 0; item < 3; item++) {
+		CHECK_EQ(ranges[1 + item].offset, header + item * 1364 + 1280);
+		CHECK_EQ(ranges[1 + item].size, size_t(84));
+	}
+	CHECK_EQ(DDSParser::getRangesSize(ranges), header + 3 * 84);
+
+	// With all the mips, the headers and the items merge into the whole file
+	ranges = DDSParser::getReadRanges(makeLayout(rgbaArray(16, 5, 3), 0));
+	CHECK_EQ(ranges.size(), size_t(1));
+	CHECK_EQ(ranges[0].size, header + 3 * 1364);
+}
+
+TEST(DDSParser, ReadsTheTailOfEveryCubeFace) {
+	// A cube of 8x8 RGBA faces, 4 mips of 256, 64, 16 and 4 bytes. Without the 8x8 one every face is a range
+	const size_t header = DDSParser::MAX_HEADER_SIZE;
+	Texture cube = rgbaArray(8, 4, 1);
+	cube.miscFlag = MISC_TEXTURECUBE;
+	DDSLayout layout = makeLayout(cube, 4);
+	CHECK(layout.cubeMap);
+	CHECK_EQ(layout.arraySize, 6u);
+	CHECK_EQ(layout.skipMip, 1u);
+	CHECK_EQ(layout.subresources.size(), size_t(6 * 3));
+
+	std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(layout);
+	CHECK_EQ(ranges.size(), size_t(7));
+	for (size_t face = 0; face < 6; face++) {
+		CHECK_EQ(ranges[1 + face].offset, header + face * 340 + 256);
+		CHECK_EQ(ranges[1 + face].size, size_t(84));
+	}
+
+	// Two cubes are twelve faces
+	cube.arraySize = 2;
+	CHECK_EQ(DDSParser::getReadRanges(makeLayout(cube, 4)).size(), size_t(13));
+}
+
+TEST(DDSParser, PacksTheSubresourcesBackToBack) {
+	const size_t header = DDSParser::MAX_HEADER_SIZE;
+	DDSLayout layout = makeLayout(rgbaArray(16, 5, 3), 4);
+	std::vector<DDSByteRange> ranges = DDSParser::getReadRanges(layout);
+	DDSParser::packSubresources(layout, ranges);
+
+	// Every item is 84 bytes past the previous one, its mips 64, 16 and 4 bytes large
+	const size_t mipOffsets[3] = { 0, 64, 80 };
+	for (size_t item = 0; item < 3; item++) {
+		for (size_t mip = 0; mip < 3; mip++) {
+			const DDSSubresource& sub = layout.subresources[item * 3 + mip];
+			CHECK_EQ(sub.offset, header + item * 84 + mipOffsets[mip]);
+			CHECK_EQ(sub.width, 4u >> mip);
+			CHECK_EQ(sub.slicePitch, size_t(64) >> 2 * mip);
+		}
+	}
+	const DDSSubresource& last = layout.subresources.back();
+	CHECK_EQ(last.offset + last.slicePitch, DDSParser::getRangesSize(ranges));
+
+	// Nothing moves when the file is read whole
+	layout = makeLayout(rgbaArray(16, 5, 3), 0);
+	std::vector<size_t> offsets;
+	for (const auto& sub : layout.subresources) offsets.push_back(sub.offset);
+	DDSParser::packSubresources(layout, DDSParser::getReadRanges(layout));
+	for (size_t i = 0; i < offsets.size(); i++) CHECK_EQ(layout.subresources[i].offset, offsets[i]);
+}
+
+TEST(DDSParser, RejectsTheBrokenHeaders) {
+	std::vector<uint8_t> file = makeHeaders(Texture());
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	CHECK_EQ(layout.headerSize, DDSParser::MAX_HEADER_SIZE);
+
+	// The header, then the "DX10" one, cut short
+	CHECK(DDSParser::parseHeader(file.data(), 4 + 124 - 1, layout) == DDSStatus::Truncated);
+	CHECK(DDSParser::parseHeader(file.data(), DDSParser::MAX_HEADER_SIZE - 1, layout) == DDSStatus::Truncated);
+
+	// The magic number, the header size and the pixel format size
+	for (size_t offset : { size_t(0), size_t(4), size_t(4 + 18 * 4) }) {
+		std::vector<uint8_t> broken = file;
+		broken[offset]++;
+		CHECK(DDSParser::parseHeader(broken.data(), broken.size(), layout) == DDSStatus::InvalidData);
+	}
+
+	// The pixels past the end of the file
+	file.resize(file.size() + 16 * 16 * 4 - 1);
+	CHECK(DDSParser::parse(file.data(), file.size(), layout) == DDSStatus::Truncated);
+
+	// The supercompressed files are left to DDSCompression
+	file.resize(file.size() + 1);
+	CHECK(DDSParser::parse(file.data(), file.size(), layout) == DDSStatus::OK);
+	std::memcpy(file.data() + DDSParser::SUPERCOMPRESSED_MARKER_OFFSET, &DDSParser::SUPERCOMPRESSED_MAGIC, 4);
+	CHECK(DDSParser::parse(file.data(), file.size(), layout) == DDSStatus::NotSupported);
+
+	Texture texture;
+	texture.format = DXGIFormat::UNKNOWN;
+	CHECK(parseHeader(texture) == DDSStatus::NotSupported);
+	texture = Texture();
+	texture.arraySize = 0;
+	CHECK(parseHeader(texture) == DDSStatus::InvalidData);
+	texture = Texture();
+	texture.width = 0;
+	CHECK(parseHeader(texture) == DDSStatus::InvalidData);
+}
+
+TEST(DDSParser, RejectsTheSizesPastTheLimits) {
+	// The Direct3D 12 limits are accepted, one past them is not
+	auto check = [](DDSDimension dimension, uint32_t width, uint32_t height, uint32_t depth, uint32_t arraySize,
+	                bool cube, DDSStatus status) {
+		Texture texture;
+		texture.dimension = dimension;
+		texture.width = width;
+		texture.height = height;
+		texture.depth = depth;
+		texture.arraySize = arraySize;
+		texture.miscFlag = cube ? MISC_TEXTURECUBE : 0;
+		CHECK(parseHeader(texture) == status);
+	};
+
+	check(DDSDimension::Texture1D, 16384, 1, 1, 2048, false, DDSStatus::OK);
+	check(DDSDimension::Texture1D, 16385, 1, 1, 1, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture1D, 16, 1, 1, 2049, false, DDSStatus::NotSupported);
+
+	check(DDSDimension::Texture2D, 16384, 16384, 1, 2048, false, DDSStatus::OK);
+	check(DDSDimension::Texture2D, 16385, 16, 1, 1, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture2D, 16, 16385, 1, 1, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture2D, 16, 16, 1, 2049, false, DDSStatus::NotSupported);
+
+	// The array limit counts the faces, 341 cubes are 2046 of them
+	check(DDSDimension::Texture2D, 16384, 16384, 1, 341, true, DDSStatus::OK);
+	check(DDSDimension::Texture2D, 16, 16, 1, 342, true, DDSStatus::NotSupported);
+	check(DDSDimension::Texture2D, 16385, 16385, 1, 1, true, DDSStatus::NotSupported);
+
+	check(DDSDimension::Texture3D, 2048, 2048, 2048, 1, false, DDSStatus::OK);
+	check(DDSDimension::Texture3D, 2049, 16, 16, 1, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture3D, 16, 16, 2049, 1, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture3D, 16, 16, 16, 2, false, DDSStatus::NotSupported);
+	check(DDSDimension::Texture3D, 16, 16, 0, 1, false, DDSStatus::InvalidData);
+
+	// The mips, and with them the subresources: 2048 items of 15 mips are the 30720 allowed
+	Texture texture = rgbaArray(16384, 15, 2048);
+	CHECK(parseHeader(texture) == DDSStatus::OK);
+	texture.mips = 16;
+	CHECK(parseHeader(texture) == DDSStatus::NotSupported);
+	texture = rgbaArray(16384, 15, 342);
+	texture.miscFlag = MISC_TEXTURECUBE;
+	CHECK(parseHeader(texture) == DDSStatus::NotSupported);
+
+	// A 16384x16384 level of 16-byte pixels is 4 GiB, past the 32-bit sizes
+	texture = rgbaArray(16384, 1, 1);
+	texture.format = DXGIFormat::R32G32B32A32_FLOAT;
+	std::vector<uint8_t> file = makeHeaders(texture);
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	CHECK(DDSParser::computeSubresources(layout) == DDSStatus::Overflow);
+	texture.width = 8192;
+	file = makeHeaders(texture);
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	CHECK(DDSParser::computeSubresources(layout) == DDSStatus::OK);
+}
@@ -0,0 +1,119 @@
+#include "TestFramework.h"
+#include "../DisplayTopology.h"
+
+#include <vector>
+
+static DisplayOutput output(long left, long top, long right, long bottom, bool attached = true) {
+	DisplayOutput o;
+	o.desktop = { left, top, right, bottom };
+	o.attached = attached;
+	return o;
+}
+
+static bool sameRect(const DisplayRect& a, const DisplayRect& b) {
+	return a.left == b.left && a.top == b.top && a.right == b.right && a.bottom == b.bottom;
+}
+
+// The answer of a linear scan, which doesn't need the outputs sorted into slabs
+static int findLinearly(const std::vector<DisplayOutput>& outputs, long x, long y) {
+	for (size_t i = 0; i < outputs.size(); i++) {
+		const auto& d = outputs[i].desktop;
+		if (outputs[i].attached && x >= d.left && x < d.right && y >= d.top && y < d.bottom) return int(i);
+	}
+	return -1;
+}
+
+TEST(DisplayTopology, EmptyDesktop) {
+	DisplayTopology topology;
+	CHECK(sameRect(topology.getBounds(), {}));
+	CHECK_EQ(topology.findOutputAt(0, 0), -1);
+	CHECK_EQ(topology.findOutputContaining({ 0, 0, 100, 100 }), -1);
+}
+
+TEST(DisplayTopology, UnitesTheMonitors) {
+	// The primary at the origin, one to the left and above it, one to the right and lower
+	DisplayTopology topology({
+		output(0, 0, 1920, 1080),
+		output(-2560, -360, 0, 1080),
+		output(1920, 200, 3200, 1224),
+	});
+	CHECK(sameRect(topology.getBounds(), { -2560, -360, 3200, 1224 }));
+}
+
+TEST(DisplayTopology, BoundsIgnoreTheDetachedOutputs) {
+	DisplayTopology topology({
+		output(0, 0, 1920, 1080),
+		output(-5000, -5000, -3000, -3000, false),
+	});
+	CHECK(sameRect(topology.getBounds(), { 0, 0, 1920, 1080 }));
+	CHECK_EQ(topology.findOutputAt(-4000, -4000), -1);
+}
+
+TEST(DisplayTopology, BoundsIncludeTheOrigin) {
+	DisplayTopology topology({ output(100, 100, 200, 200) });
+	CHECK(sameRect(topology.getBounds(), { 0, 0, 200, 200 }));
+}
+
+TEST(DisplayTopology, FindsTheOutputsAtNegativeCoordinates) {
+	DisplayTopology topology({
+		output(0, 0, 1920, 1080),
+		output(-2560, -360, 0, 1080),
+		output(-1280, -1024, 0, -360),      // Above the left one
+	});
+	CHECK_EQ(topology.findOutputAt(0, 0), 0);
+	CHECK_EQ(topology.findOutputAt(-1, 0), 1);
+	CHECK_EQ(topology.findOutputAt(-2560, -360), 1);
+	CHECK_EQ(topology.findOutputAt(-1, -361), 2);
+	CHECK_EQ(topology.findOutputAt(-1280, -1024), 2);
+
+	// The right and bottom edges are outside, the gaps belong to nobody
+	CHECK_EQ(topology.findOutputAt(1920, 0), -1);
+	CHECK_EQ(topology.findOutputAt(0, 1080), -1);
+	CHECK_EQ(topology.findOutputAt(-1281, -500), -1);
+	CHECK_EQ(topology.findOutputAt(100, -1), -1);
+	CHECK_EQ(topology.findOutputAt(-2561, 0), -1);
+}
+
+TEST(DisplayTopology, FindsTheOutputContainingAWindow) {
+	DisplayTopology topology({
+		output(0, 0, 1920, 1080),
+		output(-2560, -360, 0, 1080),
+	});
+	CHECK_EQ(topology.findOutputContaining({ 100, 100, 900, 700 }), 0);
+	CHECK_EQ(topology.findOutputContaining({ -900, 100, -100, 700 }), 1);
+
+	// Straddling the edge, it belongs to the output under its center
+	CHECK_EQ(topology.findOutputContaining({ -600, 100, 400, 700 }), 1);
+	CHECK_EQ(topology.findOutputContaining({ -400, 100, 600, 700 }), 0);
+
+	// Centered in the gap above the primary
+	CHECK_EQ(topology.findOutputContaining({ 100, -900, 900, -100 }), -1);
+}
+
+TEST(DisplayTopology, MatchesALinearScan) {
+	// Staggered outputs of different sizes, several in the same slab
+	std::vector<DisplayOutput> outputs = {
+		output(0, 0, 1920, 1080),
+		output(1920, -400, 3000, 1520),
+		output(-1280, 1080, 640, 2160),
+		output(-1280, -720, 0, 0),
+		output(640, 1080, 1920, 1800),
+		output(3000, 0, 4000, 100, false),
+	};
+	DisplayTopology topology(outputs);
+
+	for (long y = -800; y < 2300; y += 37) {
+		for (long x = -1400; x < 4100; x += 41) {
+			CHECK_EQ(topology.findOutputAt(x, y), findLinearly(outputs, x, y));
+		}
+	}
+	// And at the corners
+	for (const auto& o : outputs) {
+		const auto& d = o.desktop;
+		for (long x : { d.left - 1, d.left, d.right - 1, d.right }) {
+			for (long y : { d.top - 1, d.top, d.bottom - 1, d.bottom }) {
+				CHECK_EQ(topology.findOutputAt(x, y), findLinearly(outputs, x, y));
+			}
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#include "TestFramework.h"
+#include "../FenceTimeline.h"
+
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+// The signals and the blocking waits that reach the queue
+struct RecordingQueue : SimulatedFenceQueue {
+	std::vector<uint64_t> signals;
+	std::vector<uint64_t> waits;
+
+	explicit RecordingQueue(uint64_t latency) : SimulatedFenceQueue(latency) { }
+
+	void signal(uint64_t value) override {
+		signals.push_back(value);
+		SimulatedFenceQueue::signal(value);
+	}
+	void wait(uint64_t value) override {
+		waits.push_back(value);
+		SimulatedFenceQueue::wait(value);
+	}
+};
+
+void runFrames(FenceTimeline& timeline, size_t first, size_t count) {
+	for (size_t frame = first; frame < first + count; frame++) {
+		timeline.waitForFrame(frame);
+		timeline.endFrame(frame);
+	}
+}
+
+}
+
+TEST(FenceTimeline, SlotsWaitOnlyWhenTheGpuIsBehind) {
+	// The GPU two frames behind, as many as there are other slots
+	SimulatedFenceQueue caughtUp(2);
+	FenceTimeline timeline(caughtUp, 3);
+	runFrames(timeline, 0, 10);
+	CHECK_EQ(timeline.getBlockingWaits(), size_t(0));
+
+	// Three behind, every reuse of a slot waits for the frame that used it
+	RecordingQueue behind(3);
+	FenceTimeline slow(behind, 3);
+	runFrames(slow, 0, 10);
+	CHECK_EQ(slow.getBlockingWaits(), size_t(7));
+	CHECK_EQ(behind.waits.size(), size_t(7));
+	for (size_t i = 0; i < behind.waits.size(); i++) CHECK_EQ(behind.waits[i], uint64_t(i + 1));
+}
+
+TEST(FenceTimeline, ResizeWaitsForTheLastFrame) {
+	RecordingQueue queue(2);
+	FenceTimeline timeline(queue, 3);
+	runFrames(timeline, 0, 5);
+	CHECK_EQ(timeline.getCompletedValue(), uint64_t(3));
+
+	timeline.waitForBackBuffers();
+	CHECK_EQ(queue.waits.size(), size_t(1));
+	CHECK_EQ(queue.waits[0], uint64_t(5));
+	CHECK(timeline.isComplete(5));
+	CHECK_EQ(queue.signals.size(), size_t(5));    // No signal of its own
+
+	// No frame since, a second resize doesn't wait
+	timeline.waitForBackBuffers();
+	CHECK_EQ(queue.waits.size(), size_t(1));
+
+	runFrames(timeline, 5, 4);
+	timeline.waitForBackBuffers();
+	CHECK_EQ(queue.waits.back(), uint64_t(9));
+	CHECK_EQ(timeline.getBlockingWaits(), size_t(2));
+}
+
+TEST(FenceTimeline, ResizeDoesntWaitWhenTheGpuCaughtUp) {
+	SimulatedFenceQueue queue(0);
+	FenceTimeline timeline(queue, 2);
+	runFrames(timeline, 0, 4);
+	timeline.waitForBackBuffers();
+	CHECK_EQ(timeline.getBlockingWaits(), size_t(0));
+}
+
+TEST(FenceTimeline, SignalsInOrder) {
+	RecordingQueue queue(2);
+	FenceTimeline timeline(queue, 2);
+
+	CHECK_EQ(timeline.getNextValue(), uint64_t(1));
+	runFrames(timeline, 0, 3);
+	// A fresh value covers the work after the last frame, and the frames go on after it
+	timeline.waitForIdle();
+	CHECK_EQ(queue.waits.back(), uint64_t(4));
+	CHECK_EQ(timeline.getLastSignaled(), uint64_t(4));
+	runFrames(timeline, 3, 3);
+	CHECK_EQ(timeline.getNextValue(), uint64_t(8));
+
+	CHECK_EQ(queue.signals.size(), size_t(7));
+	for (size_t i = 0; i < queue.signals.size(); i++) CHECK_EQ(queue.signals[i], uint64_t(i + 1));
+}
+
+TEST(FenceTimeline, SimulatedQueueRejectsWhatWouldDeadlock) {
+	SimulatedFenceQueue queue(2);
+	queue.signal(1);
+	CHECK_THROWS(queue.signal(1), std::logic_error);
+	CHECK_THROWS(queue.wait(2), std::logic_error);
+	queue.wait(1);
+	CHECK_EQ(queue.getCompletedValue(), uint64_t(1));
+}
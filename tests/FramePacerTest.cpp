@@ -0,0 +1,75 @@
+#include "TestFramework.h"
+#include "../FramePacer.h"
+
+#include <cmath>
+#include <initializer_list>
+
+namespace {
+
+const int64_t PERIOD = 1000;
+
+// The frames start at 0 and come the intervals apart
+FramePacer::Stats run(FramePacer& pacer, std::initializer_list<int64_t> intervals) {
+	int64_t now = 0;
+	pacer.beginFrame(now);
+	for (int64_t interval : intervals) pacer.beginFrame(now += interval);
+	return pacer.getStats();
+}
+
+bool near(double actual, double expected) {
+	return std::abs(actual - expected) < 1e-9;
+}
+
+}
+
+TEST(FramePacer, RoundsToWholePeriods) {
+	struct Case { int64_t interval; size_t missed; };
+	// Half a period rounds up, an early frame still took its vblank
+	for (Case c : { Case{ 1000, 0 }, Case{ 1499, 0 }, Case{ 1500, 1 }, Case{ 2400, 1 }, Case{ 3600, 3 },
+	                Case{ 300, 0 }, Case{ 0, 0 } }) {
+		FramePacer pacer(PERIOD);
+		CHECK_EQ(run(pacer, { c.interval }).missedFrames, c.missed);
+	}
+}
+
+TEST(FramePacer, CountsTheMissedVblanks) {
+	FramePacer pacer(PERIOD);
+	const FramePacer::Stats stats = run(pacer, { 1000, 2000, 1000, 3000, 1000 });
+	CHECK_EQ(stats.frames, size_t(6));
+	CHECK_EQ(stats.missedFrames, size_t(3));
+	CHECK(near(stats.meanIntervalUs, 1.6));
+	CHECK(near(stats.maxIntervalUs, 3));
+}
+
+TEST(FramePacer, ReturnsTheDeltaInSeconds) {
+	FramePacer pacer(PERIOD);
+	CHECK_EQ(pacer.beginFrame(5000), 0.0);     // The first frame has no previous one
+	CHECK(near(pacer.beginFrame(7000), 2e-6));
+	// A clock that went back counts as no time
+	CHECK_EQ(pacer.beginFrame(6000), 0.0);
+}
+
+TEST(FramePacer, JitterIgnoresTheMisses) {
+	// Whole periods, missed or not, are on time
+	FramePacer steady(PERIOD);
+	CHECK(near(run(steady, { 1000, 2000, 1000, 4000 }).jitterUs, 0));
+
+	// 100 ns either side of the period, and of two periods
+	FramePacer jittery(PERIOD);
+	const FramePacer::Stats stats = run(jittery, { 1100, 900, 2100, 1900 });
+	CHECK_EQ(stats.missedFrames, size_t(2));
+	CHECK(near(stats.jitterUs, 0.1));
+	CHECK(near(stats.meanIntervalUs, 1.5));
+}
+
+TEST(FramePacer, ResetStartsOver) {
+	FramePacer pacer(PERIOD);
+	run(pacer, { 3000, 3000 });
+	pacer.reset(0);
+	CHECK_EQ(pacer.getRefreshPeriodNs(), FramePacer::DEFAULT_REFRESH_PERIOD_NS);
+	const FramePacer::Stats stats = pacer.getStats();
+	CHECK_EQ(stats.frames, size_t(0));
+	CHECK_EQ(stats.missedFrames, size_t(0));
+	CHECK_EQ(stats.maxIntervalUs, 0.0);
+	CHECK_EQ(pacer.beginFrame(1000000), 0.0);
+}
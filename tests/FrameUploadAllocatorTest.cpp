@@ -0,0 +1,133 @@
+#include "TestFramework.h"
+#include "../FrameUploadAllocator.h"
+
+#include <random>
+
+TEST(FrameUploadAllocator, GrowsGeometrically) {
+	const size_t min = FrameUploadAllocator::MIN_REGION_SIZE;
+	CHECK_EQ(FrameUploadAllocator::grownRegionSize(0, 1), min);
+	CHECK_EQ(FrameUploadAllocator::grownRegionSize(min, min), min);
+	CHECK_EQ(FrameUploadAllocator::grownRegionSize(min, min + 1), min * 2);
+	CHECK_EQ(FrameUploadAllocator::grownRegionSize(min, min * 5), min * 8);
+}
+
+TEST(FrameUploadAllocator, EveryFrameHasItsRegion) {
+	FrameUploadAllocator allocator(3);
+	allocator.reset(1024);
+	CHECK_EQ(allocator.getCapacity(), size_t(3072));
+	FrameUploadAllocator::Allocation a;
+
+	for (size_t frameIndex = 0; frameIndex < 6; frameIndex++) {
+		allocator.beginFrame(frameIndex);
+		CHECK_EQ(allocator.getFrame(), frameIndex % 3);
+		CHECK(allocator.allocate(100, 1, a));
+		CHECK_EQ(a.offset, frameIndex % 3 * 1024);
+		CHECK(allocator.allocate(100, 1, a));
+		CHECK_EQ(a.offset, frameIndex % 3 * 1024 + 100);
+		CHECK_EQ(a.size, size_t(100));
+	}
+}
+
+TEST(FrameUploadAllocator, AlignsWithinTheBuffer) {
+	// A region size that isn't a multiple of the alignment
+	FrameUploadAllocator allocator(2);
+	allocator.reset(1000);
+	allocator.beginFrame(1);
+	FrameUploadAllocator::Allocation a;
+
+	CHECK(allocator.allocate(10, 256, a));
+	CHECK_EQ(a.offset, size_t(1024));
+	CHECK_EQ(allocator.getUsed(), size_t(34));
+	CHECK(allocator.allocate(10, 256, a));
+	CHECK_EQ(a.offset, size_t(1280));
+
+	// The padding counts against the region
+	CHECK(allocator.allocate(700, 1, a));
+	CHECK(!allocator.allocate(1, 256, a));
+	CHECK_EQ(allocator.getUsed(), size_t(990));
+	CHECK(allocator.allocate(10, 1, a));
+	CHECK_EQ(allocator.getUsed(), size_t(1000));
+}
+
+TEST(FrameUploadAllocator, RejectsWhatDoesntFitTheRegion) {
+	FrameUploadAllocator allocator(2);
+	allocator.reset(1024);
+	allocator.beginFrame(0);
+	FrameUploadAllocator::Allocation a;
+
+	CHECK(!allocator.allocate(1025, 1, a));
+	CHECK(allocator.allocate(1000, 1, a));
+	CHECK(!allocator.allocate(100, 1, a));    // Would spill into the region of frame 1
+	CHECK_EQ(allocator.getUsed(), size_t(1000));
+	CHECK(allocator.getRequiredRegionSize(100, 1) >= size_t(1100));
+}
+
+TEST(FrameUploadAllocator, BeginFrameEmptiesItsRegionOnly) {
+	FrameUploadAllocator allocator(2);
+	allocator.reset(1024);
+	FrameUploadAllocator::Allocation a;
+
+	allocator.beginFrame(0);
+	CHECK(allocator.allocate(500, 1, a));
+	allocator.beginFrame(1);
+	CHECK(allocator.allocate(300, 1, a));
+
+	allocator.beginFrame(2);
+	CHECK_EQ(allocator.getUsed(), size_t(0));
+	CHECK(allocator.allocate(1, 1, a));
+	CHECK_EQ(a.offset, size_t(0));
+
+	// Frame 1 still has its 300 bytes until it begins again
+	allocator.beginFrame(3);
+	CHECK_EQ(allocator.getUsed(), size_t(0));
+	CHECK(allocator.allocate(1, 1, a));
+	CHECK_EQ(a.offset, size_t(1024));
+}
+
+TEST(FrameUploadAllocator, GrowsInTheMiddleOfAFrame) {
+	FrameUploadAllocator allocator(3);
+	allocator.reset(FrameUploadAllocator::MIN_REGION_SIZE);
+	allocator.beginFrame(4);
+	FrameUploadAllocator::Allocation a;
+
+	CHECK(allocator.allocate(60 << 10, 1, a));
+	CHECK(!allocator.allocate(10 << 10, 256, a));
+
+	// The backend retires the old buffer with the fence of this frame and starts a new one, the
+	// frame keeps its index and gets an empty region
+	const size_t region = FrameUploadAllocator::grownRegionSize(allocator.getRegionSize(),
+			allocator.getRequiredRegionSize(10 << 10, 256));
+	CHECK_EQ(region, size_t(128) << 10);
+	allocator.reset(region);
+	CHECK_EQ(allocator.getFrame(), size_t(1));
+	CHECK_EQ(allocator.getUsed(), size_t(0));
+	CHECK_EQ(allocator.getCapacity(), region * 3);
+	CHECK(allocator.allocate(10 << 10, 256, a));
+	CHECK_EQ(a.offset, region);
+}
+
+TEST(FrameUploadAllocator, RetryAfterGrowthAlwaysFits) {
+	// The backend throws if the allocation fails right after the growth
+	std::mt19937 random(7);
+	FrameUploadAllocator allocator(3);
+	allocator.reset(0);
+	FrameUploadAllocator::Allocation a;
+	size_t growths = 0;
+
+	for (size_t frameIndex = 0; frameIndex < 200; frameIndex++) {
+		allocator.beginFrame(frameIndex);
+		for (int i = 0; i < 20; i++) {
+			const size_t size = random() % (frameIndex * 100 + 1) + 1;
+			const size_t alignment = size_t(1) << random() % 17;
+			if (allocator.allocate(size, alignment, a)) continue;
+
+			allocator.reset(FrameUploadAllocator::grownRegionSize(allocator.getRegionSize(),
+					allocator.getRequiredRegionSize(size, alignment)));
+			growths++;
+			CHECK(allocator.allocate(size, alignment, a));
+			CHECK_EQ(a.offset % alignment, size_t(0));
+			CHECK(a.offset + size <= (allocator.getFrame() + 1) * allocator.getRegionSize());
+		}
+	}
+	CHECK(growths <= size_t(12));
+}
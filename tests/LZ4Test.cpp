@@ -0,0 +1,137 @@
+#include "TestFramework.h"
+#include "../LZ4.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<uint8_t> compress(const std::vector<uint8_t>& src) {
+	std::vector<uint8_t> block(LZ4::compressBound(src.size()));
+	const size_t size = LZ4::compress(src.data(), src.size(), block.data());
+	CHECK(size <= block.size());
+	block.resize(size);
+	return block;
+}
+
+bool decompress(const std::vector<uint8_t>& block, std::vector<uint8_t>& dst) {
+	return LZ4::decompress(block.data(), block.size(), dst.data(), dst.size());
+}
+
+void checkRoundTrip(const std::vector<uint8_t>& src) {
+	std::vector<uint8_t> block = compress(src);
+	std::vector<uint8_t> dst(src.size());
+	CHECK(decompress(block, dst));
+	CHECK(dst == src);
+
+	// The block is of that size only
+	std::vector<uint8_t> larger(src.size() + 1);
+	CHECK(!decompress(block, larger));
+	if (!src.empty()) {
+		std::vector<uint8_t> smaller(src.size() - 1);
+		CHECK(!decompress(block, smaller));
+	}
+}
+
+std::vector<uint8_t> noise(size_t size, uint32_t seed) {
+	std::vector<uint8_t> bytes(size);
+	for (uint8_t& byte : bytes) {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		byte = uint8_t(seed >> 24);
+	}
+	return bytes;
+}
+
+}
+
+TEST(LZ4, ReadsTheReferenceFormat) {
+	// A literal and a match of 8 at offset 1, then the last 5 literals, the way liblz4 writes them
+	const std::vector<uint8_t> block = { 0x14, 'a', 0x01, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' };
+	std::vector<uint8_t> dst(14);
+	CHECK(decompress(block, dst));
+	CHECK(std::string(dst.begin(), dst.end()) == "aaaaaaaaabcdef");
+
+	// The lengths of 15 and more continue in the next bytes: 15 + 255 + 0 literals
+	std::vector<uint8_t> literals = { 0xF0, 255, 0 };
+	std::vector<uint8_t> text = noise(270, 1);
+	literals.insert(literals.end(), text.begin(), text.end());
+	dst.assign(270, 0);
+	CHECK(decompress(literals, dst));
+	CHECK(dst == text);
+}
+
+TEST(LZ4, RoundTripsTheEdgeCases) {
+	// Nothing at all is a single empty token
+	CHECK(compress({}) == std::vector<uint8_t>(1, 0));
+	checkRoundTrip({});
+
+	// Up to the 12 bytes no match may start in, then the shortest blocks with a match
+	for (size_t size = 1; size <= 16; size++) checkRoundTrip(std::vector<uint8_t>(size, uint8_t(size)));
+	CHECK(compress(std::vector<uint8_t>(12, 7)).size() == 13);
+
+	// The incompressible data stays within the bound
+	std::vector<uint8_t> random = noise(100000, 2);
+	CHECK(compress(random).size() <= LZ4::compressBound(random.size()));
+	checkRoundTrip(random);
+
+	// A long run is a literal and an overlapping match at offset 1, its length in 255 steps
+	std::vector<uint8_t> run(100000, 0x5A);
+	CHECK(compress(run).size() < 500);
+	checkRoundTrip(run);
+
+	// A short period overlaps too
+	std::vector<uint8_t> period(5000);
+	for (size_t i = 0; i < period.size(); i++) period[i] = uint8_t("abc"[i % 3]);
+	CHECK(compress(period).size() < 100);
+	checkRoundTrip(period);
+}
+
+TEST(LZ4, DoesntMatchPastTheOffsetLimit) {
+	// A repeat 65535 bytes back is found, one 70000 bytes back is out of reach and stays literals.
+	// The noise in between costs its length bytes either way
+	std::vector<uint8_t> pattern = noise(4096, 3);
+	for (size_t distance : { size_t(65535), size_t(70000) }) {
+		std::vector<uint8_t> src = pattern;
+		std::vector<uint8_t> gap = noise(distance - pattern.size(), 4);
+		src.insert(src.end(), gap.begin(), gap.end());
+		src.insert(src.end(), pattern.begin(), pattern.end());
+
+		const size_t size = compress(src).size();
+		if (distance <= 65535) {
+			CHECK(size < src.size() - pattern.size() / 2);
+		} else {
+			CHECK(size >= src.size());
+		}
+		checkRoundTrip(src);
+	}
+}
+
+TEST(LZ4, RejectsTheCorruptedBlocks) {
+	std::vector<uint8_t> dst(14);
+
+	// The offsets of 0 and before the start of the output
+	CHECK(!decompress({ 0x14, 'a', 0x00, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' }, dst));
+	CHECK(!decompress({ 0x14, 'a', 0x02, 0x00, 0x50, 'b', 'c', 'd', 'e', 'f' }, dst));
+
+	// The literals past the end of the block or of the output, a continued length past the output
+	CHECK(!decompress({ 0x50, 'a', 'b', 'c', 'd' }, dst));
+	CHECK(!decompress({ 0xF0, 0 }, dst));
+	CHECK(!decompress({ 0xF0, 255, 255, 255 }, dst));
+
+	// A match past the end of the output, and continued past it
+	CHECK(!decompress({ 0x1F, 'a', 0x01, 0x00, 0, 0x50, 'b', 'c', 'd', 'e', 'f' }, dst));
+	CHECK(!decompress({ 0x1F, 'a', 0x01, 0x00, 255, 255, 0 }, dst));
+
+	// Every prefix of a valid block is truncated
+	const std::vector<uint8_t> text = noise(3000, 5);
+	std::vector<uint8_t> src = text;
+	src.insert(src.end(), 3000, 0x33);
+	src.insert(src.end(), text.begin(), text.begin() + 2000);
+	std::vector<uint8_t> block = compress(src);
+	dst.resize(src.size());
+	for (size_t size = 0; size < block.size(); size++) CHECK(!LZ4::decompress(block.data(), size, dst.data(), dst.size()));
+	CHECK(decompress(block, dst));
+	CHECK(dst == src);
+}
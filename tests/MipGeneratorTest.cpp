@@ -0,0 +1,224 @@
+#include "TestFramework.h"
+#include "../MipGenerator.h"
+#include "../Half.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+MipGenerator::Settings settings(MipFilter filter, bool srgb = false, unsigned threads = 1) {
+	MipGenerator::Settings s;
+	s.filter = filter;
+	s.srgb = srgb;
+	s.threads = threads;
+	return s;
+}
+
+// RGBA8 pixels from a function of the coordinates, tightly packed
+template <typename F>
+std::vector<uint8_t> image(size_t width, size_t height, F pixel) {
+	std::vector<uint8_t> pixels(width * height * 4);
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			uint32_t rgba = pixel(x, y);
+			for (size_t c = 0; c < 4; c++) pixels[(y * width + x) * 4 + c] = uint8_t(rgba >> (24 - 8 * c));
+		}
+	}
+	return pixels;
+}
+
+std::vector<uint8_t> downsample(const MipGenerator::Settings& s, const std::vector<uint8_t>& src,
+                                size_t srcWidth, size_t srcHeight, size_t dstWidth, size_t dstHeight) {
+	std::vector<uint8_t> dst(dstWidth * dstHeight * 4);
+	MipGenerator::downsample(MipFormat::RGBA8, s, src.data(), srcWidth * 4, srcWidth, srcHeight,
+	                         dst.data(), dstWidth * 4, dstWidth, dstHeight);
+	return dst;
+}
+
+// 0xRRGGBBAA
+uint32_t pixelAt(const std::vector<uint8_t>& pixels, size_t width, size_t x, size_t y) {
+	const uint8_t* p = pixels.data() + (y * width + x) * 4;
+	return uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | p[3];
+}
+
+}
+
+TEST(MipGenerator, BoxWeighsTheOddSizesExactly) {
+	// 3x1 into 1x1: a third of every pixel
+	auto row = image(3, 1, [](size_t x, size_t) { return uint32_t(90 * x) << 24 | 0xFF; });
+	CHECK_EQ(pixelAt(downsample(settings(MipFilter::Box), row, 3, 1, 1, 1), 1, 0, 0), 0x5A0000FFu);
+
+	// 5x3 into 2x1: the middle column is split in two halves of its 0.2 weight, every row is a third.
+	// Red grows with x, alpha with y
+	auto src = image(5, 3, [](size_t x, size_t y) { return uint32_t(50 * x) << 24 | uint32_t(30 + 30 * y); });
+	auto dst = downsample(settings(MipFilter::Box), src, 5, 3, 2, 1);
+	CHECK_EQ(pixelAt(dst, 2, 0, 0), 0x2800003Cu);     // 0.4 * 0 + 0.4 * 50 + 0.2 * 100 = 40, the alpha (30 + 60 + 90) / 3 = 60
+	CHECK_EQ(pixelAt(dst, 2, 1, 0), 0xA000003Cu);     // 0.2 * 100 + 0.4 * 150 + 0.4 * 200 = 160
+
+	// The even sizes are the classic 2x2 average
+	auto square = image(2, 2, [](size_t x, size_t y) { return uint32_t(40 * (x + 2 * y)) << 16 | 0xFF; });
+	CHECK_EQ(pixelAt(downsample(settings(MipFilter::Box), square, 2, 2, 1, 1), 1, 0, 0), 0x003C00FFu);
+}
+
+TEST(MipGenerator, KaiserWeightsSumToOne) {
+	// A constant image stays constant everywhere, the edges (where the taps are clamped) included
+	for (size_t size : { 4u, 7u, 16u, 33u }) {
+		auto src = image(size, size, [](size_t, size_t) { return 0x80C0407Fu; });
+		for (float radius : { 1.f, 2.f, 3.f }) {
+			auto s = settings(MipFilter::Kaiser);
+			s.kaiserRadius = radius;
+			const size_t half = std::max<size_t>(1, size / 2);
+			auto dst = downsample(s, src, size, size, half, half);
+			for (size_t y = 0; y < half; y++) {
+				for (size_t x = 0; x < half; x++) CHECK_EQ(pixelAt(dst, half, x, y), 0x80C0407Fu);
+			}
+		}
+	}
+
+	// The kernel is symmetric, so a linear ramp stays linear away from the edges
+	auto ramp = image(64, 1, [](size_t x, size_t) { return uint32_t(4 * x) << 24 | 0xFF; });
+	auto dst = downsample(settings(MipFilter::Kaiser), ramp, 64, 1, 32, 1);
+	for (size_t x = 4; x < 28; x++) CHECK_EQ(pixelAt(dst, 32, x, 0) >> 24, uint32_t(8 * x + 2));
+}
+
+TEST(MipGenerator, FiltersSRGBInLinearSpace) {
+	// Black and white: sRGB 188 is the linear 0.5, 128 would be the average of the encoded values.
+	// The alpha is linear in both cases
+	auto src = image(2, 1, [](size_t x, size_t) { return x ? 0xFFFFFFFFu : 0x00000000u; });
+	CHECK_EQ(pixelAt(downsample(settings(MipFilter::Box, true), src, 2, 1, 1, 1), 1, 0, 0), 0xBCBCBC80u);
+	CHECK_EQ(pixelAt(downsample(settings(MipFilter::Box, false), src, 2, 1, 1, 1), 1, 0, 0), 0x80808080u);
+
+	// A constant sRGB image round trips through the linear space
+	for (uint32_t value = 0; value < 256; value += 17) {
+		auto constant = image(4, 4, [value](size_t, size_t) { return value * 0x01010101u; });
+		CHECK_EQ(pixelAt(downsample(settings(MipFilter::Box, true), constant, 4, 4, 2, 2), 2, 1, 1), value * 0x01010101u);
+	}
+
+	MipFormat format;
+	bool srgb;
+	CHECK(MipGenerator::fromDXGIFormat(29, format, srgb));     // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+	CHECK(format == MipFormat::RGBA8 && srgb);
+	CHECK(MipGenerator::fromDXGIFormat(87, format, srgb));     // DXGI_FORMAT_B8G8R8A8_UNORM
+	CHECK(format == MipFormat::RGBA8 && !srgb);
+	CHECK(MipGenerator::fromDXGIFormat(10, format, srgb));     // DXGI_FORMAT_R16G16B16A16_FLOAT
+	CHECK(format == MipFormat::RGBA16F && !srgb);
+	CHECK(!MipGenerator::fromDXGIFormat(71, format, srgb));    // DXGI_FORMAT_BC1_UNORM
+}
+
+TEST(MipGenerator, HalfFloatsRoundTrip) {
+	// Constant halves (negative, HDR, subnormal) come back bit for bit through the box filter and within
+	// the half precision through the Kaiser one. The sRGB flag is ignored
+	const uint16_t values[4] = { 0xC000, 0x7BFF, 0x3555, 0x0001 };
+	std::vector<uint16_t> src(8 * 8 * 4);
+	for (size_t i = 0; i < src.size(); i++) src[i] = values[i % 4];
+
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser }) {
+		std::vector<uint16_t> dst(4 * 4 * 4);
+		MipGenerator::downsample(MipFormat::RGBA16F, settings(filter, true), reinterpret_cast<const uint8_t*>(src.data()), 8 * 8, 8, 8,
+		                         reinterpret_cast<uint8_t*>(dst.data()), 4 * 8, 4, 4);
+		if (filter == MipFilter::Box) {
+			for (size_t i = 0; i < dst.size(); i++) CHECK_EQ(dst[i], values[i % 4]);
+		} else {
+			for (size_t i = 0; i < dst.size(); i++) CHECK(std::abs(halfToFloat(dst[i]) - halfToFloat(values[i % 4])) <= std::abs(halfToFloat(values[i % 4])) * 1e-3f);
+		}
+	}
+
+	// 1, 2, 3 and 4 average to 2.5, with no 8-bit clamping or rounding
+	const uint16_t quad[4 * 4] = { 0x3C00, 0x3C00, 0x3C00, 0x3C00, 0x4000, 0x4000, 0x4000, 0x4000,
+	                               0x4200, 0x4200, 0x4200, 0x4200, 0x4400, 0x4400, 0x4400, 0x4400 };
+	uint16_t average[4];
+	MipGenerator::downsample(MipFormat::RGBA16F, settings(MipFilter::Box), reinterpret_cast<const uint8_t*>(quad), 2 * 8, 2, 2,
+	                         reinterpret_cast<uint8_t*>(average), 8, 1, 1);
+	for (uint16_t channel : average) CHECK_EQ(channel, uint16_t(0x4100));
+}
+
+TEST(MipGenerator, LaysOutTheChain) {
+	CHECK_EQ(MipGenerator::countMips(1, 1), size_t(1));
+	CHECK_EQ(MipGenerator::countMips(5, 3), size_t(3));
+	CHECK_EQ(MipGenerator::countMips(256, 1), size_t(9));
+	CHECK_EQ(MipGenerator::countMips(640, 480), size_t(10));
+
+	MipLevel levels[3];
+	CHECK_EQ(MipGenerator::layoutChain(MipFormat::RGBA8, 5, 3, 3, levels), size_t(72));
+	const size_t expected[3][5] = { { 5, 3, 20, 60, 0 }, { 2, 1, 8, 8, 60 }, { 1, 1, 4, 4, 68 } };
+	for (size_t i = 0; i < 3; i++) {
+		CHECK_EQ(levels[i].width, expected[i][0]);
+		CHECK_EQ(levels[i].height, expected[i][1]);
+		CHECK_EQ(levels[i].rowPitch, expected[i][2]);
+		CHECK_EQ(levels[i].slicePitch, expected[i][3]);
+		CHECK_EQ(levels[i].offset, expected[i][4]);
+	}
+
+	CHECK_EQ(MipGenerator::layoutChain(MipFormat::RGBA16F, 4, 4, 3, levels), size_t(128 + 32 + 8));
+	CHECK_EQ(levels[1].rowPitch, size_t(16));
+	CHECK_EQ(levels[2].offset, size_t(160));
+
+	// generate() copies the top level out of a padded source and filters every level from the previous one
+	const size_t srcPitch = 5 * 4 + 12;
+	std::vector<uint8_t> src(srcPitch * 3, 0xEE);
+	auto top = image(5, 3, [](size_t x, size_t y) { return uint32_t(50 * x) << 24 | uint32_t(30 + 30 * y); });
+	for (size_t y = 0; y < 3; y++) std::memcpy(src.data() + y * srcPitch, top.data() + y * 20, 20);
+
+	MipGenerator::layoutChain(MipFormat::RGBA8, 5, 3, 3, levels);
+	std::vector<uint8_t> chain(72);
+	MipGenerator::generate(MipFormat::RGBA8, settings(MipFilter::Box), src.data(), srcPitch, 3, levels, chain.data());
+	CHECK(std::equal(top.begin(), top.end(), chain.begin()));
+	CHECK_EQ(pixelAt(chain, 1, 0, 15), 0x2800003Cu);     // The level 1 starts at the pixel 15
+	CHECK_EQ(pixelAt(chain, 1, 0, 16), 0xA000003Cu);
+	CHECK_EQ(pixelAt(chain, 1, 0, 17), 0x6400003Cu);     // (40 + 160) / 2
+}
+
+TEST(MipGenerator, ThreadsDontChangeTheOutput) {
+	auto src = image(300, 260, [](size_t x, size_t y) { return uint32_t(x * 7 + y * 13) * 0x9E3779B1u; });
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser }) {
+		auto single = downsample(settings(filter, true, 1), src, 300, 260, 150, 130);
+		CHECK(downsample(settings(filter, true, 3), src, 300, 260, 150, 130) == single);
+		CHECK(downsample(settings(filter, true, 8), src, 300, 260, 150, 130) == single);
+	}
+}
+
+TEST(MipGenerator, SIMDLevelsFilterTheSame) {
+	// Odd sizes and scales, so the kernels run into their tails
+	const size_t srcWidth = 301, srcHeight = 259;
+	auto src = image(srcWidth, srcHeight, [](size_t x, size_t y) { return uint32_t(x * 7 + y * 13) * 0x9E3779B1u; });
+	std::vector<uint8_t> srcHalves(srcWidth * srcHeight * 8);
+	for (size_t i = 0; i < srcWidth * srcHeight * 4; i++) {
+		uint16_t half = floatToHalf(float(src[i]) / 64.f - 1.f);
+		std::memcpy(srcHalves.data() + 2 * i, &half, 2);
+	}
+
+	const SIMDLevel best = detectSIMDLevel();
+	CHECK(MipGenerator::getSIMDLevel() == best);
+	CHECK(MipGenerator::setSIMDLevel(SIMDLevel::Scalar));
+	CHECK(MipGenerator::getSIMDLevel() == SIMDLevel::Scalar);
+
+	const struct { size_t width, height; } sizes[] = { { 150, 129 }, { 97, 61 }, { 1, 3 } };
+	for (MipFormat format : { MipFormat::RGBA8, MipFormat::RGBA16F }) {
+		const size_t pixelSize = MipGenerator::pixelBytes(format);
+		const uint8_t* pixels = format == MipFormat::RGBA8 ? src.data() : srcHalves.data();
+		for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser }) {
+			for (const auto& size : sizes) {
+				const auto s = settings(filter, format == MipFormat::RGBA8);
+				std::vector<uint8_t> scalar(size.width * size.height * pixelSize), simd(scalar.size());
+				MipGenerator::setSIMDLevel(SIMDLevel::Scalar);
+				MipGenerator::downsample(format, s, pixels, srcWidth * pixelSize, srcWidth, srcHeight,
+				                         scalar.data(), size.width * pixelSize, size.width, size.height);
+				for (SIMDLevel level : { SIMDLevel::SSE41, SIMDLevel::AVX2 }) {
+					if (level > best) break;
+					CHECK(MipGenerator::setSIMDLevel(level));
+					std::fill(simd.begin(), simd.end(), 0);
+					MipGenerator::downsample(format, s, pixels, srcWidth * pixelSize, srcWidth, srcHeight,
+					                         simd.data(), size.width * pixelSize, size.width, size.height);
+					CHECK(simd == scalar);
+				}
+			}
+		}
+	}
+
+	// The levels past the CPU's aren't set
+	if (best != SIMDLevel::AVX2) CHECK(!MipGenerator::setSIMDLevel(SIMDLevel::AVX2));
+	CHECK(MipGenerator::setSIMDLevel(best));
+}
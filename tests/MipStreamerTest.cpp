@@ -0,0 +1,216 @@
+#include "TestFramework.h"
+#include "../MipStreamer.h"
+
+#include <cstring>
+#include <deque>
+#include <vector>
+
+namespace {
+
+// The whole chain of an RGBA texture, the level sizes are size * size * 4 >> 2 * mip
+DDSLayout makeLayout(uint32_t size) {
+	uint32_t header[31] = {};
+	header[0] = 124;
+	header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;    // CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT
+	header[2] = header[3] = size;
+	uint32_t mips = 1;
+	for (uint32_t s = size; s > 1; s >>= 1) mips++;
+	header[6] = mips;
+	header[18] = 32;
+	header[19] = 0x4;                       // DDPF_FOURCC
+	header[20] = 0x30315844;                // "DX10"
+	header[26] = 0x1000 | 0x400000 | 0x8;
+	const uint32_t dx10[5] = { uint32_t(DXGIFormat::R8G8B8A8_UNORM), 3, 0, 1, 0 };
+
+	std::vector<uint8_t> file(4 + sizeof(header) + sizeof(dx10));
+	std::memcpy(file.data(), "DDS ", 4);
+	std::memcpy(file.data() + 4, header, sizeof(header));
+	std::memcpy(file.data() + 4 + sizeof(header), dx10, sizeof(dx10));
+
+	DDSLayout layout;
+	CHECK(DDSParser::parseHeader(file.data(), file.size(), layout) == DDSStatus::OK);
+	CHECK(DDSParser::computeSubresources(layout) == DDSStatus::OK);
+	return layout;
+}
+
+// The reads in flight, completed or failed in whatever order the test picks
+struct FakeReader {
+	MipStreamer& streamer;
+	std::deque<MipStreamRequest> inFlight;
+
+	explicit FakeReader(MipStreamer& streamer) : streamer(streamer) { }
+
+	std::vector<MipStreamRequest> issue() {
+		std::vector<MipStreamRequest> requests = streamer.schedule();
+		inFlight.insert(inFlight.end(), requests.begin(), requests.end());
+		return requests;
+	}
+
+	MipStreamRequest take(uint32_t texture, uint32_t mip) {
+		for (auto it = inFlight.begin(); it != inFlight.end(); ++it) {
+			if (it->texture == texture && it->mip == mip) {
+				MipStreamRequest request = *it;
+				inFlight.erase(it);
+				return request;
+			}
+		}
+		throw TestFailure("no such read in flight");
+	}
+
+	bool complete(uint32_t texture, uint32_t mip) { return streamer.complete(take(texture, mip)); }
+	void fail(uint32_t texture, uint32_t mip) { streamer.fail(take(texture, mip)); }
+};
+
+}
+
+TEST(MipStreamer, HigherPriorityAndBlurrierFirst) {
+	MipStreamer::Settings settings;
+	settings.maxInFlight = 1;
+	MipStreamer streamer(settings);
+	FakeReader reader(streamer);
+
+	const DDSLayout layout = makeLayout(256);
+	const auto low = streamer.add(layout, 5, 1);
+	const auto sharp = streamer.add(layout, 4, 2);
+	const auto blurry = streamer.add(layout, 5, 2);
+
+	auto requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(1));
+	CHECK_EQ(requests[0].texture, blurry);
+	CHECK_EQ(requests[0].mip, 4u);
+	reader.complete(blurry, 4);
+
+	// Level with the sharp one now, the lower ID wins the tie
+	requests = reader.issue();
+	CHECK_EQ(requests[0].texture, sharp);
+	reader.complete(sharp, 3);
+
+	streamer.setPriority(low, 3);
+	requests = reader.issue();
+	CHECK_EQ(requests[0].texture, low);
+}
+
+TEST(MipStreamer, BoundsTheReadsPerTexture) {
+	MipStreamer::Settings settings;
+	settings.maxInFlightPerTexture = 2;
+	MipStreamer streamer(settings);
+	FakeReader reader(streamer);
+
+	const auto texture = streamer.add(makeLayout(256), 8);
+	auto requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(2));
+	CHECK_EQ(requests[0].mip, 7u);
+	CHECK_EQ(requests[1].mip, 6u);
+	CHECK(reader.issue().empty());
+
+	CHECK(reader.complete(texture, 7));
+	requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(1));
+	CHECK_EQ(requests[0].mip, 5u);
+	CHECK_EQ(streamer.getStats().inFlight, 2u);
+}
+
+TEST(MipStreamer, BoundsTheBytesInFlight) {
+	MipStreamer::Settings settings;
+	settings.maxInFlightPerTexture = 4;
+	settings.maxInFlightBytes = 100 << 10;
+	MipStreamer streamer(settings);
+	FakeReader reader(streamer);
+
+	// 16 KB, 64 KB and 256 KB to go
+	const auto texture = streamer.add(makeLayout(256), 3);
+	auto requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(2));
+	CHECK_EQ(requests[0].size, size_t(16) << 10);
+	CHECK_EQ(requests[1].size, size_t(64) << 10);
+	CHECK_EQ(streamer.getStats().inFlightBytes, size_t(80) << 10);
+
+	// Over the budget on its own, it goes when nothing else is in flight
+	reader.complete(texture, 2);
+	CHECK(reader.issue().empty());
+	reader.complete(texture, 1);
+	requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(1));
+	CHECK_EQ(requests[0].mip, 0u);
+	CHECK_EQ(requests[0].ranges.size(), size_t(1));
+	CHECK_EQ(requests[0].ranges[0].size, size_t(256) << 10);
+}
+
+TEST(MipStreamer, ResidentOnlyWithoutHoles) {
+	MipStreamer::Settings settings;
+	settings.maxInFlightPerTexture = 3;
+	MipStreamer streamer(settings);
+	FakeReader reader(streamer);
+
+	const auto texture = streamer.add(makeLayout(256), 8);
+	CHECK_EQ(reader.issue().size(), size_t(3));
+
+	// Finest first, nothing moves until the coarsest lands
+	CHECK(!reader.complete(texture, 5));
+	CHECK_EQ(streamer.getResidentMip(texture), 8u);
+	CHECK(!reader.complete(texture, 6));
+	CHECK_EQ(streamer.getResidentMip(texture), 8u);
+	CHECK(reader.complete(texture, 7));
+	CHECK_EQ(streamer.getResidentMip(texture), 5u);
+
+	// The landed levels aren't read again
+	auto requests = reader.issue();
+	CHECK_EQ(requests[0].mip, 4u);
+	CHECK_EQ(streamer.getStats().completed, uint64_t(3));
+}
+
+TEST(MipStreamer, FailStopsAndSetWantedMipRestarts) {
+	MipStreamer::Settings settings;
+	settings.maxInFlightPerTexture = 2;
+	MipStreamer streamer(settings);
+	FakeReader reader(streamer);
+
+	const auto texture = streamer.add(makeLayout(256), 4);
+	CHECK_EQ(reader.issue().size(), size_t(2));
+	reader.fail(texture, 3);
+	CHECK(!reader.complete(texture, 2));
+	CHECK(reader.issue().empty());
+	CHECK(streamer.isStreamed(texture));
+	CHECK_EQ(streamer.getResidentMip(texture), 4u);
+
+	// Level 2 landed already, only the failed one and the finer ones are read
+	streamer.setWantedMip(texture, 0);
+	CHECK(!streamer.isStreamed(texture));
+	auto requests = reader.issue();
+	CHECK_EQ(requests.size(), size_t(2));
+	CHECK_EQ(requests[0].mip, 3u);
+	CHECK_EQ(requests[1].mip, 1u);
+	CHECK(reader.complete(texture, 3));
+	CHECK_EQ(streamer.getResidentMip(texture), 2u);
+	CHECK_EQ(streamer.getStats().failed, uint64_t(1));
+}
+
+TEST(MipStreamer, AddsWithReservedIds) {
+	MipStreamer streamer;
+	const DDSLayout layout = makeLayout(64);
+
+	const auto id = streamer.reserve();
+	CHECK(!streamer.contains(id));
+	CHECK(streamer.schedule().empty());
+	CHECK(streamer.add(id, layout, 3));
+	CHECK(streamer.contains(id));
+	CHECK(!streamer.add(id, layout, 3));
+	CHECK(!streamer.add(0, layout, 3));
+	CHECK(!streamer.add(id + 1, layout, 3));             // Not reserved
+	CHECK(!streamer.add(streamer.reserve(), layout, layout.mipCount));
+	CHECK_EQ(streamer.getResidentMip(id), 3u);
+}
+
+TEST(MipStreamer, DropsTheReadsOfRemovedTextures) {
+	MipStreamer streamer;
+	FakeReader reader(streamer);
+
+	const auto texture = streamer.add(makeLayout(256), 6);
+	CHECK_EQ(reader.issue().size(), size_t(2));
+	streamer.remove(texture);
+	CHECK(!reader.complete(texture, 5));
+	reader.fail(texture, 4);
+	CHECK_EQ(streamer.getStats().inFlight, 0u);
+	CHECK_EQ(streamer.getStats().inFlightBytes, size_t(0));
+	CHECK(reader.issue().empty());
+}
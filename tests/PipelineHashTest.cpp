@@ -0,0 +1,245 @@
+#include "TestFramework.h"
+#include "../PipelineHash.h"
+
+#include <cstring>
+#include <new>
+#include <string>
+
+// Look-alikes of the D3D12 description structures, with the same field names and the same unions
+namespace {
+
+typedef unsigned int UINT;
+typedef int BOOL;
+
+struct DESCRIPTOR_RANGE { int RangeType; UINT NumDescriptors, BaseShaderRegister, RegisterSpace, OffsetInDescriptorsFromTableStart; };
+struct DESCRIPTOR_RANGE1 { int RangeType; UINT NumDescriptors, BaseShaderRegister, RegisterSpace; int Flags; UINT OffsetInDescriptorsFromTableStart; };
+template <typename Range> struct ROOT_DESCRIPTOR_TABLE { UINT NumDescriptorRanges; const Range* pDescriptorRanges; };
+struct ROOT_CONSTANTS { UINT ShaderRegister, RegisterSpace, Num32BitValues; };
+struct ROOT_DESCRIPTOR { UINT ShaderRegister, RegisterSpace; };
+struct ROOT_DESCRIPTOR1 { UINT ShaderRegister, RegisterSpace; int Flags; };
+template <typename Range, typename RootDescriptor> struct ROOT_PARAMETER {
+	int ParameterType;
+	union {
+		ROOT_DESCRIPTOR_TABLE<Range> DescriptorTable;
+		ROOT_CONSTANTS Constants;
+		RootDescriptor Descriptor;
+	};
+	int ShaderVisibility;
+};
+struct STATIC_SAMPLER_DESC {
+	int Filter, AddressU, AddressV, AddressW; float MipLODBias; UINT MaxAnisotropy; int ComparisonFunc, BorderColor;
+	float MinLOD, MaxLOD; UINT ShaderRegister, RegisterSpace; int ShaderVisibility;
+};
+template <typename Parameter> struct ROOT_SIGNATURE_DESC {
+	UINT NumParameters; const Parameter* pParameters; UINT NumStaticSamplers; const STATIC_SAMPLER_DESC* pStaticSamplers; int Flags;
+};
+typedef ROOT_PARAMETER<DESCRIPTOR_RANGE, ROOT_DESCRIPTOR> ROOT_PARAMETER_1_0;
+typedef ROOT_PARAMETER<DESCRIPTOR_RANGE1, ROOT_DESCRIPTOR1> ROOT_PARAMETER_1_1;
+struct VERSIONED_ROOT_SIGNATURE_DESC {
+	int Version;
+	union {
+		ROOT_SIGNATURE_DESC<ROOT_PARAMETER_1_0> Desc_1_0;
+		ROOT_SIGNATURE_DESC<ROOT_PARAMETER_1_1> Desc_1_1;
+	};
+};
+
+struct SHADER_BYTECODE { const void* pShaderBytecode; size_t BytecodeLength; };
+struct SO_DECLARATION_ENTRY { UINT Stream; const char* SemanticName; UINT SemanticIndex; unsigned char StartComponent, ComponentCount, OutputSlot; };
+struct STREAM_OUTPUT_DESC { const SO_DECLARATION_ENTRY* pSODeclaration; UINT NumEntries; const UINT* pBufferStrides; UINT NumStrides; UINT RasterizedStream; };
+struct RENDER_TARGET_BLEND_DESC {
+	BOOL BlendEnable, LogicOpEnable; int SrcBlend, DestBlend, BlendOp, SrcBlendAlpha, DestBlendAlpha, BlendOpAlpha, LogicOp;
+	unsigned char RenderTargetWriteMask;
+};
+struct BLEND_DESC { BOOL AlphaToCoverageEnable, IndependentBlendEnable; RENDER_TARGET_BLEND_DESC RenderTarget[8]; };
+struct RASTERIZER_DESC {
+	int FillMode, CullMode; BOOL FrontCounterClockwise; int DepthBias; float DepthBiasClamp, SlopeScaledDepthBias;
+	BOOL DepthClipEnable, MultisampleEnable, AntialiasedLineEnable; UINT ForcedSampleCount; int ConservativeRaster;
+};
+struct DEPTH_STENCILOP_DESC { int StencilFailOp, StencilDepthFailOp, StencilPassOp, StencilFunc; };
+struct DEPTH_STENCIL_DESC {
+	BOOL DepthEnable; int DepthWriteMask, DepthFunc; BOOL StencilEnable; unsigned char StencilReadMask, StencilWriteMask;
+	DEPTH_STENCILOP_DESC FrontFace, BackFace;
+};
+struct INPUT_ELEMENT_DESC { const char* SemanticName; UINT SemanticIndex; int Format; UINT InputSlot, AlignedByteOffset; int InputSlotClass; UINT InstanceDataStepRate; };
+struct INPUT_LAYOUT_DESC { const INPUT_ELEMENT_DESC* pInputElementDescs; UINT NumElements; };
+struct SAMPLE_DESC { UINT Count, Quality; };
+struct GRAPHICS_PIPELINE_STATE_DESC {
+	void* pRootSignature;
+	SHADER_BYTECODE VS, PS, DS, HS, GS;
+	STREAM_OUTPUT_DESC StreamOutput;
+	BLEND_DESC BlendState;
+	UINT SampleMask;
+	RASTERIZER_DESC RasterizerState;
+	DEPTH_STENCIL_DESC DepthStencilState;
+	INPUT_LAYOUT_DESC InputLayout;
+	int IBStripCutValue, PrimitiveTopologyType;
+	UINT NumRenderTargets;
+	int RTVFormats[8];
+	int DSVFormat;
+	SAMPLE_DESC SampleDesc;
+	UINT NodeMask;
+	int Flags;
+};
+
+// Constructs T over garbage, so that any padding byte that leaks into a hash shows up
+template <typename T>
+struct Dirty {
+	alignas(T) unsigned char storage[sizeof(T)];
+	explicit Dirty(unsigned char fill) { std::memset(storage, fill, sizeof(storage)); }
+	T& get() { return *reinterpret_cast<T*>(storage); }
+};
+
+struct TriangleRootSignature {
+	DESCRIPTOR_RANGE1 range = { 0, 1, 0, 0, 0, 0 };
+	ROOT_PARAMETER_1_1 parameters[2];
+	STATIC_SAMPLER_DESC sampler = { 21, 1, 1, 1, 0.0f, 16, 0, 0, 0.0f, 1000.0f, 0, 0, 5 };
+	VERSIONED_ROOT_SIGNATURE_DESC desc;
+
+	explicit TriangleRootSignature(unsigned char fill) {
+		std::memset(parameters, fill, sizeof(parameters));
+		std::memset(&desc, fill, sizeof(desc));
+		parameters[0].ParameterType = PipelineHash::ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+		parameters[0].DescriptorTable = { 1, &range };
+		parameters[0].ShaderVisibility = 5;
+		parameters[1].ParameterType = PipelineHash::ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+		parameters[1].Constants = { 0, 0, 4 };
+		parameters[1].ShaderVisibility = 1;
+		desc.Version = 2;
+		desc.Desc_1_1 = { 2, parameters, 1, &sampler, 1 };
+	}
+};
+
+const unsigned char VS_BYTECODE[] = { 1, 2, 3, 4 };
+const unsigned char PS_BYTECODE[] = { 5, 6, 7 };
+
+void fillPipeline(GRAPHICS_PIPELINE_STATE_DESC& desc, const INPUT_ELEMENT_DESC* elements, UINT elementCount,
+                  const void* vs = VS_BYTECODE) {
+	desc.pRootSignature = nullptr;
+	desc.VS = { vs, sizeof(VS_BYTECODE) };
+	desc.PS = { PS_BYTECODE, sizeof(PS_BYTECODE) };
+	desc.DS = desc.HS = desc.GS = { nullptr, 0 };
+	desc.StreamOutput = { nullptr, 0, nullptr, 0, 0 };
+	desc.BlendState.AlphaToCoverageEnable = 0;
+	desc.BlendState.IndependentBlendEnable = 0;
+	for (auto& rt : desc.BlendState.RenderTarget) rt = { 0, 0, 2, 1, 1, 2, 1, 1, 4, 15 };
+	desc.SampleMask = ~0u;
+	desc.RasterizerState = { 3, 3, 0, 0, 0.0f, 0.0f, 1, 0, 0, 0, 0 };
+	desc.DepthStencilState = { 0, 1, 2, 0, 0xFF, 0xFF, { 1, 1, 1, 8 }, { 1, 1, 1, 8 } };
+	desc.InputLayout = { elements, elementCount };
+	desc.IBStripCutValue = 0;
+	desc.PrimitiveTopologyType = 3;
+	desc.NumRenderTargets = 1;
+	desc.RTVFormats[0] = 28;
+	desc.DSVFormat = 0;
+	desc.SampleDesc = { 1, 0 };
+	desc.NodeMask = 0;
+	desc.Flags = 0;
+}
+
+const INPUT_ELEMENT_DESC ELEMENTS[] = {
+	{ "POSITION", 0, 6, 0, 0, 0, 0 },
+	{ "COLOR", 0, 2, 0, 12, 0, 0 },
+};
+
+}
+
+TEST(PipelineHash, RootSignatureIgnoresPaddingAndAddresses) {
+	TriangleRootSignature a(0x00), b(0xCD);
+	CHECK_EQ(PipelineHash::hashRootSignature(a.desc), PipelineHash::hashRootSignature(b.desc));
+}
+
+TEST(PipelineHash, RootSignatureHashesEveryLevel) {
+	TriangleRootSignature base(0);
+	const uint64_t key = PipelineHash::hashRootSignature(base.desc);
+
+	TriangleRootSignature range(0);
+	range.range.Flags = 8;
+	CHECK(PipelineHash::hashRootSignature(range.desc) != key);
+
+	TriangleRootSignature constants(0);
+	constants.parameters[1].Constants.Num32BitValues = 5;
+	CHECK(PipelineHash::hashRootSignature(constants.desc) != key);
+
+	TriangleRootSignature sampler(0);
+	sampler.sampler.MaxLOD = 3.0f;
+	CHECK(PipelineHash::hashRootSignature(sampler.desc) != key);
+
+	TriangleRootSignature flags(0);
+	flags.desc.Desc_1_1.Flags = 0;
+	CHECK(PipelineHash::hashRootSignature(flags.desc) != key);
+
+	TriangleRootSignature fewer(0);
+	fewer.desc.Desc_1_1.NumParameters = 1;
+	CHECK(PipelineHash::hashRootSignature(fewer.desc) != key);
+}
+
+TEST(PipelineHash, RootSignatureVersion10) {
+	DESCRIPTOR_RANGE range = { 0, 1, 0, 0, 0 };
+	ROOT_PARAMETER_1_0 parameter;
+	std::memset(&parameter, 0xAB, sizeof(parameter));
+	parameter.ParameterType = PipelineHash::ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+	parameter.DescriptorTable = { 1, &range };
+	parameter.ShaderVisibility = 5;
+
+	Dirty<VERSIONED_ROOT_SIGNATURE_DESC> a(0x11), b(0x77);
+	for (auto* desc : { &a.get(), &b.get() }) {
+		desc->Version = PipelineHash::ROOT_SIGNATURE_VERSION_1_0;
+		desc->Desc_1_0 = { 1, &parameter, 0, nullptr, 1 };
+	}
+	CHECK_EQ(PipelineHash::hashRootSignature(a.get()), PipelineHash::hashRootSignature(b.get()));
+
+	// The same fields declared as 1.1 are another signature
+	TriangleRootSignature v11(0);
+	CHECK(PipelineHash::hashRootSignature(a.get()) != PipelineHash::hashRootSignature(v11.desc));
+
+	// A root descriptor (a CBV here) hashes its register
+	parameter.ParameterType = 2;
+	parameter.Descriptor = { 3, 0 };
+	const uint64_t cbv3 = PipelineHash::hashRootSignature(a.get());
+	parameter.Descriptor = { 4, 0 };
+	CHECK(PipelineHash::hashRootSignature(a.get()) != cbv3);
+}
+
+TEST(PipelineHash, PipelineHashesContentsNotPointers) {
+	Dirty<GRAPHICS_PIPELINE_STATE_DESC> a(0x00), b(0xEE);
+	fillPipeline(a.get(), ELEMENTS, 2);
+
+	// The same bytecode and semantic names at other addresses
+	std::string position = "POSITION", color = "COLOR";
+	const INPUT_ELEMENT_DESC copies[] = {
+		{ position.c_str(), 0, 6, 0, 0, 0, 0 },
+		{ color.c_str(), 0, 2, 0, 12, 0, 0 },
+	};
+	unsigned char vsCopy[sizeof(VS_BYTECODE)];
+	std::memcpy(vsCopy, VS_BYTECODE, sizeof(vsCopy));
+	fillPipeline(b.get(), copies, 2, vsCopy);
+	// The formats past NumRenderTargets are ignored
+	b.get().RTVFormats[5] = 99;
+
+	CHECK_EQ(PipelineHash::hashGraphicsPipeline(a.get(), 1), PipelineHash::hashGraphicsPipeline(b.get(), 1));
+	CHECK(PipelineHash::hashGraphicsPipeline(a.get(), 1) != PipelineHash::hashGraphicsPipeline(a.get(), 2));
+
+	vsCopy[0] = 42;
+	CHECK(PipelineHash::hashGraphicsPipeline(a.get(), 1) != PipelineHash::hashGraphicsPipeline(b.get(), 1));
+}
+
+TEST(PipelineHash, PipelineHashesTheState) {
+	Dirty<GRAPHICS_PIPELINE_STATE_DESC> base(0);
+	fillPipeline(base.get(), ELEMENTS, 2);
+	const uint64_t key = PipelineHash::hashGraphicsPipeline(base.get(), 1);
+
+	auto changed = [&](auto change) {
+		Dirty<GRAPHICS_PIPELINE_STATE_DESC> desc(0);
+		fillPipeline(desc.get(), ELEMENTS, 2);
+		change(desc.get());
+		return PipelineHash::hashGraphicsPipeline(desc.get(), 1) != key;
+	};
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.BlendState.RenderTarget[7].BlendEnable = 1; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.RasterizerState.CullMode = 1; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.DepthStencilState.BackFace.StencilFunc = 1; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.InputLayout.NumElements = 1; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.PrimitiveTopologyType = 4; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.RTVFormats[0] = 87; }));
+	CHECK(changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.SampleDesc.Count = 4; }));
+	CHECK(!changed([](GRAPHICS_PIPELINE_STATE_DESC& d) { d.pRootSignature = &d; }));
+}
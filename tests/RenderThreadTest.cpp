@@ -0,0 +1,151 @@
+#include "TestFramework.h"
+#include "../RenderThread.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct FakeContents : _GraphicContents<RGBAVertex> {
+	std::atomic<int> layouts = 0;
+	std::atomic<int> updates = 0;
+
+	void updateLayout(int, int) override { layouts++; }
+	void update(double) override { updates++; }
+	size_t getVertexCount() override { return 0; }
+	void writeVertices(std::span<RGBAVertex>) override { }
+	std::string getShader() override { return {}; }
+};
+
+// Remembers the rects it was repositioned to, on which thread, and throws when told to
+struct FakeSurface : RenderSurface {
+	std::mutex mutex;
+	std::vector<DisplayRect> rects;
+	std::thread::id thread;
+	std::atomic<int> frames = 0;
+	std::atomic<bool> failReposition = false;
+
+	FakeSurface() : thread(std::this_thread::get_id()) { }
+
+	void reposition(const DisplayRect& position) override {
+		if (failReposition.load()) throw std::runtime_error("reposition");
+		std::lock_guard<std::mutex> lock(mutex);
+		rects.push_back(position);
+	}
+
+	void presentFrame() override {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));    // The vblank
+		frames++;
+	}
+
+	size_t getRectCount() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return rects.size();
+	}
+};
+
+struct Fixture {
+	std::shared_ptr<FakeContents> contents = std::make_shared<FakeContents>();
+	std::shared_ptr<FakeSurface> surface;
+	std::unique_ptr<RenderThread<RGBAVertex>> thread;
+
+	explicit Fixture(size_t queueCapacity = RenderThread<RGBAVertex>::DEFAULT_QUEUE_CAPACITY) {
+		thread = std::make_unique<RenderThread<RGBAVertex>>(contents, [this] {
+			surface = std::make_shared<FakeSurface>();
+			return surface;
+		}, queueCapacity);
+	}
+};
+
+DisplayRect rectOfWidth(int width) {
+	return { 0, 0, width, 100 };
+}
+
+}
+
+TEST(RenderThread, CreatesTheSurfaceOnItsThread) {
+	Fixture fixture;
+	CHECK(fixture.thread->getSurface() == fixture.surface);
+	CHECK(fixture.surface->thread != std::this_thread::get_id());
+}
+
+TEST(RenderThread, FactoryErrorsComeOutOfTheConstructor) {
+	auto contents = std::make_shared<FakeContents>();
+	auto create = [&contents] {
+		RenderThread<RGBAVertex> thread(contents, []() -> std::shared_ptr<RenderSurface> {
+			throw std::runtime_error("factory");
+		});
+	};
+	CHECK_THROWS(create(), std::runtime_error);
+}
+
+TEST(RenderThread, ResizeReturnsOnceItsFrameIsPresented) {
+	Fixture fixture;
+	for (int width = 1; width <= 100; width++) {
+		fixture.thread->resize(rectOfWidth(width));
+		// The sequence of this resize completed, nothing later is pending
+		std::lock_guard<std::mutex> lock(fixture.surface->mutex);
+		CHECK_EQ(fixture.surface->rects.size(), size_t(width));
+		CHECK_EQ(fixture.surface->rects.back().right, width);
+	}
+	CHECK_EQ(fixture.contents->layouts.load(), 100);
+
+	// An empty rect (a minimized window) is completed without a frame
+	fixture.thread->resize({ 0, 0, 0, 0 });
+	CHECK_EQ(fixture.surface->getRectCount(), size_t(100));
+}
+
+TEST(RenderThread, PostedTasksRunInOrderBeforeTheFlushReturns) {
+	// A small queue, so the posts sleep while the render thread is behind
+	Fixture fixture(4);
+	std::vector<int> order;
+	for (int i = 0; i < 100; i++) {
+		fixture.thread->post([&order, i](RenderSurface&) {
+			std::this_thread::sleep_for(std::chrono::microseconds(10));
+			order.push_back(i);
+		});
+	}
+	fixture.thread->flush();
+	CHECK_EQ(order.size(), size_t(100));
+	for (int i = 0; i < 100; i++) CHECK_EQ(order[i], i);
+}
+
+TEST(RenderThread, RethrowsAnErrorOnTheNextWait) {
+	Fixture fixture;
+	fixture.thread->post([](RenderSurface&) { throw std::runtime_error("task"); });
+	fixture.thread->post([](RenderSurface&) { throw std::logic_error("second"); });
+
+	// The first error only, by whichever wait comes next
+	CHECK_THROWS(fixture.thread->resize(rectOfWidth(10)), std::runtime_error);
+	// Rethrown once, the thread goes on
+	fixture.thread->resize(rectOfWidth(20));
+	CHECK_EQ(fixture.surface->getRectCount(), size_t(2));
+
+	fixture.surface->failReposition = true;
+	CHECK_THROWS(fixture.thread->resize(rectOfWidth(30)), std::runtime_error);
+	fixture.surface->failReposition = false;
+	fixture.thread->flush();
+}
+
+TEST(RenderThread, AnimatesBetweenTheRequests) {
+	Fixture fixture;
+	fixture.thread->startAnimation(0);
+	while (fixture.surface->frames.load() < 5) std::this_thread::yield();
+
+	// The resizes still wait for their own frames
+	fixture.thread->resize(rectOfWidth(50));
+	CHECK_EQ(fixture.surface->getRectCount(), size_t(1));
+
+	fixture.thread->stopAnimation();
+	fixture.thread->flush();
+	const int frames = fixture.surface->frames.load();
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	CHECK_EQ(fixture.surface->frames.load(), frames);
+	CHECK(fixture.contents->updates.load() >= frames);
+	CHECK(fixture.thread->getFramePacer().getStats().frames >= size_t(5));
+}
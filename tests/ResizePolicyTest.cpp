@@ -0,0 +1,127 @@
+#include "TestFramework.h"
+#include "../ResizePolicy.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+// The client sizes of a window dragged by its bottom-right corner from one size to another, a pixel
+// of width per update (the way WM_NCCALCSIZE comes during a slow drag)
+static std::vector<BufferSize> drag(BufferSize from, BufferSize to) {
+	std::vector<BufferSize> trace;
+	int steps = std::max(std::abs(to.width - from.width), 1);
+	for (int i = 0; i <= steps; i++) {
+		trace.push_back({ from.width + (to.width - from.width) * i / steps,
+		                  from.height + (to.height - from.height) * i / steps });
+	}
+	return trace;
+}
+
+static void append(std::vector<BufferSize>& trace, const std::vector<BufferSize>& more) {
+	trace.insert(trace.end(), more.begin(), more.end());
+}
+
+TEST(ResizePolicy, GrowsInBuckets) {
+	ResizePolicy policy;
+	CHECK(policy.update({ 800, 600 }));
+	CHECK_EQ(policy.getAllocated().width, 832);
+	CHECK_EQ(policy.getAllocated().height, 640);
+
+	// Inside the bucket
+	CHECK(!policy.update({ 832, 640 }));
+	CHECK(!policy.update({ 500, 400 }));
+
+	// Only the overflowing dimension grows, by the growth factor at least
+	CHECK(policy.update({ 833, 600 }));
+	CHECK_EQ(policy.getAllocated().width, 1088);
+	CHECK_EQ(policy.getAllocated().height, 640);
+	CHECK_EQ(policy.getReallocations(), size_t(2));
+}
+
+TEST(ResizePolicy, SlowDragReallocatesLogarithmically) {
+	auto trace = drag({ 640, 480 }, { 3840, 2160 });
+	size_t reallocations = ResizePolicy::replay({}, trace);
+
+	// Every one of the 3201 updates changes the size; the buckets reallocate a few times per dimension
+	CHECK_EQ(trace.size(), size_t(3201));
+	CHECK(reallocations >= 8);
+	CHECK(reallocations <= 16);
+
+	// A finer growth reallocates more often
+	ResizePolicy::Settings fine;
+	fine.growthFactor = 1.0f;
+	CHECK(ResizePolicy::replay(fine, trace) > reallocations);
+}
+
+TEST(ResizePolicy, JitterAtTheBucketEdgeDoesntThrash) {
+	ResizePolicy policy;
+	policy.update({ 1088, 640 });
+	CHECK_EQ(policy.getAllocated().width, 1088);
+
+	// A shaking hand around the edge grows once and then fits
+	for (int i = 0; i < 1000; i++) policy.update({ i % 2 == 0 ? 1087 : 1089, 640 });
+	CHECK_EQ(policy.getReallocations(), size_t(2));
+	CHECK_EQ(policy.getAllocated().width, 1408);
+}
+
+TEST(ResizePolicy, ShrinksOnlyAfterTheDelay) {
+	ResizePolicy policy;
+	policy.update({ 1920, 1080 });
+	const BufferSize big = policy.getAllocated();
+
+	for (int i = 1; i < ResizePolicy::Settings().shrinkDelay; i++) {
+		CHECK(!policy.update({ 800, 500 }));
+	}
+	CHECK(policy.getAllocated() == big);
+	CHECK(policy.update({ 800, 500 }));
+	CHECK_EQ(policy.getAllocated().width, 832);
+	CHECK_EQ(policy.getAllocated().height, 512);
+
+	// Slightly below the allocation isn't too small
+	ResizePolicy keeping;
+	keeping.update({ 1920, 1080 });
+	for (int i = 0; i < 100; i++) CHECK(!keeping.update({ 1000, 600 }));
+}
+
+TEST(ResizePolicy, AlternatingSizesNeverShrink) {
+	// A maximize/restore storm: the restored size never stays long enough to shrink the buffers
+	std::vector<BufferSize> trace;
+	for (int i = 0; i < 1000; i++) trace.push_back(i % 2 == 0 ? BufferSize { 1920, 1080 } : BufferSize { 400, 300 });
+	CHECK_EQ(ResizePolicy::replay({}, trace), size_t(1));
+}
+
+TEST(ResizePolicy, RepeatedDragsReuseTheBuckets) {
+	// Out and back, with a pause at the small size that lets the buffers shrink
+	std::vector<BufferSize> cycle = drag({ 640, 480 }, { 1920, 1080 });
+	append(cycle, drag({ 1920, 1080 }, { 640, 480 }));
+	append(cycle, std::vector<BufferSize>(ResizePolicy::Settings().shrinkDelay, BufferSize { 640, 480 }));
+
+	size_t once = ResizePolicy::replay({}, cycle);
+	std::vector<BufferSize> storm;
+	for (int i = 0; i < 10; i++) append(storm, cycle);
+	size_t tenTimes = ResizePolicy::replay({}, storm);
+
+	// The first cycle starts from nothing, the others from the shrunk buffers
+	CHECK(once >= 2);
+	CHECK(tenTimes <= 10 * once);
+	CHECK(tenTimes * 100 < storm.size());
+
+	// The same as the updates one by one
+	ResizePolicy policy;
+	for (const auto& size : storm) policy.update(size);
+	CHECK_EQ(policy.getReallocations(), tenTimes);
+}
+
+TEST(ResizePolicy, StaysWithinTheTextureLimits) {
+	ResizePolicy policy;
+	policy.update({ 16000, 100 });
+	CHECK_EQ(policy.getAllocated().width, 16000);
+
+	// The growth factor would go past the limit
+	policy.update({ 16001, 100 });
+	CHECK_EQ(policy.getAllocated().width, 16384);
+
+	// Unless the request itself does
+	policy.update({ 20000, 100 });
+	CHECK_EQ(policy.getAllocated().width, 20000);
+}
@@ -0,0 +1,97 @@
+#include "TestFramework.h"
+#include "../RingBufferAllocator.h"
+
+TEST(RingBufferAllocator, GrowsGeometrically) {
+	CHECK_EQ(RingBufferAllocator::grownCapacity(0, 1), RingBufferAllocator::MIN_CAPACITY);
+	CHECK_EQ(RingBufferAllocator::grownCapacity(0, 5000), size_t(8192));
+	CHECK_EQ(RingBufferAllocator::grownCapacity(8192, 8192), size_t(8192));
+	CHECK_EQ(RingBufferAllocator::grownCapacity(8192, 8193), size_t(16384));
+	CHECK_EQ(RingBufferAllocator::grownCapacity(8192, 100000), size_t(131072));
+
+	// A steadily growing request reallocates log2 times
+	size_t capacity = 0, reallocations = 0;
+	for (size_t required = 1; required <= (1 << 20); required += 1000) {
+		size_t grown = RingBufferAllocator::grownCapacity(capacity, required);
+		if (grown != capacity) reallocations++;
+		capacity = grown;
+	}
+	CHECK_EQ(reallocations, size_t(9));     // 4K to 1M
+}
+
+TEST(RingBufferAllocator, FirstMapDiscardsThenAppends) {
+	RingBufferAllocator ring;
+	ring.reset(1024);
+	RingBufferAllocator::Allocation a;
+
+	CHECK(ring.allocate(100, 1, a));
+	CHECK_EQ(a.offset, size_t(0));
+	CHECK(a.discard);
+
+	CHECK(ring.allocate(100, 1, a));
+	CHECK_EQ(a.offset, size_t(100));
+	CHECK(!a.discard);
+	CHECK_EQ(ring.getHead(), size_t(200));
+}
+
+TEST(RingBufferAllocator, AlignsTheOffsets) {
+	RingBufferAllocator ring;
+	ring.reset(1024);
+	RingBufferAllocator::Allocation a;
+
+	CHECK(ring.allocate(10, 28, a));
+	CHECK_EQ(a.offset, size_t(0));
+	CHECK(ring.allocate(10, 28, a));
+	CHECK_EQ(a.offset, size_t(28));
+	CHECK(ring.allocate(1, 256, a));
+	CHECK_EQ(a.offset, size_t(256));
+	CHECK(ring.allocate(1, 0, a));      // 0 and 1 mean unaligned
+	CHECK_EQ(a.offset, size_t(257));
+}
+
+TEST(RingBufferAllocator, WrapsWithDiscard) {
+	RingBufferAllocator ring;
+	ring.reset(1000);
+	RingBufferAllocator::Allocation a;
+
+	for (int i = 0; i < 3; i++) CHECK(ring.allocate(300, 1, a));
+	CHECK_EQ(a.offset, size_t(600));
+	CHECK(!a.discard);
+
+	// 900 + 300 doesn't fit, the buffer is renamed
+	CHECK(ring.allocate(300, 1, a));
+	CHECK_EQ(a.offset, size_t(0));
+	CHECK(a.discard);
+	CHECK(ring.allocate(300, 1, a));
+	CHECK_EQ(a.offset, size_t(300));
+	CHECK(!a.discard);
+
+	// The exact fit doesn't wrap
+	CHECK(ring.allocate(400, 1, a));
+	CHECK_EQ(a.offset, size_t(600));
+	CHECK(!a.discard);
+
+	// The alignment padding alone can push an allocation past the end
+	ring.reset(1000);
+	CHECK(ring.allocate(996, 1, a));
+	CHECK(ring.allocate(3, 16, a));     // 996 would fit, its aligned offset 1008 doesn't
+	CHECK_EQ(a.offset, size_t(0));
+	CHECK(a.discard);
+}
+
+TEST(RingBufferAllocator, RejectsWhatNeverFits) {
+	RingBufferAllocator ring;
+	RingBufferAllocator::Allocation a;
+	CHECK(!ring.allocate(1, 1, a));     // No buffer yet
+
+	ring.reset(1000);
+	CHECK(!ring.allocate(1001, 1, a));
+	CHECK(ring.allocate(1000, 1, a));
+	CHECK(a.discard);
+
+	// After growing, the fresh buffer discards again
+	ring.reset(RingBufferAllocator::grownCapacity(ring.getCapacity(), 1001));
+	CHECK_EQ(ring.getCapacity(), size_t(4096));
+	CHECK(ring.allocate(1001, 1, a));
+	CHECK_EQ(a.offset, size_t(0));
+	CHECK(a.discard);
+}
@@ -0,0 +1,99 @@
+#include "TestFramework.h"
+#include "../SPSCQueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST(SPSCQueue, RoundsTheCapacityUp) {
+	CHECK_EQ(SPSCQueue<int>(1).getCapacity(), size_t(1));
+	CHECK_EQ(SPSCQueue<int>(5).getCapacity(), size_t(8));
+	CHECK_EQ(SPSCQueue<int>(64).getCapacity(), size_t(64));
+}
+
+TEST(SPSCQueue, KeepsTheOrderAcrossTheWrapAround) {
+	SPSCQueue<int> queue(4);
+	int next = 0, expected = 0, item;
+	// Three in, two out, so the indices go around the slots many times at every fill level
+	for (int round = 0; round < 1000; round++) {
+		while (queue.tryPush(int(next))) next++;
+		for (int i = 0; i < 2; i++) {
+			CHECK(queue.tryPop(item));
+			CHECK_EQ(item, expected++);
+		}
+	}
+	while (queue.tryPop(item)) CHECK_EQ(item, expected++);
+	CHECK_EQ(expected, next);
+	CHECK(queue.isEmpty());
+}
+
+TEST(SPSCQueue, TryFailsWhenFullOrEmpty) {
+	SPSCQueue<int> queue(2);
+	int item;
+	CHECK(queue.isEmpty());
+	CHECK(!queue.tryPop(item));
+	CHECK(queue.tryPush(1));
+	CHECK(queue.tryPush(2));
+	CHECK(!queue.tryPush(3));
+	CHECK(queue.tryPop(item));
+	CHECK_EQ(item, 1);
+	CHECK(queue.tryPush(3));
+	CHECK(!queue.tryPush(4));
+}
+
+TEST(SPSCQueue, PushSleepsWhileFull) {
+	SPSCQueue<int> queue(2);
+	queue.push(1);
+	queue.push(2);
+
+	std::atomic<bool> pushed = false;
+	std::thread producer([&] {
+		queue.push(3);
+		pushed = true;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK(!pushed.load());
+
+	int item;
+	queue.pop(item);
+	producer.join();
+	CHECK(pushed.load());
+	queue.pop(item);
+	CHECK_EQ(item, 2);
+	queue.pop(item);
+	CHECK_EQ(item, 3);
+}
+
+TEST(SPSCQueue, PopSleepsWhileEmpty) {
+	SPSCQueue<int> queue(2);
+	std::atomic<int> popped = 0;
+	std::thread consumer([&] {
+		int item;
+		queue.pop(item);
+		popped = item;
+	});
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	CHECK_EQ(popped.load(), 0);
+
+	queue.push(42);
+	consumer.join();
+	CHECK_EQ(popped.load(), 42);
+}
+
+TEST(SPSCQueue, PassesEveryItemBetweenThreads) {
+	// Small, so both sides keep sleeping on each other
+	SPSCQueue<uint64_t> queue(8);
+	const uint64_t count = 100000;
+	std::atomic<uint64_t> mismatches = 0;
+	std::thread consumer([&] {
+		uint64_t item;
+		for (uint64_t i = 0; i < count; i++) {
+			queue.pop(item);
+			if (item != i) mismatches++;
+		}
+	});
+	for (uint64_t i = 0; i < count; i++) queue.push(uint64_t(i));
+	consumer.join();
+	CHECK_EQ(mismatches.load(), uint64_t(0));
+	CHECK(queue.isEmpty());
+}
@@ -0,0 +1,126 @@
+#include "TestFramework.h"
+#include "../ShaderCache.h"
+
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+// Counts the compilations, the bytecode is the inputs concatenated
+struct StubCompiler : ShaderCompiler {
+	size_t compilations = 0;
+
+	std::vector<uint8_t> compile(const std::string& source, const std::string& entryPoint,
+	                             const std::string& target, uint32_t flags) override {
+		compilations++;
+		std::string text = source + "|" + entryPoint + "|" + target + "|" + std::to_string(flags);
+		return std::vector<uint8_t>(text.begin(), text.end());
+	}
+};
+
+// A fresh directory, removed with the object
+struct TempDirectory {
+	std::filesystem::path path;
+
+	explicit TempDirectory(const char* name) : path(std::filesystem::temp_directory_path() / name) {
+		std::filesystem::remove_all(path);
+	}
+	~TempDirectory() {
+		std::error_code ec;
+		std::filesystem::remove_all(path, ec);
+	}
+};
+
+}
+
+TEST(ShaderCache, CompilesOnceAndHitsMemory) {
+	StubCompiler compiler;
+	ShaderCache cache(compiler);
+
+	const auto& first = cache.get("source", "VSMain", "vs_5_0", 1);
+	const auto& second = cache.get("source", "VSMain", "vs_5_0", 1);
+	CHECK(&first == &second);
+	CHECK_EQ(compiler.compilations, size_t(1));
+	CHECK_EQ(cache.getStats().compilations, size_t(1));
+	CHECK_EQ(cache.getStats().memoryHits, size_t(1));
+	CHECK_EQ(cache.getStats().diskHits, size_t(0));
+}
+
+TEST(ShaderCache, EveryKeyPartMatters) {
+	StubCompiler compiler;
+	ShaderCache cache(compiler);
+
+	cache.get("source", "VSMain", "vs_5_0", 1);
+	cache.get("source2", "VSMain", "vs_5_0", 1);
+	cache.get("source", "PSMain", "vs_5_0", 1);
+	cache.get("source", "VSMain", "ps_5_0", 1);
+	cache.get("source", "VSMain", "vs_5_0", 2);
+	CHECK_EQ(compiler.compilations, size_t(5));
+	CHECK_EQ(cache.getStats().memoryHits, size_t(0));
+}
+
+TEST(ShaderCache, KeyHashesTheLengths) {
+	CHECK(ShaderCache::makeKey("ab", "c", "t", 0) != ShaderCache::makeKey("a", "bc", "t", 0));
+	CHECK(ShaderCache::makeKey("a", "b", "c", 0) == ShaderCache::makeKey("a", "b", "c", 0));
+}
+
+TEST(ShaderCache, DiskTierSurvivesTheCache) {
+	TempDirectory directory("noflicker_shader_cache_test");
+	StubCompiler compiler;
+	std::vector<uint8_t> bytecode;
+	{
+		ShaderCache cache(compiler, directory.path);
+		bytecode = cache.get("source", "VSMain", "vs_5_0", 1);
+	}
+
+	// A new process, in effect
+	ShaderCache cache(compiler, directory.path);
+	CHECK(cache.get("source", "VSMain", "vs_5_0", 1) == bytecode);
+	CHECK_EQ(compiler.compilations, size_t(1));
+	CHECK_EQ(cache.getStats().diskHits, size_t(1));
+
+	// No temporary files are left behind
+	for (const auto& entry : std::filesystem::directory_iterator(directory.path)) {
+		CHECK(entry.path().extension() == ".cso");
+	}
+}
+
+TEST(ShaderCache, ClearKeepsTheDisk) {
+	TempDirectory directory("noflicker_shader_cache_clear_test");
+	StubCompiler compiler;
+	ShaderCache cache(compiler, directory.path);
+
+	cache.get("source", "VSMain", "vs_5_0", 1);
+	cache.clear();
+	cache.get("source", "VSMain", "vs_5_0", 1);
+	CHECK_EQ(compiler.compilations, size_t(1));
+	CHECK_EQ(cache.getStats().diskHits, size_t(1));
+}
+
+TEST(ShaderCache, EmptyEntryIsRecompiled) {
+	TempDirectory directory("noflicker_shader_cache_empty_test");
+	StubCompiler compiler;
+	{
+		ShaderCache cache(compiler, directory.path);
+		cache.get("source", "VSMain", "vs_5_0", 1);
+	}
+	for (const auto& entry : std::filesystem::directory_iterator(directory.path)) {
+		std::ofstream(entry.path(), std::ios::trunc);
+	}
+
+	ShaderCache cache(compiler, directory.path);
+	CHECK(!cache.get("source", "VSMain", "vs_5_0", 1).empty());
+	CHECK_EQ(compiler.compilations, size_t(2));
+	CHECK_EQ(cache.getStats().diskHits, size_t(0));
+}
+
+TEST(ShaderCache, WithoutDirectoryNothingIsStored) {
+	StubCompiler compiler;
+	{
+		ShaderCache cache(compiler);
+		cache.get("source", "VSMain", "vs_5_0", 1);
+	}
+	ShaderCache cache(compiler);
+	cache.get("source", "VSMain", "vs_5_0", 1);
+	CHECK_EQ(compiler.compilations, size_t(2));
+}
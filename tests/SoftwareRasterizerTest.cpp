@@ -0,0 +1,286 @@
+#include "TestFramework.h"
+#include "../SoftwareRasterizer.h"
+
+#include <array>
+#include <cmath>
+#include <vector>
+
+namespace {
+
+// A power of two, so that the vertex positions, the snapped coordinates and the barycentric
+// weights are all exact in float, and the expected pixels can be worked out by hand
+const int SIZE = 8;
+
+using Topology = SoftwareRasterizer::Topology;
+
+// A vertex at a screen position in pixels (y down)
+RGBAVertex at(float px, float py, float r = 1.f, float g = 1.f, float b = 1.f, float a = 1.f) {
+	return { 2.f * px / SIZE - 1.f, 1.f - 2.f * py / SIZE, 0.f, r, g, b, a };
+}
+
+TextureVertex textured(float px, float py, float tx, float ty) {
+	return { 2.f * px / SIZE - 1.f, 1.f - 2.f * py / SIZE, 0.f, tx, ty };
+}
+
+// Two clockwise triangles: top-left, top-right, bottom-left and top-right, bottom-right, bottom-left
+std::vector<RGBAVertex> quad(float left, float top, float right, float bottom) {
+	return { at(left, top), at(right, top), at(left, bottom), at(right, top), at(right, bottom), at(left, bottom) };
+}
+
+uint32_t pixel(const SoftwareRasterizer& r, int x, int y) {
+	return r.getPixels()[size_t(y) * r.getBufferWidth() + x];
+}
+
+// The covered pixels as rows of '#' and '.', for the readable expectations
+std::string coverage(const SoftwareRasterizer& r) {
+	std::string result;
+	for (int y = 0; y < r.getViewportHeight(); y++) {
+		for (int x = 0; x < r.getViewportWidth(); x++) result += pixel(r, x, y) != 0 ? '#' : '.';
+		result += '\n';
+	}
+	return result;
+}
+
+std::string drawCoverage(std::vector<RGBAVertex> vertices, Topology topology = Topology::TriangleList) {
+	SoftwareRasterizer r(1);
+	r.resize(SIZE, SIZE);
+	r.clear(0);
+	r.draw(vertices, topology);
+	return coverage(r);
+}
+
+}
+
+TEST(SoftwareRasterizer, FillsTheCentersOnTheTopAndLeftEdgesOnly) {
+	// The edges run through the pixel centers: the top and the left ones are in, the bottom and the right ones out
+	CHECK_EQ(drawCoverage(quad(0.5f, 0.5f, 3.5f, 3.5f)),
+	         std::string("###.....\n"
+	                     "###.....\n"
+	                     "###.....\n"
+	                     "........\n"
+	                     "........\n"
+	                     "........\n"
+	                     "........\n"
+	                     "........\n"));
+}
+
+TEST(SoftwareRasterizer, SharedEdgesCoverEveryPixelOnce) {
+	// The diagonal runs through the centers of (0, 3), (1, 2), (2, 1) and (3, 0). It is the right edge
+	// of the first triangle and the left edge of the second one, so they go to the second one
+	const std::string first = drawCoverage({ at(0, 0), at(4, 0), at(0, 4) });
+	const std::string second = drawCoverage({ at(4, 0), at(4, 4), at(0, 4) });
+	CHECK_EQ(first, std::string("###.....\n"
+	                            "##......\n"
+	                            "#.......\n"
+	                            "........\n"
+	                            "........\n"
+	                            "........\n"
+	                            "........\n"
+	                            "........\n"));
+	CHECK_EQ(second, std::string("...#....\n"
+	                             "..##....\n"
+	                             ".###....\n"
+	                             "####....\n"
+	                             "........\n"
+	                             "........\n"
+	                             "........\n"
+	                             "........\n"));
+
+	// A fan around a center pixel: the four triangles share the edges through (4.5, 4.5)
+	// and the vertical and horizontal ones through the centers
+	std::array<std::string, 4> fan = {
+		drawCoverage({ at(2.5f, 2.5f), at(6.5f, 2.5f), at(4.5f, 4.5f) }),
+		drawCoverage({ at(6.5f, 2.5f), at(6.5f, 6.5f), at(4.5f, 4.5f) }),
+		drawCoverage({ at(6.5f, 6.5f), at(2.5f, 6.5f), at(4.5f, 4.5f) }),
+		drawCoverage({ at(2.5f, 6.5f), at(2.5f, 2.5f), at(4.5f, 4.5f) }) };
+	const std::string whole = drawCoverage(quad(2.5f, 2.5f, 6.5f, 6.5f));
+	for (size_t i = 0; i < whole.size(); i++) {
+		int owners = 0;
+		for (const std::string& part : fan) owners += part[i] == '#';
+		CHECK_EQ(owners, whole[i] == '#' ? 1 : 0);
+	}
+}
+
+TEST(SoftwareRasterizer, CullsTheBackFaces) {
+	// Counter-clockwise on screen
+	CHECK_EQ(drawCoverage({ at(0, 0), at(0, 4), at(4, 0) }).find('#'), std::string::npos);
+	// The same triangle clockwise
+	CHECK_EQ(drawCoverage({ at(0, 0), at(4, 0), at(0, 4) }).substr(0, 9), std::string("###.....\n"));
+	// Degenerate
+	CHECK_EQ(drawCoverage({ at(0, 0), at(4, 4), at(8, 8) }).find('#'), std::string::npos);
+}
+
+TEST(SoftwareRasterizer, FlipsTheOddTrianglesOfAStrip) {
+	// Without the flip, the second triangle of the strip would be counter-clockwise and culled
+	const std::string strip = drawCoverage({ at(0, 0), at(4, 0), at(0, 4), at(4, 4) }, Topology::TriangleStrip);
+	CHECK_EQ(strip, drawCoverage(quad(0, 0, 4, 4)));
+	CHECK_EQ(strip.substr(0, 9), std::string("####....\n"));
+	CHECK_EQ(strip.substr(3 * 9, 9), std::string("####....\n"));
+
+	// Five vertices: the third triangle is even again
+	const std::string longer = drawCoverage({ at(0, 0), at(4, 0), at(0, 4), at(4, 4), at(0, 8) }, Topology::TriangleStrip);
+	CHECK_EQ(longer.substr(4 * 9, 9), std::string("###.....\n"));
+	CHECK_EQ(longer.substr(6 * 9, 9), std::string("#.......\n"));
+
+	// The strip started the other way round is all back faces
+	CHECK_EQ(drawCoverage({ at(4, 0), at(0, 0), at(4, 4), at(0, 4) }, Topology::TriangleStrip).find('#'), std::string::npos);
+	// The list takes the whole triangles only
+	CHECK_EQ(drawCoverage({ at(0, 0), at(4, 0), at(0, 4), at(4, 4) }), drawCoverage({ at(0, 0), at(4, 0), at(0, 4) }));
+}
+
+TEST(SoftwareRasterizer, SnapsTheVerticesTo256thsOfAPixel) {
+	const float quarter = 1.f / 1024;      // A quarter of a subpixel rounds away
+	const float one = 1.f / 256;           // A whole subpixel doesn't
+
+	// A left edge just right of the column 0 centers still takes them once snapped onto them
+	CHECK_EQ(drawCoverage(quad(0.5f + quarter, 0, 4, 1)).substr(0, 9), std::string("####....\n"));
+	CHECK_EQ(drawCoverage(quad(0.5f + one, 0, 4, 1)).substr(0, 9), std::string(".###....\n"));
+
+	// A right edge just right of the column 3 centers snaps back onto them and leaves them out
+	CHECK_EQ(drawCoverage(quad(0, 0, 3.5f + quarter, 1)).substr(0, 9), std::string("###.....\n"));
+	CHECK_EQ(drawCoverage(quad(0, 0, 3.5f + one, 1)).substr(0, 9), std::string("####....\n"));
+
+	// The same for a top and a bottom edge
+	CHECK_EQ(drawCoverage(quad(0, 0.5f + quarter, 1, 4)).substr(0, 9 * 4), std::string("#.......\n#.......\n#.......\n#.......\n"));
+	CHECK_EQ(drawCoverage(quad(0, 0.5f + one, 1, 4)).substr(0, 9 * 4), std::string("........\n#.......\n#.......\n#.......\n"));
+	CHECK_EQ(drawCoverage(quad(0, 0, 1, 2.5f + quarter)).substr(0, 9 * 3), std::string("#.......\n#.......\n........\n"));
+	CHECK_EQ(drawCoverage(quad(0, 0, 1, 2.5f + one)).substr(0, 9 * 3), std::string("#.......\n#.......\n#.......\n"));
+}
+
+TEST(SoftwareRasterizer, InterpolatesTheColors) {
+	// Red grows to the right, green grows down, blue and alpha are constant
+	SoftwareRasterizer r(1);
+	r.resize(SIZE, SIZE);
+	r.clear(0);
+	const std::vector<RGBAVertex> vertices = {
+		at(0, 0, 0, 0, 0.25f, 1), at(8, 0, 1, 0, 0.25f, 1), at(0, 8, 0, 1, 0.25f, 1),
+		at(8, 0, 1, 0, 0.25f, 1), at(8, 8, 1, 1, 0.25f, 1), at(0, 8, 0, 1, 0.25f, 1) };
+	r.draw(vertices, Topology::TriangleList);
+
+	// (x + 0.5) / 8 * 255, rounded
+	const uint32_t ramp[SIZE] = { 16, 48, 80, 112, 143, 175, 207, 239 };
+	for (int y = 0; y < SIZE; y++) {
+		for (int x = 0; x < SIZE; x++) {
+			CHECK_EQ(pixel(r, x, y), 0xFF000000u | ramp[x] << 16 | ramp[y] << 8 | 64u);
+		}
+	}
+
+	// The alpha interpolates too, and the weights follow each vertex
+	r.clear(0);
+	const std::vector<RGBAVertex> corner = { at(0, 0, 1, 0, 0, 0), at(8, 0, 0, 1, 0, 1), at(0, 8, 0, 0, 1, 1) };
+	r.draw(corner, Topology::TriangleList);
+	// The center of (0, 0) has the weights 7/8, 1/16 and 1/16
+	CHECK_EQ(pixel(r, 0, 0), SoftwareRasterizer::packColor(0.875f, 0.0625f, 0.0625f, 0.125f));
+	CHECK_EQ(pixel(r, 0, 0), 0x20DF1010u);
+	// The center of (3, 2) has 1/4, 7/16 and 5/16
+	CHECK_EQ(pixel(r, 3, 2), 0xBF407050u);
+}
+
+TEST(SoftwareRasterizer, SamplesBilinearlyWithClamping) {
+	// Blue is on in the right column, green in the bottom row
+	SoftwareTexture texture;
+	texture.width = 2;
+	texture.height = 2;
+	texture.texels = { 0xFF000000u, 0xFF0000FFu, 0xFF00FF00u, 0xFF00FFFFu };
+
+	SoftwareRasterizer r(1);
+	r.resize(SIZE, SIZE);
+	r.clear(0);
+	const std::vector<TextureVertex> vertices = {
+		textured(0, 0, 0, 0), textured(8, 0, 1, 0), textured(0, 8, 0, 1),
+		textured(8, 0, 1, 0), textured(8, 8, 1, 1), textured(0, 8, 0, 1) };
+	r.draw(vertices, Topology::TriangleList, texture);
+
+	// The texel coordinate of the pixel x is (x + 0.5) / 4 - 0.5: the first and the last two
+	// pixels are clamped to the edge texels, the middle ones get the 8-bit weights 32, 96, 160 and 224
+	const uint32_t ramp[SIZE] = { 0, 0, 31, 95, 159, 223, 255, 255 };
+	for (int y = 0; y < SIZE; y++) {
+		for (int x = 0; x < SIZE; x++) {
+			CHECK_EQ(pixel(r, x, y), 0xFF000000u | ramp[y] << 8 | ramp[x]);
+		}
+	}
+
+	// Outside of [0, 1] the coordinates clamp to the edge too
+	r.clear(0);
+	const std::vector<TextureVertex> outside = {
+		textured(0, 0, -2, -2), textured(8, 0, -1, -2), textured(0, 8, -2, -1) };
+	r.draw(outside, Topology::TriangleList, texture);
+	CHECK_EQ(pixel(r, 0, 0), 0xFF000000u);
+	CHECK_EQ(pixel(r, 3, 3), 0xFF000000u);
+
+	// An empty texture samples opaque black
+	r.clear(0);
+	r.draw(vertices, Topology::TriangleList, SoftwareTexture());
+	CHECK_EQ(pixel(r, 5, 5), 0xFF000000u);
+}
+
+TEST(SoftwareRasterizer, TilesAndThreadsDontChangeThePixels) {
+	// Many triangles across the tile borders of a buffer larger than the viewport
+	auto render = [](unsigned threads) {
+		SoftwareRasterizer r(threads);
+		r.resize(300, 200);
+		r.setViewport(257, 131);
+		r.clear(0xFF101010u);
+		std::vector<RGBAVertex> vertices;
+		for (int i = 0; i < 40; i++) {
+			float t = float(i) / 40;
+			vertices.push_back({ -1.f + t, 1.f - t * 0.3f, 0, t, 1 - t, 0.5f, 1 });
+			vertices.push_back({ 1.f - t * 0.5f, 0.9f - t, 0, 1, t, 0, 1 });
+			vertices.push_back({ -0.8f + t * 1.3f, -1.f + t * 0.2f, 0, 0, 0, t, 1 });
+		}
+		r.draw(vertices, Topology::TriangleStrip);
+		return r.getPixels();
+	};
+
+	const std::vector<uint32_t> single = render(1);
+	CHECK(render(4) == single);
+	CHECK(render(7) == single);
+
+	// Nothing is drawn outside of the viewport
+	for (int y = 0; y < 200; y++) {
+		for (int x = 0; x < 300; x++) {
+			if (x >= 257 || y >= 131) CHECK_EQ(single[size_t(y) * 300 + x], 0u);
+		}
+	}
+}
+
+TEST(SoftwareRasterizer, SIMDLevelsCoverTheSame) {
+	// Pseudo-random triangles of every size, some slivers, some far off the screen; both windings
+	std::vector<RGBAVertex> vertices;
+	uint64_t state = 0x2545F4914F6CDD1Dull;
+	auto random = [&state](float range) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return (float(state >> 40) / float(1 << 24) * 2.f - 1.f) * range;
+	};
+	for (int i = 0; i < 300; i++) {
+		const float range = i % 3 == 0 ? 1.f : i % 3 == 1 ? 0.1f : 40.f;
+		const float cx = random(1.f), cy = random(1.f);
+		for (int k = 0; k < 3; k++) {
+			const float c = float(k) / 2;
+			vertices.push_back({ cx + random(range), cy + random(range), 0, c, 1 - c, 0.5f, 1 });
+		}
+	}
+
+	auto render = [&vertices] {
+		SoftwareRasterizer r(1);
+		r.resize(301, 203);
+		r.clear(0xFF101010u);
+		r.draw(vertices, Topology::TriangleList);
+		return r.getPixels();
+	};
+
+	const SIMDLevel best = detectSIMDLevel();
+	CHECK(SoftwareRasterizer::getSIMDLevel() == best);
+	CHECK(SoftwareRasterizer::setSIMDLevel(SIMDLevel::Scalar));
+	CHECK(SoftwareRasterizer::getSIMDLevel() == SIMDLevel::Scalar);
+	const std::vector<uint32_t> scalar = render();
+	for (SIMDLevel level : { SIMDLevel::SSE41, SIMDLevel::AVX2 }) {
+		if (level > best) break;
+		CHECK(SoftwareRasterizer::setSIMDLevel(level));
+		CHECK(render() == scalar);
+	}
+
+	// The levels past the CPU's aren't set
+	if (best != SIMDLevel::AVX2) CHECK(!SoftwareRasterizer::setSIMDLevel(SIMDLevel::AVX2));
+	CHECK(SoftwareRasterizer::setSIMDLevel(best));
+}
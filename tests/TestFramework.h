@@ -0,0 +1,64 @@
+#pragma once
+
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Just enough of a unit test framework for the backend-neutral modules, with no dependencies.
+//
+// TEST(Suite, Name) registers a test, the CHECK macros throw TestFailure on the first failed
+// check of a test. noflicker_tests runs every test, or the suites named on the command line
+// (that is how ctest runs them, a suite per test).
+struct TestCase {
+	const char* suite;
+	const char* name;
+	void (*run)();
+};
+
+struct TestFailure : std::exception {
+	std::string message;
+	explicit TestFailure(std::string message) : message(std::move(message)) { }
+	const char* what() const noexcept override { return message.c_str(); }
+};
+
+inline std::vector<TestCase>& testRegistry() {
+	static std::vector<TestCase> tests;
+	return tests;
+}
+
+struct TestRegistrar {
+	TestRegistrar(const char* suite, const char* name, void (*run)()) { testRegistry().push_back({ suite, name, run }); }
+};
+
+[[noreturn]] inline void testFail(const char* file, int line, const std::string& what) {
+	std::ostringstream out;
+	out << file << ":" << line << ": " << what;
+	throw TestFailure(out.str());
+}
+
+#define TEST(suite, name) \
+	static void suite##_##name(); \
+	static TestRegistrar suite##_##name##_registrar(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) testFail(__FILE__, __LINE__, "CHECK(" #condition ")"); } while (false)
+
+#define CHECK_EQ(actual, expected) \
+	do { \
+		const auto& actualValue_ = (actual); \
+		const auto& expectedValue_ = (expected); \
+		if (!(actualValue_ == expectedValue_)) { \
+			std::ostringstream message_; \
+			message_ << "CHECK_EQ(" #actual ", " #expected "): " << actualValue_ << " != " << expectedValue_; \
+			testFail(__FILE__, __LINE__, message_.str()); \
+		} \
+	} while (false)
+
+#define CHECK_THROWS(expression, type) \
+	do { \
+		bool thrown_ = false; \
+		try { (void) (expression); } catch (const type&) { thrown_ = true; } \
+		if (!thrown_) testFail(__FILE__, __LINE__, "CHECK_THROWS(" #expression ", " #type ")"); \
+	} while (false)
@@ -0,0 +1,179 @@
+#include "TestFramework.h"
+#include "../TextureCache.h"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Textures of 1 MB on the GPU and 1 KB on the CPU, the files named "missing" fail to load
+struct FakeResidency : TextureResidency {
+	std::mutex mutex;
+	std::vector<std::string> loads;
+	std::vector<std::string> evictions;
+	std::atomic<bool> holdLoads = false;
+	std::atomic<int> loading = 0;
+
+	bool load(const std::string& path, uint32_t flags, CachedTexture& texture) override {
+		loading++;
+		while (holdLoads.load()) std::this_thread::yield();
+		loading--;
+
+		const std::string name = std::filesystem::path(path).filename().string();
+		std::lock_guard<std::mutex> lock(mutex);
+		loads.push_back(name);
+		if (name == "missing") return false;
+		texture.texture = new std::string(name + "/" + std::to_string(flags));
+		texture.cpuBytes = 1 << 10;
+		texture.gpuBytes = 1 << 20;
+		return true;
+	}
+
+	void evict(const CachedTexture& texture) override {
+		auto* name = static_cast<std::string*>(texture.texture);
+		std::lock_guard<std::mutex> lock(mutex);
+		evictions.push_back(*name);
+		delete name;
+	}
+};
+
+TextureCache::Settings budget(size_t textures) {
+	TextureCache::Settings settings;
+	settings.gpuBudget = textures << 20;
+	return settings;
+}
+
+}
+
+TEST(TextureCache, SharesOneLoadPerKey) {
+	FakeResidency residency;
+	TextureCache cache(residency);
+
+	auto a = cache.acquire("a.dds");
+	auto b = cache.acquire("./a.dds");
+	auto srgb = cache.acquire("a.dds", 1);
+	CHECK(a && b && srgb);
+	CHECK_EQ(a.as<std::string>(), b.as<std::string>());
+	CHECK_EQ(*srgb.as<std::string>(), std::string("a.dds/1"));
+	CHECK_EQ(residency.loads.size(), size_t(2));
+
+	const TextureCache::Stats stats = cache.getStats();
+	CHECK_EQ(stats.misses, uint64_t(2));
+	CHECK_EQ(stats.hits, uint64_t(1));
+	CHECK_EQ(stats.entries, size_t(2));
+	CHECK_EQ(stats.gpuBytes, size_t(2) << 20);
+	CHECK_EQ(stats.cpuBytes, size_t(2) << 10);
+}
+
+TEST(TextureCache, ConcurrentRequestsWaitForOneLoad) {
+	FakeResidency residency;
+	TextureCache cache(residency);
+
+	residency.holdLoads = true;
+	std::vector<std::thread> threads;
+	std::atomic<int> loaded = 0;
+	for (int i = 0; i < 4; i++) {
+		threads.emplace_back([&cache, &loaded] {
+			if (cache.acquire("shared.dds")) loaded++;
+		});
+	}
+	while (residency.loading.load() == 0) std::this_thread::yield();
+	// The others reach the entry and wait on it, not on the residency
+	while (cache.getStats().joined < 3) std::this_thread::yield();
+	residency.holdLoads = false;
+	for (auto& thread : threads) thread.join();
+
+	CHECK_EQ(loaded.load(), 4);
+	CHECK_EQ(residency.loads.size(), size_t(1));
+	CHECK_EQ(cache.getStats().misses, uint64_t(1));
+	CHECK_EQ(cache.getStats().joined, uint64_t(3));
+}
+
+TEST(TextureCache, EvictsTheLeastRecentlyUsedOverBudget) {
+	FakeResidency residency;
+	TextureCache cache(residency, budget(2));
+
+	cache.acquire("a.dds");
+	cache.acquire("b.dds");
+	cache.acquire("a.dds");    // b is the oldest now
+	cache.acquire("c.dds");
+	CHECK_EQ(residency.evictions.size(), size_t(1));
+	CHECK_EQ(residency.evictions[0], std::string("b.dds/0"));
+
+	const TextureCache::Stats stats = cache.getStats();
+	CHECK_EQ(stats.evictions, uint64_t(1));
+	CHECK_EQ(stats.entries, size_t(2));
+	CHECK_EQ(stats.gpuBytes, size_t(2) << 20);
+
+	// Loaded again, a miss
+	cache.acquire("b.dds");
+	CHECK_EQ(cache.getStats().misses, uint64_t(4));
+	CHECK_EQ(residency.evictions.back(), std::string("a.dds/0"));
+}
+
+TEST(TextureCache, ReferencesPinOverBudget) {
+	FakeResidency residency;
+	TextureCache cache(residency, budget(1));
+
+	auto a = cache.acquire("a.dds");
+	auto b = cache.acquire("b.dds");
+	CHECK(residency.evictions.empty());
+	CHECK_EQ(cache.getStats().gpuBytes, size_t(2) << 20);
+
+	// Moving the reference keeps the pin
+	TextureCache::Reference moved = std::move(a);
+	CHECK(!a);
+	CHECK(residency.evictions.empty());
+
+	// The last reference gone, back under the budget
+	moved.reset();
+	CHECK_EQ(residency.evictions.size(), size_t(1));
+	CHECK_EQ(residency.evictions[0], std::string("a.dds/0"));
+	CHECK_EQ(*b.as<std::string>(), std::string("b.dds/0"));
+}
+
+TEST(TextureCache, SmallerBudgetAndClearEvict) {
+	FakeResidency residency;
+	TextureCache cache(residency, budget(4));
+
+	auto held = cache.acquire("held.dds");
+	for (const char* name : { "a.dds", "b.dds", "c.dds" }) cache.acquire(name);
+	CHECK(residency.evictions.empty());
+
+	cache.setSettings(budget(2));
+	CHECK_EQ(residency.evictions.size(), size_t(2));
+	CHECK_EQ(residency.evictions[0], std::string("a.dds/0"));
+	CHECK_EQ(residency.evictions[1], std::string("b.dds/0"));
+
+	cache.clear();
+	CHECK_EQ(residency.evictions.size(), size_t(3));
+	CHECK_EQ(cache.getStats().entries, size_t(1));
+	held.reset();
+}
+
+TEST(TextureCache, FailuresAreNotCached) {
+	FakeResidency residency;
+	TextureCache cache(residency);
+
+	CHECK(!cache.acquire("missing"));
+	CHECK(!cache.acquire("missing"));
+	CHECK_EQ(residency.loads.size(), size_t(2));
+
+	const TextureCache::Stats stats = cache.getStats();
+	CHECK_EQ(stats.failures, uint64_t(2));
+	CHECK_EQ(stats.entries, size_t(0));
+}
+
+TEST(TextureCache, DestructorEvictsEverything) {
+	FakeResidency residency;
+	{
+		TextureCache cache(residency);
+		cache.acquire("a.dds");
+		cache.acquire("b.dds");
+	}
+	CHECK_EQ(residency.evictions.size(), size_t(2));
+}
@@ -0,0 +1,214 @@
+#include "TestFramework.h"
+#include "../TraceRecorder.h"
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static bool near(double actual, double expected, double tolerance) {
+	return std::abs(actual - expected) <= tolerance * expected;
+}
+
+static size_t countOccurrences(const std::string& text, const std::string& what) {
+	size_t count = 0;
+	for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) count++;
+	return count;
+}
+
+TEST(TraceRecorder, StatsCoverTheEventsPastTheRing) {
+	TraceRecorder recorder;
+	const size_t events = 3 * TraceRecorder::RING_SIZE + 5;
+	// 1 us to 12.3 ms, the shortest ones long gone from the ring
+	for (size_t i = 1; i <= events; i++) recorder.record("Phase", int64_t(i) * 100000, int64_t(i) * 1000);
+
+	CHECK_EQ(recorder.snapshot().size(), TraceRecorder::RING_SIZE);
+
+	auto stats = recorder.computeStats();
+	CHECK_EQ(stats.size(), size_t(1));
+	const auto& s = stats["Phase"];
+	CHECK_EQ(s.count, events);
+	CHECK_EQ(s.minUs, 1.0);
+	CHECK_EQ(s.maxUs, double(events));
+	CHECK(near(s.meanUs, (events + 1) / 2.0, 1e-9));
+
+	// To the bucket, an eighth of an octave
+	CHECK(near(s.p50Us, events * 0.50, 1.0 / 16));
+	CHECK(near(s.p90Us, events * 0.90, 1.0 / 16));
+	CHECK(near(s.p99Us, events * 0.99, 1.0 / 16));
+	CHECK(s.p99Us <= s.maxUs);
+}
+
+TEST(TraceRecorder, ShortDurationsAreExact) {
+	TraceRecorder recorder;
+	for (int i = 0; i < 100; i++) recorder.record("Short", 0, i < 50 ? 3 : 12);
+	const auto stats = recorder.computeStats();
+	const auto& s = stats.at("Short");
+	CHECK_EQ(s.p50Us, 0.003);
+	CHECK_EQ(s.p90Us, 0.012);
+	CHECK_EQ(s.maxUs, 0.012);
+}
+
+TEST(TraceRecorder, ChromeTraceHasTheLatestEvents) {
+	TraceRecorder recorder;
+	for (size_t i = 0; i < TraceRecorder::RING_SIZE + 10; i++) recorder.record("Phase", int64_t(i) * 1000, 500);
+
+	std::ostringstream out;
+	recorder.writeChromeTrace(out);
+	CHECK_EQ(countOccurrences(out.str(), "\"ph\":\"X\""), TraceRecorder::RING_SIZE);
+	// The first ten are overwritten
+	CHECK_EQ(countOccurrences(out.str(), "\"ts\":0,"), size_t(0));
+	CHECK_EQ(countOccurrences(out.str(), "\"ts\":10,"), size_t(1));
+}
+
+TEST(TraceRecorder, SumsTheThreads) {
+	TraceRecorder recorder;
+	const int threads = 4, events = 5000;
+	std::vector<std::thread> writers;
+	for (int t = 0; t < threads; t++) {
+		writers.emplace_back([&recorder, t] {
+			for (int i = 0; i < events; i++) recorder.record("Phase", i, (t + 1) * 1000);
+		});
+	}
+	for (auto& writer : writers) writer.join();
+
+	const auto stats = recorder.computeStats();
+	const auto& s = stats.at("Phase");
+	CHECK_EQ(s.count, size_t(threads * events));
+	CHECK_EQ(s.minUs, 1.0);
+	CHECK_EQ(s.maxUs, double(threads));
+	CHECK(near(s.meanUs, 2.5, 1e-9));
+	CHECK_EQ(recorder.snapshot().size(), threads * TraceRecorder::RING_SIZE);
+}
+
+TEST(TraceRecorder, MergesTheCopiesOfAName) {
+	static const char first[] = "Phase";
+	static const char second[] = "Phase";
+	TraceRecorder recorder;
+	recorder.record(first, 0, 1000);
+	recorder.record(second, 0, 3000);
+
+	auto stats = recorder.computeStats();
+	CHECK_EQ(stats.size(), size_t(1));
+	CHECK_EQ(stats["Phase"].count, size_t(2));
+	CHECK_EQ(stats["Phase"].meanUs, 2.0);
+}
+
+TEST(TraceRecorder, CountsTheEventsPastMaxPhases) {
+	static std::vector<std::string> names;
+	for (size_t i = names.size(); i <= TraceRecorder::MAX_PHASES; i++) names.push_back("Phase" + std::to_string(i));
+
+	TraceRecorder recorder;
+	for (const auto& name : names) recorder.record(name.c_str(), 0, 1000);
+	recorder.record(names.back().c_str(), 0, 1000);
+
+	CHECK_EQ(recorder.computeStats().size(), TraceRecorder::MAX_PHASES);
+	CHECK_EQ(recorder.getUncountedEvents(), uint64_t(2));
+	CHECK_EQ(recorder.snapshot().size(), TraceRecorder::MAX_PHASES + 2);
+}
+
+TEST(TraceRecorder, KeepsTheRecordersApart) {
+	TraceRecorder a, b;
+	a.record("Phase", 0, 1000);
+	b.record("Phase", 0, 2000);
+	b.record("Phase", 0, 2000);
+	const auto statsA = a.computeStats();
+	const auto statsB = b.computeStats();
+	CHECK_EQ(statsA.at("Phase").count, size_t(1));
+	CHECK_EQ(statsB.at("Phase").count, size_t(2));
+}
+
+TEST(TraceRecorder, ResetStartsANewWindow) {
+	TraceRecorder recorder;
+	for (int i = 0; i < 100; i++) recorder.record("Slow", 0, 9000);
+	for (int i = 0; i < 100; i++) recorder.record("Phase", 0, 1000);
+	recorder.resetStats();
+	CHECK(recorder.computeStats().empty());
+
+	// The extremes and the percentiles are of the new events only, and so is the other thread
+	for (int i = 0; i < 10; i++) recorder.record("Phase", 0, i < 5 ? 3000 : 5000);
+	std::thread([&recorder] { recorder.record("Phase", 0, 4000); }).join();
+	auto stats = recorder.computeStats();
+	CHECK_EQ(stats.size(), size_t(1));
+	CHECK_EQ(stats["Phase"].count, size_t(11));
+	CHECK_EQ(stats["Phase"].minUs, 3.0);
+	CHECK_EQ(stats["Phase"].maxUs, 5.0);
+	CHECK(near(stats["Phase"].meanUs, 44.0 / 11, 1e-9));
+	CHECK(near(stats["Phase"].p50Us, 4.0, 1.0 / 16));
+
+	// The rings keep everything
+	CHECK_EQ(recorder.snapshot().size(), size_t(211));
+}
+
+TEST(TraceRecorder, ResetClearsTheUncountedEvents) {
+	static std::vector<std::string> names;
+	for (size_t i = names.size(); i <= TraceRecorder::MAX_PHASES; i++) names.push_back("Phase" + std::to_string(i));
+
+	TraceRecorder recorder;
+	for (const auto& name : names) recorder.record(name.c_str(), 0, 1000);
+	CHECK_EQ(recorder.getUncountedEvents(), uint64_t(1));
+	recorder.resetStats();
+	CHECK_EQ(recorder.getUncountedEvents(), uint64_t(0));
+
+	// The phases keep their slots, the last one still has none
+	recorder.record(names.front().c_str(), 0, 1000);
+	recorder.record(names.back().c_str(), 0, 1000);
+	CHECK_EQ(recorder.computeStats().size(), size_t(1));
+	CHECK_EQ(recorder.getUncountedEvents(), uint64_t(1));
+}
+
+TEST(TraceRecorder, RollingStatsCoverTheLastSlices) {
+	const int64_t slice = TraceRecorder::ROLLING_SLICE_NS;
+	const int64_t slices = int64_t(TraceRecorder::ROLLING_SLICES);
+	TraceRecorder recorder;
+	// An event of 1 us per slice, ending in it, then one of 2 us in the last slice
+	for (int64_t i = 0; i < 2 * slices; i++) recorder.record("Phase", i * slice + slice / 2, 1000);
+	recorder.record("Phase", (2 * slices - 1) * slice, 2000);
+
+	// The window has them all, the rolling statistics the last slices only
+	const auto stats = recorder.computeStats();
+	CHECK_EQ(stats.at("Phase").count, size_t(2 * slices + 1));
+	const int64_t now = 2 * slices * slice - 1;
+	auto rolling = recorder.computeRollingStats(now);
+	CHECK_EQ(rolling.at("Phase").count, size_t(slices + 1));
+	CHECK_EQ(rolling.at("Phase").maxUs, 2.0);
+	CHECK(near(rolling.at("Phase").meanUs, double(slices + 2) / double(slices + 1), 1e-9));
+
+	// The slices drop out as the time moves on, even with no new events
+	rolling = recorder.computeRollingStats(now + slice);
+	CHECK_EQ(rolling.at("Phase").count, size_t(slices));
+	CHECK(recorder.computeRollingStats(now + slices * slice).empty());
+
+	// An event that ends in a slice already reused is late for the rolling statistics, not for the window
+	recorder.record("Phase", slice / 2, 1000);
+	rolling = recorder.computeRollingStats(now);
+	CHECK_EQ(rolling.at("Phase").count, size_t(slices + 1));
+	const auto later = recorder.computeStats();
+	CHECK_EQ(later.at("Phase").count, size_t(2 * slices + 2));
+
+	// A new slice clears the one it reuses
+	recorder.record("Phase", 2 * slices * slice, 3000);
+	rolling = recorder.computeRollingStats(now + 1);
+	CHECK_EQ(rolling.at("Phase").count, size_t(slices + 1));
+	CHECK_EQ(rolling.at("Phase").minUs, 1.0);
+	CHECK_EQ(rolling.at("Phase").maxUs, 3.0);
+}
+
+TEST(TraceRecorder, ResetClearsTheRollingStats) {
+	TraceRecorder recorder;
+	recorder.record("Phase", 0, 9000);
+	recorder.resetStats();
+	CHECK(recorder.computeRollingStats(0).empty());
+
+	recorder.record("Phase", 0, 1000);
+	std::thread([&recorder] { recorder.record("Other", 0, 2000); }).join();
+	const auto rolling = recorder.computeRollingStats(0);
+	CHECK_EQ(rolling.size(), size_t(2));
+	CHECK_EQ(rolling.at("Phase").count, size_t(1));
+	CHECK_EQ(rolling.at("Phase").maxUs, 1.0);
+
+	std::ostringstream out;
+	recorder.writeRollingStats(out, 0);
+	CHECK_EQ(countOccurrences(out.str(), "count 1,"), size_t(2));
+}
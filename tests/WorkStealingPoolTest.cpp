@@ -0,0 +1,89 @@
+#include "TestFramework.h"
+#include "../WorkStealingPool.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+TEST(WorkStealingPool, RunsEveryTask) {
+	std::atomic<int> done = 0;
+	{
+		WorkStealingPool pool(4);
+		CHECK_EQ(pool.getThreadCount(), 4u);
+		for (int i = 0; i < 10000; i++) pool.submit([&done] { done.fetch_add(1); });
+	}
+	CHECK_EQ(done.load(), 10000);
+}
+
+TEST(WorkStealingPool, KeepsTheClaimsUnderContention) {
+	// Several threads submitting at once while the workers steal from each other: a claimed task
+	// that a worker fails to find must not be lost, or the pool stops with it still queued
+	for (int round = 0; round < 200; round++) {
+		std::atomic<int> done = 0;
+		{
+			WorkStealingPool pool(4);
+			std::vector<std::thread> submitters;
+			for (int t = 0; t < 4; t++) {
+				submitters.emplace_back([&pool, &done] {
+					for (int i = 0; i < 500; i++) pool.submit([&done] { done.fetch_add(1); });
+				});
+			}
+			for (auto& submitter : submitters) submitter.join();
+		}
+		CHECK_EQ(done.load(), 4 * 500);
+	}
+}
+
+TEST(WorkStealingPool, RunsTheTasksSubmittedByTasks) {
+	std::atomic<int> done = 0;
+	{
+		WorkStealingPool pool(4);
+		for (int i = 0; i < 100; i++) {
+			pool.submit([&pool, &done] {
+				for (int j = 0; j < 100; j++) pool.submit([&done] { done.fetch_add(1); });
+			});
+		}
+	}
+	CHECK_EQ(done.load(), 10000);
+}
+
+TEST(WorkStealingPool, WakesTheSleepingWorkers) {
+	WorkStealingPool pool(2);
+	// Long enough for the workers to go to sleep between the rounds
+	for (int round = 0; round < 3; round++) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		std::vector<std::future<int>> results;
+		for (int i = 0; i < 8; i++) results.push_back(pool.async([i] { return i * i; }));
+		for (int i = 0; i < 8; i++) CHECK_EQ(results[i].get(), i * i);
+	}
+}
+
+TEST(WorkStealingPool, OtherWorkersStealTheTasks) {
+	// A worker blocked in a task while its own queue fills up
+	WorkStealingPool pool(2);
+	std::atomic<bool> release = false;
+	std::atomic<int> done = 0;
+	auto blocker = pool.async([&] {
+		for (int i = 0; i < 100; i++) pool.submit([&done] { done.fetch_add(1); });
+		while (!release.load()) std::this_thread::yield();
+	});
+	while (done.load() < 100) std::this_thread::yield();
+	release = true;
+	blocker.get();
+}
+
+TEST(WorkStealingPool, PassesTheExceptionsThroughTheFutures) {
+	WorkStealingPool pool(2);
+	auto failing = pool.async([]() -> int { throw std::runtime_error("task"); });
+	auto working = pool.async([] { return 42; });
+	CHECK_THROWS(failing.get(), std::runtime_error);
+	CHECK_EQ(working.get(), 42);
+}
+
+TEST(WorkStealingPool, StopsWhenIdle) {
+	for (int i = 0; i < 20; i++) {
+		WorkStealingPool pool(3);
+	}
+}
@@ -0,0 +1,26 @@
+#include "TestFramework.h"
+
+#include <cstring>
+#include <iostream>
+
+// Runs the registered tests. Usage: noflicker_tests [suite...]
+int main(int argc, char* argv[]) {
+	size_t passed = 0, failed = 0;
+	for (const TestCase& test : testRegistry()) {
+		bool selected = argc < 2;
+		for (int i = 1; i < argc && !selected; i++) selected = std::strcmp(argv[i], test.suite) == 0;
+		if (!selected) continue;
+
+		try {
+			test.run();
+			passed++;
+			std::cout << "[  OK  ] " << test.suite << "." << test.name << std::endl;
+		} catch (const std::exception& e) {
+			failed++;
+			std::cout << "[ FAIL ] " << test.suite << "." << test.name << ": " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << passed << " passed, " << failed << " failed" << std::endl;
+	return failed == 0 && passed > 0 ? 0 : 1;
+}